@@ -74,6 +74,8 @@ int main(int argc, char **argv)
         return rc;
     Q_ASSERT(server.isListening());
 
+    app.logHttpStatistics(&server);
+
     try {
         auto ep = app.serverAddressFromArguments(1235);
         if (!ep.hostname.empty())
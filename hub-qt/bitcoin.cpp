@@ -259,6 +259,7 @@ private:
 #include "bitcoin.moc"
 
 BitcoinCore::BitcoinCore()
+    : scheduler(Application::instance()->ioService())
 {
 }
 
@@ -292,6 +293,7 @@ void BitcoinCore::shutdown()
         qDebug() << __func__ << ": Running Shutdown in thread";
         hubApiServices.reset();
         Interrupt(threadGroup);
+        scheduler.stop();
         threadGroup.join_all();
         Shutdown();
         qDebug() << __func__ << ": Shutdown finished";
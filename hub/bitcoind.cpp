@@ -75,7 +75,7 @@ static bool SelectChain()
 bool AppInit(int argc, char* argv[])
 {
     boost::thread_group threadGroup;
-    CScheduler scheduler;
+    CScheduler scheduler(Application::instance()->ioService());
 
     bool fRet = false;
 
@@ -189,6 +189,7 @@ bool AppInit(int argc, char* argv[])
     } else {
         WaitForShutdown(&threadGroup);
     }
+    scheduler.stop();
     hubApiServices.reset();
     Shutdown();
 
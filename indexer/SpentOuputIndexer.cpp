@@ -18,6 +18,7 @@
 #include "SpentOuputIndexer.h"
 #include "Indexer.h"
 
+#include <IndexerKeys.h>
 #include <Message.h>
 #include <APIProtocol.h>
 #include <streaming/MessageParser.h>
@@ -47,13 +48,13 @@ void SpentOutputIndexer::blockFinished(int blockheight, const uint256 &blockId)
 
 void SpentOutputIndexer::insertSpentTransaction(const uint256 &prevTxId, int prevOutIndex, int blockHeight, int offsetInBlock)
 {
-    m_txdb.insert(prevTxId, prevOutIndex, blockHeight, offsetInBlock);
+    IndexerKeys::insertSpentOutput(m_txdb, prevTxId, prevOutIndex, blockHeight, offsetInBlock);
 }
 
 SpentOutputIndexer::TxData SpentOutputIndexer::findSpendingTx(const uint256 &txid, int output) const
 {
     TxData answer;
-    auto item = m_txdb.find(txid, output);
+    auto item = IndexerKeys::findSpentOutput(m_txdb, txid, output);
     if (item.isValid()) {
         answer.blockHeight = item.blockHeight();
         answer.offsetInBlock = item.offsetInBlock();
@@ -98,7 +99,7 @@ void SpentOutputIndexer::run()
                 assert(parser.isInt());
                 assert(blockHeight >= 0);
                 assert(txOffsetInBlock > 80);
-                m_txdb.insert(prevTxId, parser.intData(), blockHeight, txOffsetInBlock);
+                IndexerKeys::insertSpentOutput(m_txdb, prevTxId, parser.intData(), blockHeight, txOffsetInBlock);
             }
         }
         assert(blockHeight > 0);
@@ -18,6 +18,7 @@
 #include "TxIndexer.h"
 #include "Indexer.h"
 
+#include <IndexerKeys.h>
 #include <Message.h>
 #include <APIProtocol.h>
 #include <streaming/MessageParser.h>
@@ -46,13 +47,13 @@ void TxIndexer::blockFinished(int blockheight, const uint256 &blockId)
 
 void TxIndexer::insert(const uint256 &txid, int blockHeight, int offsetInBlock)
 {
-    m_txdb.insert(txid, 0, blockHeight, offsetInBlock);
+    IndexerKeys::insertTransaction(m_txdb, txid, blockHeight, offsetInBlock);
 }
 
 TxIndexer::TxData TxIndexer::find(const uint256 &txid) const
 {
     TxData answer;
-    auto item = m_txdb.find(txid, 0);
+    auto item = IndexerKeys::findTransaction(m_txdb, txid);
     if (item.isValid()) {
         answer.blockHeight = item.blockHeight();
         answer.offsetInBlock = item.offsetInBlock();
@@ -87,7 +88,7 @@ void TxIndexer::run()
                 if (txOffsetInBlock > 0 && !txid.IsNull()) {
                     assert(blockHeight >= 0);
                     assert(blockHeight > m_txdb.blockheight());
-                    m_txdb.insert(txid, 0, blockHeight, txOffsetInBlock);
+                    IndexerKeys::insertTransaction(m_txdb, txid, blockHeight, txOffsetInBlock);
                 }
                 txOffsetInBlock = 0;
             } else if (parser.tag() == Api::BlockChain::Tx_OffsetInBlock) {
@@ -102,7 +103,7 @@ void TxIndexer::run()
         if (txOffsetInBlock > 0 && !txid.IsNull()) {
             assert(blockHeight > 0);
             assert(blockHeight > m_txdb.blockheight());
-            m_txdb.insert(txid, 0, blockHeight, txOffsetInBlock);
+            IndexerKeys::insertTransaction(m_txdb, txid, blockHeight, txOffsetInBlock);
         }
         m_txdb.blockFinished(blockHeight, blockId);
         if (blockHeight == tipOfChain)
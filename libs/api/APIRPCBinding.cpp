@@ -40,6 +40,7 @@
 #include <boost/algorithm/hex.hpp>
 #include <BlockMetaData.h>
 #include <list>
+#include <map>
 
 namespace {
 
@@ -234,7 +235,13 @@ public:
  */
 struct TransactionSerializationOptions
 {
-    void serialize(Streaming::MessageBuilder &builder, Tx::Iterator &iter)
+    /**
+     * Serialize the transaction \a iter points to.
+     * The \a outputs are optional precomputed output data from the BlockMetaData
+     * (\a outputCount items), which avoids hashing the output scripts.
+     */
+    void serialize(Streaming::MessageBuilder &builder, Tx::Iterator &iter,
+                   const BlockMetaData::OutputData *outputs = nullptr, int outputCount = 0)
     {
         int outIndex = 0;
         auto type = iter.next();
@@ -279,7 +286,10 @@ struct TransactionSerializationOptions
                             }
                         }
                     }
-                    if (returnOutputScriptHashed) {
+                    if (returnOutputScriptHashed && outputs && outIndex < outputCount) {
+                        builder.addByteArray(Api::BlockChain::Tx_Out_ScriptHash, outputs[outIndex].scriptHash, 32);
+                    }
+                    else if (returnOutputScriptHashed) {
                         CSHA256 sha;
                         sha.Write(iter.byteData().begin(), iter.dataLength());
                         char buf[32];
@@ -437,8 +447,22 @@ public:
             throw Api::ParserException(requestOk ? "Requested block not found" :
                                                    "Request needs to contain either height or blockhash");
         m_height = index->nHeight;
+        m_blockId = index->GetBlockHash();
+        BlockMetaData metaData;
+        if ((m_scriptFilter > 0 || filterOnScriptHashes || opt.returnOutputScriptHashed)
+                && (index->nStatus & BLOCK_HAVE_METADATA)) {
+            try {
+                metaData = Blocks::DB::instance()->loadBlockMetaData(index->GetMetaDataPos());
+            } catch (...) {}
+        }
+        if (filterOnScriptHashes && m_scriptFilter <= 0) {
+            // the script-hash filter allows us to skip blocks without any matches without loading them.
+            const auto filter = metaData.scriptHashFilter();
+            if (filter.isValid() && !filter.containsAny(session->hashes))
+                return 45;
+        }
         try {
-            m_block = Blocks::DB::instance()->loadBlock(index->GetBlockPos());
+            m_block = Blocks::DB::instance()->loadBlock(index->GetBlockPos(), Blocks::SequentialAccess);
             assert(m_block.isFullBlock());
         } catch (...) {
             throw Api::ParserException("Blockdata not present on this Hub");
@@ -446,13 +470,13 @@ public:
 
         // use faster matching using the metadata.
         const BlockMetaData::TransactionData *txData = nullptr;
-        BlockMetaData metaData;
-        if (m_scriptFilter > 0) {
-            try {
-                metaData = Blocks::DB::instance()->loadBlockMetaData(index->GetMetaDataPos());
-                txData = metaData.first();
-            } catch (...) {}
-        }
+        if (m_scriptFilter > 0 && metaData.txCount() > 0)
+            txData = metaData.first();
+        // the metadata may hold the script-hashes, avoiding us hashing all the scripts.
+        const bool useOutputData = metaData.hasOutputData() && metaData.txCount() > 0;
+        if (useOutputData)
+            m_metaData = metaData;
+        int txIndex = 0, outIndex = 0;
 
         Tx::Iterator iter(m_block);
         auto type = iter.next();
@@ -472,10 +496,14 @@ public:
                     matchedOutputs += txOutputCount;
                     matchedOutputScriptSizes += txOutputScriptSizes;
                     m_transactions.push_back(std::make_pair(prevTx.offsetInBlock(m_block), prevTx.size()));
+                    if (useOutputData)
+                        m_txIndexes.push_back(txIndex);
                     txMatched = !filterOnScriptHashes && txData == nullptr;
                 }
                 oneEnd = true;
                 coinbase = false;
+                ++txIndex;
+                outIndex = 0;
 
                 txInputSize = 0;
                 txOutputCount = 0;
@@ -502,9 +530,15 @@ public:
                     // m_scriptFilter is a flags where ANY bit should match.
                     txMatched = (m_scriptFilter & txData->scriptTags) != 0;
                 }
-                if (!txMatched
-                        && session->hashes.find(iter.hashedByteData()) != session->hashes.end())
-                    txMatched = true;
+                if (!txMatched && !session->hashes.empty()) {
+                    uint256 scriptHash;
+                    if (useOutputData && outIndex < m_metaData.outputCount(txIndex))
+                        scriptHash = uint256(m_metaData.outputs(txIndex)[outIndex].scriptHash);
+                    else
+                        iter.hashByteData(scriptHash);
+                    txMatched = session->hashes.find(scriptHash) != session->hashes.end();
+                }
+                ++outIndex;
             }
             type = iter.next();
         }
@@ -537,10 +571,12 @@ public:
 
     void buildReply(const Message&, Streaming::MessageBuilder &builder) override {
         assert(m_height >= 0);
+        Blocks::PageFaultCounter faultCounter(Blocks::SequentialAccess);
         builder.add(Api::BlockChain::BlockHeight, m_height);
-        builder.add(Api::BlockChain::BlockHash, m_block.createHash());
+        builder.add(Api::BlockChain::BlockHash, m_blockId);
 
-        for (auto posAndSize : m_transactions) {
+        for (size_t i = 0; i < m_transactions.size(); ++i) {
+            const auto &posAndSize = m_transactions.at(i);
             if (m_returnOffsetInBlock)
                 builder.add(Api::BlockChain::Tx_OffsetInBlock, posAndSize.first);
             if (m_returnTxId) {
@@ -553,7 +589,12 @@ public:
                     iter.next(Tx::PrevTxIndex); // skip version, prevTxId and prevTxIndex for coinbase
                     assert(iter.tag() == Tx::PrevTxIndex);
                 }
-                opt.serialize(builder, iter);
+                if (m_txIndexes.empty()) {
+                    opt.serialize(builder, iter);
+                } else {
+                    const int txIndex = m_txIndexes.at(i);
+                    opt.serialize(builder, iter, m_metaData.outputs(txIndex), m_metaData.outputCount(txIndex));
+                }
             }
             if (m_fullTxData)
                 builder.add(Api::BlockChain::GenericByteData,
@@ -564,7 +605,10 @@ public:
     }
 
     FastBlock m_block;
+    uint256 m_blockId;
+    BlockMetaData m_metaData; // only set if it has output data
     std::vector<std::pair<int, int>> m_transactions; // list of offset-in-block and length of tx to include
+    std::vector<int> m_txIndexes; // the index in block for each of m_transactions, if we have m_metaData
     bool m_fullTxData = true;
     bool m_returnTxId = false;
     bool m_returnOffsetInBlock = true;
@@ -572,6 +616,51 @@ public:
     int  m_scriptFilter = -1;
     TransactionSerializationOptions opt;
 };
+class GetBlockFilter : public Api::DirectParser
+{
+public:
+    GetBlockFilter() : DirectParser(Api::BlockChain::GetBlockFilterReply) {}
+
+    int calculateMessageSize(const Message &request) override {
+        CBlockIndex *index = nullptr;
+        Streaming::MessageParser parser(request.body());
+        while (parser.next() == Streaming::FoundTag) {
+            if (parser.tag() == Api::BlockChain::BlockHash) {
+                if (parser.dataLength() != 32)
+                    throw Api::ParserException("BlockHash should be a 32 byte-bytearray");
+                index = Blocks::Index::get(parser.uint256Data());
+            } else if (parser.tag() == Api::BlockChain::BlockHeight) {
+                index = chainActive[parser.intData()];
+            }
+        }
+        if (index == nullptr)
+            throw Api::ParserException("Requested block not found");
+        if ((index->nStatus & BLOCK_HAVE_METADATA) == 0)
+            throw Api::ParserException("Blockfilter not present on this Hub");
+        try {
+            m_filter = Blocks::DB::instance()->loadBlockMetaData(index->GetMetaDataPos()).scriptHashFilter();
+        } catch (...) {
+            throw Api::ParserException("Blockfilter not present on this Hub");
+        }
+        if (!m_filter.isValid())
+            throw Api::ParserException("Blockfilter not present on this Hub");
+        m_index = index;
+        return m_filter.data().size() + 60;
+    }
+
+    void buildReply(const Message&, Streaming::MessageBuilder &builder) override {
+        assert(m_index);
+        builder.add(Api::BlockChain::BlockHeight, m_index->nHeight);
+        builder.add(Api::BlockChain::BlockHash, m_index->GetBlockHash());
+        builder.add(Api::BlockChain::FilterItemCount, m_filter.itemCount());
+        builder.add(Api::BlockChain::GenericByteData, m_filter.data());
+    }
+
+private:
+    CBlockIndex *m_index = nullptr;
+    GolombCodedSet m_filter;
+};
+
 class GetBlockCount : public Api::DirectParser
 {
 public:
@@ -768,13 +857,131 @@ public:
     }
 };
 
+/**
+ * The parts shared by GetTransaction and GetTransactions, which both return
+ * transactions found by their position in a block.
+ */
+struct TransactionByPosition
+{
+    /// Reads the option the \a parser points to.
+    void readOption(const Streaming::MessageParser &parser) {
+        if (parser.tag() == Api::BlockChain::FullTransactionData) {
+            m_explicitFullTxData = parser.boolData();
+            if (!m_explicitFullTxData)
+                fullTxData = false;
+        } else if (parser.tag() == Api::BlockChain::Include_TxId) {
+            returnTxId = parser.boolData();
+        } else if (parser.tag() == Api::BlockChain::Include_OffsetInBlock) {
+            returnOffsetInBlock = parser.boolData();
+        } else if (parser.tag() == Api::BlockChain::FilterOutputIndex) {
+            if (!parser.isInt() || parser.intData() < 0)
+                throw Api::ParserException("FilterOutputIndex should be a positive number");
+            opt.filterOutputs.insert(parser.intData());
+        } else if (parser.tag() == Api::BlockChain::Include_TxFee) {
+            returnTxFee = parser.boolData();
+        } else {
+            opt.readParser(parser);
+        }
+    }
+
+    /// Call after all options have been read.
+    void finishOptions() {
+        if (m_explicitFullTxData) // if explicitly asked.
+            fullTxData = true;
+        else if (returnTxId || opt.shouldRun()) // we imply false if they want a subset.
+            fullTxData = false;
+    }
+
+    static FastBlock loadBlock(const CBlockIndex *index) {
+        assert(index);
+        if (index->nDataPos < 4 || (index->nStatus & BLOCK_HAVE_DATA) == 0)
+            throw Api::ParserException("Block known but data not available");
+        FastBlock block;
+        try {
+            block = Blocks::DB::instance()->loadBlock(index->GetBlockPos());
+            assert(block.isFullBlock());
+        } catch (...) {
+            throw Api::ParserException("Blockdata not present on this Hub");
+        }
+        return block;
+    }
+
+    /// Loads the block meta data into \a meta, returns true if it has the fees.
+    static bool loadFees(const CBlockIndex *index, BlockMetaData &meta) {
+        if ((index->nStatus & BLOCK_HAVE_METADATA) == 0)
+            return false;
+        try {
+            meta = Blocks::DB::instance()->loadBlockMetaData(index->GetMetaDataPos());
+            return meta.hasFeesData();
+        } catch (...) { }
+        return false;
+    }
+
+    static Tx findTransaction(const FastBlock &block, int offsetInBlock) {
+        if (offsetInBlock > block.size() - 60)
+            throw Api::ParserException("OffsetInBlock larger than block");
+        try {
+            Tx::Iterator iter(block, offsetInBlock);
+            iter.next(Tx::End);
+            if (iter.tag() == Tx::End)
+                return iter.prevTx();
+        } catch (const std::runtime_error &e) {
+            throw Api::ParserException("Invalid offsetInBlock");
+        }
+        return Tx();
+    }
+
+    /// Returns the fee paid by the transaction at \a offsetInBlock, or -1 if unknown.
+    static int findFee(const BlockMetaData &meta, int offsetInBlock) {
+        if (offsetInBlock <= 90)
+            return -1;
+        auto tx = meta.findTransaction(offsetInBlock);
+        return tx ? static_cast<int>(tx->fees) : -1;
+    }
+
+    int calculateMessageSize(const Tx &tx, int fee) {
+        int amount = fullTxData ? tx.size() + 10 : 0;
+        if (returnTxId) amount += 40;
+        if (returnOffsetInBlock) amount += 10;
+        if (fee >= 0) amount += 10;
+        if (opt.shouldRun())
+            amount += opt.calculateNeededSize(tx);
+        return amount;
+    }
+
+    void serialize(Streaming::MessageBuilder &builder, const Tx &tx, int offsetInBlock, int fee) {
+        if (returnTxId)
+            builder.add(Api::BlockChain::TxId, tx.createHash());
+        if (returnOffsetInBlock)
+            builder.add(Api::BlockChain::Tx_OffsetInBlock, offsetInBlock);
+        if (fee >= 0)
+            builder.add(Api::BlockChain::Tx_Fees, fee);
+        if (tx.size() > 0) {
+            if (opt.shouldRun()) {
+                Tx::Iterator iter(tx);
+                opt.serialize(builder, iter);
+            }
+            if (fullTxData)
+                builder.add(Api::BlockChain::GenericByteData, tx.data());
+        }
+    }
+
+    bool fullTxData = true;
+    bool returnTxId = false;
+    bool returnOffsetInBlock = false;
+    bool returnTxFee = false;
+    TransactionSerializationOptions opt;
+
+private:
+    bool m_explicitFullTxData = false;
+};
+
 class GetTransaction : public Api::DirectParser {
 public:
     GetTransaction() : DirectParser(Api::BlockChain::GetTransactionReply) {}
     int calculateMessageSize(const Message &request) override {
         Streaming::MessageParser parser(request);
         CBlockIndex *index = nullptr;
-        bool fullTxData = false;
         while (parser.next() == Streaming::FoundTag) {
             if (parser.tag() == Api::BlockChain::BlockHeight) {
                 index = chainActive[parser.intData()];
@@ -788,93 +995,129 @@ public:
                 m_offsetInBlock = parser.intData();
                 if (m_offsetInBlock < 81)
                     throw Api::ParserException("OffsetInBlock out of range");
-            } else if (parser.tag() == Api::BlockChain::FullTransactionData) {
-                fullTxData = parser.boolData();
-                if (!fullTxData)
-                    m_fullTxData = false;
-            } else if (parser.tag() == Api::BlockChain::Include_TxId) {
-                m_returnTxId = parser.boolData();
-            } else if (parser.tag() == Api::BlockChain::Include_OffsetInBlock) {
-                m_returnOffsetInBlock = parser.boolData();
-            } else if (parser.tag() == Api::BlockChain::FilterOutputIndex) {
-                if (!parser.isInt() || parser.intData() < 0)
-                    throw Api::ParserException("FilterOutputIndex should be a positive number");
-                opt.filterOutputs.insert(parser.intData());
-            } else if (parser.tag() == Api::BlockChain::Include_TxFee) {
-                m_returnTxFee = parser.boolData();
             } else {
-                opt.readParser(parser);
+                m_helper.readOption(parser);
             }
         }
-        if (fullTxData) // if explicitly asked.
-            m_fullTxData = true;
-        else if (m_returnTxId || opt.shouldRun()) // we imply false if they want a subset.
-            m_fullTxData = false;
+        m_helper.finishOptions();
 
         if (!index || m_offsetInBlock < 81)
             throw Api::ParserException("Incomplete request.");
-        if (index->nDataPos < 4 || (index->nStatus & BLOCK_HAVE_DATA) == 0)
-            throw Api::ParserException("Block known but data not available");
+        FastBlock block = TransactionByPosition::loadBlock(index);
+        Blocks::PageFaultCounter faultCounter(Blocks::NormalAccess);
+        m_tx = TransactionByPosition::findTransaction(block, m_offsetInBlock);
+        BlockMetaData meta;
+        if (m_helper.returnTxFee && TransactionByPosition::loadFees(index, meta))
+            m_txFee = TransactionByPosition::findFee(meta, m_offsetInBlock);
+        return m_helper.calculateMessageSize(m_tx, m_txFee);
+    }
+    void buildReply(const Message &, Streaming::MessageBuilder &builder) override {
+        m_helper.serialize(builder, m_tx, m_offsetInBlock, m_txFee);
+    }
 
-        FastBlock block;
-        try {
-            block = Blocks::DB::instance()->loadBlock(index->GetBlockPos());
-            assert(block.isFullBlock());
-        } catch (...) {
-            throw Api::ParserException("Blockdata not present on this Hub");
+private:
+    TransactionByPosition m_helper;
+    int m_offsetInBlock = 0;
+    int m_txFee = -1;
+    Tx m_tx;
+};
+
+class GetTransactions : public Api::DirectParser {
+public:
+    GetTransactions() : DirectParser(Api::BlockChain::GetTransactionsReply) {}
+    int calculateMessageSize(const Message &request) override {
+        Streaming::MessageParser parser(request);
+        int height = -1;
+        while (parser.next() == Streaming::FoundTag) {
+            if (parser.tag() == Api::BlockChain::BlockHeight) {
+                height = parser.intData();
+            } else if (parser.tag() == Api::BlockChain::Tx_OffsetInBlock) {
+                if (height < 0)
+                    throw Api::ParserException("Tx_OffsetInBlock without BlockHeight");
+                if (m_items.size() >= MaxItems) // protect the Hub from DOS.
+                    throw Api::ParserException("Too many transactions requested");
+                Item item;
+                item.height = height;
+                item.offsetInBlock = parser.intData();
+                if (item.offsetInBlock < 81)
+                    throw Api::ParserException("OffsetInBlock out of range");
+                m_items.push_back(item);
+            } else if (parser.tag() != Api::BlockChain::Separator) {
+                m_helper.readOption(parser);
+            }
         }
-        if (m_offsetInBlock > block.size() - 60)
-            throw Api::ParserException("OffsetInBlock larger than block");
-        try {
-            Tx::Iterator iter(block, m_offsetInBlock);
-            iter.next(Tx::End);
-            if (iter.tag() == Tx::End)
-                m_tx = iter.prevTx();
-        } catch (const std::runtime_error &e) {
-            throw Api::ParserException("Invalid offsetInBlock");
+        m_helper.finishOptions();
+        m_helper.returnOffsetInBlock = false; // always added, see buildReply()
+        if (m_items.empty())
+            throw Api::ParserException("Incomplete request.");
+
+        // Visit the transactions in on-disk order, that way each block is mapped only once
+        // and the reads move forward through the block files.
+        std::vector<CBlockIndex*> indexes;
+        indexes.reserve(m_items.size());
+        for (const Item &item : m_items) {
+            CBlockIndex *index = chainActive[item.height];
+            if (!index)
+                throw Api::ParserException("Unknown blockheight");
+            if (index->nDataPos < 4 || (index->nStatus & BLOCK_HAVE_DATA) == 0)
+                throw Api::ParserException("Block known but data not available");
+            indexes.push_back(index);
         }
-        if (m_returnTxFee && m_offsetInBlock > 90) {
-            try {
-                BlockMetaData meta = Blocks::DB::instance()->loadBlockMetaData(index->GetMetaDataPos());
-                auto tx = meta.findTransaction(m_offsetInBlock);
-                if (tx && meta.hasFeesData())
-                    m_txFee = tx->fees;
-            } catch (...) { }
+        std::vector<int> order(m_items.size());
+        for (size_t i = 0; i < order.size(); ++i) {
+            order[i] = static_cast<int>(i);
+        }
+        std::sort(order.begin(), order.end(), [&](int a, int b) {
+            const CBlockIndex *ia = indexes.at(a);
+            const CBlockIndex *ib = indexes.at(b);
+            if (ia->nFile != ib->nFile)
+                return ia->nFile < ib->nFile;
+            if (ia->nDataPos != ib->nDataPos)
+                return ia->nDataPos < ib->nDataPos;
+            return m_items.at(a).offsetInBlock < m_items.at(b).offsetInBlock;
+        });
+
+        Blocks::PageFaultCounter faultCounter(Blocks::NormalAccess);
+        const CBlockIndex *currentIndex = nullptr;
+        FastBlock block;
+        BlockMetaData meta;
+        bool haveFees = false;
+        int amount = 0;
+        for (const int i : order) {
+            Item &item = m_items[i];
+            if (indexes.at(i) != currentIndex) {
+                currentIndex = indexes.at(i);
+                block = TransactionByPosition::loadBlock(currentIndex);
+                haveFees = m_helper.returnTxFee && TransactionByPosition::loadFees(currentIndex, meta);
+            }
+            item.tx = TransactionByPosition::findTransaction(block, item.offsetInBlock);
+            if (haveFees)
+                item.fee = TransactionByPosition::findFee(meta, item.offsetInBlock);
+            amount += 22; // height, offset and separator
+            amount += m_helper.calculateMessageSize(item.tx, item.fee);
         }
-
-        int amount = m_fullTxData ? m_tx.size() + 10 : 0;
-        if (m_returnTxId) amount += 40;
-        if (m_returnOffsetInBlock) amount += 10;
-        if (opt.shouldRun())
-            amount += opt.calculateNeededSize(m_tx);
         return amount;
     }
     void buildReply(const Message &, Streaming::MessageBuilder &builder) override {
-        if (m_returnTxId)
-            builder.add(Api::BlockChain::TxId, m_tx.createHash());
-        if (m_returnOffsetInBlock)
-            builder.add(Api::BlockChain::Tx_OffsetInBlock, m_offsetInBlock);
-        if (m_txFee >= 0)
-            builder.add(Api::BlockChain::Tx_Fees, m_txFee);
-        if (m_tx.size() > 0) {
-            if (opt.shouldRun()) {
-                Tx::Iterator iter(m_tx);
-                opt.serialize(builder, iter);
-            }
-            if (m_fullTxData)
-                builder.add(Api::BlockChain::GenericByteData, m_tx.data());
+        for (const Item &item : m_items) {
+            builder.add(Api::BlockChain::BlockHeight, item.height);
+            builder.add(Api::BlockChain::Tx_OffsetInBlock, item.offsetInBlock);
+            m_helper.serialize(builder, item.tx, item.offsetInBlock, item.fee);
+            builder.add(Api::BlockChain::Separator, true);
         }
     }
 
 private:
-    bool m_fullTxData = true;
-    bool m_returnTxId = false;
-    bool m_returnOffsetInBlock = false;
-    bool m_returnTxFee = false;
-    int m_offsetInBlock = 0;
-    int m_txFee = -1;
-    Tx m_tx;
-    TransactionSerializationOptions opt;
+    static constexpr size_t MaxItems = 2500;
+
+    struct Item {
+        int height = -1;
+        int offsetInBlock = 0;
+        int fee = -1;
+        Tx tx;
+    };
+    std::vector<Item> m_items; // in request order
+    TransactionByPosition m_helper;
 };
 
 class UtxoFetcher: public Api::DirectParser
@@ -899,6 +1142,7 @@ public:
         } catch (...) {
             throw Api::ParserException("Blockdata not present on this Hub");
         }
+        Blocks::PageFaultCounter faultCounter(Blocks::NormalAccess);
         if (offsetInBlock > block.size())
             throw Api::ParserException("OffsetInBlock larger than block");
         Tx::Iterator iter(block, offsetInBlock);
@@ -1049,22 +1293,18 @@ public:
 
         if (!scriptHashes.empty()) {
             LOCK(mempool.cs);
-            for (auto iter = mempool.mapTx.begin(); iter != mempool.mapTx.end(); ++iter) {
-                Tx::Iterator txIter(iter->tx);
-                int outIndex = 0;
-                while (txIter.next(Tx::OutputScript) == Tx::OutputScript) {
-                    auto hit = scriptHashes.find(txIter.hashedByteData());
-                    if (hit != scriptHashes.end()) {
-                        ResultPair result;
-                        result.tx = iter->tx;
-                        result.dsProof = iter->dsproof;
-                        result.time = iter->GetTime();
-                        result.outputIndex = outIndex;
-                        m_results.push_back(std::move(result));
-                        if (m_results.size() > 2500) // protect the Hub from DOS.
-                            break;
-                    }
-                    ++outIndex;
+            // protect the Hub from DOS, the limit is for the request as a whole.
+            constexpr size_t MaxResults = 2500;
+            for (const uint256 &hash : scriptHashes) {
+                if (m_results.size() >= MaxResults)
+                    break;
+                for (const auto &match : mempool.findByScriptHash(hash, MaxResults - m_results.size())) {
+                    ResultPair result;
+                    result.tx = match.entry->tx;
+                    result.dsProof = match.entry->dsproof;
+                    result.time = match.entry->GetTime();
+                    result.outputIndex = match.outIndex;
+                    m_results.push_back(std::move(result));
                 }
             }
         }
@@ -1135,6 +1375,7 @@ public:
         Streaming::MessageParser parser(m_request);
         Tx tx;
         bool validateOnly = false;
+        bool keepOrphan = false;
         while (parser.next() == Streaming::FoundTag) {
             if (parser.tag() == Api::LiveTransactions::Transaction
                     || parser.tag() == Api::LiveTransactions::GenericByteData) {
@@ -1144,6 +1385,8 @@ public:
             }
             if (parser.tag() == Api::LiveTransactions::ValidateOnly)
                 validateOnly = parser.boolData();
+            else if (parser.tag() == Api::LiveTransactions::KeepOrphan)
+                keepOrphan = parser.boolData();
         }
         if (tx.data().isEmpty())
             throw Api::ParserException("No transaction found in message");
@@ -1151,6 +1394,8 @@ public:
         std::uint32_t flags = 0;
         if (validateOnly)
             flags += Validation::TxValidateOnly;
+        else if (keepOrphan)
+            flags += Validation::KeepOrphanTx;
         flags += Validation::RejectAbsurdFeeTx;
         auto resultFuture = Application::instance()->validation()->addTransaction(tx, flags);
         auto result = resultFuture.get(); // <= blocking call.
@@ -1169,6 +1414,166 @@ private:
     uint256 m_txid;
 };
 
+class SendLiveTransactionsASync : public Api::ASyncParser {
+public:
+    SendLiveTransactionsASync(const Message &request)
+        : Api::ASyncParser(request, Api::LiveTransactions::SendTransactionsReply)
+    {
+    }
+
+    void run() override {
+        Streaming::MessageParser parser(m_request);
+        bool validateOnly = false;
+        bool keepOrphan = false;
+        while (parser.next() == Streaming::FoundTag) {
+            if (parser.tag() == Api::LiveTransactions::Transaction
+                    || parser.tag() == Api::LiveTransactions::GenericByteData) {
+                if (m_entries.size() >= MaxBatchSize)
+                    throw Api::ParserException("Too many transactions in message");
+                Entry entry;
+                entry.tx = Tx(parser.bytesDataBuffer());
+                m_entries.push_back(entry);
+            }
+            else if (parser.tag() == Api::LiveTransactions::ValidateOnly)
+                validateOnly = parser.boolData();
+            else if (parser.tag() == Api::LiveTransactions::KeepOrphan)
+                keepOrphan = parser.boolData();
+        }
+        if (m_entries.empty())
+            throw Api::ParserException("No transactions found in message");
+
+        const int generations = sortByDependencies(validateOnly);
+
+        std::uint32_t flags = 0;
+        if (validateOnly)
+            flags += Validation::TxValidateOnly;
+        else if (keepOrphan)
+            flags += Validation::KeepOrphanTx;
+        flags += Validation::RejectAbsurdFeeTx;
+
+        // Each generation is validated concurrently, the next one is started only
+        // after its parents have been accepted into the mempool.
+        auto validation = Application::instance()->validation();
+        std::vector<std::pair<int, std::future<std::string> > > futures;
+        for (int generation = 0; generation < generations; ++generation) {
+            futures.clear();
+            for (size_t i = 0; i < m_entries.size(); ++i) {
+                Entry &entry = m_entries[i];
+                if (entry.generation != generation || !entry.error.empty())
+                    continue;
+                for (const int parent : entry.parents) {
+                    if (!m_entries[parent].error.empty()) {
+                        entry.error = "parent-in-batch-rejected";
+                        break;
+                    }
+                }
+                if (entry.error.empty())
+                    futures.push_back(std::make_pair(static_cast<int>(i), validation->addTransaction(entry.tx, flags)));
+            }
+            for (auto &future : futures) {
+                m_entries[future.first].error = future.second.get(); // <= blocking call.
+            }
+        }
+
+        m_messageSize = 0;
+        for (const Entry &entry : m_entries) {
+            m_messageSize += 40; // txid and separator
+            if (!entry.error.empty())
+                m_messageSize += entry.error.size() + 5;
+        }
+    }
+
+    void buildReply(Streaming::MessageBuilder &builder) override {
+        for (const Entry &entry : m_entries) {
+            builder.add(Api::LiveTransactions::TxId, entry.txid);
+            if (!entry.error.empty())
+                builder.add(Api::LiveTransactions::RejectReason, entry.error);
+            builder.add(Api::LiveTransactions::Separator, true);
+        }
+    }
+
+private:
+    /**
+     * Find the in-batch parents of each transaction and sort them topologically into
+     * generations, a transaction is in a later generation than all its parents.
+     * Returns the number of generations.
+     */
+    int sortByDependencies(bool validateOnly) {
+        std::map<uint256, int> txIndex;
+        for (size_t i = 0; i < m_entries.size(); ++i) {
+            Entry &entry = m_entries[i];
+            entry.txid = entry.tx.createHash();
+            txIndex.insert(std::make_pair(entry.txid, static_cast<int>(i)));
+        }
+        std::vector<std::vector<int> > children(m_entries.size());
+        std::vector<int> waitingFor(m_entries.size(), 0);
+        for (size_t i = 0; i < m_entries.size(); ++i) {
+            Entry &entry = m_entries[i];
+            try {
+                Tx::Iterator iter(entry.tx);
+                while (iter.next(Tx::PrevTxHash) != Tx::End) {
+                    auto parent = txIndex.find(iter.uint256Data());
+                    if (parent == txIndex.end() || parent->second == static_cast<int>(i))
+                        continue;
+                    if (std::find(entry.parents.begin(), entry.parents.end(), parent->second) != entry.parents.end())
+                        continue;
+                    entry.parents.push_back(parent->second);
+                    children[parent->second].push_back(static_cast<int>(i));
+                    ++waitingFor[i];
+                }
+            } catch (const std::exception &) {
+                entry.error = "malformed-transaction";
+            }
+            if (validateOnly && !entry.parents.empty() && entry.error.empty())
+                entry.error = "validate-only-with-parent-in-batch";
+        }
+
+        // Kahn's algorithm, starting with all transactions without in-batch parents.
+        std::deque<int> ready;
+        for (size_t i = 0; i < m_entries.size(); ++i) {
+            if (waitingFor[i] == 0)
+                ready.push_back(static_cast<int>(i));
+        }
+        int generations = 0;
+        size_t sorted = 0;
+        while (!ready.empty()) {
+            const int index = ready.front();
+            ready.pop_front();
+            ++sorted;
+            Entry &entry = m_entries[index];
+            for (const int parent : entry.parents) {
+                entry.generation = std::max(entry.generation, m_entries[parent].generation + 1);
+            }
+            generations = std::max(generations, entry.generation + 1);
+            for (const int child : children[index]) {
+                if (--waitingFor[child] == 0)
+                    ready.push_back(child);
+            }
+        }
+        if (sorted < m_entries.size()) { // only possible with bogus data.
+            for (size_t i = 0; i < m_entries.size(); ++i) {
+                if (waitingFor[i] > 0) {
+                    m_entries[i].error = "dependency-cycle-in-batch";
+                    m_entries[i].generation = -1;
+                }
+            }
+        }
+        return generations;
+    }
+
+    // protect the Hub from DOS.
+    static constexpr size_t MaxBatchSize = 2500;
+
+    struct Entry {
+        Tx tx;
+        uint256 txid;
+        std::vector<int> parents; // indexes of the in-batch transactions this one spends
+        int generation = 0;
+        std::string error;
+    };
+    std::vector<Entry> m_entries;
+};
+
 class GetMempoolInfo : public Api::RpcParser
 {
 public:
@@ -1249,8 +1654,12 @@ Api::Parser *Api::createParser(const Message &message)
             return new GetBlockHeader();
         case Api::BlockChain::GetBlockCount:
             return new GetBlockCount();
+        case Api::BlockChain::GetBlockFilter:
+            return new GetBlockFilter();
         case Api::BlockChain::GetTransaction:
             return new GetTransaction();
+        case Api::BlockChain::GetTransactions:
+            return new GetTransactions();
         }
         break;
     case Api::LiveTransactionService:
@@ -1261,6 +1670,8 @@ Api::Parser *Api::createParser(const Message &message)
             if (message.headerInt(Api::ASyncRequest) <= 0)
                 return new SendLiveTransaction();
             return new SendLiveTransactonASync(message);
+        case Api::LiveTransactions::SendTransactions:
+            return new SendLiveTransactionsASync(message);
         case Api::LiveTransactions::IsUnspent:
             return new UtxoFetcher(Api::LiveTransactions::IsUnspentReply);
         case Api::LiveTransactions::GetUnspentOutput:
@@ -22,6 +22,8 @@
 #include <DoubleSpendProof.h>
 #include <encodings_legacy.h>
 #include <chain.h>
+#include <BlockMetaData.h>
+#include <BlocksDB.h>
 #include <Application.h>
 
 #include <NetworkManager.h>
@@ -102,29 +104,79 @@ bool AddressMonitorService::match(Tx::Iterator &iter, const std::deque<NetworkSe
 void AddressMonitorService::syncAllTransactionsInBlock(const FastBlock &block, CBlockIndex *index)
 {
     assert(index);
-    Tx::Iterator iter(block);
     auto rem = remotes();
+    if (rem.empty())
+        return;
+    if (matchBlockFromMetaData(index, rem))
+        return;
+    Tx::Iterator iter(block);
     while (true) {
         std::map<int, Match> matches;
         if (!match(iter, rem, matches))
             break;
-        for (auto i = matches.begin(); i != matches.end(); ++i) {
-            Match &match = i->second;
-            std::lock_guard<std::mutex> guard(m_poolMutex);
-            m_pool.reserve(match.hashes.size() * 35 + match.amounts.size() * 10 + 20);
-            Streaming::MessageBuilder builder(m_pool);
-            for (auto hash : match.hashes)
-                builder.add(Api::AddressMonitor::BitcoinScriptHashed, hash);
-            for (auto amount : match.amounts)
-                builder.add(Api::AddressMonitor::Amount, amount);
+        if (!matches.empty()) {
             auto tx = iter.prevTx();
-            builder.add(Api::AddressMonitor::TxId, tx.createHash());
-            builder.add(Api::AddressMonitor::OffsetInBlock, static_cast<uint64_t>(tx.offsetInBlock(block)));
-            builder.add(Api::AddressMonitor::BlockHeight, index->nHeight);
-            logDebug(Log::MonitorService) << "Remote" << i->first << "gets" << match.hashes.size() << "tx notification(s) from block";
-            rem[i->first]->connection.send(builder.message(Api::AddressMonitorService, Api::AddressMonitor::TransactionFound));
+            sendBlockMatches(matches, rem, tx.createHash(), tx.offsetInBlock(block), index->nHeight);
+        }
+    }
+}
+
+bool AddressMonitorService::matchBlockFromMetaData(CBlockIndex *index, const std::deque<NetworkService::Remote *> &remotes)
+{
+    if ((index->nStatus & BLOCK_HAVE_METADATA) == 0)
+        return false;
+    BlockMetaData meta;
+    try {
+        meta = Blocks::DB::instance()->loadBlockMetaData(index->GetMetaDataPos());
+    } catch (const std::exception &) {
+        return false;
+    }
+    if (!meta.hasOutputData())
+        return false;
+
+    const int txCount = meta.txCount();
+    for (int txIndex = 0; txIndex < txCount; ++txIndex) {
+        std::map<int, Match> matches;
+        const BlockMetaData::OutputData *outputs = meta.outputs(txIndex);
+        const int outputCount = meta.outputCount(txIndex);
+        for (int out = 0; out < outputCount; ++out) {
+            const uint256 hash(outputs[out].scriptHash);
+            for (size_t i = 0; i < remotes.size(); ++i) {
+                assert(i < INT_MAX);
+                RemoteWithKeys *rwk = static_cast<RemoteWithKeys*>(remotes.at(i));
+                if (rwk->hashes.find(hash) != rwk->hashes.end()) {
+                    Match &m = matches[static_cast<int>(i)];
+                    m.amounts.push_back(outputs[out].amount);
+                    m.hashes.push_back(hash);
+                }
+            }
+        }
+        if (!matches.empty()) {
+            const auto tx = meta.tx(txIndex);
+            sendBlockMatches(matches, remotes, uint256(tx->txid), static_cast<int>(tx->offsetInBlock), index->nHeight);
         }
     }
+    return true;
+}
+
+void AddressMonitorService::sendBlockMatches(const std::map<int, Match> &matches, const std::deque<NetworkService::Remote *> &remotes,
+                                             const uint256 &txid, int offsetInBlock, int blockHeight)
+{
+    for (auto i = matches.begin(); i != matches.end(); ++i) {
+        const Match &match = i->second;
+        std::lock_guard<std::mutex> guard(m_poolMutex);
+        m_pool.reserve(match.hashes.size() * 35 + match.amounts.size() * 10 + 60);
+        Streaming::MessageBuilder builder(m_pool);
+        for (auto hash : match.hashes)
+            builder.add(Api::AddressMonitor::BitcoinScriptHashed, hash);
+        for (auto amount : match.amounts)
+            builder.add(Api::AddressMonitor::Amount, amount);
+        builder.add(Api::AddressMonitor::TxId, txid);
+        builder.add(Api::AddressMonitor::OffsetInBlock, static_cast<uint64_t>(offsetInBlock));
+        builder.add(Api::AddressMonitor::BlockHeight, blockHeight);
+        logDebug(Log::MonitorService) << "Remote" << i->first << "gets" << match.hashes.size() << "tx notification(s) from block";
+        remotes[i->first]->connection.send(builder.message(Api::AddressMonitorService, Api::AddressMonitor::TransactionFound));
+    }
 }
 
 void AddressMonitorService::doubleSpendFound(const Tx &first, const Tx &duplicate)
@@ -256,37 +308,22 @@ void AddressMonitorService::findTxInMempool(int connectionId, const uint256 &has
         return;
 
     LOCK(m_mempool->cs);
-    for (auto iter = m_mempool->mapTx.begin(); iter != m_mempool->mapTx.end(); ++iter) {
-        Tx::Iterator txIter(iter->tx);
-        auto type = txIter.next();
-        uint64_t curAmount = 0, matchedAmounts = 0;
-        bool match = false;
-        while (true) {
-            if (type == Tx::End) {
-                if (match) {
-                    logDebug(Log::MonitorService) << " + Sending to peers tx from mempool!";
-                    std::lock_guard<std::mutex> guard(m_poolMutex);
-                    m_pool.reserve(75);
-                    Streaming::MessageBuilder builder(m_pool);
-                    builder.add(Api::AddressMonitor::BitcoinScriptHashed, hash);
-                    builder.add(Api::AddressMonitor::TxId, txIter.prevTx().createHash());
-                    builder.add(Api::AddressMonitor::Amount, matchedAmounts);
-                    Message message = builder.message(Api::AddressMonitorService, Api::AddressMonitor::TransactionFound);
-                    connection.send(message);
-                }
-                break;
-            }
-            if (type == Tx::OutputValue) {
-                curAmount = txIter.longData();
-            }
-            else if (type == Tx::OutputScript) {
-                if (txIter.hashedByteData() == hash) {
-                    match = true;
-                    matchedAmounts += curAmount;
-                }
-            }
-            type = txIter.next();
-        }
+    // one message per transaction, with the total amount of all its matching outputs.
+    const auto matches = m_mempool->findByScriptHash(hash);
+    std::map<CTxMemPool::txiter, uint64_t, CTxMemPool::CompareIteratorByHash> amounts;
+    for (const auto &match : matches) {
+        amounts[match.entry] += match.amount;
+    }
+    for (auto iter = amounts.begin(); iter != amounts.end(); ++iter) {
+        logDebug(Log::MonitorService) << " + Sending to peers tx from mempool!";
+        std::lock_guard<std::mutex> guard(m_poolMutex);
+        m_pool.reserve(75);
+        Streaming::MessageBuilder builder(m_pool);
+        builder.add(Api::AddressMonitor::BitcoinScriptHashed, hash);
+        builder.add(Api::AddressMonitor::TxId, iter->first->GetTx().GetHash());
+        builder.add(Api::AddressMonitor::Amount, iter->second);
+        Message message = builder.message(Api::AddressMonitorService, Api::AddressMonitor::TransactionFound);
+        connection.send(message);
     }
 }
 
@@ -69,6 +69,10 @@ private:
     };
 
     bool match(Tx::Iterator &iter, const std::deque<NetworkService::Remote *> &remotes, std::map<int, Match> &matchingRemotes) const;
+    /// Match using the script-hashes stored in the BlockMetaData. Returns false if that data is not available.
+    bool matchBlockFromMetaData(CBlockIndex *index, const std::deque<NetworkService::Remote *> &remotes);
+    void sendBlockMatches(const std::map<int, Match> &matches, const std::deque<NetworkService::Remote *> &remotes,
+                          const uint256 &txid, int offsetInBlock, int blockHeight);
 
     void updateBools();
     /// Callback for just subscribed addresses to find if there is a hit in the mempool.
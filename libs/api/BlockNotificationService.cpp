@@ -52,7 +52,7 @@ void BlockNotificationService::syncAllTransactionsInBlock(const FastBlock &, CBl
     }
 }
 
-void BlockNotificationService::chainReorged(CBlockIndex *oldTip, const std::vector<FastBlock> &revertedBlocks)
+void BlockNotificationService::chainReorged(CBlockIndex *oldTip, const std::vector<FastBlock> &revertedBlocks, int64_t duration)
 {
     const auto list = remotes<RemoteWithBool>(&NetworkService::filterRemoteWithBool);
     if (list.empty())
@@ -60,9 +60,10 @@ void BlockNotificationService::chainReorged(CBlockIndex *oldTip, const std::vect
 
     /*
      * since the service already sends out which block is the new one in a separate message,
-     * all we will do in this one is notify them which blocks have been removed.
+     * all we will do in this one is notify them which blocks have been removed and how long
+     * the hub was busy with that.
      */
-    m_pool.reserve(revertedBlocks.size() * 42);
+    m_pool.reserve(revertedBlocks.size() * 42 + 10);
     CBlockIndex *index = oldTip;
     Streaming::MessageBuilder builder(m_pool);
     for (size_t i = 0; i < revertedBlocks.size(); ++i) {
@@ -71,6 +72,7 @@ void BlockNotificationService::chainReorged(CBlockIndex *oldTip, const std::vect
         builder.add(Api::BlockNotification::BlockHeight, index->nHeight);
         index = index->pprev;
     }
+    builder.add(Api::BlockNotification::ReorgDuration, static_cast<int>(duration / 1000));
     Message message(builder.message(Api::BlockNotificationService, Api::BlockNotification::BlocksRemoved));
 
     for (auto &subinfo : list) {
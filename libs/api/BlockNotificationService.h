@@ -30,7 +30,7 @@ public:
     // the hub pushed a transaction into its mempool
     void syncAllTransactionsInBlock(const FastBlock &block, CBlockIndex *index) override;
     void onIncomingMessage(Remote *con, const Message &message, const EndPoint &ep) override;
-    void chainReorged(CBlockIndex *oldTip, const std::vector<FastBlock> &revertedBlocks) override;
+    void chainReorged(CBlockIndex *oldTip, const std::vector<FastBlock> &revertedBlocks, int64_t duration) override;
 
 protected:
     Remote *createRemote() override {
@@ -30,4 +30,11 @@ HubApiServices::HubApiServices(boost::asio::io_service &service)
     m_apiServer.addService(&m_blockNotificationService);
     m_apiServer.addService(&m_dsp);
     m_addressMonitorService.setMaxAddressesPerConnection(GetArg("-api_max_addresses", -1));
+
+    const bool txIndex = GetBoolArg("-indexer_txid", false);
+    const bool spentIndex = GetBoolArg("-indexer_spent", false);
+    if (txIndex || spentIndex) {
+        m_indexer.reset(new IndexerService(service, GetDataDir() / "indexer", txIndex, spentIndex));
+        m_apiServer.addService(m_indexer.get());
+    }
 }
@@ -23,6 +23,9 @@
 #include "BlockNotificationService.h"
 #include "TransactionMonitorService.h"
 #include "DoubleSpendService.h"
+#include "IndexerService.h"
+
+#include <memory>
 
 
 /**
@@ -42,6 +45,7 @@ private:
     AddressMonitorService m_addressMonitorService;
     BlockNotificationService m_blockNotificationService;
     DoubleSpendService m_dsp;
+    std::unique_ptr<IndexerService> m_indexer;
 };
 
 #endif
@@ -0,0 +1,373 @@
+/*
+ * This file is part of the Flowee project
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "IndexerService.h"
+
+// server 'lib'
+#include <BlocksDB.h>
+#include <chain.h>
+#include <main.h>
+#include <util.h>
+
+#include <utxo/IndexerKeys.h>
+
+#include <APIProtocol.h>
+#include <clientversion.h>
+#include <Logger.h>
+#include <Message.h>
+#include <streaming/MessageBuilder.h>
+#include <streaming/MessageParser.h>
+#include <primitives/FastTransaction.h>
+
+#include <sstream>
+
+// the amount of blocks from validation we hold on to for the indexing thread
+static const size_t MaxRecentBlocks = 20;
+
+IndexerService::IndexerService(boost::asio::io_service &service, const boost::filesystem::path &basedir, bool txIndex, bool spentIndex)
+    : NetworkService(Api::IndexerService),
+      m_stop(false)
+{
+    if (txIndex)
+        m_txdb.reset(new UnspentOutputDatabase(service, basedir / "txindex"));
+    if (spentIndex)
+        m_spentdb.reset(new UnspentOutputDatabase(service, basedir / "spent"));
+    logInfo(Log::ApiServer) << "Embedded indexer started. TxIndex:" << (m_txdb ? m_txdb->blockheight() : -1)
+                            << "SpentOutputs:" << (m_spentdb ? m_spentdb->blockheight() : -1);
+
+    ValidationNotifier().addListener(this);
+    m_thread = std::thread(std::bind(&IndexerService::run, this));
+}
+
+IndexerService::~IndexerService()
+{
+    ValidationNotifier().removeListener(this);
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_stop = true;
+    }
+    m_waitVariable.notify_all();
+    m_thread.join();
+    // the databases flush themselves on delete, a saveCaches() here would schedule a
+    // flush on an object that is about to be deleted.
+}
+
+void IndexerService::syncAllTransactionsInBlock(const FastBlock &block, CBlockIndex *index)
+{
+    assert(index);
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_recentBlocks.push_back(std::make_pair(index->GetBlockHash(), block));
+        if (m_recentBlocks.size() > MaxRecentBlocks) // the indexer is behind, it will read from disk.
+            m_recentBlocks.pop_front();
+        m_chainChanged = true;
+    }
+    m_waitVariable.notify_all();
+}
+
+void IndexerService::chainReorged(CBlockIndex *oldTip, const std::vector<FastBlock> &revertedBlocks, int64_t)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        // hand over the reverted blocks, the indexing thread needs them to undo their changes.
+        CBlockIndex *index = oldTip;
+        for (size_t i = 0; index && i < revertedBlocks.size(); ++i) {
+            m_recentBlocks.push_back(std::make_pair(index->GetBlockHash(), revertedBlocks.at(i)));
+            index = index->pprev;
+        }
+        while (m_recentBlocks.size() > MaxRecentBlocks)
+            m_recentBlocks.pop_front();
+        m_chainChanged = true;
+    }
+    m_waitVariable.notify_all();
+}
+
+void IndexerService::run()
+{
+    RenameThread("indexer");
+    while (!m_stop) {
+        {
+            std::unique_lock<std::mutex> lock(m_lock);
+            // the timeout makes us retry after an error.
+            m_waitVariable.wait_for(lock, std::chrono::seconds(60), [this] {
+                return m_stop || m_chainChanged;
+            });
+            m_chainChanged = false;
+        }
+        try {
+            int blocksChanged = 0;
+            if (!revertOrphans(blocksChanged))
+                continue;
+            while (!m_stop) {
+                const CBlockIndex *index;
+                {
+                    // block-indexes are never deleted, the pointer stays valid outside the lock.
+                    LOCK(cs_main);
+                    index = chainActive[lowestHeight() + 1];
+                }
+                if (index == nullptr)
+                    break;
+                indexBlock(loadBlock(index), index);
+                if ((++blocksChanged % 5000) == 0)
+                    logInfo(Log::ApiServer) << "Indexer catching up, at block" << index->nHeight;
+            }
+            if (blocksChanged > 0 && !m_stop) { // at tip, a good time to write to disk
+                if (m_txdb)
+                    m_txdb->saveCaches();
+                if (m_spentdb)
+                    m_spentdb->saveCaches();
+            }
+        } catch (const std::exception &e) {
+            logCritical(Log::ApiServer) << "Indexer failed to process block:" << e;
+        }
+    }
+}
+
+FastBlock IndexerService::loadBlock(const CBlockIndex *index)
+{
+    const uint256 hash = index->GetBlockHash();
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        for (auto iter = m_recentBlocks.begin(); iter != m_recentBlocks.end(); ++iter) {
+            if (iter->first == hash) {
+                FastBlock block = iter->second;
+                m_recentBlocks.erase(iter);
+                return block;
+            }
+        }
+    }
+    return Blocks::DB::instance()->loadBlock(index->GetBlockPos(), Blocks::SequentialAccess);
+}
+
+bool IndexerService::revertOrphans(int &blocksReverted)
+{
+    for (auto db : { m_txdb.get(), m_spentdb.get() }) {
+        if (db == nullptr)
+            continue;
+        while (db->blockheight() > 0 && !m_stop) {
+            bool onMainChain;
+            {
+                LOCK(cs_main);
+                const CBlockIndex *index = chainActive[db->blockheight()];
+                onMainChain = index && index->GetBlockHash() == db->blockId();
+            }
+            if (onMainChain)
+                break;
+            const CBlockIndex *orphan = Blocks::Index::get(db->blockId());
+            if (orphan == nullptr || orphan->pprev == nullptr) {
+                logFatal(Log::ApiServer) << "Indexer is on unknown block" << db->blockId() << "please delete the indexer dir";
+                return false;
+            }
+            logInfo(Log::ApiServer) << "Indexer reverting block" << orphan->nHeight << db->blockId();
+            revertBlock(db, loadBlock(orphan), orphan);
+            ++blocksReverted;
+        }
+    }
+    return true;
+}
+
+int IndexerService::blockheight() const
+{
+    return lowestHeight();
+}
+
+UnspentOutput IndexerService::findTransaction(const uint256 &txid) const
+{
+    if (!m_txdb)
+        return UnspentOutput();
+    return IndexerKeys::findTransaction(*m_txdb, txid);
+}
+
+UnspentOutput IndexerService::findSpentOutput(const uint256 &txid, int outIndex) const
+{
+    if (!m_spentdb)
+        return UnspentOutput();
+    return IndexerKeys::findSpentOutput(*m_spentdb, txid, outIndex);
+}
+
+int IndexerService::lowestHeight() const
+{
+    int height = INT_MAX;
+    if (m_txdb)
+        height = m_txdb->blockheight();
+    if (m_spentdb)
+        height = std::min(height, m_spentdb->blockheight());
+    return height;
+}
+
+void IndexerService::indexBlock(const FastBlock &block, const CBlockIndex *index)
+{
+    const int height = index->nHeight;
+    UnspentOutputDatabase *txdb = nullptr;
+    if (m_txdb && m_txdb->blockheight() == height - 1)
+        txdb = m_txdb.get();
+    UnspentOutputDatabase *spentdb = nullptr;
+    if (m_spentdb && m_spentdb->blockheight() == height - 1)
+        spentdb = m_spentdb.get();
+    assert(txdb || spentdb);
+
+    // the offset of a transaction is known only at its end, so we remember the inputs till then.
+    std::vector<std::pair<uint256, int> > inputs;
+    uint256 prevTxId;
+    bool coinbase = true;
+    Tx::Iterator iter(block);
+    while (true) {
+        const auto type = iter.next();
+        if (type == Tx::End) {
+            Tx tx = iter.prevTx();
+            const int offsetInBlock = static_cast<int>(tx.offsetInBlock(block));
+            if (txdb)
+                IndexerKeys::insertTransaction(*txdb, tx.createHash(), height, offsetInBlock);
+            if (spentdb) {
+                for (const auto &input : inputs) {
+                    IndexerKeys::insertSpentOutput(*spentdb, input.first, input.second, height, offsetInBlock);
+                }
+            }
+            inputs.clear();
+            coinbase = false;
+            if (iter.next() == Tx::End) // double end: last tx in block
+                break;
+        }
+        else if (spentdb && !coinbase && type == Tx::PrevTxHash) {
+            prevTxId = iter.uint256Data();
+        }
+        else if (spentdb && !coinbase && type == Tx::PrevTxIndex) {
+            inputs.push_back(std::make_pair(prevTxId, iter.intData()));
+        }
+    }
+    if (txdb)
+        txdb->blockFinished(height, index->GetBlockHash());
+    if (spentdb)
+        spentdb->blockFinished(height, index->GetBlockHash());
+}
+
+void IndexerService::revertBlock(UnspentOutputDatabase *db, const FastBlock &block, const CBlockIndex *index)
+{
+    assert(db);
+    assert(index->pprev);
+    const bool spentIndex = db == m_spentdb.get();
+    uint256 prevTxId;
+    bool coinbase = true;
+    Tx::Iterator iter(block);
+    while (true) {
+        const auto type = iter.next();
+        if (type == Tx::End) {
+            if (!spentIndex)
+                IndexerKeys::removeTransaction(*db, iter.prevTx().createHash());
+            coinbase = false;
+            if (iter.next() == Tx::End)
+                break;
+        }
+        else if (spentIndex && !coinbase && type == Tx::PrevTxHash) {
+            prevTxId = iter.uint256Data();
+        }
+        else if (spentIndex && !coinbase && type == Tx::PrevTxIndex) {
+            IndexerKeys::removeSpentOutput(*db, prevTxId, iter.intData());
+        }
+    }
+    db->blockFinished(index->nHeight - 1, index->pprev->GetBlockHash());
+}
+
+void IndexerService::onIncomingMessage(Remote *con, const Message &message, const EndPoint &)
+{
+    assert(message.serviceId() == Api::IndexerService);
+    if (message.messageId() == Api::Indexer::GetAvailableIndexers) {
+        con->pool.reserve(10);
+        Streaming::MessageBuilder builder(con->pool);
+        if (m_txdb)
+            builder.add(Api::Indexer::TxIdIndexer, true);
+        if (m_spentdb)
+            builder.add(Api::Indexer::SpentOutputIndexer, true);
+        con->connection.send(builder.reply(message));
+    }
+    else if (message.messageId() == Api::Indexer::FindTransaction) {
+        if (!m_txdb) {
+            con->connection.disconnect();
+            return;
+        }
+        Streaming::MessageParser parser(message.body());
+        while (parser.next() == Streaming::FoundTag) {
+            if (parser.tag() == Api::Indexer::TxId) {
+                if (parser.dataLength() != 32) {
+                    con->connection.disconnect();
+                    return;
+                }
+                auto item = findTransaction(parser.uint256Data());
+                con->pool.reserve(20);
+                Streaming::MessageBuilder builder(con->pool);
+                builder.add(Api::Indexer::BlockHeight, item.isValid() ? item.blockHeight() : -1);
+                builder.add(Api::Indexer::OffsetInBlock, item.isValid() ? item.offsetInBlock() : 0);
+                con->connection.send(builder.reply(message));
+                return; // just one item per message
+            }
+        }
+    }
+    else if (message.messageId() == Api::Indexer::FindSpentOutput) {
+        if (!m_spentdb) {
+            con->connection.disconnect();
+            return;
+        }
+        Streaming::MessageParser parser(message.body());
+        uint256 txid;
+        bool foundTxId = false;
+        int outIndex = 0;
+        while (parser.next() == Streaming::FoundTag) {
+            if (parser.tag() == Api::Indexer::TxId) {
+                if (parser.dataLength() != 32) {
+                    con->connection.disconnect();
+                    return;
+                }
+                txid = parser.uint256Data();
+                foundTxId = true;
+            }
+            else if (parser.tag() == Api::Indexer::OutIndex) {
+                outIndex = parser.intData();
+            }
+        }
+        if (!foundTxId || outIndex < 0) {
+            con->connection.disconnect();
+            return;
+        }
+        auto item = findSpentOutput(txid, outIndex);
+        con->pool.reserve(20);
+        Streaming::MessageBuilder builder(con->pool);
+        builder.add(Api::Indexer::BlockHeight, item.isValid() ? item.blockHeight() : -1);
+        builder.add(Api::Indexer::OffsetInBlock, item.isValid() ? item.offsetInBlock() : 0);
+        con->connection.send(builder.reply(message));
+    }
+    else if (message.messageId() == Api::Indexer::GetIndexerLastBlock) {
+        con->pool.reserve(10);
+        Streaming::MessageBuilder builder(con->pool);
+        builder.add(Api::Indexer::BlockHeight, lowestHeight());
+        con->connection.send(builder.reply(message));
+    }
+    else if (message.messageId() == Api::Indexer::Version) {
+        con->pool.reserve(50);
+        Streaming::MessageBuilder builder(con->pool);
+        std::ostringstream ss;
+        ss << "Flowee Indexer:" << HUB_SERIES << " (" << CLIENT_VERSION_MAJOR << "-";
+        ss.width(2);
+        ss.fill('0');
+        ss << CLIENT_VERSION_MINOR << ") embedded";
+        builder.add(Api::Indexer::GenericByteData, ss.str());
+        con->connection.send(builder.reply(message));
+    }
+    else if (message.messageId() == Api::Indexer::FindAddress) {
+        // the address index needs a SQL database and is only offered by the stand-alone indexer.
+        con->connection.disconnect();
+    }
+}
@@ -0,0 +1,86 @@
+/*
+ * This file is part of the Flowee project
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef INDEXERSERVICE_H
+#define INDEXERSERVICE_H
+
+#include <validationinterface.h>
+#include <NetworkService.h>
+#include <utxo/UnspentOutputDatabase.h>
+#include <primitives/FastBlock.h>
+
+#include <boost/filesystem/path.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+/**
+ * The TxId and spent-output indexers, running inside the Hub.
+ *
+ * The stand-alone indexer fetches every block over the network. This service
+ * instead gets the blocks handed to it by validation (or directly from the
+ * memory mapped block files when catching up) and answers the same
+ * IndexerService requests, so clients can be pointed at the Hub.
+ *
+ * The databases are stored in the same format as the indexer uses for its
+ * 'txindex' and 'spent' directories.
+ */
+class IndexerService : public ValidationInterface, public NetworkService
+{
+public:
+    IndexerService(boost::asio::io_service &service, const boost::filesystem::path &basedir, bool txIndex, bool spentIndex);
+    ~IndexerService() override;
+
+    void syncAllTransactionsInBlock(const FastBlock &block, CBlockIndex *index) override;
+    void chainReorged(CBlockIndex *oldTip, const std::vector<FastBlock> &revertedBlocks, int64_t duration) override;
+
+    void onIncomingMessage(Remote *con, const Message &message, const EndPoint &ep) override;
+
+    /// returns the height of the last block all enabled indexes processed.
+    int blockheight() const;
+    /// returns where the transaction was mined, invalid if unknown or the txid index is not enabled.
+    UnspentOutput findTransaction(const uint256 &txid) const;
+    /// returns the transaction spending the output, invalid if unknown or the spent index is not enabled.
+    UnspentOutput findSpentOutput(const uint256 &txid, int outIndex) const;
+
+private:
+    void run();
+    /// returns the block at \a index, preferring the one validation handed us.
+    FastBlock loadBlock(const CBlockIndex *index);
+    /// revert the databases that are on a block that is no longer in the main chain.
+    bool revertOrphans(int &blocksReverted);
+    void indexBlock(const FastBlock &block, const CBlockIndex *index);
+    void revertBlock(UnspentOutputDatabase *db, const FastBlock &block, const CBlockIndex *index);
+    int lowestHeight() const;
+
+    std::unique_ptr<UnspentOutputDatabase> m_txdb;
+    std::unique_ptr<UnspentOutputDatabase> m_spentdb;
+
+    std::mutex m_lock;
+    std::condition_variable m_waitVariable;
+    // blocks validation handed us, saves us a lookup. Protected by m_lock
+    std::deque<std::pair<uint256, FastBlock> > m_recentBlocks;
+    bool m_chainChanged = true; // protected by m_lock
+    std::atomic<bool> m_stop;
+    std::thread m_thread;
+};
+
+#endif
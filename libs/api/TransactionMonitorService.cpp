@@ -23,6 +23,8 @@
 #include <DoubleSpendProofStorage.h>
 #include <encodings_legacy.h>
 #include <chain.h>
+#include <BlockMetaData.h>
+#include <BlocksDB.h>
 #include <Application.h>
 
 #include <NetworkManager.h>
@@ -77,31 +79,51 @@ void TransactionMonitorService::syncAllTransactionsInBlock(const FastBlock &bloc
     if (!m_findByHash)
         return;
 
-    Tx::Iterator iter(block);
-    auto type = iter.next();
-    assert(type != Tx::End); // empty block (not even coinbase) is invalid.
-
     auto remotes = this->remotes();
     std::vector<std::deque<Match> > matches;
     matches.resize(remotes.size());
-    bool seenOneEnd = false;
-    while (true) {
-        if (type == Tx::End) {
-            if (seenOneEnd)
-                break; // block done.
-            seenOneEnd = true;
 
-            auto txId = iter.prevTx().createHash();
-            for (size_t i = 0; i < remotes.size(); ++i) {
-                auto remote = static_cast<RemoteWithHashes*>(remotes[i]);
-                if (remote->hashes.find(txId) != remote->hashes.end())
-                    matches[i].push_back({iter.prevTx().offsetInBlock(block), txId});
-            }
+    // the metadata has all the txids, avoiding hashing each transaction.
+    BlockMetaData meta;
+    if (index->nStatus & BLOCK_HAVE_METADATA) {
+        try {
+            meta = Blocks::DB::instance()->loadBlockMetaData(index->GetMetaDataPos());
+        } catch (const std::exception &) {}
+    }
+    const int txCount = meta.txCount();
+    for (int txIndex = 0; txIndex < txCount; ++txIndex) {
+        const auto tx = meta.tx(txIndex);
+        const uint256 txId(tx->txid);
+        for (size_t i = 0; i < remotes.size(); ++i) {
+            auto remote = static_cast<RemoteWithHashes*>(remotes[i]);
+            if (remote->hashes.find(txId) != remote->hashes.end())
+                matches[i].push_back({tx->offsetInBlock, txId});
         }
-        else {
-            seenOneEnd = false;
+    }
+
+    if (txCount == 0) { // no metadata, find the txids the slow way.
+        Tx::Iterator iter(block);
+        auto type = iter.next();
+        assert(type != Tx::End); // empty block (not even coinbase) is invalid.
+        bool seenOneEnd = false;
+        while (true) {
+            if (type == Tx::End) {
+                if (seenOneEnd)
+                    break; // block done.
+                seenOneEnd = true;
+
+                auto txId = iter.prevTx().createHash();
+                for (size_t i = 0; i < remotes.size(); ++i) {
+                    auto remote = static_cast<RemoteWithHashes*>(remotes[i]);
+                    if (remote->hashes.find(txId) != remote->hashes.end())
+                        matches[i].push_back({iter.prevTx().offsetInBlock(block), txId});
+                }
+            }
+            else {
+                seenOneEnd = false;
+            }
+            type = iter.next();
         }
-        type = iter.next();
     }
 
     for (size_t i = 0; i < matches.size(); ++i) {
@@ -267,6 +267,16 @@ bool Blockchain::SearchEngine::isIndexerConnected() const
     return false;
 }
 
+void Blockchain::SearchEngine::setCacheSize(int maxBytes)
+{
+    d->cache.setMaxSize(maxBytes);
+}
+
+Blockchain::CacheStats Blockchain::SearchEngine::cacheStats() const
+{
+    return d->cache.stats();
+}
+
 Blockchain::SearchEnginePrivate::SearchEnginePrivate(SearchEngine *q)
     : network(workers.ioService()),
       nextRequestId(1),
@@ -289,6 +299,7 @@ void Blockchain::SearchEnginePrivate::findServices()
     using namespace boost::program_options;
 
     EndPoint ep;
+    int cacheSize = ResultCache::DefaultMaxSize;
     for (detail::config_file_iterator it(streamConfig, setOptions), end; it != end; ++it) {
         if (it->string_key == "services.indexer" && !it->value.empty()) {
             std::vector<std::string> indexers;
@@ -318,7 +329,16 @@ void Blockchain::SearchEnginePrivate::findServices()
                 }
             }
         }
+        else if (it->string_key == "services.cachesize" && !it->value.empty()) {
+            try {
+                // in megabytes
+                cacheSize = std::min(2000, std::max(0, std::stoi(it->value[0]))) * 1000000;
+            } catch (const std::exception &e) {
+                logWarning(Log::SearchEngine) << "Invalid cachesize" << it->value[0] << "ignoring";
+            }
+        }
     }
+    cache.setMaxSize(cacheSize);
 }
 
 void Blockchain::SearchEnginePrivate::hubConnected(const EndPoint &ep)
@@ -341,6 +361,11 @@ void Blockchain::SearchEnginePrivate::hubDisconnected(const EndPoint &ep)
         }
     }
 
+    // the replies to the requests in flight will not come, make sure the jobs
+    // that were coalesced on those requests don't wait forever either.
+    std::vector<ResultCache::JobRef> jobs;
+    cache.abortRequests(jobs);
+    failJobs(jobs, "Hub disconnected");
     logDebug(Log::SearchEngine);
     q->hubDisconnected();
 }
@@ -350,6 +375,17 @@ void Blockchain::SearchEnginePrivate::hubSentMessage(const Message &message)
     const int id = message.headerInt(SearchRequestId);
     if (id > 0) {
         logDebug(Log::SearchEngine) << "Received hub message for search:" << id;
+        const ResultCache::JobRef job(id, message.headerInt(JobRequestId));
+        ResultCache::Key key((Job()));
+        std::vector<ResultCache::JobRef> waiting;
+        if (cache.finishRequest(job, &key, waiting)) {
+            if (message.serviceId() == Api::BlockChainService)
+                cache.insert(key, message);
+            for (auto &w : waiting) {
+                deliverHubReply(w, message);
+            }
+        }
+
         std::lock_guard<std::mutex> lock_(lock);
         auto searcher = searchers.find(id);
         if (searcher != searchers.end()) {
@@ -390,6 +426,9 @@ void Blockchain::SearchEnginePrivate::hubSentMessage(const Message &message)
         q->initializeHubConnection(network.connection(network.endPoint(message.remote)), hubId);
         return;
     }
+    if (message.serviceId() == Api::BlockNotificationService
+            || (message.serviceId() == Api::BlockChainService && message.messageId() == Api::BlockChain::GetBlockCountReply))
+        processBlockNotification(message);
     q->hubSentMessage(message);
 }
 
@@ -517,6 +556,63 @@ void Blockchain::SearchEnginePrivate::searchFinished(Blockchain::Search *searche
         searchers.erase(iter);
 }
 
+void Blockchain::SearchEnginePrivate::deliverHubReply(const ResultCache::JobRef &job, const Message &reply)
+{
+    Message message(reply.body(), reply.serviceId(), reply.messageId());
+    message.setHeaderInt(SearchRequestId, job.first);
+    message.setHeaderInt(JobRequestId, job.second);
+    message.remote = reply.remote;
+    // always async, the caller may hold locks that the handling of the reply needs.
+    workers.ioService().post(std::bind(&SearchEnginePrivate::hubSentMessage, this, message));
+}
+
+void Blockchain::SearchEnginePrivate::failWaitingJobs(const ResultCache::JobRef &job, const char *error)
+{
+    ResultCache::Key key((Job()));
+    std::vector<ResultCache::JobRef> waiting;
+    if (cache.finishRequest(job, &key, waiting))
+        failJobs(waiting, error);
+}
+
+void Blockchain::SearchEnginePrivate::failJobs(const std::vector<ResultCache::JobRef> &jobs, const char *error)
+{
+    if (jobs.empty())
+        return;
+    Streaming::MessageBuilder builder(pool(40 + static_cast<int>(strlen(error))));
+    builder.add(Api::Meta::FailedReason, error);
+    Message failed = builder.message(Api::APIService, Api::Meta::CommandFailed);
+    for (auto &job : jobs) {
+        deliverHubReply(job, failed);
+    }
+}
+
+void Blockchain::SearchEnginePrivate::processBlockNotification(const Message &message)
+{
+    Streaming::MessageParser parser(message);
+    int lowestHeight = -1;
+    while (parser.next() == Streaming::FoundTag) {
+        if (parser.tag() == Api::BlockHeight) {
+            if (lowestHeight == -1 || parser.intData() < lowestHeight)
+                lowestHeight = parser.intData();
+        }
+    }
+    if (lowestHeight == -1)
+        return;
+    if (message.messageId() == Api::BlockNotification::BlocksRemoved
+            && message.serviceId() == Api::BlockNotificationService) {
+        logInfo(Log::SearchEngine) << "Reorg, removing cached results from height" << lowestHeight;
+        cache.removeFromHeight(lowestHeight);
+        return;
+    }
+    cache.setTipHeight(lowestHeight);
+    const CacheStats stats = cache.stats();
+    if (stats.hits + stats.misses > 0) {
+        logInfo(Log::SearchEngine) << "Result cache entries:" << stats.entries << "bytes:" << stats.bytes
+                                   << "hit-rate:" << (stats.hits * 100 / (stats.hits + stats.misses))
+                                   << "% coalesced:" << stats.coalesced;
+    }
+}
+
 thread_local Streaming::BufferPool m_buffer;
 Streaming::BufferPool &Blockchain::SearchEnginePrivate::pool(int reserveSize)
 {
@@ -573,6 +669,10 @@ void Blockchain::SearchPolicy::parseMessageFromHub(Search *request, const Messag
                 else if (parser.tag() == Api::BlockChain::Difficulty)
                     header.difficulty = parser.doubleData();
             }
+            // the reply may have come from the cache, update the confirmations for main-chain headers.
+            const int tipHeight = m_owner->cache.tipHeight();
+            if (header.confirmations > 0 && tipHeight >= header.height)
+                header.confirmations = tipHeight - header.height + 1;
             if (header.height > 0)
                 request->blockHeaders.insert(std::make_pair(header.height, header));
         }
@@ -814,6 +914,8 @@ void Blockchain::SearchPolicy::processRequests(Blockchain::Search *request)
             case Blockchain::FetchTx:
                 if (job.intData && job.intData2) {
                     job.started = true;
+                    if (!startHubRequest(request, job, static_cast<int>(i)))
+                        break;
                     logDebug(Log::SearchEngine) << "starting fetch TX" << i;
                     // simple, we just send the message.
                     Streaming::MessageBuilder builder(m_owner->pool(40), Streaming::HeaderAndBody);
@@ -851,6 +953,8 @@ void Blockchain::SearchPolicy::processRequests(Blockchain::Search *request)
                     continue;
                 }
                 job.started = true;
+                if (!startHubRequest(request, job, static_cast<int>(i)))
+                    break;
                 logDebug(Log::SearchEngine) << "starting fetching of block header" << i;
                 Streaming::MessageBuilder builder(m_owner->pool(60), Streaming::HeaderAndBody);
                 builder.add(Network::ServiceId, Api::BlockChainService);
@@ -923,6 +1027,7 @@ void Blockchain::SearchPolicy::processRequests(Blockchain::Search *request)
                 break;
             }
         } catch (const ServiceUnavailableException &e) {
+            m_owner->failWaitingJobs(ResultCache::JobRef(request->requestId, static_cast<int>(i)), e.what());
             throw;
         } catch (std::exception &e) {
             logWarning(Log::SearchEngine) << "Job processing failed due to" << e;
@@ -939,6 +1044,21 @@ void Blockchain::SearchPolicy::processRequests(Blockchain::Search *request)
         request->finished(jobsWaiting);
 }
 
+bool Blockchain::SearchPolicy::startHubRequest(Search *request, const Job &job, int jobId)
+{
+    const ResultCache::Key key(job);
+    if (!key.isValid())
+        return true;
+    const ResultCache::JobRef ref(request->requestId, jobId);
+    Message cached = m_owner->cache.find(key);
+    if (cached.serviceId() != -1) {
+        logDebug(Log::SearchEngine) << "Answering job from cache" << jobId;
+        m_owner->deliverHubReply(ref, cached);
+        return false;
+    }
+    return m_owner->cache.startRequest(key, ref);
+}
+
 void Blockchain::SearchPolicy::searchFinished(Blockchain::Search *request)
 {
     m_owner->searchFinished(request);
@@ -979,3 +1099,178 @@ void Blockchain::SearchPolicy::updateJob(int jobIndex, Search *request, const St
     ref.intData2 = intData2;
     ref.data = data;
 }
+
+
+// ////////////////////////////////////////////////////////////////
+
+Blockchain::ResultCache::Key::Key(const Job &job)
+    : type(job.type),
+      blockHeight(job.intData),
+      offsetInBlock(job.type == FetchTx ? job.intData2 : 0),
+      transactionFilters(job.type == FetchTx ? job.transactionFilters : 0)
+{
+}
+
+bool Blockchain::ResultCache::Key::isValid() const
+{
+    if (blockHeight <= 0)
+        return false;
+    if (type == FetchTx)
+        return offsetInBlock > 0;
+    return type == FetchBlockHeader;
+}
+
+bool Blockchain::ResultCache::Key::operator<(const Key &other) const
+{
+    if (blockHeight != other.blockHeight)
+        return blockHeight < other.blockHeight;
+    if (offsetInBlock != other.offsetInBlock)
+        return offsetInBlock < other.offsetInBlock;
+    if (type != other.type)
+        return type < other.type;
+    return transactionFilters < other.transactionFilters;
+}
+
+Blockchain::ResultCache::ResultCache()
+    : m_pool(1000000)
+{
+}
+
+void Blockchain::ResultCache::setMaxSize(int bytes)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (m_maxSize != bytes)
+        logInfo(Log::SearchEngine) << "Result cache size set to" << bytes << "bytes";
+    m_maxSize = std::max(0, bytes);
+    while (m_stats.bytes > m_maxSize) {
+        assert(!m_lru.empty());
+        m_stats.bytes -= m_lru.back().reply.size();
+        m_entries.erase(m_lru.back().key);
+        m_lru.pop_back();
+    }
+    m_stats.entries = static_cast<int>(m_entries.size());
+}
+
+Message Blockchain::ResultCache::find(const Key &key)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    auto iter = m_entries.find(key);
+    if (iter == m_entries.end()) {
+        ++m_stats.misses;
+        return Message();
+    }
+    ++m_stats.hits;
+    m_lru.splice(m_lru.begin(), m_lru, iter->second);
+    return iter->second->reply;
+}
+
+void Blockchain::ResultCache::insert(const Key &key, const Message &reply)
+{
+    const int size = reply.body().size();
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (size > m_maxSize / 10) // don't let one big item push out everything else
+        return;
+    if (m_tipHeight > 0 && key.blockHeight > m_tipHeight) // not yet known to be on our chain
+        return;
+    if (m_entries.find(key) != m_entries.end())
+        return;
+
+    // copy the data to avoid keeping alive the (much bigger) network buffer.
+    m_pool.reserve(size);
+    memcpy(m_pool.begin(), reply.body().begin(), static_cast<size_t>(size));
+    Message copy(m_pool.commit(size), reply.serviceId(), reply.messageId());
+    m_lru.push_front(Entry(key, copy));
+    m_entries.insert(std::make_pair(key, m_lru.begin()));
+    m_stats.bytes += size;
+
+    while (m_stats.bytes > m_maxSize) {
+        assert(!m_lru.empty());
+        m_stats.bytes -= m_lru.back().reply.size();
+        m_entries.erase(m_lru.back().key);
+        m_lru.pop_back();
+    }
+    m_stats.entries = static_cast<int>(m_entries.size());
+}
+
+bool Blockchain::ResultCache::startRequest(const Key &key, const JobRef &job)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    auto iter = m_inFlight.find(key);
+    if (iter == m_inFlight.end()) {
+        m_inFlight.insert(std::make_pair(key, std::vector<JobRef>(1, job)));
+        m_inFlightByJob.insert(std::make_pair(job, key));
+        return true;
+    }
+    ++m_stats.coalesced;
+    iter->second.push_back(job);
+    return false;
+}
+
+bool Blockchain::ResultCache::finishRequest(const JobRef &job, Key *key, std::vector<JobRef> &waiting)
+{
+    assert(key);
+    std::lock_guard<std::mutex> lock(m_lock);
+    auto iter = m_inFlightByJob.find(job);
+    if (iter == m_inFlightByJob.end())
+        return false;
+    *key = iter->second;
+    m_inFlightByJob.erase(iter);
+    auto request = m_inFlight.find(*key);
+    assert(request != m_inFlight.end());
+    assert(!request->second.empty());
+    assert(request->second.front() == job);
+    waiting.insert(waiting.end(), request->second.begin() + 1, request->second.end());
+    m_inFlight.erase(request);
+    return true;
+}
+
+void Blockchain::ResultCache::abortRequests(std::vector<JobRef> &jobs)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    for (auto &request : m_inFlight) {
+        jobs.insert(jobs.end(), request.second.begin(), request.second.end());
+    }
+    m_inFlight.clear();
+    m_inFlightByJob.clear();
+}
+
+void Blockchain::ResultCache::setTipHeight(int blockHeight)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (blockHeight <= m_tipHeight) // the chain got shorter or changed, a reorg.
+        removeFromHeight_priv(blockHeight);
+    m_tipHeight = blockHeight;
+}
+
+int Blockchain::ResultCache::tipHeight() const
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_tipHeight;
+}
+
+void Blockchain::ResultCache::removeFromHeight(int blockHeight)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    removeFromHeight_priv(blockHeight);
+    m_tipHeight = std::min(m_tipHeight, blockHeight - 1);
+}
+
+void Blockchain::ResultCache::removeFromHeight_priv(int blockHeight)
+{
+    Key first((Job()));
+    first.blockHeight = blockHeight;
+    first.offsetInBlock = -1;
+    auto iter = m_entries.lower_bound(first);
+    while (iter != m_entries.end()) {
+        m_stats.bytes -= iter->second->reply.size();
+        m_lru.erase(iter->second);
+        iter = m_entries.erase(iter);
+    }
+    m_stats.entries = static_cast<int>(m_entries.size());
+}
+
+Blockchain::CacheStats Blockchain::ResultCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_stats;
+}
@@ -164,6 +164,15 @@ struct Error {
     std::string error;
 };
 
+/// Statistics of the SearchEngine result cache.
+struct CacheStats {
+    uint64_t hits = 0;      ///< requests answered from the cache.
+    uint64_t misses = 0;    ///< requests that were sent to the Hub.
+    uint64_t coalesced = 0; ///< requests that piggy-backed on an identical request in flight.
+    int entries = 0;
+    int bytes = 0;
+};
+
 struct Search
 {
 public:
@@ -291,6 +300,20 @@ public:
     bool isHubConnected() const;
     bool isIndexerConnected() const;
 
+    /**
+     * Set the maximum amount of bytes the cache of Hub replies may use.
+     *
+     * Replies for confirmed transactions and for block headers don't change (until a reorg), as such
+     * they are cached and shared between all searches. Identical requests that are in flight at
+     * the same time are only sent to the Hub once.
+     * Set to zero to disable the cache.
+     *
+     * The size is also read from the 'cachesize' (in megabytes) key in the 'services' section of
+     * the config file.
+     */
+    void setCacheSize(int maxBytes);
+    CacheStats cacheStats() const;
+
     virtual void initializeHubConnection(NetworkConnection connection, const std::string &hubVersion) { }
     virtual void initializeIndexerConnection(NetworkConnection connection, const std::set<Service> &services) { }
     virtual void hubSentMessage(const Message &message) { }
@@ -28,8 +28,10 @@
 #include <boost/thread/tss.hpp>
 
 #include <deque>
+#include <list>
 #include <map>
 #include <mutex>
+#include <vector>
 
 namespace Blockchain {
 
@@ -39,6 +41,85 @@ enum HeaderTags
     JobRequestId
 };
 
+/**
+ * A size-bounded LRU cache of Hub replies for jobs whose answer is fixed once a block
+ * has been mined, which additionally tracks requests in flight so identical requests
+ * from different searches are only sent once.
+ */
+class ResultCache
+{
+public:
+    struct Key {
+        explicit Key(const Job &job);
+        /// returns true if the answer to this job is cachable.
+        bool isValid() const;
+        bool operator<(const Key &other) const;
+
+        int type;
+        int blockHeight;
+        int offsetInBlock;
+        uint32_t transactionFilters;
+    };
+    typedef std::pair<int, int> JobRef; // searchId, jobId
+
+    enum {
+        DefaultMaxSize = 50000000
+    };
+
+    ResultCache();
+
+    void setMaxSize(int bytes);
+
+    /// returns a copy of the reply, or an invalid message if not found.
+    Message find(const Key &key);
+    void insert(const Key &key, const Message &reply);
+
+    /**
+     * Register the intent to send a request for \a key.
+     * @returns true if the caller should send the request, false when an identical
+     *      request is in flight and the caller will be sent its reply.
+     */
+    bool startRequest(const Key &key, const JobRef &job);
+    /**
+     * Returns the jobs that are waiting for the reply of the request \a job started.
+     * @param key is set to the key the request was started with.
+     * @returns true if \a job was a request started by startRequest()
+     */
+    bool finishRequest(const JobRef &job, Key *key, std::vector<JobRef> &waiting);
+    /**
+     * Forget about all requests in flight, for instance on a disconnect.
+     * @param jobs is filled with all jobs, senders and waiters, that will not get a reply.
+     */
+    void abortRequests(std::vector<JobRef> &jobs);
+
+    /// the chain got a new tip, remove data that may have become invalid.
+    void setTipHeight(int blockHeight);
+    int tipHeight() const;
+    /// blocks starting at \a blockHeight have been removed from the chain.
+    void removeFromHeight(int blockHeight);
+
+    CacheStats stats() const;
+
+private:
+    void removeFromHeight_priv(int blockHeight);
+
+    struct Entry {
+        Entry(const Key &key, const Message &reply) : key(key), reply(reply) {}
+        Key key;
+        Message reply;
+    };
+
+    mutable std::mutex m_lock;
+    std::list<Entry> m_lru; // most recently used at the front
+    std::map<Key, std::list<Entry>::iterator> m_entries;
+    std::map<Key, std::vector<JobRef>> m_inFlight; // first item is the one that sent the request
+    std::map<JobRef, Key> m_inFlightByJob;
+    Streaming::BufferPool m_pool;
+    CacheStats m_stats;
+    int m_maxSize = DefaultMaxSize;
+    int m_tipHeight = -1;
+};
+
 class SearchEnginePrivate {
 public:
     SearchEnginePrivate(SearchEngine *q);
@@ -57,6 +138,13 @@ public:
 
     void sendMessage(const Message &message, Service service);
     void searchFinished(Search *searcher);
+    /// deliver (async) a Hub \a reply to the job of a search as if the Hub sent it.
+    void deliverHubReply(const ResultCache::JobRef &job, const Message &reply);
+    /// a request we sent failed to be sent, let the jobs waiting for it know.
+    void failWaitingJobs(const ResultCache::JobRef &job, const char *error);
+    /// deliver (async) a failed-reply to each of the \a jobs.
+    void failJobs(const std::vector<ResultCache::JobRef> &jobs, const char *error);
+    void processBlockNotification(const Message &message);
 
     Streaming::BufferPool &pool(int reserve);
 
@@ -78,6 +166,8 @@ public:
 
     std::string configFile;
 
+    ResultCache cache;
+
     SearchEngine *q;
 
     // policies
@@ -127,6 +217,12 @@ public:
 
 protected:
     void sendMessage(Search *request, Message message, Service service);
+    /**
+     * Checks the cache for the Hub-request \a job, returns true if the caller should
+     * send the request to the Hub. False if the answer will be delivered from the cache or
+     * from an identical request already in flight.
+     */
+    bool startHubRequest(Search *request, const Job &job, int jobId);
     void updateJob(int jobIndex, Search *request, const Streaming::ConstBuffer &data, int intData1, int intData2);
 
 private:
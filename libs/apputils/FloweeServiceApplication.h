@@ -22,6 +22,7 @@
 #include <QCoreApplication>
 #include <QCommandLineParser>
 #include <QList>
+#include <QTimer>
 
 #include <Logger.h>
 #include <NetworkEndPoint.h>
@@ -123,6 +124,26 @@ public:
 
     int bindTo(QTcpServer *server, int defaultPort);
 
+    /**
+     * Periodically log the request-rate and latency numbers of an HttpEngine::Server.
+     * Periods without any requests are not logged.
+     *
+     * This is a template to avoid the apputils library depending on the httpengine one.
+     */
+    template<class HttpServer>
+    void logHttpStatistics(HttpServer *server, int intervalMs = 10 * 60 * 1000) {
+        QTimer *timer = new QTimer(server);
+        QObject::connect(timer, &QTimer::timeout, [server]() {
+            const auto stats = server->statistics();
+            if (stats.requests == 0)
+                return;
+            logInfo().nospace() << "HTTP: " << stats.openConnections << " connections, "
+                                << stats.requestsPerSecond << " req/s, latency avg: "
+                                << stats.averageLatencyUs << "us max: " << stats.maxLatencyUs << "us";
+        });
+        timer->start(intervalMs);
+    }
+
 signals:
     void reparseConfig() const;
 
@@ -0,0 +1,248 @@
+/* This file is part of Flowee
+ *
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * For the full copy of the License see <http://www.gnu.org/licenses/>
+ */
+
+#include "connection_p.h"
+#include "server_p.h"
+#include "socket_p.h"
+
+#if !defined(QT_NO_SSL)
+#  include <QSslSocket>
+#endif
+#include <QTcpSocket>
+
+using namespace HttpEngine;
+
+// The amount of requests we start handling before their predecessors got answered.
+static const int MaxPipelinedRequests = 16;
+// Time a new connection gets to send its first request when keep-alive is disabled.
+static const int DefaultIdleTimeout = 30;
+
+Connection::Connection(ServerPrivate *server, qintptr socketDescriptor, int worker)
+    : m_server(server),
+      m_socketDescriptor(socketDescriptor),
+      m_worker(worker),
+      m_idleTimer(this)
+{
+    m_idleTimer.setSingleShot(true);
+    connect (&m_idleTimer, SIGNAL(timeout()), this, SLOT(onIdleTimeout()));
+}
+
+Connection::~Connection()
+{
+    --m_server->openConnections[m_worker];
+}
+
+QTcpSocket *Connection::tcpSocket() const
+{
+    return m_socket;
+}
+
+void Connection::start()
+{
+#if !defined(QT_NO_SSL)
+    if (!m_server->configuration.isNull()) {
+        // Initialize the socket with the SSL configuration
+        QSslSocket *socket = new QSslSocket(this);
+        m_socket = socket;
+
+        // Wait until encryption is complete before processing the socket
+        QObject::connect(socket, &QSslSocket::encrypted, this, &Connection::startHttp);
+        // If an error occurs, drop the connection
+        QObject::connect(socket, static_cast<void(QAbstractSocket::*)(QAbstractSocket::SocketError)>(&QAbstractSocket::error),
+            this, &Connection::onDisconnected);
+
+        socket->setSocketDescriptor(m_socketDescriptor);
+        socket->setSslConfiguration(m_server->configuration);
+        socket->startServerEncryption();
+    }
+    else
+#endif
+    {
+        m_socket = new QTcpSocket(this);
+        m_socket->setSocketDescriptor(m_socketDescriptor);
+        startHttp();
+    }
+    connect (m_socket, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
+    const int timeout = m_server->keepAliveTimeout;
+    m_idleTimer.start((timeout > 0 ? timeout : DefaultIdleTimeout) * 1000);
+}
+
+void Connection::startHttp()
+{
+    connect (m_socket, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
+    connect (m_socket, SIGNAL(bytesWritten(qint64)), this, SLOT(onBytesWritten(qint64)));
+    onReadyRead();
+}
+
+void Connection::write(Socket *socket, const char *data, qint64 len)
+{
+    if (!m_responses.contains(socket)) // we hung up on this one
+        return;
+    if (m_responses.first() == socket)
+        m_socket->write(data, len);
+    else
+        socket->d->pendingOutput.append(data, len);
+}
+
+qint64 Connection::bytesToWrite(const Socket *socket) const
+{
+    if (m_responses.isEmpty() || m_responses.first() != socket)
+        return socket->d->pendingOutput.size();
+    return qMax<qint64>(0, m_socket->bytesToWrite() - m_bytesOfEarlierResponses);
+}
+
+void Connection::responseFinished(Socket *socket, bool keepAlive)
+{
+    if (socket->d->requestTimer.isValid())
+        m_server->requestFinished(socket->d->requestTimer.nsecsElapsed() / 1000);
+    if (!keepAlive) {
+        // finish the responses we have, but don't start on new requests
+        m_closing = true;
+        m_buffer.clear();
+    }
+    if (socket == m_reading)
+        m_reading = nullptr;
+    flushResponses();
+}
+
+void Connection::socketDestroyed(Socket *socket)
+{
+    // A request going away without finishing its response leaves the client
+    // with a response stream it can't parse, all we can do is hang up.
+    m_responses.removeAll(socket);
+    if (socket == m_reading)
+        m_reading = nullptr;
+    closeConnection();
+}
+
+bool Connection::acceptsMoreRequests() const
+{
+    return !m_closing && m_server->keepAliveTimeout > 0;
+}
+
+void Connection::onReadyRead()
+{
+    m_buffer.append(m_socket->readAll());
+    if (m_closing) {
+        m_buffer.clear();
+        return;
+    }
+    m_idleTimer.start();
+    processBuffer();
+}
+
+void Connection::onBytesWritten(qint64 bytes)
+{
+    // bytes of responses we already finished are not reported to the current one
+    const qint64 earlier = qMin(bytes, m_bytesOfEarlierResponses);
+    m_bytesOfEarlierResponses -= earlier;
+    bytes -= earlier;
+    if (bytes > 0 && !m_responses.isEmpty())
+        m_responses.first()->d->onBytesWritten(bytes);
+}
+
+void Connection::onDisconnected()
+{
+    if (m_disconnected)
+        return;
+    m_disconnected = true;
+    m_closing = true;
+    m_idleTimer.stop();
+    const auto responses = m_responses;
+    m_responses.clear();
+    m_reading = nullptr;
+    for (auto socket : responses) {
+        emit socket->disconnected();
+    }
+    deleteLater();
+}
+
+void Connection::onIdleTimeout()
+{
+    // Only close between requests, never while a response is being worked on.
+    if (m_responses.isEmpty()
+            || (m_responses.size() == 1 && m_reading && !m_reading->isHeadersParsed())) {
+        closeConnection();
+    }
+}
+
+void Connection::processBuffer()
+{
+    if (m_processing) // the outer call will continue with the buffer
+        return;
+    m_processing = true;
+    while (!m_buffer.isEmpty() && !m_closing && !m_disconnected) {
+        if (m_reading == nullptr) {
+            if (m_responses.size() >= MaxPipelinedRequests)
+                break; // continue when earlier responses are done
+            // the server factory gets the descriptor for compatibility only.
+            WebRequest *request = m_server->q->createRequest(m_socketDescriptor);
+            Q_ASSERT(request);
+            request->startHttpParsing(this);
+            m_reading = request->socket();
+            m_responses.append(m_reading);
+        }
+        Socket *socket = m_reading;
+        socket->d->receive(m_buffer);
+        if (m_reading != socket)  // it finished its response already
+            continue;
+        if (socket->d->readState != SocketPrivate::ReadFinished)
+            break; // needs more data
+        m_reading = nullptr;
+    }
+    m_processing = false;
+}
+
+void Connection::flushResponses()
+{
+    while (!m_responses.isEmpty()) {
+        Socket *head = m_responses.first();
+        if (!head->d->pendingOutput.isEmpty()) {
+            m_socket->write(head->d->pendingOutput);
+            head->d->pendingOutput.clear();
+        }
+        if (head->d->writeState != SocketPrivate::WriteFinished)
+            break; // still working on it
+        m_responses.removeFirst();
+        m_bytesOfEarlierResponses = m_socket->bytesToWrite();
+        // the request is done, let the app clean it up. Queued to avoid
+        // it being deleted while it is still on the stack.
+        QMetaObject::invokeMethod(head, "disconnected", Qt::QueuedConnection);
+    }
+    if (m_responses.isEmpty()) {
+        if (m_closing) {
+            m_socket->disconnectFromHost();
+            return;
+        }
+        m_idleTimer.start();
+    }
+    if (!m_closing)
+        processBuffer();
+}
+
+void Connection::closeConnection()
+{
+    m_closing = true;
+    m_buffer.clear();
+    const auto responses = m_responses;
+    m_responses.clear();
+    m_reading = nullptr;
+    for (auto socket : responses) {
+        QMetaObject::invokeMethod(socket, "disconnected", Qt::QueuedConnection);
+    }
+    m_socket->disconnectFromHost();
+}
@@ -0,0 +1,96 @@
+/* This file is part of Flowee
+ *
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * For the full copy of the License see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef HTTPENGINE_CONNECTION_P_H
+#define HTTPENGINE_CONNECTION_P_H
+
+#include <QList>
+#include <QObject>
+#include <QTimer>
+
+class QTcpSocket;
+
+namespace HttpEngine
+{
+
+class ServerPrivate;
+class Socket;
+
+/**
+ * One TCP connection accepted by the Server, living on a worker thread.
+ *
+ * A client can send many requests over one connection (HTTP/1.1 keep-alive)
+ * and may send the next before the previous is answered (pipelining). For
+ * every request a new WebRequest is created, so the application keeps
+ * seeing one WebRequest/Socket per request.
+ * Requests are handled concurrently, responses are sent in the order the
+ * requests came in; a later response is buffered until the ones before it
+ * are finished.
+ */
+class Connection : public QObject
+{
+    Q_OBJECT
+public:
+    Connection(ServerPrivate *server, qintptr socketDescriptor, int worker);
+    ~Connection() override;
+
+    QTcpSocket *tcpSocket() const;
+
+    /// write response data of \a socket, or buffer it if earlier responses are still pending.
+    void write(Socket *socket, const char *data, qint64 len);
+    /// the amount of response data of \a socket not yet sent.
+    qint64 bytesToWrite(const Socket *socket) const;
+    /// the response of \a socket is complete.
+    void responseFinished(Socket *socket, bool keepAlive);
+    /// a socket got deleted before it finished its response.
+    void socketDestroyed(Socket *socket);
+    /// false when the connection will be closed after the current responses.
+    bool acceptsMoreRequests() const;
+
+public slots:
+    void start();
+
+private slots:
+    void onReadyRead();
+    void onBytesWritten(qint64 bytes);
+    void onDisconnected();
+    void onIdleTimeout();
+
+private:
+    void startHttp();
+    void processBuffer();
+    void flushResponses();
+    void closeConnection();
+
+    ServerPrivate *m_server;
+    const qintptr m_socketDescriptor;
+    const int m_worker;
+    QTcpSocket *m_socket = nullptr;
+    QTimer m_idleTimer; // child of this, so it follows us to the worker thread
+
+    QByteArray m_buffer; // received, not yet claimed by a request
+    QList<Socket*> m_responses; // in request order, the first one is being written
+    Socket *m_reading = nullptr; // request still receiving its headers/body
+    qint64 m_bytesOfEarlierResponses = 0; // still in the QTcpSocket buffer
+    bool m_closing = false;
+    bool m_processing = false;
+    bool m_disconnected = false;
+};
+
+}
+
+#endif
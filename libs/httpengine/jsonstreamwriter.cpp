@@ -0,0 +1,272 @@
+/* This file is part of Flowee
+ *
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * For the full copy of the License see <http://www.gnu.org/licenses/>
+ */
+
+#include "jsonstreamwriter.h"
+
+#include <QIODevice>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QLocale>
+
+#include <cmath>
+
+using namespace HttpEngine;
+
+JsonStreamWriter::JsonStreamWriter(QIODevice *device, int flushThreshold)
+    : m_device(device),
+      m_flushThreshold(flushThreshold)
+{
+    Q_ASSERT(m_device);
+    m_buffer.reserve(flushThreshold + 1000);
+}
+
+JsonStreamWriter::~JsonStreamWriter()
+{
+    flush();
+}
+
+void JsonStreamWriter::setIndented(bool on)
+{
+    m_indented = on;
+}
+
+void JsonStreamWriter::beginObject()
+{
+    open('{');
+}
+
+void JsonStreamWriter::endObject()
+{
+    close('}');
+}
+
+void JsonStreamWriter::beginArray()
+{
+    open('[');
+}
+
+void JsonStreamWriter::endArray()
+{
+    close(']');
+}
+
+void JsonStreamWriter::writeName(const QString &name)
+{
+    Q_ASSERT(!m_stack.isEmpty());
+    Q_ASSERT(!m_afterName);
+    separate();
+    writeString(name);
+    m_buffer.append(m_indented ? ": " : ":");
+    m_afterName = true;
+}
+
+void JsonStreamWriter::write(const QString &name, const QJsonValue &value)
+{
+    writeName(name);
+    writeValue(value);
+}
+
+void JsonStreamWriter::writeValue(const QJsonValue &value)
+{
+    switch (value.type()) {
+    case QJsonValue::Object:
+    case QJsonValue::Array:
+        writeCompound(value);
+        return;
+    default:
+        break;
+    }
+
+    separate();
+    switch (value.type()) {
+    case QJsonValue::Bool:
+        m_buffer.append(value.toBool() ? "true" : "false");
+        break;
+    case QJsonValue::Double: {
+        const double d = value.toDouble();
+        if (!std::isfinite(d)) // same as QJsonDocument, JSON has no inf/nan
+            m_buffer.append("null");
+        else if (std::floor(d) == d && std::fabs(d) < 9007199254740992.) // 2^53
+            m_buffer.append(QByteArray::number(static_cast<qint64>(d)));
+        else
+            m_buffer.append(QByteArray::number(d, 'g', QLocale::FloatingPointShortest));
+        break;
+    }
+    case QJsonValue::String:
+        writeString(value.toString());
+        break;
+    default:
+        m_buffer.append("null");
+        break;
+    }
+    m_afterName = false;
+    if (m_buffer.size() >= m_flushThreshold)
+        flush();
+}
+
+void JsonStreamWriter::flush()
+{
+    if (m_buffer.isEmpty())
+        return;
+    if (m_device) // a client hanging up deletes the socket
+        m_device->write(m_buffer);
+    m_buffer.clear();
+}
+
+void JsonStreamWriter::separate()
+{
+    if (m_afterName) // value directly follows its name
+        return;
+    if (m_stack.isEmpty())
+        return;
+    if (m_stack.last())
+        m_buffer.append(',');
+    m_stack.last() = true;
+    newline();
+}
+
+void JsonStreamWriter::newline()
+{
+    if (!m_indented)
+        return;
+    m_buffer.append('\n');
+    m_buffer.append(QByteArray(m_stack.size() * 4, ' '));
+}
+
+void JsonStreamWriter::open(char bracket)
+{
+    separate();
+    m_buffer.append(bracket);
+    m_stack.append(false);
+    m_afterName = false;
+}
+
+void JsonStreamWriter::close(char bracket)
+{
+    Q_ASSERT(!m_stack.isEmpty());
+    Q_ASSERT(!m_afterName);
+    const bool hadItems = m_stack.takeLast();
+    if (hadItems)
+        newline();
+    m_buffer.append(bracket);
+    if (m_stack.isEmpty() && m_indented)
+        m_buffer.append('\n');
+    if (m_buffer.size() >= m_flushThreshold)
+        flush();
+}
+
+void JsonStreamWriter::writeCompound(const QJsonValue &value)
+{
+    if (value.isObject()) {
+        const QJsonObject object = value.toObject();
+        beginObject();
+        for (auto i = object.constBegin(); i != object.constEnd(); ++i)
+            write(i.key(), i.value());
+        endObject();
+    } else {
+        const QJsonArray array = value.toArray();
+        beginArray();
+        for (auto v : array)
+            writeValue(v);
+        endArray();
+    }
+}
+
+void JsonStreamWriter::writeString(const QString &string)
+{
+    static const char hex[] = "0123456789abcdef";
+    const QByteArray utf8 = string.toUtf8();
+    m_buffer.append('"');
+    for (const char c : utf8) {
+        switch (c) {
+        case '"': m_buffer.append("\\\""); break;
+        case '\\': m_buffer.append("\\\\"); break;
+        case '\b': m_buffer.append("\\b"); break;
+        case '\f': m_buffer.append("\\f"); break;
+        case '\n': m_buffer.append("\\n"); break;
+        case '\r': m_buffer.append("\\r"); break;
+        case '\t': m_buffer.append("\\t"); break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                m_buffer.append("\\u00");
+                m_buffer.append(hex[(c >> 4) & 0xF]);
+                m_buffer.append(hex[c & 0xF]);
+            } else {
+                m_buffer.append(c);
+            }
+        }
+    }
+    m_buffer.append('"');
+}
+
+
+JsonArrayStreamer::JsonArrayStreamer(QIODevice *device, int itemCount, const ItemWriter &writeItem, QObject *parent)
+    : QObject(parent),
+      m_device(device),
+      m_writer(new JsonStreamWriter(device)),
+      m_writeItem(writeItem),
+      m_itemCount(itemCount)
+{
+    Q_ASSERT(m_writeItem);
+}
+
+void JsonArrayStreamer::setIndented(bool on)
+{
+    m_writer->setIndented(on);
+}
+
+void JsonArrayStreamer::setMaxPendingBytes(qint64 bytes)
+{
+    m_maxPendingBytes = bytes;
+}
+
+qint64 JsonArrayStreamer::maxPendingBytes() const
+{
+    return m_maxPendingBytes;
+}
+
+int JsonArrayStreamer::itemsWritten() const
+{
+    return m_nextItem;
+}
+
+void JsonArrayStreamer::start()
+{
+    Q_ASSERT(m_device);
+    m_writer->beginArray();
+    connect(m_device, SIGNAL(bytesWritten(qint64)), this, SLOT(writeItems()));
+    writeItems();
+}
+
+void JsonArrayStreamer::writeItems()
+{
+    if (m_finished || m_device.isNull())
+        return;
+    while (m_nextItem < m_itemCount && m_device->bytesToWrite() < m_maxPendingBytes) {
+        m_writeItem(*m_writer, m_nextItem++);
+    }
+    if (m_nextItem < m_itemCount) {
+        // wait for the client to catch up, continues on bytesWritten()
+        m_writer->flush();
+        return;
+    }
+    m_finished = true;
+    disconnect(m_device, SIGNAL(bytesWritten(qint64)), this, SLOT(writeItems()));
+    m_writer->endArray();
+    m_writer->flush();
+    Q_EMIT finished();
+}
@@ -0,0 +1,164 @@
+/* This file is part of Flowee
+ *
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * For the full copy of the License see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef HTTPENGINE_JSONSTREAMWRITER_H
+#define HTTPENGINE_JSONSTREAMWRITER_H
+
+#include <QByteArray>
+#include <QJsonValue>
+#include <QObject>
+#include <QPointer>
+#include <QVector>
+
+#include <functional>
+#include <memory>
+
+#include "httpengine_export.h"
+
+class QIODevice;
+
+namespace HttpEngine
+{
+
+/**
+ * @brief Incremental JSON serializer writing into a QIODevice
+ *
+ * Where QJsonDocument requires the whole tree to be built in memory before
+ * it can be serialized, this class writes the JSON text as the structure is
+ * being walked. Output is collected in a small buffer which is written to
+ * the device each time it passes the flush threshold, combined with
+ * Socket::beginStreamingResponse() each flush becomes one HTTP chunk.
+ *
+ * @code
+ * socket->beginStreamingResponse();
+ * JsonStreamWriter writer(socket);
+ * writer.beginObject();
+ * writer.writeName("txs");
+ * writer.beginArray();
+ * for (auto tx : list)
+ *     writer.writeValue(tx); // a QJsonObject
+ * writer.endArray();
+ * writer.endObject();
+ * writer.flush();
+ * socket->close();
+ * @endcode
+ *
+ * The caller is responsible for producing a well-formed structure, each name
+ * inside an object has to be followed by exactly one value.
+ */
+class HTTPENGINE_EXPORT JsonStreamWriter
+{
+public:
+    explicit JsonStreamWriter(QIODevice *device, int flushThreshold = 16000);
+    ~JsonStreamWriter();
+
+    /// Use indentation and newlines, like QJsonDocument::Indented.
+    void setIndented(bool on);
+
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+
+    /// Write the name of the next member inside an object.
+    void writeName(const QString &name);
+
+    /// Write a (possibly compound) value in the current array, or after a writeName().
+    void writeValue(const QJsonValue &value);
+    /// Convenience for writing a name/value pair inside an object.
+    void write(const QString &name, const QJsonValue &value);
+
+    /// Write all buffered data to the device.
+    void flush();
+
+private:
+    void separate();
+    void newline();
+    void open(char bracket);
+    void close(char bracket);
+    void writeString(const QString &string);
+    void writeCompound(const QJsonValue &value);
+
+    QPointer<QIODevice> m_device;
+    QByteArray m_buffer;
+    const int m_flushThreshold;
+    bool m_indented = true;
+    bool m_afterName = false;
+    // one entry per open object/array, true when it already holds an item
+    QVector<bool> m_stack;
+};
+
+/**
+ * @brief Writes a JSON array item by item, at the pace the client reads it
+ *
+ * Rendering a long list in one go fills the socket buffer with all of it
+ * when the client is slower than we are. This class only asks for the next
+ * item while the device has less than maxPendingBytes() waiting to be sent,
+ * and continues when the device reports bytesWritten().
+ *
+ * @code
+ * socket->beginStreamingResponse();
+ * auto streamer = new JsonArrayStreamer(socket, list.size(),
+ *         [&list](JsonStreamWriter &writer, int index) {
+ *     writer.writeValue(list.at(index));
+ * }, socket);
+ * connect(streamer, SIGNAL(finished()), socket, SLOT(close()));
+ * streamer->start();
+ * @endcode
+ *
+ * An empty list results in an empty JSON array.
+ */
+class HTTPENGINE_EXPORT JsonArrayStreamer : public QObject
+{
+    Q_OBJECT
+public:
+    typedef std::function<void(JsonStreamWriter &writer, int index)> ItemWriter;
+
+    JsonArrayStreamer(QIODevice *device, int itemCount, const ItemWriter &writeItem, QObject *parent = nullptr);
+
+    /// Use indentation and newlines, like QJsonDocument::Indented.
+    void setIndented(bool on);
+
+    void setMaxPendingBytes(qint64 bytes);
+    qint64 maxPendingBytes() const;
+
+    /// The amount of items written so far.
+    int itemsWritten() const;
+
+public Q_SLOTS:
+    void start();
+
+Q_SIGNALS:
+    /// All items and the end of the array have been written to the device.
+    void finished();
+
+private Q_SLOTS:
+    void writeItems();
+
+private:
+    QPointer<QIODevice> m_device;
+    std::unique_ptr<JsonStreamWriter> m_writer;
+    ItemWriter m_writeItem;
+    const int m_itemCount;
+    int m_nextItem = 0;
+    qint64 m_maxPendingBytes = 100000;
+    bool m_finished = false;
+};
+
+}
+
+#endif
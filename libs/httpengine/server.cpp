@@ -17,6 +17,7 @@
  */
 
 #include "server_p.h"
+#include "connection_p.h"
 
 #if !defined(QT_NO_SSL)
 #  include <QSslSocket>
@@ -26,12 +27,24 @@
 #include "handler.h"
 #include "socket.h"
 
+#include <climits>
+
 using namespace HttpEngine;
 
 ServerPrivate::ServerPrivate(Server *httpServer)
     : QObject(httpServer),
-      q(httpServer)
+      q(httpServer),
+      maxConnectionsPerThread(1000),
+      keepAliveTimeout(30),
+      openConnections(static_cast<size_t>(QThread::idealThreadCount())),
+      connectionsAccepted(0),
+      connectionsRejected(0),
+      requests(0),
+      intervalRequests(0),
+      intervalLatency(0),
+      intervalMaxLatency(0)
 {
+    intervalTimer.start();
     for (int i = 0; i < QThread::idealThreadCount(); ++i) {
         QThread *t = new QThread();
         t->setObjectName("HttpWorker");
@@ -57,6 +70,32 @@ void ServerPrivate::schedule(qintptr socketDescriptor)
     Q_UNUSED(socketDescriptor)
 }
 
+void ServerPrivate::reject(qintptr socketDescriptor)
+{
+    ++connectionsRejected;
+    QTcpSocket *socket = new QTcpSocket(this);
+    connect(socket, &QTcpSocket::disconnected, socket, &QTcpSocket::deleteLater);
+    socket->setSocketDescriptor(socketDescriptor);
+#if !defined(QT_NO_SSL)
+    if (!configuration.isNull()) { // we can't talk plain HTTP to them
+        socket->abort();
+        socket->deleteLater();
+        return;
+    }
+#endif
+    socket->write("HTTP/1.1 503 SERVICE UNAVAILABLE\r\nConnection: close\r\nContent-Length: 0\r\n\r\n");
+    socket->disconnectFromHost();
+}
+
+void ServerPrivate::requestFinished(quint64 latencyUs)
+{
+    ++requests;
+    ++intervalRequests;
+    intervalLatency += latencyUs;
+    quint64 max = intervalMaxLatency;
+    while (latencyUs > max && !intervalMaxLatency.compare_exchange_weak(max, latencyUs));
+}
+
 Server::Server()
     : d(new ServerPrivate(this))
 {
@@ -81,16 +120,72 @@ WebRequest *HttpEngine::Server::createRequest(qintptr socketDescriptor)
     return new WebRequest(socketDescriptor, d->func);
 }
 
+Server::Statistics Server::statistics()
+{
+    Statistics answer;
+    answer.connectionsAccepted = d->connectionsAccepted;
+    answer.connectionsRejected = d->connectionsRejected;
+    for (const auto &count : d->openConnections) {
+        answer.openConnections += count;
+    }
+    answer.requests = d->requests;
+    const quint64 requests = d->intervalRequests.exchange(0);
+    const quint64 latency = d->intervalLatency.exchange(0);
+    answer.maxLatencyUs = d->intervalMaxLatency.exchange(0);
+    if (requests > 0)
+        answer.averageLatencyUs = latency / requests;
+    const qint64 elapsed = d->intervalTimer.restart();
+    if (elapsed > 0)
+        answer.requestsPerSecond = requests * 1000. / elapsed;
+    return answer;
+}
+
+void Server::setMaxConnectionsPerThread(int max)
+{
+    d->maxConnectionsPerThread = max;
+}
+
+int Server::maxConnectionsPerThread() const
+{
+    return d->maxConnectionsPerThread;
+}
+
+void Server::setKeepAliveTimeout(int seconds)
+{
+    d->keepAliveTimeout = seconds;
+}
+
+int Server::keepAliveTimeout() const
+{
+    return d->keepAliveTimeout;
+}
+
 void Server::incomingConnection(qintptr socketDescriptor)
 {
     Q_ASSERT(d->nextWorker < d->threads.size());
-    QThread *t = d->threads.at(d->nextWorker);
-    auto request = createRequest(socketDescriptor);
-    request->setSslConfiguration(d->configuration);
-    request->moveToThread(t);
-    QTimer::singleShot(0, request, SLOT(start()));
+    // pick the thread with the fewest connections, round-robin between equals.
+    int worker = d->nextWorker;
+    int lowest = INT_MAX;
+    for (int i = 0; i < d->threads.size(); ++i) {
+        const int index = (d->nextWorker + i) % d->threads.size();
+        const int count = d->openConnections[index];
+        if (count < lowest) {
+            lowest = count;
+            worker = index;
+        }
+    }
     if (++d->nextWorker >= d->threads.size())
         d->nextWorker = 0;
+    if (lowest >= d->maxConnectionsPerThread) {
+        d->reject(socketDescriptor);
+        return;
+    }
+
+    ++d->openConnections[worker];
+    ++d->connectionsAccepted;
+    auto connection = new Connection(d, socketDescriptor, worker);
+    connection->moveToThread(d->threads.at(worker));
+    QTimer::singleShot(0, connection, SLOT(start()));
 }
 
 WebRequest::WebRequest(qintptr socketDescriptor, std::function<void(HttpEngine::WebRequest*)> &handler)
@@ -130,7 +225,6 @@ void WebRequest::start()
         socket->setSocketDescriptor(m_socketDescriptor);
         startHttpParsing(socket);
     }
-
 }
 
 Socket *WebRequest::socket() const
@@ -143,10 +237,20 @@ QString WebRequest::path() const
     return m_socket->path();
 }
 
+void WebRequest::startHttpParsing(Connection *connection)
+{
+    m_socket = new Socket(connection, this);
+    connectHandler();
+}
+
 void WebRequest::startHttpParsing(QTcpSocket *socket)
 {
     m_socket = new Socket(socket, this);
+    connectHandler();
+}
 
+void WebRequest::connectHandler()
+{
     // Wait until the socket finishes reading the HTTP headers before routing
     connect(m_socket, &Socket::headersParsed, [this]() {
         try {
@@ -158,7 +262,9 @@ void WebRequest::startHttpParsing(QTcpSocket *socket)
     });
 }
 
+#if !defined(QT_NO_SSL)
 void WebRequest::setSslConfiguration(const QSslConfiguration &configuration)
 {
     m_ssl = configuration;
 }
+#endif
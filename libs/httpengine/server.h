@@ -35,6 +35,7 @@ namespace HttpEngine
 class ServerPrivate;
 class WebRequest;
 class Socket;
+class Connection;
 
 class HTTPENGINE_EXPORT WebRequest : public QObject
 {
@@ -47,13 +48,23 @@ public:
     QString path() const;
 
 public slots:
+    /**
+     * Serve a single request on the socket descriptor passed in the constructor.
+     *
+     * The Server doesn't call this, it hands requests on a keep-alive
+     * connection to the WebRequest itself. This is for users that accept
+     * sockets outside of the Server, the connection is closed after the response.
+     */
     void start();
 
 protected:
     Socket *m_socket;
 
 private:
+    friend class Connection;
+    void startHttpParsing(Connection *connection);
     void startHttpParsing(QTcpSocket *socket);
+    void connectHandler();
 
     qintptr m_socketDescriptor;
     std::function<void(WebRequest*)> m_handler;
@@ -61,10 +72,11 @@ private:
 #if !defined(QT_NO_SSL)
 public:
     /**
-     * @brief Set the SSL configuration for the server
+     * @brief Set the SSL configuration used by start()
      *
-     * If the configuration is not NULL, the server will begin negotiating
-     * connections using SSL/TLS.
+     * If the configuration is not NULL, start() will begin negotiating
+     * the connection using SSL/TLS. Connections accepted by the Server use
+     * Server::setSslConfiguration() instead.
      */
     void setSslConfiguration(const QSslConfiguration &configuration);
 
@@ -122,9 +134,46 @@ public:
      * The default implementation will simply create the baseclass but
      * users may want to create a subclass that they get handed in order
      * to provide all the context they need in their apps.
+     *
+     * Clients using keep-alive send many requests over one connection,
+     * each request gets its own WebRequest. Notice that this method is
+     * called on the worker thread that owns the connection.
      */
     virtual WebRequest *createRequest(qintptr socketDescriptor);
 
+    struct Statistics {
+        quint64 connectionsAccepted = 0;
+        /// connections refused because all threads were at their budget
+        quint64 connectionsRejected = 0;
+        int openConnections = 0;
+        quint64 requests = 0;
+        // the following are over the period since the previous call to statistics()
+        double requestsPerSecond = 0;
+        quint64 averageLatencyUs = 0; ///< from headers received to response complete
+        quint64 maxLatencyUs = 0;
+    };
+
+    /**
+     * Return the request-rate and latency counters.
+     * The rate and latency numbers are reset on every call.
+     */
+    Statistics statistics();
+
+    /**
+     * Set the amount of connections a single worker thread handles.
+     * New connections are handed to the least busy thread, when all of them
+     * reached this budget the connection is answered with a 503 and closed.
+     */
+    void setMaxConnectionsPerThread(int max);
+    int maxConnectionsPerThread() const;
+
+    /**
+     * Set the amount of seconds an idle keep-alive connection stays open.
+     * Zero disables keep-alive, closing the connection after each response.
+     */
+    void setKeepAliveTimeout(int seconds);
+    int keepAliveTimeout() const;
+
 #if !defined(QT_NO_SSL)
     /**
      * @brief Set the SSL configuration for the server
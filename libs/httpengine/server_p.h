@@ -21,10 +21,14 @@
 
 #include "server.h"
 
+#include <QElapsedTimer>
 #include <QObject>
 #include <QTcpSocket>
 #include <QThreadPool>
 
+#include <atomic>
+#include <vector>
+
 #if !defined(QT_NO_SSL)
 #  include <QSslConfiguration>
 #endif
@@ -43,6 +47,10 @@ public:
     ~ServerPrivate();
 
     void schedule(qintptr socketDescriptor);
+    /// refuse a connection because all worker threads are at their connection budget
+    void reject(qintptr socketDescriptor);
+    /// called from the worker threads as each response completes
+    void requestFinished(quint64 latencyUs);
 
 #if !defined(QT_NO_SSL)
     QSslConfiguration configuration;
@@ -53,6 +61,19 @@ public:
     QList<QThread*> threads;
     int nextWorker = 0;
 
+    std::atomic<int> maxConnectionsPerThread;
+    std::atomic<int> keepAliveTimeout; // in seconds
+    std::vector<std::atomic<int> > openConnections; // per worker thread
+
+    std::atomic<quint64> connectionsAccepted;
+    std::atomic<quint64> connectionsRejected;
+    std::atomic<quint64> requests;
+    // reset on every call to Server::statistics()
+    std::atomic<quint64> intervalRequests;
+    std::atomic<quint64> intervalLatency;
+    std::atomic<quint64> intervalMaxLatency;
+    QElapsedTimer intervalTimer;
+
 };
 
 }
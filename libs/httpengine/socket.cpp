@@ -16,6 +16,7 @@
  * For the full copy of the License see <http://www.gnu.org/licenses/>
  */
 
+#include "connection_p.h"
 #include "parser.h"
 #include "socket_p.h"
 
@@ -52,6 +53,7 @@ const QString ErrorTemplate =
 SocketPrivate::SocketPrivate(Socket *httpSocket, QTcpSocket *tcpSocket)
     : QObject(httpSocket),
       socket(tcpSocket),
+      sharedConnection(false),
       readState(ReadHeaders),
       requestDataRead(0),
       requestDataTotal(-1),
@@ -71,6 +73,28 @@ SocketPrivate::SocketPrivate(Socket *httpSocket, QTcpSocket *tcpSocket)
     onReadyRead();
 }
 
+SocketPrivate::SocketPrivate(Socket *httpSocket, Connection *connection)
+    : QObject(httpSocket),
+      socket(connection->tcpSocket()),
+      connection(connection),
+      sharedConnection(true),
+      readState(ReadHeaders),
+      requestDataRead(0),
+      requestDataTotal(-1),
+      writeState(WriteNone),
+      responseStatusCode(200),
+      responseStatusReason(statusReason(200)),
+      q(httpSocket)
+{
+    // The connection owns the QTcpSocket and feeds us our part of the data
+}
+
+SocketPrivate::~SocketPrivate()
+{
+    if (sharedConnection && connection && writeState != WriteFinished)
+        connection->socketDestroyed(q);
+}
+
 QByteArray SocketPrivate::statusReason(int statusCode) const
 {
     switch (statusCode) {
@@ -98,7 +122,68 @@ void SocketPrivate::onReadyRead()
 {
     // Append all of the new data to the read buffer
     readBuffer.append(socket->readAll());
+    processReadBuffer();
+}
+
+void SocketPrivate::receive(QByteArray &data)
+{
+    Q_ASSERT(sharedConnection);
+    if (readState == ReadFinished)
+        return;
+    readBuffer.append(data);
+    data.clear();
+    takeSurplus();
+    processReadBuffer();
+    data = surplus;
+    surplus.clear();
+}
+
+bool SocketPrivate::requestComplete() const
+{
+    if (readState == ReadHeaders)
+        return false;
+    return requestDataRead + readBuffer.size() >= qMax<qint64>(0, requestDataTotal);
+}
+
+bool SocketPrivate::canKeepAlive() const
+{
+    if (!sharedConnection || !connection || !requestIsHttp11)
+        return false;
+    if (requestHeaders.value("Connection").toLower().contains("close"))
+        return false;
+    // we don't parse chunked request bodies, so we can't find the start of the next request.
+    if (requestHeaders.contains("Transfer-Encoding"))
+        return false;
+    return connection->acceptsMoreRequests();
+}
+
+qint64 SocketPrivate::write(const char *data, qint64 len)
+{
+    if (sharedConnection) {
+        if (connection.isNull())
+            return -1;
+        connection->write(q, data, len);
+        return len;
+    }
+    if (socket.isNull())
+        return -1;
+    return socket->write(data, len);
+}
+
+void SocketPrivate::takeSurplus()
+{
+    // On a shared connection anything after the body is the next request.
+    if (!sharedConnection || readState != ReadData)
+        return;
+    const qint64 wanted = qMax<qint64>(0, requestDataTotal) - requestDataRead;
+    if (readBuffer.size() > wanted) {
+        surplus.append(readBuffer.mid(wanted));
+        readBuffer.truncate(wanted);
+    }
+}
 
+void SocketPrivate::processReadBuffer()
+{
     // If reading headers, return if they could not be read (yet)
     if (readState == ReadHeaders && !readHeaders()) {
         return;
@@ -160,9 +245,12 @@ bool SocketPrivate::readHeaders()
         return false;
     }
 
+    requestIsHttp11 = readBuffer.left(readBuffer.indexOf("\r\n")).endsWith("HTTP/1.1");
+
     // Remove the headers from the buffer
     readBuffer.remove(0, index + 4);
     readState = ReadData;
+    requestTimer.start();
 
     // If the content-length header is present, use it to determine
     // how much data to expect from the socket - not all requests
@@ -170,6 +258,7 @@ bool SocketPrivate::readHeaders()
     if (requestHeaders.contains("Content-Length")) {
         requestDataTotal = requestHeaders.value("Content-Length").toLongLong();
     }
+    takeSurplus();
 
     // Indicate that the headers have been parsed
     Q_EMIT q->headersParsed();
@@ -190,6 +279,9 @@ void SocketPrivate::readData()
             requestDataRead + readBuffer.size() >= requestDataTotal) {
         readState = ReadFinished;
         Q_EMIT q->readChannelFinished();
+    } else if (sharedConnection && requestDataTotal == -1) {
+        // Without a Content-Length there is no body on a keep-alive connection
+        readState = ReadFinished;
     }
 }
 
@@ -201,6 +293,13 @@ Socket::Socket(QTcpSocket *socket, QObject *parent)
     setOpenMode(QIODevice::ReadWrite);
 }
 
+Socket::Socket(Connection *connection, QObject *parent)
+    : QIODevice(parent),
+      d(new SocketPrivate(this, connection))
+{
+    setOpenMode(QIODevice::ReadWrite);
+}
+
 qint64 Socket::bytesAvailable() const
 {
     if (d->readState > SocketPrivate::ReadHeaders) {
@@ -210,6 +309,13 @@ qint64 Socket::bytesAvailable() const
     }
 }
 
+qint64 Socket::bytesToWrite() const
+{
+    if (d->sharedConnection)
+        return d->connection.isNull() ? 0 : d->connection->bytesToWrite(this);
+    return d->socket.isNull() ? 0 : d->socket->bytesToWrite();
+}
+
 bool Socket::isSequential() const
 {
     return true;
@@ -217,18 +323,36 @@ bool Socket::isSequential() const
 
 void Socket::close()
 {
+    const bool wasFinished = d->writeState == SocketPrivate::WriteFinished;
+    // Terminate a chunked response with the zero-length chunk
+    if (d->responseIsChunked && !wasFinished) {
+        d->write("0\r\n\r\n", 5);
+        d->responseIsChunked = false;
+    }
+
     // Invoke the parent method
     QIODevice::close();
 
+    const bool keepAlive = d->keepAlive && d->requestComplete();
     d->readState = SocketPrivate::ReadFinished;
     d->writeState = SocketPrivate::WriteFinished;
 
-    connect(d->socket, &QTcpSocket::disconnected, this, &Socket::deleteLater);
-    d->socket->close();
+    if (d->sharedConnection) {
+        // The connection outlives this request, it decides when to close.
+        if (!wasFinished && d->connection)
+            d->connection->responseFinished(this, keepAlive);
+        return;
+    }
+    if (d->socket) {
+        connect(d->socket.data(), &QTcpSocket::disconnected, this, &Socket::deleteLater);
+        d->socket->close();
+    }
 }
 
 QHostAddress Socket::peerAddress() const
 {
+    if (d->socket.isNull())
+        return QHostAddress();
     return d->socket->peerAddress();
 }
 
@@ -306,8 +430,18 @@ void Socket::writeHeaders()
     // exactly how many bytes were written
     QByteArray header;
 
+    d->keepAlive = d->canKeepAlive();
+    if (d->keepAlive && !d->responseIsChunked && d->requestMethod != HEAD
+            && !d->responseHeaders.contains("Content-Length")) {
+        // the client needs to be able to find the end of the body to keep the connection
+        d->responseIsChunked = true;
+        setHeader("Transfer-Encoding", "chunked");
+    }
+    if (d->requestIsHttp11 && !d->keepAlive)
+        setHeader("Connection", "close");
+
     // Append the status line
-    header.append("HTTP/1.0 ");
+    header.append(d->requestIsHttp11 ? "HTTP/1.1 " : "HTTP/1.0 ");
     header.append(QByteArray::number(d->responseStatusCode) + " " + d->responseStatusReason);
     header.append("\r\n");
 
@@ -326,7 +460,7 @@ void Socket::writeHeaders()
     d->responseHeaderRemaining = header.length();
 
     // Write the header
-    d->socket->write(header);
+    d->write(header.constData(), header.size());
 }
 
 void Socket::writeRedirect(const QByteArray &path, bool permanent)
@@ -365,6 +499,16 @@ void Socket::writeJson(const QJsonDocument &document, QJsonDocument::JsonFormat
     close();
 }
 
+void Socket::beginStreamingResponse()
+{
+    Q_ASSERT(d->writeState == SocketPrivate::WriteNone);
+    if (d->requestIsHttp11 && d->requestMethod != HEAD) {
+        d->responseIsChunked = true;
+        setHeader("Transfer-Encoding", "chunked");
+    }
+    writeHeaders();
+}
+
 qint64 Socket::readData(char *data, qint64 maxlen)
 {
     // Ensure the connection is in the correct state for reading data
@@ -391,7 +535,16 @@ qint64 Socket::writeData(const char *data, qint64 len)
         writeHeaders();
     }
 
-    return d->socket->write(data, len);
+    if (d->responseIsChunked) {
+        if (len == 0) // a zero sized chunk would end the response
+            return 0;
+        const QByteArray size = QByteArray::number(len, 16) + "\r\n";
+        d->write(size.constData(), size.size());
+        d->write(data, len);
+        d->write("\r\n", 2);
+        return len;
+    }
+    return d->write(data, len);
 }
 
 void HttpEngine::returnTemplatePath(Socket *socket, const QString &templateName, const QString &error)
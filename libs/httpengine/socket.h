@@ -35,6 +35,7 @@ namespace HttpEngine
 {
 
 class HTTPENGINE_EXPORT SocketPrivate;
+class Connection;
 
 /**
  * @brief Implementation of the HTTP protocol
@@ -189,6 +190,13 @@ public:
      */
     qint64 bytesAvailable() const override;
 
+    /**
+     * @brief Retrieve the number of bytes of the response not yet sent
+     *
+     * On a keep-alive connection this only counts the data of this response.
+     */
+    qint64 bytesToWrite() const override;
+
     /**
      * @brief Determine if the device is sequential
      *
@@ -331,6 +339,18 @@ public:
      */
     void writeJson(const QJsonDocument &document, QJsonDocument::JsonFormat format = QJsonDocument::Indented);
 
+    /**
+     * @brief Start a response of which the length is not known up-front
+     *
+     * The headers are written immediately. If the client speaks HTTP/1.1 the
+     * chunked transfer-encoding is used and every write() becomes one chunk,
+     * older clients get the data as-is and the end of the response is marked
+     * by closing the connection.
+     *
+     * Call close() after all data has been written.
+     */
+    void beginStreamingResponse();
+
 Q_SIGNALS:
 
     /**
@@ -345,6 +365,10 @@ Q_SIGNALS:
 
     /**
      * @brief Indicate that the client has disconnected
+     *
+     * Sockets handed out by the Server share a keep-alive connection with
+     * the other requests of the same client, for those this signal means that
+     * the response has been handed off and this request is done.
      */
     void disconnected();
 
@@ -361,9 +385,13 @@ protected:
     qint64 writeData(const char *data, qint64 len) override;
 
 private:
+    /// create a socket for one request on a (keep-alive) connection
+    Socket(Connection *connection, QObject *parent);
 
     SocketPrivate *const d;
     friend class SocketPrivate;
+    friend class Connection;
+    friend class WebRequest;
 };
 
 
@@ -20,7 +20,9 @@
 
 #include "socket.h"
 
-class QTcpSocket;
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QTcpSocket>
 
 namespace HttpEngine
 {
@@ -32,12 +34,29 @@ class SocketPrivate : public QObject
 public:
 
     SocketPrivate(Socket *httpSocket, QTcpSocket *tcpSocket);
+    SocketPrivate(Socket *httpSocket, Connection *connection);
+    ~SocketPrivate();
 
     QByteArray statusReason(int statusCode) const;
 
-    QTcpSocket *socket;
+    /// Take the bytes belonging to this request from \a data, leaving the rest.
+    void receive(QByteArray &data);
+    /// True if the full request, including its body, has been received.
+    bool requestComplete() const;
+    /// True if the connection may stay open after this request.
+    bool canKeepAlive() const;
+    qint64 write(const char *data, qint64 len);
+
+    QPointer<QTcpSocket> socket;
     QByteArray readBuffer;
 
+    // set when this socket is one request on a keep-alive connection
+    QPointer<Connection> connection;
+    const bool sharedConnection;
+    QByteArray surplus; // data read that belongs to the next request
+    QByteArray pendingOutput; // response held back while earlier responses are written
+    QElapsedTimer requestTimer;
+
     enum {
         ReadHeaders,
         ReadData,
@@ -51,6 +70,7 @@ public:
     Socket::HeaderMap requestHeaders;
     qint64 requestDataRead;
     qint64 requestDataTotal;
+    bool requestIsHttp11 = false;
 
     enum {
         WriteNone,
@@ -63,6 +83,8 @@ public:
     QByteArray responseStatusReason;
     Socket::HeaderMap responseHeaders;
     qint64 responseHeaderRemaining;
+    bool responseIsChunked = false;
+    bool keepAlive = false;
 
 private Q_SLOTS:
 
@@ -72,10 +94,13 @@ private Q_SLOTS:
 
 private:
 
+    void processReadBuffer();
     bool readHeaders();
     void readData();
+    void takeSurplus();
 
     Socket*const q;
+    friend class Connection;
 };
 
 }
@@ -148,6 +148,19 @@ enum MessageIds {
 
     GetMempoolInfo,
     GetMempoolInfoReply,
+
+    /**
+     * Submit a batch of up to 2500 transactions in one message.
+     * Each transaction is sent as a Transaction tag, in any order. Transactions spending
+     * outputs of another transaction in the same batch are only validated after their
+     * parent has been accepted, and not at all when their parent was rejected.
+     * With ValidateOnly no parent enters the mempool, so transactions spending an
+     * output of another transaction in the batch are rejected without validation.
+     * The reply has one entry per transaction, in request order, each with the TxId
+     * and, when it was rejected, a RejectReason. Entries end with a Separator.
+     */
+    SendTransactions,
+    SendTransactionsReply,
 };
 enum Tags {
     Separator = Api::Separator,
@@ -171,6 +184,8 @@ enum Tags {
     FirstSeenTime, // long-int with seconds since epoch (UTC)
     MatchingOutIndex, // int. Output index that matches the requested search.
     ValidateOnly,       // bool, if true then we stop after validation finished.
+    KeepOrphan,         // bool, if true a transaction spending unknown outputs is kept until those arrive.
+    RejectReason,       // string, the reason a transaction in a SendTransactions batch was not accepted.
 
     // for individual transaction you can select how they should be returned.
     Include_TxId = 43,      ///< bool.
@@ -208,6 +223,25 @@ enum MessageIds {
     GetBlockCountReply,
     GetTransaction,
     GetTransactionReply,
+    /**
+     * Request the script-hash filter of a block.
+     * The filter is a Golomb-coded set (see libs/utils/GolombCodedSet.h) of the
+     * sha256 of all output scripts and of all the outputs spent in this block.
+     * Request with either a BlockHeight or a BlockHash, the reply has both,
+     * as well as FilterItemCount and the filter in GenericByteData.
+     */
+    GetBlockFilter,
+    GetBlockFilterReply,
+    /**
+     * Fetch many transactions in one request.
+     * Each transaction is requested with a Tx_OffsetInBlock, it uses the last BlockHeight
+     * seen in the message. The options of GetTransaction apply to all of them.
+     * The reply has one entry per transaction, in request order, each starting
+     * with BlockHeight and Tx_OffsetInBlock and ending with a Separator.
+     * One request can ask for at most 2500 transactions.
+     */
+    GetTransactions,
+    GetTransactionsReply,
 //   getchaintips
 //   getdifficulty
 //   gettxout "txid" n ( includemempool )
@@ -274,7 +308,10 @@ enum Tags {
     Nonce,          // int
     Bits,           // int
     PrevBlockHash,  // sha256
-    NextBlockHash  // sha256
+    NextBlockHash,  // sha256
+
+    // GetBlockFilterReply-tags
+    FilterItemCount = 80 // int
 
 };
 
@@ -414,7 +451,8 @@ enum MessageIds {
 
 enum Tags {
     BlockHash = Api::BlockHash,
-    BlockHeight = Api::BlockHeight
+    BlockHeight = Api::BlockHeight,
+    ReorgDuration = 20 ///< int. In BlocksRemoved; the time, in milliseconds, the hub took to process the reorg.
 };
 }
 
@@ -75,9 +75,9 @@ void ValidationInterfaceBroadcaster::doubleSpendFound(const Tx &txInMempool, con
     for (auto i : m_listeners) i->doubleSpendFound(txInMempool, proof);
 }
 
-void ValidationInterfaceBroadcaster::chainReorged(CBlockIndex *oldTip, const std::vector<FastBlock> &revertedBlocks)
+void ValidationInterfaceBroadcaster::chainReorged(CBlockIndex *oldTip, const std::vector<FastBlock> &revertedBlocks, int64_t duration)
 {
-    for (auto i : m_listeners) i->chainReorged(oldTip, revertedBlocks);
+    for (auto i : m_listeners) i->chainReorged(oldTip, revertedBlocks, duration);
 }
 
 void ValidationInterfaceBroadcaster::addListener(ValidationInterface *impl)
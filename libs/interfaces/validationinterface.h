@@ -72,7 +72,14 @@ public:
      */
     virtual void doubleSpendFound(const Tx &txInMempool, const DoubleSpendProof &proof) {}
 
-    virtual void chainReorged(CBlockIndex *oldTip,  const std::vector<FastBlock> &revertedBlocks) {}
+    /**
+     * Notifies listeners that blocks have been removed from the chain.
+     * @param oldTip the tip before the reorg.
+     * @param revertedBlocks the removed blocks, starting with the old tip.
+     * @param duration the amount of microseconds it took to disconnect the blocks and
+     *      re-add their transactions to the mempool.
+     */
+    virtual void chainReorged(CBlockIndex *oldTip,  const std::vector<FastBlock> &revertedBlocks, int64_t duration) {}
 };
 
 class ValidationInterfaceBroadcaster : public ValidationInterface
@@ -88,7 +95,7 @@ public:
     void resendWalletTransactions(int64_t nBestBlockTime) override;
     void doubleSpendFound(const Tx &first, const Tx &duplicate) override;
     void doubleSpendFound(const Tx &txInMempool, const DoubleSpendProof &proof) override;
-    void chainReorged(CBlockIndex *oldTip,  const std::vector<FastBlock> &revertedBlocks) override;
+    void chainReorged(CBlockIndex *oldTip,  const std::vector<FastBlock> &revertedBlocks, int64_t duration) override;
 
     void addListener(ValidationInterface *impl);
     void removeListener(ValidationInterface *impl);
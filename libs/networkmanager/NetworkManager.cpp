@@ -29,6 +29,7 @@
 #include <boost/lexical_cast.hpp>
 #include <boost/make_shared.hpp>
 
+#include <algorithm>
 #include <fstream>
 
 // #define DEBUG_CONNECTIONS
@@ -197,10 +198,7 @@ void NetworkManager::removeService(NetworkServiceBase *service)
 void NetworkManager::setMessageIdLookup(const std::map<int, std::string> &table)
 {
     d->messageIds = table;
-    d->messageIdsReverse.clear();
-    for (auto iter = table.begin(); iter != table.end(); ++iter) {
-        d->messageIdsReverse.insert(std::make_pair(iter->second, iter->first));
-    }
+    d->legacyCommands.set(table);
 }
 
 void NetworkManager::setLegacyNetworkId(const std::vector<uint8_t> &magic)
@@ -993,11 +991,8 @@ bool NetworkManagerConnection::processLegacyPacket(const std::shared_ptr<char> &
     const int bodyLength = ReadLE32(reinterpret_cast<const uint8_t*>(data + 16));
     logDebug(Log::NWM) << "Receive legacy-packet Body-length:" << bodyLength;
 
-    char buf[13];
-    memcpy(buf, data + 4, 12);
-    buf[12] = 0;
-    auto m = d->messageIdsReverse.find(std::string(buf));
-    if (m == d->messageIdsReverse.end()) {
+    const int messageId = d->legacyCommands.lookup(data + 4);
+    if (messageId == -1) {
         char buf[12]; // sanitized copy
         for (int i = 0; i < 12; ++i) {
             buf[i] = data[4 + i];
@@ -1009,7 +1004,7 @@ bool NetworkManagerConnection::processLegacyPacket(const std::shared_ptr<char> &
     }
     Message message(buffer, data, data + LEGACY_HEADER_SIZE, data + LEGACY_HEADER_SIZE + bodyLength);
 
-    message.setMessageId(m->second);
+    message.setMessageId(messageId);
     message.setServiceId(Api::LegacyP2P);
     message.remote = m_remote.connectionId;
 
@@ -1378,3 +1373,41 @@ void NetworkManagerServer::acceptConnection(boost::system::error_code error)
         try { m_socket.close(); } catch (...) {} // TODO do we need this?
     }
 }
+
+
+/////////////////////////////////////
+
+void LegacyCommandTable::set(const std::map<int, std::string> &table)
+{
+    m_entries.clear();
+    m_entries.reserve(table.size());
+    for (auto iter = table.begin(); iter != table.end(); ++iter) {
+        assert(iter->second.size() <= 12);
+        char command[12] = { 0 };
+        memcpy(command, iter->second.c_str(), std::min<size_t>(12, iter->second.size()));
+        m_entries.push_back(createEntry(command, iter->first));
+    }
+    std::sort(m_entries.begin(), m_entries.end(), [](const Entry &a, const Entry &b) {
+        return a.prefix < b.prefix || (a.prefix == b.prefix && a.suffix < b.suffix);
+    });
+}
+
+int LegacyCommandTable::lookup(const char *command) const
+{
+    const Entry key = createEntry(command, -1);
+    auto iter = std::lower_bound(m_entries.begin(), m_entries.end(), key, [](const Entry &a, const Entry &b) {
+        return a.prefix < b.prefix || (a.prefix == b.prefix && a.suffix < b.suffix);
+    });
+    if (iter == m_entries.end() || iter->prefix != key.prefix || iter->suffix != key.suffix)
+        return -1;
+    return iter->messageId;
+}
+
+LegacyCommandTable::Entry LegacyCommandTable::createEntry(const char *command, int messageId)
+{
+    Entry answer;
+    memcpy(&answer.prefix, command, 8);
+    memcpy(&answer.suffix, command + 8, 4);
+    answer.messageId = messageId;
+    return answer;
+}
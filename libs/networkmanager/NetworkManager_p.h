@@ -34,6 +34,7 @@
 #include <streaming/BufferPool.h>
 
 #include <list>
+#include <map>
 #include <deque>
 #include <mutex>
 #include <atomic>
@@ -359,6 +360,31 @@ struct BannedNode
     boost::posix_time::ptime banTimeout;
 };
 
+/**
+ * Maps the 12-byte command of a legacy P2P message header to our message-id.
+ *
+ * The lookup is done on the raw command bytes as they sit in the receive buffer,
+ * comparing them as two integers against a small sorted table. This avoids
+ * the copy and allocation a string-based lookup would need for each message.
+ */
+class LegacyCommandTable
+{
+public:
+    void set(const std::map<int, std::string> &table);
+
+    /// Returns the message-id for the 12 bytes at \a command, or -1 if unknown.
+    int lookup(const char *command) const;
+
+private:
+    struct Entry {
+        uint64_t prefix;
+        uint32_t suffix;
+        int messageId;
+    };
+    static Entry createEntry(const char *command, int messageId);
+    std::vector<Entry> m_entries; // sorted on prefix, suffix
+};
+
 class NetworkManagerPrivate
 {
 public:
@@ -391,7 +417,7 @@ public:
     // support for the p2p legacy envelope design
     uint8_t networkId[4] = { 0xE3, 0xE1, 0xF3, 0xE8};
     std::map<int, std::string> messageIds;
-    std::map<std::string, int> messageIdsReverse;
+    LegacyCommandTable legacyCommands;
 };
 
 #endif
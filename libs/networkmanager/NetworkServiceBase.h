@@ -55,7 +55,7 @@ protected:
     NetworkServiceBase(int id);
 
     const int m_id;
-    NetworkManager *m_manager;
+    NetworkManager *m_manager = nullptr;
 };
 
 #endif
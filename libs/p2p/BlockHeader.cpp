@@ -21,6 +21,8 @@
 #include <utils/hash.h>
 #include <streaming/P2PBuilder.h>
 
+#include <cstring>
+
 BlockHeader BlockHeader::fromMessage(Streaming::P2PParser &parser)
 {
     BlockHeader answer;
@@ -40,6 +42,14 @@ BlockHeader BlockHeader::fromMessage(const Streaming::ConstBuffer &buffer)
     return fromMessage(parser);
 }
 
+BlockHeader BlockHeader::fromRaw(const char *data)
+{
+    static_assert (sizeof(BlockHeader) == 80, "Header size");
+    BlockHeader answer;
+    memcpy(&answer, data, 80);
+    return answer;
+}
+
 uint256 BlockHeader::createHash() const
 {
     static_assert (sizeof(*this) == 80, "Header size");
@@ -32,6 +32,8 @@ struct BlockHeader
 {
     static BlockHeader fromMessage(Streaming::P2PParser &parser);
     static BlockHeader fromMessage(const Streaming::ConstBuffer &buffer);
+    /// Create a header from the 80 bytes serialized header at \a data. The caller checks the size.
+    static BlockHeader fromRaw(const char *data);
 
     uint256 createHash() const;
     arith_uint256 blockProof() const;
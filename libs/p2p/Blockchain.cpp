@@ -24,7 +24,12 @@
 #include <streaming/P2PParser.h>
 #include <utils/utiltime.h>
 
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#include <atomic>
+#include <condition_variable>
 #include <stdexcept>
+#include <thread>
 
 struct StaticChain {
     const unsigned char *data = nullptr;
@@ -32,6 +37,37 @@ struct StaticChain {
 };
 static StaticChain s_staticChain = StaticChain();
 
+// a header in the headers message is followed by a (zero) transaction count.
+constexpr int HeaderItemSize = 81;
+// the amount of headers one thread checks in one go.
+constexpr size_t HeaderBatchSize = 25;
+
+namespace {
+// hash and check the proof of work of the headers [begin, end)
+void checkHeaders(const char *headers, size_t begin, size_t end, uint256 *hashes, const arith_uint256 &powLimit, uint32_t maxFuture)
+{
+    for (size_t i = begin; i < end; ++i) {
+        const char *raw = headers + i * HeaderItemSize;
+        if (raw[80] != 0)
+            throw std::runtime_error("sent bogus headers. Transaction count not zero");
+        const BlockHeader header = BlockHeader::fromRaw(raw);
+        // timestamp not more than 2h in the future.
+        if (header.nTime > maxFuture)
+            throw std::runtime_error("sent bogus headers. Too far in future");
+
+        hashes[i] = header.createHash();
+        bool fNegative;
+        bool fOverflow;
+        arith_uint256 bnTarget;
+        bnTarget.SetCompact(header.nBits, &fNegative, &fOverflow);
+        if (fNegative || bnTarget == 0 || fOverflow || bnTarget > powLimit
+                || UintToArith256(hashes[i]) > bnTarget) {// Check proof of work matches claimed amount
+            throw std::runtime_error("sent bogus headers. POW failed");
+        }
+    }
+}
+}
+
 Blockchain::Blockchain(DownloadManager *downloadManager, const boost::filesystem::path &basedir, P2PNet::Chain chain)
     : m_basedir(basedir),
       m_blockHeight(chain == P2PNet::MainChain ? 60001 : 1001),
@@ -99,7 +135,6 @@ void Blockchain::processBlockHeaders(Message message, int peerId)
     int newTip;
 
     try {
-        std::unique_lock<std::mutex> lock(m_lock);
         Streaming::P2PParser parser(message);
         auto count = parser.readCompactInt();
         if (count > 2000) {
@@ -107,23 +142,25 @@ void Blockchain::processBlockHeaders(Message message, int peerId)
             m_dlmanager->reportDataFailure(peerId);
             return;
         }
+        // Each item is an 80 byte header and a tx-count that is always zero.
+        // Validate the size once, after that we read the headers straight from the message.
+        if (count * HeaderItemSize != static_cast<size_t>(parser.bytesLeft()))
+            throw std::runtime_error("sent a malformed headers message");
+        const char *headers = parser.readRawBytes(static_cast<int32_t>(count) * HeaderItemSize);
+
+        // The hashing and proof-of-work checks don't depend on each other, so
+        // do those in parallel and without holding our lock.
+        std::vector<uint256> hashes(count);
         const uint32_t maxFuture = time(nullptr) + 7200; // headers can not be more than 2 hours in the future.
+        checkHeadersParallel(headers, count, hashes.data(), maxFuture);
 
-        uint256 prevHash;
+        // The serial pass; checks the headers form a chain and extend ours and sums up the work.
+        std::unique_lock<std::mutex> lock(m_lock);
         int startHeight = -1;
         int height = 0;
         arith_uint256 chainWork;
         for (size_t i = 0; i < count; ++i) {
-            BlockHeader header = BlockHeader::fromMessage(parser);
-            /*int txCount =*/ parser.readCompactInt(); // always zero
-
-            // timestamp not more than 2h in the future.
-            if (header.nTime > maxFuture) {
-                logWarning() << "Peer:" << peerId << "sent bogus headers. Too far in future";
-                m_dlmanager->reportDataFailure(peerId);
-                return;
-            }
-
+            const BlockHeader header = BlockHeader::fromRaw(headers + i * HeaderItemSize);
             if (startHeight == -1) { // first header in the sequence.
                 auto iter = m_blockHeight.find(header.hashPrevBlock);
                 if (iter == m_blockHeight.end())
@@ -142,31 +179,19 @@ void Blockchain::processBlockHeaders(Message message, int peerId)
                     }
                 }
             }
-            else if (prevHash != header.hashPrevBlock) { // check if we are really a sequence.
+            else if (hashes.at(i - 1) != header.hashPrevBlock) { // check if we are really a sequence.
                 throw std::runtime_error("sent bogus headers. Not in sequence");
             }
-            uint256 hash = header.createHash();
-            // check POW
-            {
-                bool fNegative;
-                bool fOverflow;
-                arith_uint256 bnTarget;
-                bnTarget.SetCompact(header.nBits, &fNegative, &fOverflow);
-                if (fNegative || bnTarget == 0 || fOverflow || bnTarget > UintToArith256(powLimit)
-                        || UintToArith256(hash) > bnTarget) {// Check proof of work matches claimed amount
-                    throw std::runtime_error("sent bogus headers. POW failed");
-                }
-            }
             chainWork += header.blockProof();
 
             auto cpIter = checkpoints.find(height);
             if (cpIter != checkpoints.end()) {
-                if (cpIter->second != hash)
+                if (cpIter->second != hashes.at(i))
                     throw std::runtime_error("is on a different chain, checkpoint failure");
             }
-            prevHash = std::move(hash);
             ++height;
         }
+        const uint256 prevHash = count > 0 ? hashes.back() : uint256();
 
         if (chainWork <= m_tip.chainWork) {
             if (chainWork == m_tip.chainWork) { // Good headers, same tip we already had
@@ -189,15 +214,11 @@ void Blockchain::processBlockHeaders(Message message, int peerId)
         }
 
         // The new chain has more PoW, apply it.
-        parser = Streaming::P2PParser(message);
-        count = parser.readCompactInt();
         height = startHeight;
         m_longestChain.resize(startHeight + count);
         for (size_t i = 0; i < count; ++i) {
-            BlockHeader header = BlockHeader::fromMessage(parser);
-            /*int txCount =*/ parser.readCompactInt(); // always zero
-            m_blockHeight.insert(std::make_pair(header.createHash(), height));
-            m_longestChain[height++] = header;
+            m_blockHeight.insert(std::make_pair(hashes.at(i), height));
+            m_longestChain[height++] = BlockHeader::fromRaw(headers + i * HeaderItemSize);
         }
         m_tip.height = height - 1;
         m_tip.tip = prevHash;
@@ -215,6 +236,71 @@ void Blockchain::processBlockHeaders(Message message, int peerId)
     m_dlmanager->headersDownloadFinished(newTip, peerId);
 }
 
+void Blockchain::checkHeadersParallel(const char *headers, size_t count, uint256 *hashes, uint32_t maxFuture) const
+{
+    /*
+     * The headers are split in batches, the calling thread and some helpers posted to the
+     * io-service each claim batches until none are left. The caller never waits on a batch
+     * that has not been claimed, so this finishes even when all worker threads are busy.
+     */
+    struct Job {
+        const char *headers;
+        size_t count;
+        uint256 *hashes;
+        arith_uint256 powLimit;
+        uint32_t maxFuture;
+        size_t batches;
+        std::atomic<size_t> nextBatch;
+        std::mutex lock;
+        std::condition_variable finished;
+        size_t batchesDone = 0;
+        std::exception_ptr error;
+
+        void work() {
+            while (true) {
+                const size_t batch = nextBatch++;
+                if (batch >= batches)
+                    return;
+                std::exception_ptr failure;
+                try {
+                    checkHeaders(headers, batch * HeaderBatchSize,
+                                 std::min(count, (batch + 1) * HeaderBatchSize), hashes, powLimit, maxFuture);
+                } catch (...) {
+                    failure = std::current_exception();
+                }
+                std::lock_guard<std::mutex> guard(lock);
+                if (failure && !error)
+                    error = failure;
+                if (++batchesDone == batches)
+                    finished.notify_all();
+            }
+        }
+    };
+
+    auto job = std::make_shared<Job>();
+    job->headers = headers;
+    job->count = count;
+    job->hashes = hashes;
+    job->powLimit = UintToArith256(powLimit);
+    job->maxFuture = maxFuture;
+    job->batches = (count + HeaderBatchSize - 1) / HeaderBatchSize;
+    job->nextBatch = 0;
+    if (job->batches == 0)
+        return;
+
+    // helpers that start after all batches got claimed just return, the job outlives this method for them.
+    const size_t helpers = std::min<size_t>(job->batches, std::max(1u, std::thread::hardware_concurrency())) - 1;
+    for (size_t i = 0; i < helpers; ++i) {
+        m_dlmanager->service().post(std::bind(&Job::work, job));
+    }
+    job->work();
+
+    std::unique_lock<std::mutex> guard(job->lock);
+    job->finished.wait(guard, [&job]() { return job->batchesDone == job->batches; });
+    if (job->error)
+        std::rethrow_exception(job->error);
+}
+
 // static
 void Blockchain::setStaticChain(const unsigned char *data, int64_t size)
 {
@@ -420,60 +506,72 @@ void Blockchain::load()
 {
     std::unique_lock<std::mutex> lock(m_lock);
 
-    std::ifstream in((m_basedir / "blockchain").string());
-    if (!in.is_open())
+    const boost::filesystem::path path = m_basedir / "blockchain";
+    boost::system::error_code error;
+    const auto fileSize = boost::filesystem::file_size(path, error);
+    if (error || fileSize < 80)
+        return;
+    boost::iostreams::mapped_file_source file;
+    try {
+        file.open(path.string());
+    } catch (const std::exception &e) {
+        logWarning() << "Failed to open the blockchain file" << e;
+        return;
+    }
+    if (!file.is_open())
         return;
 
     logInfo() << "Starting to load the blockchain";
-    Streaming::BufferPool pool;
-    int skipNumber = -1;
-    while (true) {
-        pool.reserve(80);
-        size_t need = 80;
-        while (need > 0) {
-            auto readAmount = in.readsome(pool.begin() + (80 - need), need);
-            if (readAmount <= 0)
-                break;
-            need -= readAmount;
-        }
-        if (need != 0)
-            break;
-
-        auto headerData = pool.commit(80);
-        const BlockHeader *hd = reinterpret_cast<const BlockHeader*>(headerData.begin());
-        if (skipNumber == -1) {
-            const uint256 blockHash = hd->createHash();
-            // On finding the first block in the file, check how it relates to the existing blockheaders already
-            // known. Most importantly from the static data.
-            if (blockHash == m_longestChain.at(0).createHash()) {
-                // external file starts at genesis.
-                skipNumber = m_longestChain.size();
-            }
-            else {
-                auto former = m_blockHeight.find(hd->hashPrevBlock);
-                if (former == m_blockHeight.end()) {
-                    logFatal() << "Blockchain ERROR: Loaded blocksdata do not match our chain" << blockHash;
-                    // if you get here, one of the reasons might be that you used to, but no longer have, a static
-                    // headers file.
-                    // Either point to the same (or longer) headers file, or delete the blockheaders to re-download them.
-                    abort();
-                }
-                skipNumber = m_longestChain.size() - former->second - 1;
-            }
-        }
-        if (skipNumber > 0) {
-            --skipNumber;
-            continue;
+    const char *data = file.data();
+    const int count = static_cast<int>(fileSize / 80);
+    auto headerAt = [data](int index) {
+        return BlockHeader::fromRaw(data + index * 80);
+    };
+
+    // On finding the first block in the file, check how it relates to the existing blockheaders already
+    // known. Most importantly from the static data.
+    int skipNumber = 0;
+    const BlockHeader first = headerAt(0);
+    if (first.createHash() == m_longestChain.at(0).createHash()) {
+        // external file starts at genesis.
+        skipNumber = m_longestChain.size();
+    }
+    else {
+        auto former = m_blockHeight.find(first.hashPrevBlock);
+        if (former == m_blockHeight.end()) {
+            logFatal() << "Blockchain ERROR: Loaded blocksdata do not match our chain" << first.createHash();
+            // if you get here, one of the reasons might be that you used to, but no longer have, a static
+            // headers file.
+            // Either point to the same (or longer) headers file, or delete the blockheaders to re-download them.
+            abort();
         }
-
-        m_blockHeight.insert(std::make_pair(hd->createHash(), m_longestChain.size()));
-        m_tip.chainWork += hd->blockProof();
-        m_longestChain.push_back(*hd);
+        skipNumber = m_longestChain.size() - former->second - 1;
     }
 
-    if (m_tip.height < int(m_longestChain.size()) - 1) {
-        m_tip.tip = m_longestChain.back().createHash();
-        m_tip.height = m_longestChain.size() - 1;
+    // Each header has the hash of its predecessor, we only need to actually hash the last one.
+    // Check at least that one links up, a damaged file gets ignored and the headers are downloaded again.
+    if (count - skipNumber >= 2 && headerAt(count - 2).createHash() != headerAt(count - 1).hashPrevBlock) {
+        logWarning() << "Blockchain file is damaged, ignoring it";
+        return;
+    }
+    m_longestChain.reserve(m_longestChain.size() + std::max(0, count - skipNumber));
+    // Most blocks share the difficulty of their predecessor, remember the last proof to avoid recalculating it.
+    uint32_t prevBits = 0;
+    arith_uint256 prevProof;
+    for (int i = skipNumber; i < count; ++i) {
+        const BlockHeader header = headerAt(i);
+        const uint256 hash = i + 1 < count ? headerAt(i + 1).hashPrevBlock : header.createHash();
+        m_blockHeight.insert(std::make_pair(hash, m_longestChain.size()));
+        if (header.nBits != prevBits || i == skipNumber) {
+            prevBits = header.nBits;
+            prevProof = header.blockProof();
+        }
+        m_tip.chainWork += prevProof;
+        m_longestChain.push_back(header);
+        if (i + 1 == count) {
+            m_tip.tip = hash;
+            m_tip.height = m_longestChain.size() - 1;
+        }
     }
     logCritical() << "Blockchain loading completed. Tip:" << m_tip.height << m_tip.tip;
     m_needsSaving = false;
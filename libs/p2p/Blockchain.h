@@ -104,6 +104,12 @@ private:
 
     void createGenericGenesis(BlockHeader genesis);
 
+    /**
+     * Hash and check the proof-of-work of \a count headers as found in a headers message.
+     * The work is shared with the threads of the DownloadManager's io-service, throws a runtime_error on failure.
+     */
+    void checkHeadersParallel(const char *headers, size_t count, uint256 *hashes, uint32_t maxFuture) const;
+
     mutable std::mutex m_lock;
     const boost::filesystem::path m_basedir;
     std::vector<BlockHeader> m_longestChain;
@@ -24,6 +24,7 @@
 #include "SyncSPVAction.h"
 #include "CleanPeersAction.h"
 
+#include <crypto/common.h>
 #include <primitives/FastTransaction.h>
 #include <streaming/P2PParser.h>
 #include <streaming/P2PBuilder.h>
@@ -115,10 +116,16 @@ void DownloadManager::parseInvMessage(Message message, int sourcePeerId)
         Streaming::P2PParser parser(message);
         const size_t count = parser.readCompactInt();
         logDebug() << "Received" << count << "Inv messages";
+        // each item is a 4 byte type and a 32 byte hash, validate the size once
+        // and then read the items directly from the message.
+        constexpr int InvItemSize = 36;
+        if (count > static_cast<size_t>(parser.bytesLeft() / InvItemSize))
+            throw Streaming::ParsingException("Inv count out of range");
+        const char *item = parser.readRawBytes(static_cast<int32_t>(count) * InvItemSize);
         std::unique_lock<std::mutex> lock(m_downloadsLock);
-        for (size_t i = 0; i < count; ++i) {
-            uint32_t type = parser.readInt();
-            auto inv = InventoryItem(parser.readUint256(), type);
+        for (size_t i = 0; i < count; ++i, item += InvItemSize) {
+            const uint32_t type = ReadLE32(reinterpret_cast<const uint8_t*>(item));
+            auto inv = InventoryItem(uint256(item + 4), type);
 
             // if block type, check if we already know about it
             if (type == InventoryItem::BlockType) {
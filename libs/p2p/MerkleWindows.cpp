@@ -0,0 +1,127 @@
+/*
+ * This file is part of the Flowee project
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "MerkleWindows.h"
+
+#include <Logger.h>
+
+uint32_t MerkleWindows::add(int from, int to)
+{
+    assert(from <= to);
+    Window window;
+    window.from = from;
+    window.to = to;
+    window.requestTime = boost::posix_time::microsec_clock::universal_time();
+    std::lock_guard<std::mutex> lock(m_lock);
+    window.id = m_nextId++;
+    m_windows.push_back(std::move(window));
+    return m_windows.back().id;
+}
+
+bool MerkleWindows::startBlock(int blockHeight)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (m_windows.empty())
+        return false;
+    auto &window = m_windows.front();
+    if (window.firstBlockTime.is_not_a_date_time()
+            && window.from <= blockHeight && window.to >= blockHeight)
+        window.firstBlockTime = boost::posix_time::microsec_clock::universal_time();
+    return true;
+}
+
+void MerkleWindows::addBlock(Block &&block)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (m_windows.empty())
+        return;
+    auto &window = m_windows.front();
+    if (window.cancelled)
+        return;
+    if (block.blockHeight < window.from || block.blockHeight > window.to
+            || (!window.blocks.empty() && window.blocks.back().blockHeight >= block.blockHeight)) {
+        logDebug() << "Ignoring merkle block" << block.blockHeight << "not requested in window" << window.from << window.to;
+        return;
+    }
+    window.blocks.push_back(std::move(block));
+}
+
+bool MerkleWindows::pongReceived(uint64_t id)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    auto iter = m_windows.begin();
+    while (iter != m_windows.end() && iter->id != id)
+        ++iter;
+    if (iter == m_windows.end())
+        return false;
+    const auto now = boost::posix_time::microsec_clock::universal_time();
+    // the peer answers in order, windows before this one will not get more blocks either.
+    ++iter;
+    for (auto i = m_windows.begin(); i != iter; ++i) {
+        if (!i->cancelled) {
+            i->completeTime = now;
+            m_completed.push_back(std::move(*i));
+        }
+    }
+    m_windows.erase(m_windows.begin(), iter);
+    return true;
+}
+
+std::deque<MerkleWindows::Window> MerkleWindows::takeCompleted()
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    std::deque<Window> answer;
+    answer.swap(m_completed);
+    return answer;
+}
+
+void MerkleWindows::cancel(uint32_t id)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    for (auto &window : m_windows) {
+        if (window.id == id) {
+            window.cancelled = true;
+            return;
+        }
+    }
+    for (auto iter = m_completed.begin(); iter != m_completed.end(); ++iter) {
+        if (iter->id == id) {
+            m_completed.erase(iter);
+            return;
+        }
+    }
+}
+
+void MerkleWindows::cancelAll()
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    for (auto &window : m_windows) {
+        window.cancelled = true;
+    }
+    m_completed.clear();
+}
+
+int MerkleWindows::pending() const
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    int count = 0;
+    for (const auto &window : m_windows) {
+        if (!window.cancelled)
+            ++count;
+    }
+    return count;
+}
@@ -0,0 +1,94 @@
+/*
+ * This file is part of the Flowee project
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef MERKLEWINDOWS_H
+#define MERKLEWINDOWS_H
+
+#include "BlockHeader.h"
+
+#include <primitives/FastTransaction.h>
+
+#include <deque>
+#include <mutex>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+/**
+ * The book keeping of the ranges of merkle blocks requested from one peer.
+ *
+ * Each window is requested with one getdata, followed by a ping which has
+ * the window id as nonce. The peer answers in order, so all blocks that
+ * arrive before the matching pong belong to that window. This way a window
+ * that is cancelled, or one for which the peer skipped blocks, can never
+ * take in the blocks of the window requested after it.
+ */
+class MerkleWindows
+{
+public:
+    /// A merkle block and its matched transactions.
+    struct Block {
+        BlockHeader header;
+        int blockHeight = -1;
+        std::deque<Tx> transactions;
+    };
+
+    /// A range of merkle blocks, as registered with add().
+    struct Window {
+        uint32_t id = 0;
+        int from = 0;
+        int to = 0; // to-and-including
+        /// the received blocks, in order. Blocks the peer didn't send are missing.
+        std::deque<Block> blocks;
+        boost::posix_time::ptime requestTime;
+        boost::posix_time::ptime firstBlockTime; // not_a_date_time if no block arrived
+        boost::posix_time::ptime completeTime;
+        bool cancelled = false;
+    };
+
+    /// Register the request of the blocks \a from up to and including \a to. Returns the window id.
+    uint32_t add(int from, int to);
+
+    /**
+     * A merkle block at \a blockHeight started to arrive.
+     * Returns true if it is part of the answer to a window, which means it
+     * should be passed to addBlock() once its transactions are in.
+     */
+    bool startBlock(int blockHeight);
+    /// Add a block to the window the peer is answering, unless that window got cancelled.
+    void addBlock(Block &&block);
+    /**
+     * The peer answered the ping of window \a id, which completes it.
+     * Returns false if the nonce is not one of our windows.
+     */
+    bool pongReceived(uint64_t id);
+
+    /// Returns and forgets the windows that were completed since the last call.
+    std::deque<Window> takeCompleted();
+    /// Cancel the window \a id, its blocks will be ignored when they arrive.
+    void cancel(uint32_t id);
+    /// Cancel all windows.
+    void cancelAll();
+    /// Returns the amount of windows that are requested and not cancelled or completed.
+    int pending() const;
+
+private:
+    mutable std::mutex m_lock;
+    std::deque<Window> m_windows; // waiting for their pong, in request order.
+    std::deque<Window> m_completed;
+    uint32_t m_nextId = 1;
+};
+
+#endif
@@ -30,7 +30,8 @@
 Peer::Peer(ConnectionManager *parent, const PeerAddress &address)
     : m_peerAddress(address),
       m_peerStatus(Connecting),
-      m_connectionManager(parent)
+      m_connectionManager(parent),
+      m_filterVersion(-1)
 {
     assert(m_peerAddress.isValid());
     m_peerAddress.setInUse(true);
@@ -138,6 +139,14 @@ void Peer::processMessage(const Message &message)
         else if (message.messageId() == Api::P2P::Ping) {
             m_con.send(Message(message.body(), Api::LegacyP2P, Api::P2P::Pong));
         }
+        else if (message.messageId() == Api::P2P::Pong) {
+            Streaming::P2PParser parser(message);
+            const uint64_t nonce = parser.readLong();
+            if (m_merkleBlockInWindow) // the peer skipped transactions it assumes we have.
+                finishWindowBlock_priv();
+            if (!m_merkleWindows.pongReceived(nonce))
+                logDebug() << "Pong with unknown nonce. Peer:" << connectionId();
+        }
         else if (message.messageId() == Api::P2P::PreferHeaders) {
             m_preferHeaders = true;
         }
@@ -210,6 +219,8 @@ void Peer::processMessage(const Message &message)
                 m_connectionManager->punish(PUNISHMENT_MAX);
                 return;
             }
+            if (m_merkleBlockInWindow) // the peer skipped transactions of the previous block it assumes we have.
+                finishWindowBlock_priv();
             CPartialMerkleTree tree = CPartialMerkleTree::construct(parser);
             if (tree.ExtractMatches(m_transactionHashes) != header.hashMerkleRoot) {
                 m_transactionHashes.clear();
@@ -221,8 +232,16 @@ void Peer::processMessage(const Message &message)
             m_merkleHeader = header;
             m_merkleBlockHeight = blockHeight;
             m_lastReceivedMerkle = blockHeight;
-            m_segment->blockSynched(blockHeight);
             logDebug() << "Merkle received by" << connectionId() << "height:" << blockHeight;
+            m_merkleBlockInWindow = m_merkleWindows.startBlock(blockHeight);
+            if (m_merkleBlockInWindow) {
+                if (m_transactionHashes.empty()) {
+                    m_merkleBlockHeight = -1;
+                    finishWindowBlock_priv();
+                }
+                return;
+            }
+            m_segment->blockSynched(blockHeight);
 
             if (m_lastReceivedMerkle == m_merkleDownloadTo)
                 startMerkleDownload(m_merkleDownloadTo + 1);
@@ -268,6 +287,7 @@ void Peer::sendFilter_priv()
         return;
     assert(m_segment);
     auto buf = m_segment->writeFilter(m_connectionManager->pool(0));
+    m_filterVersion = m_segment->filterVersion();
     m_con.send(Message(buf, Api::LegacyP2P, Api::P2P::FilterLoad));
     m_bloomUploadHeight = m_segment->lastBlockSynched();
 }
@@ -295,6 +315,7 @@ void Peer::sendFilter(const CBloomFilter &bloom, int blockHeight)
     bloom.store(builder);
     m_con.send(Message(builder.buffer(), Api::LegacyP2P, Api::P2P::FilterLoad));
     m_bloomUploadHeight = blockHeight;
+    m_filterVersion = -1; // not the segments filter
 }
 
 int Peer::lastReceivedMerkle() const
@@ -339,6 +360,65 @@ void Peer::startMerkleDownload(int from)
     m_con.send(builder.message(Api::P2P::GetData));
 }
 
+uint32_t Peer::requestMerkleWindow(int from, int to)
+{
+    if (m_peerStatus == ShuttingDown)
+        return 0;
+    assert(m_segment);
+    assert(from <= to);
+    // the filter may have been changed on a different thread and its upload
+    // still be pending, we need it to be sent before our getdata.
+    if (m_filterVersion != m_segment->filterVersion())
+        sendFilter_priv();
+
+    const uint32_t windowId = m_merkleWindows.add(from, to);
+    const int count = 1 + to - from;
+    Streaming::P2PBuilder builder(m_connectionManager->pool(40 * count));
+    builder.writeCompactSize(count);
+    for (int i = from; i <= to; ++i) {
+        builder.writeInt(InventoryItem::MerkleBlock);
+        builder.writeByteArray(m_connectionManager->blockHashFor(i), Streaming::RawBytes);
+    }
+    m_con.send(builder.message(Api::P2P::GetData));
+    // the pong marks the end of the answer to the getdata.
+    Streaming::P2PBuilder ping(m_connectionManager->pool(8));
+    ping.writeLong(windowId);
+    m_con.send(ping.message(Api::P2P::Ping));
+    return windowId;
+}
+
+std::deque<Peer::MerkleWindow> Peer::takeCompletedMerkleWindows()
+{
+    return m_merkleWindows.takeCompleted();
+}
+
+void Peer::cancelMerkleWindow(uint32_t windowId)
+{
+    m_merkleWindows.cancel(windowId);
+}
+
+void Peer::cancelMerkleWindows()
+{
+    m_merkleWindows.cancelAll();
+}
+
+int Peer::pendingMerkleWindows() const
+{
+    return m_merkleWindows.pending();
+}
+
+void Peer::finishWindowBlock_priv()
+{
+    MerkleBlock block;
+    block.header = m_merkleHeader;
+    block.blockHeight = m_lastReceivedMerkle;
+    block.transactions.swap(m_blockTransactions);
+    m_transactionHashes.clear();
+    m_merkleBlockHeight = -1;
+    m_merkleBlockInWindow = false;
+    m_merkleWindows.addBlock(std::move(block));
+}
+
 int Peer::bloomUploadHeight() const
 {
     return m_bloomUploadHeight;
@@ -388,6 +468,10 @@ void Peer::processTransaction(const Tx &tx)
                 if (m_transactionHashes.empty()) {
                     // done with this block
                     m_merkleBlockHeight = -1;
+                    if (m_merkleBlockInWindow) {
+                        finishWindowBlock_priv();
+                        return;
+                    }
                     assert(m_segment);
                     m_segment->newTransactions(m_merkleHeader, bh, m_blockTransactions);
                     m_blockTransactions.clear();
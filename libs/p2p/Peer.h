@@ -20,6 +20,7 @@
 
 #include "PeerAddressDB.h"
 #include "BlockHeader.h"
+#include "MerkleWindows.h"
 #include "PrivacySegmentListener.h"
 
 #include <networkmanager/NetworkConnection.h>
@@ -42,6 +43,9 @@ public:
         ShuttingDown
     };
 
+    typedef MerkleWindows::Block MerkleBlock;
+    typedef MerkleWindows::Window MerkleWindow;
+
     explicit Peer(ConnectionManager *parent, const PeerAddress &address);
     ~Peer();
 
@@ -146,6 +150,25 @@ public:
     /// send to the peer the bloom filter arg, with the promise that that it looked like that at \a blockHeight
     void sendFilter(const CBloomFilter &bloom, int blockHeight);
 
+    /**
+     * Request the merkle blocks \a from up to and including \a to.
+     *
+     * Unlike startMerkleDownload() the results are not forwarded to the privacy
+     * segment, they are collected until fetched using takeCompletedMerkleWindows().
+     * Windows can be requested while others are still in flight, the peer
+     * answers them in order.
+     * Returns the id of the window, see MerkleWindow::id
+     */
+    uint32_t requestMerkleWindow(int from, int to);
+    /// Returns and forgets the windows that were fully received since the last call.
+    std::deque<MerkleWindow> takeCompletedMerkleWindows();
+    /// Cancel the window \a windowId, its blocks will be ignored when they arrive.
+    void cancelMerkleWindow(uint32_t windowId);
+    /// Cancel all windows in flight, their blocks will be ignored when they arrive.
+    void cancelMerkleWindows();
+    /// Returns the amount of windows that are requested and not cancelled or completed.
+    int pendingMerkleWindows() const;
+
     /// Return the timestamp of first-connection time.
     uint32_t connectTime() const;
 
@@ -171,6 +194,9 @@ private:
     /// sends the bloom filter to peer.
     void sendFilter_priv();
 
+    /// Adds the current merkle block, and its transactions, to the MerkleWindow it belongs to.
+    void finishWindowBlock_priv();
+
     // PrivacySegmentListener interface
     void filterUpdated();
 
@@ -200,12 +226,16 @@ private:
     int m_lastReceivedMerkle = 0;
     int m_merkleDownloadFrom = -1;
     int m_merkleDownloadTo = -1;
+    std::atomic<int> m_filterVersion; // the PrivacySegment::filterVersion() we sent last
 
     // SPV merkle block data
     int m_merkleBlockHeight = -1;
     std::vector<uint256> m_transactionHashes;
     std::deque<Tx> m_blockTransactions;
     BlockHeader m_merkleHeader;
+    bool m_merkleBlockInWindow = false;
+
+    MerkleWindows m_merkleWindows;
 
     std::deque<std::weak_ptr<BroadcastTxData> > m_transactions;
 };
@@ -162,6 +162,12 @@ int PrivacySegment::filterChangedHeight() const
     return m_filterChangedHeight;
 }
 
+int PrivacySegment::filterVersion() const
+{
+    std::unique_lock<std::recursive_mutex> lock(m_lock);
+    return m_filterVersion;
+}
+
 const CBloomFilter &PrivacySegment::bloomFilter() const
 {
     std::unique_lock<std::recursive_mutex> lock(m_lock);
@@ -212,6 +218,7 @@ PrivacySegment::FilterLock::FilterLock(PrivacySegment::FilterLock && other)
 
 PrivacySegment::FilterLock::~FilterLock()
 {
+    ++parent->m_filterVersion;
     parent->m_lock.unlock();
     for (auto l : parent->m_listeners) {
         l->filterUpdated();
@@ -121,6 +121,8 @@ public:
     void newTransaction(const Tx &tx);
 
     int filterChangedHeight() const;
+    /// Returns a number that is increased every time the filter is changed.
+    int filterVersion() const;
 
     const CBloomFilter &bloomFilter() const;
 
@@ -142,6 +144,7 @@ private:
     DataListenerInterface *m_parent;
     int m_merkleBlockHeight = -1;
     int m_filterChangedHeight = 0;
+    int m_filterVersion = 0;
     int m_softMerkleBlockHeight = -1;
     Priority m_priority = Normal;
 };
@@ -20,10 +20,28 @@
 #include "DownloadManager.h"
 #include "Peer.h"
 
+#include <algorithm>
+#include <climits>
 #include <set>
 
 constexpr int MIN_PEERS_PER_WALLET = 3;
 
+// a wallet this many blocks behind is synched using all its peers in parallel.
+constexpr int ParallelSyncMinBlocks = 500;
+// the amount of windows we allow to be in flight per peer.
+constexpr int MaxWindowsPerPeer = 2;
+constexpr int MinWindowSize = 20;
+constexpr int MaxWindowSize = 500;
+constexpr int DefaultWindowSize = 100;
+// how long a peer should be busy with one window.
+constexpr int WindowTargetMs = 3000;
+// the speed we assume for a peer we have not measured yet.
+constexpr double DefaultBlocksPerSecond = 30;
+// we don't request windows further than this beyond the last block handed to the wallet.
+constexpr int MaxLookahead = 4000;
+// minimum time we give a window that holds up the rest of the download.
+constexpr int MinStallTimeout = 5000;
+
 SyncSPVAction::SyncSPVAction(DownloadManager *parent)
     : Action(parent)
 {
@@ -45,11 +63,13 @@ void SyncSPVAction::execute(const boost::system::error_code &error)
     uint32_t nowInSec = time(nullptr);
 
     std::map<PrivacySegment*, WalletInfo> wallets;
+    std::set<int> connectedPeerIds;
     /*
      * Privacy Segments are assigned to a number of peers, make an inventory of each segment.
      * For ease, realize that segments are the same thing as wallets here.
      */
     for (const auto &peer : m_dlm->connectionManager().connectedPeers()) {
+        connectedPeerIds.insert(peer->connectionId());
         auto *ps = peer->privacySegment();
         if (ps) {
             auto iter = wallets.find(ps);
@@ -68,6 +88,14 @@ void SyncSPVAction::execute(const boost::system::error_code &error)
         }
     }
 
+    // forget the speeds of peers that disconnected.
+    for (auto iter = m_peerSpeeds.begin(); iter != m_peerSpeeds.end();) {
+        if (connectedPeerIds.find(iter->first) == connectedPeerIds.end())
+            iter = m_peerSpeeds.erase(iter);
+        else
+            ++iter;
+    }
+
     bool didSomething = false;
 
     // connect to enough peers for each wallet.
@@ -142,6 +170,7 @@ void SyncSPVAction::execute(const boost::system::error_code &error)
      * This specifically means we ask them to download blocks for our wallet
      * and act on them being slow or similar issues.
      */
+    bool anyParallel = false;
 
     for (auto w = wallets.begin(); w != wallets.end(); ++w) {
         PrivacySegment *privSegment = w->first;
@@ -160,6 +189,24 @@ void SyncSPVAction::execute(const boost::system::error_code &error)
                     || privSegment->backupSyncHeight() < currentBlockHeight)) {
             didSomething = true;
 
+            if (!info.parallel && w->second.downloading == nullptr
+                    && w->second.peers.size() > 1
+                    && privSegment->backupSyncHeight() == privSegment->lastBlockSynched()
+                    && currentBlockHeight - privSegment->lastBlockSynched() >= ParallelSyncMinBlocks) {
+                logDebug() << "   [checkpoint]. Starting parallel sync at" << privSegment->lastBlockSynched();
+                info.parallel = true;
+                info.bloom = privSegment->bloomFilter();
+                info.bloomPos = privSegment->lastBlockSynched();
+                info.nextWindow = info.bloomPos + 1;
+                info.windows.clear();
+            }
+            if (info.parallel) {
+                if (syncParallel(privSegment, info, w->second.peers, currentBlockHeight, now)) {
+                    anyParallel = true;
+                    continue;
+                }
+            }
+
             // is behind. Is someone downloading?
             if (w->second.downloading) {
                 auto curPeer = w->second.downloading;
@@ -222,27 +269,32 @@ void SyncSPVAction::execute(const boost::system::error_code &error)
                 else
                     from = info.bloomPos;
                 std::shared_ptr<Peer> preferred;
+                /*
+                 * After a parallel download it is likely that all our peers downloaded
+                 * a part of the range. Then we settle for the peer that did the least,
+                 * as long as that is less than half of the blocks.
+                 */
+                std::shared_ptr<Peer> leastOverlap;
+                int leastOverlapBlocks = (currentBlockHeight - from) / 2;
                 for (auto p : w->second.peers) {
                     // logDebug() << "  + " << p->connectionId();
-                    bool ok = true;
-                    for (auto pdi : info.previousDownloads) {
-                        if (pdi.peerId == p->connectionId()) {
-                            if (from < pdi.toBlock) {// this one already downloaded for us
-                                // logDebug() << "Skipping peer because it downloaded before";
-                                ok = false;
-                                break;
-                            }
-                        }
-                        if (!ok)
-                            break;
-                    }
-                    if (!ok)
-                        continue;
-
                     if (from >= p->peerHeight()) {// peer isn't up-to-date yet
                         // logDebug() << "Skipping peer because its behind. Height:" << p->peerHeight();
                         continue;
                     }
+                    int overlap = 0;
+                    for (auto pdi : info.previousDownloads) {
+                        if (pdi.peerId == p->connectionId() && from < pdi.toBlock) // this one already downloaded for us
+                            overlap += pdi.toBlock - std::max(from, pdi.fromBlock - 1);
+                    }
+                    if (overlap > 0) {
+                        // logDebug() << "Skipping peer because it downloaded before";
+                        if (overlap < leastOverlapBlocks && p->receivedHeaders()) {
+                            leastOverlap = p;
+                            leastOverlapBlocks = overlap;
+                        }
+                        continue;
+                    }
 
                     if (!p->receivedHeaders()
                             // or we did that recently anyway.
@@ -257,6 +309,8 @@ void SyncSPVAction::execute(const boost::system::error_code &error)
                     preferred = p;
                     break;
                 }
+                if (preferred == nullptr)
+                    preferred = leastOverlap;
                 if (preferred) {
                     w->second.downloading = preferred;
                     logDebug() << "Wallet merkle-download started on peer" << preferred->connectionId()
@@ -287,5 +341,223 @@ void SyncSPVAction::execute(const boost::system::error_code &error)
         m_dlm->done(this);
         return;
     }
+    // with a parallel download in progress we need to hand out new work quickly.
+    setInterval(anyParallel ? 400 : 1500);
     again();
 }
+
+bool SyncSPVAction::syncParallel(PrivacySegment *segment, Info &info, const std::set<std::shared_ptr<Peer> > &peers,
+                                 int currentBlockHeight, const boost::posix_time::ptime &now)
+{
+    std::map<int, std::shared_ptr<Peer>> peerMap;
+    for (const auto &p : peers) {
+        peerMap.insert(std::make_pair(p->connectionId(), p));
+    }
+
+    // collect the windows our peers finished downloading.
+    for (auto &p : peerMap) {
+        for (auto &finished : p.second->takeCompletedMerkleWindows()) {
+            updatePeerSpeed(p.first, finished);
+            for (auto &window : info.windows) {
+                if (window.done || window.peerId != p.first || window.windowId != finished.id)
+                    continue;
+                if (static_cast<int>(finished.blocks.size()) == 1 + window.to - window.from) {
+                    window.blocks = std::move(finished.blocks);
+                    window.done = true;
+                } else { // the peer skipped some blocks, ask someone else.
+                    logDebug() << "Peer" << p.first << "did not send all blocks of window"
+                               << window.from << "-" << window.to;
+                    window.peerId = -1;
+                    window.skipPeerId = p.first;
+                }
+                break;
+            }
+        }
+    }
+
+    // windows of peers that went away need a new owner.
+    for (auto &window : info.windows) {
+        if (window.peerId != -1 && peerMap.find(window.peerId) == peerMap.end())
+            window.peerId = -1;
+    }
+
+    /*
+     * The window with the lowest blockheight holds up handing blocks to the wallet.
+     * If its peer takes much longer than its speed promised we move all its work
+     * to others.
+     */
+    for (auto &window : info.windows) {
+        if (window.done)
+            continue;
+        if (window.peerId == -1)
+            break;
+        const PeerSpeed &speed = m_peerSpeeds[window.peerId];
+        const double bps = speed.blocksPerSecond > 0 ? speed.blocksPerSecond : DefaultBlocksPerSecond;
+        const int64_t expected = speed.latency + static_cast<int64_t>((1 + window.to - window.from) * 1000 / bps);
+        const int64_t allowed = std::max<int64_t>(MinStallTimeout, 3 * MaxWindowsPerPeer * expected);
+        if ((now - window.requestTime).total_milliseconds() > allowed) {
+            const int slowPeer = window.peerId;
+            logInfo() << "SyncSPV re-assigns the work of peer" << slowPeer << "which is stalling at block" << window.from;
+            peerMap.at(slowPeer)->cancelMerkleWindows();
+            m_peerSpeeds[slowPeer].blocksPerSecond = bps / 4;
+            for (auto &other : info.windows) {
+                if (!other.done && other.peerId == slowPeer) {
+                    other.peerId = -1;
+                    other.skipPeerId = slowPeer;
+                }
+            }
+        }
+        break;
+    }
+
+    // hand the blocks to the wallet, in order.
+    while (!info.windows.empty() && info.windows.front().done) {
+        Window window = std::move(info.windows.front());
+        info.windows.pop_front();
+        bool matched = false;
+        for (const auto &block : window.blocks) {
+            segment->blockSynched(block.blockHeight);
+            if (!block.transactions.empty()) {
+                segment->newTransactions(block.header, block.blockHeight, block.transactions);
+                matched = true;
+            }
+        }
+        if (!info.previousDownloads.empty() && info.previousDownloads.back().peerId == window.peerId
+                && info.previousDownloads.back().toBlock + 1 == window.from)
+            info.previousDownloads.back().toBlock = window.to;
+        else
+            info.previousDownloads.push_back({window.peerId, window.from, window.to});
+
+        if (matched && !info.windows.empty()) {
+            /*
+             * The wallet is expected to add the outputs it just received to the filter.
+             * The windows after this one were requested with the older filter and may
+             * miss transactions spending those outputs, so we need to request them again.
+             * Windows still in flight are requested again from the same peer, which gets
+             * the new filter first. Windows already received go back in the queue and are
+             * handed out below like new ones.
+             */
+            logDebug() << "Merkle window" << window.from << "-" << window.to
+                       << "had transactions, re-requesting" << info.windows.size() << "windows";
+            for (auto &later : info.windows) {
+                if (later.peerId == -1) // not requested yet
+                    continue;
+                if (later.done) {
+                    later.done = false;
+                    later.blocks.clear();
+                    later.peerId = -1;
+                    continue;
+                }
+                auto peer = peerMap.find(later.peerId);
+                assert(peer != peerMap.end());
+                peer->second->cancelMerkleWindow(later.windowId);
+                later.requestTime = now;
+                later.windowId = peer->second->requestMerkleWindow(later.from, later.to);
+            }
+            break;
+        }
+    }
+
+    // find the peers that can be used, fastest first.
+    const uint32_t nowInSec = time(nullptr);
+    std::vector<std::shared_ptr<Peer>> available;
+    std::map<int, int> load;
+    for (const auto &p : peerMap) {
+        if (!p.second->receivedHeaders()
+                && nowInSec - p.second->peerAddress().lastReceivedGoodHeaders() >= 60 * 60 * 48)
+            continue;
+        available.push_back(p.second);
+        load[p.first] = p.second->pendingMerkleWindows();
+    }
+    auto speedOf = [this](int peerId) {
+        auto iter = m_peerSpeeds.find(peerId);
+        if (iter == m_peerSpeeds.end() || iter->second.blocksPerSecond <= 0)
+            return DefaultBlocksPerSecond;
+        return iter->second.blocksPerSecond;
+    };
+    std::sort(available.begin(), available.end(),
+              [&speedOf](const std::shared_ptr<Peer> &a, const std::shared_ptr<Peer> &b) {
+        return speedOf(a->connectionId()) > speedOf(b->connectionId());
+    });
+    auto pickPeer = [&](int to, int skipPeerId) -> std::shared_ptr<Peer> {
+        std::shared_ptr<Peer> skipped;
+        for (const auto &p : available) {
+            if (load[p->connectionId()] >= MaxWindowsPerPeer || p->peerHeight() < to)
+                continue;
+            if (p->connectionId() != skipPeerId)
+                return p;
+            skipped = p;
+        }
+        // only fall back to the peer that failed if it is the only one we have.
+        return available.size() == 1 ? skipped : nullptr;
+    };
+    auto assign = [&](Window &window, const std::shared_ptr<Peer> &peer) {
+        window.peerId = peer->connectionId();
+        window.requestTime = now;
+        ++load[window.peerId];
+        window.windowId = peer->requestMerkleWindow(window.from, window.to);
+    };
+
+    for (auto &window : info.windows) {
+        if (window.done || window.peerId != -1)
+            continue;
+        auto peer = pickPeer(window.to, window.skipPeerId);
+        if (peer)
+            assign(window, peer);
+    }
+
+    const int lookaheadEnd = segment->lastBlockSynched() + MaxLookahead;
+    while (info.nextWindow <= currentBlockHeight && info.nextWindow <= lookaheadEnd) {
+        auto peer = pickPeer(info.nextWindow, -1);
+        if (peer == nullptr)
+            break;
+        Window window;
+        window.from = info.nextWindow;
+        window.to = std::min(window.from + windowSize(peer->connectionId()) - 1,
+                             std::min(currentBlockHeight, peer->peerHeight()));
+        info.windows.push_back(window);
+        assign(info.windows.back(), peer);
+        info.nextWindow = window.to + 1;
+    }
+
+    if (info.windows.empty() && info.nextWindow > currentBlockHeight) {
+        logInfo() << "Parallel merkle download finished for wallet" << segment->segmentId()
+                  << "at" << segment->lastBlockSynched();
+        info.parallel = false;
+        // like a normal download, finish by fetching the transactions from the mempool.
+        for (const auto &p : available) {
+            if (p->peerHeight() >= currentBlockHeight) {
+                p->startMerkleDownload(currentBlockHeight + 1);
+                break;
+            }
+        }
+        return false;
+    }
+    return true;
+}
+
+void SyncSPVAction::updatePeerSpeed(int peerId, const Peer::MerkleWindow &window)
+{
+    if (window.blocks.empty() || window.firstBlockTime.is_not_a_date_time())
+        return;
+    const int64_t total = std::max<int64_t>(1, (window.completeTime - window.requestTime).total_milliseconds());
+    const int latency = static_cast<int>((window.firstBlockTime - window.requestTime).total_milliseconds());
+    const double bps = window.blocks.size() * 1000.0 / total;
+    PeerSpeed &speed = m_peerSpeeds[peerId];
+    if (speed.blocksPerSecond <= 0) {
+        speed.blocksPerSecond = bps;
+        speed.latency = latency;
+    } else {
+        speed.blocksPerSecond = speed.blocksPerSecond * 0.7 + bps * 0.3;
+        speed.latency = (speed.latency * 7 + latency * 3) / 10;
+    }
+}
+
+int SyncSPVAction::windowSize(int peerId) const
+{
+    auto iter = m_peerSpeeds.find(peerId);
+    if (iter == m_peerSpeeds.end() || iter->second.blocksPerSecond <= 0)
+        return DefaultWindowSize;
+    const int size = static_cast<int>(iter->second.blocksPerSecond * WindowTargetMs / 1000);
+    return std::max(MinWindowSize, std::min(MaxWindowSize, size));
+}
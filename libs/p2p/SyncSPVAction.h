@@ -19,6 +19,7 @@
 #define SYNCSPVACTION_H
 
 #include "Action.h"
+#include "Peer.h"
 
 #include <bloom.h>
 #include <map>
@@ -36,6 +37,18 @@ protected:
     void execute(const boost::system::error_code &error) override;
 
 private:
+    struct Info;
+    /**
+     * Download the merkle blocks for \a segment using all its \a peers in parallel.
+     * Returns true while the parallel download is not finished.
+     */
+    bool syncParallel(PrivacySegment *segment, Info &info, const std::set<std::shared_ptr<Peer>> &peers,
+                      int currentBlockHeight, const boost::posix_time::ptime &now);
+    /// Remember the speed of a peer, based on the window it just completed.
+    void updatePeerSpeed(int peerId, const Peer::MerkleWindow &window);
+    /// The amount of blocks we ask a peer for in one go.
+    int windowSize(int peerId) const;
+
     int m_quietCount = 0;
 
     struct PeerDownloadInfo {
@@ -44,6 +57,23 @@ private:
         int toBlock; // to-and-including
     };
 
+    /// A range of blocks in a parallel download, assigned to a single peer.
+    struct Window {
+        int from;
+        int to; // to-and-including
+        int peerId = -1; // -1 if not assigned
+        uint32_t windowId = 0; // the MerkleWindow::id at the peer
+        int skipPeerId = -1; // peer that failed to deliver this window before
+        boost::posix_time::ptime requestTime;
+        bool done = false;
+        std::deque<Peer::MerkleBlock> blocks;
+    };
+
+    struct PeerSpeed {
+        double blocksPerSecond = 0; // moving average
+        int latency = 0; // ms till the first block of a window arrives, moving average
+    };
+
     struct Info {
         boost::posix_time::ptime lastCheckedTime;
         uint32_t peersCreatedTime;
@@ -61,9 +91,15 @@ private:
         // at the start of the run.
         CBloomFilter bloom;
         int bloomPos = 0;
+
+        // the first pass is downloaded in parallel, in windows which are sorted by blockheight.
+        bool parallel = false;
+        std::deque<Window> windows;
+        int nextWindow = 0; // first block not in a window yet
     };
 
     std::map<PrivacySegment*, Info> m_segmentInfos;
+    std::map<int, PeerSpeed> m_peerSpeeds;
 };
 
 #endif
@@ -17,6 +17,7 @@
  */
 #include "BlockMetaData.h"
 
+#include <algorithm>
 #include <deque>
 #include <string.h>
 
@@ -26,6 +27,7 @@
 #include <primitives/script.h>
 
 constexpr int TxRowWidth = 40;
+constexpr int OutputRowWidth = 40;
 constexpr int32_t FEE_INVALID = 0xFFFFFF;
 
 // tags used to save our data file with.
@@ -33,7 +35,11 @@ enum Tags {
     BlockID = 0,
     BlockHeight,
     IsCTOR,
-    TransactionDataBlob
+    TransactionDataBlob,
+    ScriptHashFilter,
+    ScriptHashFilterItemCount,
+    OutputDataBlob,
+    OutputIndexBlob
 };
 
 bool BlockMetaData::hasFeesData() const
@@ -56,6 +62,20 @@ BlockMetaData::BlockMetaData(const Streaming::ConstBuffer &buffer)
             assert(parser.isByteArray());
             m_transactions = parser.bytesDataBuffer();
         }
+        else if (parser.tag() == ScriptHashFilter) {
+            assert(parser.isByteArray());
+            m_filter = parser.bytesDataBuffer();
+        }
+        else if (parser.tag() == ScriptHashFilterItemCount)
+            m_filterItemCount = parser.intData();
+        else if (parser.tag() == OutputDataBlob) {
+            assert(parser.isByteArray());
+            m_outputs = parser.bytesDataBuffer();
+        }
+        else if (parser.tag() == OutputIndexBlob) {
+            assert(parser.isByteArray());
+            m_outputIndex = parser.bytesDataBuffer();
+        }
     }
 }
 
@@ -65,7 +85,7 @@ BlockMetaData::BlockMetaData()
 
 BlockMetaData BlockMetaData::parseBlock(int blockHeight, const FastBlock &block,
                                         const std::vector<std::unique_ptr<std::deque<std::int32_t> > > &perTxFees,
-                                        Streaming::BufferPool &pool)
+                                        Streaming::BufferPool &pool, bool includeOutputs, bool includeFilter)
 {
     std::deque<TransactionData> txs;
     Tx::Iterator iter(block);
@@ -76,6 +96,10 @@ BlockMetaData BlockMetaData::parseBlock(int blockHeight, const FastBlock &block,
     currentTx.scriptTags = 0;
     uint256 txidBeforeThis; // the txid of the transaction placed before the current in the block
     uint256 prevTxHash; // a copy from the input
+    std::vector<uint256> filterItems; // output script-hashes and spent outputs
+    std::vector<OutputData> outputs;
+    std::vector<uint32_t> outputIndex(1, 0);
+    uint64_t outputAmount = 0;
 
     size_t chunkIndex = 0;
     size_t feeIndex = 0;
@@ -117,6 +141,8 @@ BlockMetaData BlockMetaData::parseBlock(int blockHeight, const FastBlock &block,
 
             coinbase = false;
             txs.push_back(currentTx);
+            if (includeOutputs)
+                outputIndex.push_back(static_cast<uint32_t>(outputs.size()));
             currentTx.scriptTags = 0;
 
             if (txs.size() >= 2) {
@@ -133,9 +159,24 @@ BlockMetaData BlockMetaData::parseBlock(int blockHeight, const FastBlock &block,
             prevTxHash = iter.uint256Data();
         }
         else if (iter.tag() == Tx::PrevTxIndex) {
-
+            if (includeFilter && !coinbase)
+                filterItems.push_back(GolombCodedSet::hashOutPoint(prevTxHash, iter.intData()));
+        }
+        else if (iter.tag() == Tx::OutputValue) {
+            outputAmount = iter.longData();
         }
         else if (iter.tag() == Tx::OutputScript) {
+            if (includeFilter || includeOutputs) {
+                const uint256 scriptHash = iter.hashedByteData();
+                if (includeFilter)
+                    filterItems.push_back(scriptHash);
+                if (includeOutputs) {
+                    OutputData output;
+                    memcpy(output.scriptHash, scriptHash.begin(), 32);
+                    output.amount = outputAmount;
+                    outputs.push_back(output);
+                }
+            }
             const CScript script(iter.byteData());
             if (script.IsPayToScriptHash()) {
                 currentTx.scriptTags |= Api::ScriptTag::P2SH;
@@ -178,12 +219,40 @@ BlockMetaData BlockMetaData::parseBlock(int blockHeight, const FastBlock &block,
     }
     auto txData = pool.commit(txs.size() * TxRowWidth);
 
-    pool.reserve(txData.size() + 55);
+    Streaming::ConstBuffer outputData, outputIndexData;
+    if (includeOutputs) {
+        static_assert(sizeof(OutputData) == OutputRowWidth, "Output row size");
+        pool.reserve(outputs.size() * OutputRowWidth);
+        if (!outputs.empty())
+            memcpy(pool.begin(), outputs.data(), outputs.size() * OutputRowWidth);
+        outputData = pool.commit(outputs.size() * OutputRowWidth);
+        pool.reserve(outputIndex.size() * sizeof(uint32_t));
+        memcpy(pool.begin(), outputIndex.data(), outputIndex.size() * sizeof(uint32_t));
+        outputIndexData = pool.commit(outputIndex.size() * sizeof(uint32_t));
+    }
+
+    const uint256 blockId = block.createHash();
+    GolombCodedSet filter;
+    if (includeFilter) {
+        std::sort(filterItems.begin(), filterItems.end());
+        filterItems.erase(std::unique(filterItems.begin(), filterItems.end()), filterItems.end());
+        filter = GolombCodedSet(blockId, filterItems, pool);
+    }
+
+    pool.reserve(txData.size() + filter.data().size() + outputData.size() + outputIndexData.size() + 80);
     Streaming::MessageBuilder builder(pool);
-    builder.add(BlockID, block.createHash());
+    builder.add(BlockID, blockId);
     builder.add(BlockHeight, blockHeight);
     builder.add(IsCTOR, isCTOR);
     builder.add(TransactionDataBlob, txData);
+    if (includeFilter) {
+        builder.add(ScriptHashFilter, filter.data());
+        builder.add(ScriptHashFilterItemCount, filter.itemCount());
+    }
+    if (includeOutputs) {
+        builder.add(OutputDataBlob, outputData);
+        builder.add(OutputIndexBlob, outputIndexData);
+    }
 
     return BlockMetaData(pool.commit());
 }
@@ -262,3 +331,40 @@ uint256 BlockMetaData::blockId() const
 {
     return m_blockId;
 }
+
+bool BlockMetaData::hasScriptHashFilter() const
+{
+    return m_filterItemCount >= 0;
+}
+
+GolombCodedSet BlockMetaData::scriptHashFilter() const
+{
+    if (m_filterItemCount < 0)
+        return GolombCodedSet();
+    return GolombCodedSet(m_blockId, m_filterItemCount, m_filter);
+}
+
+bool BlockMetaData::hasOutputData() const
+{
+    return m_outputIndex.size() > 0;
+}
+
+int BlockMetaData::outputCount(int txIndex) const
+{
+    assert(txIndex >= 0);
+    if (static_cast<size_t>(txIndex + 1) * sizeof(uint32_t) >= static_cast<size_t>(m_outputIndex.size()))
+        return 0;
+    const uint32_t *index = reinterpret_cast<const uint32_t*>(m_outputIndex.begin()) + txIndex;
+    return static_cast<int>(index[1] - index[0]);
+}
+
+const BlockMetaData::OutputData *BlockMetaData::outputs(int txIndex) const
+{
+    assert(txIndex >= 0);
+    if (static_cast<size_t>(txIndex + 1) * sizeof(uint32_t) >= static_cast<size_t>(m_outputIndex.size()))
+        return nullptr;
+    const uint32_t first = reinterpret_cast<const uint32_t*>(m_outputIndex.begin())[txIndex];
+    if (static_cast<int>(first * OutputRowWidth) > m_outputs.size())
+        return nullptr;
+    return reinterpret_cast<const OutputData*>(m_outputs.begin() + first * OutputRowWidth);
+}
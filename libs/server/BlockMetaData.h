@@ -22,6 +22,7 @@
 #include <streaming/ConstBuffer.h>
 
 #include <primitives/FastBlock.h>
+#include <GolombCodedSet.h>
 
 #include <vector>
 #include <deque>
@@ -59,10 +60,15 @@ public:
      * list of fee items per transaction, skipping the coinbase. So total fee objects is one less than all the
      * transactions in a block since the coinbase is not represented here.
      * The perTxFees can be an empty vector if no fees are present.
+     *
+     * When \a includeOutputs is true, the script-hash and amount of each output is stored as well.
+     * When \a includeFilter is true, a filter over the output script-hashes and spent outputs is stored.
+     * \see outputs()
+     * \see scriptHashFilter()
      */
     static BlockMetaData parseBlock(int blockHeight, const FastBlock &block,
                                     const std::vector<std::unique_ptr<std::deque<std::int32_t> > > &perTxFees,
-                                    Streaming::BufferPool &pool);
+                                    Streaming::BufferPool &pool, bool includeOutputs = false, bool includeFilter = false);
 
     /**
      * The per-transaction data.
@@ -78,6 +84,14 @@ public:
         }
     };
 
+    /**
+     * The per-output data.
+     */
+    struct OutputData {
+        char scriptHash[32]; ///< the sha256 of the output script
+        uint64_t amount;
+    };
+
     /**
      * Find a transaction by txid.
      * This will walk over the list of transactions and find a match with /a txid.
@@ -106,6 +120,22 @@ public:
      */
     const TransactionData* tx(int index) const;
 
+    /**
+     * Returns true if this metadata was created with the per-output data.
+     */
+    bool hasOutputData() const;
+    /**
+     * Returns the amount of outputs of the transaction at \a txIndex.
+     * This returns zero when there is no output data.
+     */
+    int outputCount(int txIndex) const;
+    /**
+     * Returns the outputs of the transaction at \a txIndex, in the order of the transaction.
+     * This allows the script-hashes to be used without hashing the scripts again.
+     * Returns nullptr if there is no output data, \see outputCount() for the size.
+     */
+    const OutputData *outputs(int txIndex) const;
+
     /**
      * \internal
      * Returns the hard data.
@@ -127,6 +157,20 @@ public:
      */
     uint256 blockId() const;
 
+    /**
+     * Returns true if this metadata has a script-hash filter.
+     * Metadata written by older versions of the Hub lacks one.
+     */
+    bool hasScriptHashFilter() const;
+
+    /**
+     * Return the filter over all the output script-hashes and the spent outputs in this block.
+     * The items are the sha256 of the output script and GolombCodedSet::hashOutPoint() for
+     * the spent outputs, the key is the blockId.
+     * The filter is invalid if hasScriptHashFilter() returns false.
+     */
+    GolombCodedSet scriptHashFilter() const;
+
     BlockMetaData &operator=(const BlockMetaData &other) = default;
 
 private:
@@ -135,6 +179,10 @@ private:
     uint256 m_blockId;
     Streaming::ConstBuffer m_data;
     Streaming::ConstBuffer m_transactions;
+    Streaming::ConstBuffer m_filter;
+    Streaming::ConstBuffer m_outputs;
+    Streaming::ConstBuffer m_outputIndex; // per tx the index of its first output in m_outputs
+    int m_filterItemCount = -1;
 };
 
 #endif
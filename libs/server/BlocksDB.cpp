@@ -45,6 +45,13 @@
 #include <boost/filesystem/fstream.hpp>
 #include <boost/math/distributions/poisson.hpp>
 
+#ifndef WIN32
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/resource.h>
+# include <unistd.h>
+#endif
+
 static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
 static const char DB_BLOCK_INDEX = 'b';
@@ -91,7 +98,7 @@ bool LoadExternalBlockFile(const CDiskBlockPos &pos)
     static_assert(MESSAGE_START_SIZE == 4, "We assume 4");
     int64_t nStart = GetTimeMillis();
 
-    Streaming::ConstBuffer dataFile = Blocks::DB::instance()->loadBlockFile(pos.nFile);
+    Streaming::ConstBuffer dataFile = Blocks::DB::instance()->loadBlockFile(pos.nFile, Blocks::SequentialAccess);
     if (!dataFile.isValid()) {
         logWarning(Log::DB) << "LoadExternalBlockFile: Unable to open file" << pos.nFile;
         return false;
@@ -459,9 +466,11 @@ boost::filesystem::path Blocks::getFilepathForIndex(int fileIndex, const char *p
     return path;
 }
 
-FastBlock Blocks::DB::loadBlock(CDiskBlockPos pos)
+FastBlock Blocks::DB::loadBlock(CDiskBlockPos pos, AccessPattern pattern)
 {
-    return FastBlock(d->loadBlock(pos, ForwardBlock));
+    auto buf = d->loadBlock(pos, ForwardBlock);
+    d->adviseAccess(pos.nFile, buf, pattern);
+    return FastBlock(buf);
 }
 
 BlockMetaData Blocks::DB::loadBlockMetaData(CDiskBlockPos pos)
@@ -475,13 +484,72 @@ FastUndoBlock Blocks::DB::loadUndoBlock(CDiskBlockPos pos)
     return FastUndoBlock(d->loadBlock(pos, RevertBlock));
 }
 
-Streaming::ConstBuffer Blocks::DB::loadBlockFile(int fileIndex)
+Streaming::ConstBuffer Blocks::DB::loadBlockFile(int fileIndex, AccessPattern pattern)
 {
     size_t fileSize;
     auto buf = d->mapFile(fileIndex, ForwardBlock, &fileSize);
     if (buf.get() == nullptr)
         return Streaming::ConstBuffer(); // got pruned
-    return Streaming::ConstBuffer(buf, buf.get(), buf.get() + fileSize - 1);
+    Streaming::ConstBuffer answer(buf, buf.get(), buf.get() + fileSize - 1);
+    d->adviseAccess(fileIndex, answer, pattern);
+    return answer;
+}
+
+void Blocks::DB::releaseBlock(CDiskBlockPos pos, const FastBlock &block)
+{
+#if !defined(WIN32) && defined(POSIX_FADV_DONTNEED)
+    if (block.size() == 0)
+        return;
+    // The page cache keeps pages that are still mapped, so first drop our mapping of the
+    // pages this block fully owns (the neighbours may still be needed). This doesn't lose
+    // data, it is faulted in again should someone still read it.
+    static const uintptr_t pageMask = ~(static_cast<uintptr_t>(sysconf(_SC_PAGESIZE)) - 1);
+    const uintptr_t begin = (reinterpret_cast<uintptr_t>(block.data().begin()) + ~pageMask) & pageMask;
+    const uintptr_t end = reinterpret_cast<uintptr_t>(block.data().end()) & pageMask;
+    if (end > begin)
+        madvise(reinterpret_cast<void*>(begin), end - begin, MADV_DONTNEED);
+
+    const int fd = d->fileDescriptor(pos.nFile);
+    if (fd >= 0)
+        posix_fadvise(fd, pos.nPos, block.size(), POSIX_FADV_DONTNEED);
+#endif
+}
+
+Blocks::PageFaultStats Blocks::DB::pageFaultStats(AccessPattern pattern) const
+{
+    return d->pageFaultStats(pattern);
+}
+
+namespace {
+long currentMajorPageFaults()
+{
+#ifndef WIN32
+    struct rusage usage;
+# ifdef RUSAGE_THREAD
+    if (getrusage(RUSAGE_THREAD, &usage) == 0)
+# else
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+# endif
+        return usage.ru_majflt;
+#endif
+    return 0;
+}
+}
+
+Blocks::PageFaultCounter::PageFaultCounter(AccessPattern pattern)
+    : m_pattern(pattern),
+    m_start(currentMajorPageFaults())
+{
+}
+
+Blocks::PageFaultCounter::~PageFaultCounter()
+{
+    auto db = Blocks::DB::instance();
+    if (db == nullptr)
+        return;
+    auto d = db->priv();
+    d->faultCountedOperations[m_pattern].fetch_add(1);
+    d->majorPageFaults[m_pattern].fetch_add(static_cast<uint64_t>(std::max(0l, currentMajorPageFaults() - m_start)));
 }
 
 CDiskBlockPos Blocks::DB::writeMetaBlock(const BlockMetaData &blockmd)
@@ -803,6 +871,10 @@ std::vector<std::pair<int, CBlockIndex *> > Blocks::DBPrivate::allByHeight() con
 
 Blocks::DBPrivate::DBPrivate()
 {
+    for (int i = 0; i < 2; ++i) {
+        faultCountedOperations[i] = 0;
+        majorPageFaults[i] = 0;
+    }
 }
 
 Blocks::DBPrivate::~DBPrivate()
@@ -1049,6 +1121,62 @@ std::shared_ptr<char> Blocks::DBPrivate::mapFile(int fileIndex, Blocks::BlockTyp
     return buf;
 }
 
+void Blocks::DBPrivate::adviseAccess(int fileIndex, const Streaming::ConstBuffer &data, AccessPattern pattern)
+{
+    /*
+     * The kernel-side read-ahead of a memory map follows the advice of the whole map (madvise),
+     * the block files are shared between all readers and advising only the pages of one block
+     * would split the mapping into many small ones. Instead we ask the page-cache directly
+     * to start reading the block from disk, the page faults of the reader then are cheap.
+     */
+#if !defined(WIN32) && defined(POSIX_FADV_WILLNEED)
+    if (pattern != SequentialAccess || data.size() == 0)
+        return;
+    const int fd = fileDescriptor(fileIndex);
+    if (fd < 0)
+        return;
+    const off_t offset = data.begin() - data.internal_buffer().get();
+    posix_fadvise(fd, offset, data.size(), POSIX_FADV_WILLNEED);
+#endif
+}
+
+int Blocks::DBPrivate::fileDescriptor(int fileIndex)
+{
+#ifndef WIN32
+    std::lock_guard<std::recursive_mutex> lock_(lock);
+    if (fileIndex < 0 || static_cast<int>(datafiles.size()) <= fileIndex)
+        return -1;
+    DataFile *df = datafiles.at(static_cast<size_t>(fileIndex));
+    if (df == nullptr)
+        return -1;
+    if (df->fd == -1) {
+        const auto path = getFilepathForIndex(fileIndex, "blk", true);
+        df->fd = ::open(path.string().c_str(), O_RDONLY | O_CLOEXEC);
+        if (df->fd == -1)
+            df->fd = -2; // don't try again for this mapping
+    }
+    return df->fd;
+#else
+    return -1;
+#endif
+}
+
+Blocks::DataFile::~DataFile()
+{
+#ifndef WIN32
+    if (fd >= 0)
+        ::close(fd);
+#endif
+}
+
+Blocks::PageFaultStats Blocks::DBPrivate::pageFaultStats(AccessPattern pattern) const
+{
+    PageFaultStats answer;
+    answer.operations = faultCountedOperations[pattern].load();
+    answer.majorFaults = majorPageFaults[pattern].load();
+    return answer;
+}
+
 void Blocks::DBPrivate::setScheduler(CScheduler *scheduler)
 {
     scheduler->scheduleEvery(std::bind(&Blocks::DBPrivate::closeFiles, this), 10);
@@ -1073,8 +1201,14 @@ void Blocks::DBPrivate::closeFiles()
         }
         after = fileHistory.size();
     }
-    if (before != after)
+    if (before != after) {
         logInfo(Log::DB).nospace() << "Close block files unmapped " << (before - after) << "/" << before << " files";
+        const auto sequential = pageFaultStats(SequentialAccess);
+        const auto normal = pageFaultStats(NormalAccess);
+        logInfo(Log::DB) << "Major page faults. Sequential:" << sequential.majorFaults
+                         << "in" << sequential.operations << "ops, other:"
+                         << normal.majorFaults << "in" << normal.operations << "ops";
+    }
 }
 
 extern CChain chainActive;
@@ -47,6 +47,23 @@ enum ReindexingState {
     ParsingBlocks
 };
 
+/**
+ * Hint on how the caller is going to read the data it loads from the blocks-DB.
+ * Sequential reads ask the kernel to read the block into the page cache ahead of the
+ * reader. The pattern is also used to keep separate page-fault statistics,
+ * see DB::pageFaultStats().
+ */
+enum AccessPattern {
+    NormalAccess,       ///< No hint, the kernel default. Used for point lookups.
+    SequentialAccess    ///< The block will be read front-to-back (block streaming, reindex).
+};
+
+/// Statistics of disk-access per AccessPattern.
+struct PageFaultStats {
+    uint64_t operations = 0;
+    uint64_t majorFaults = 0;
+};
+
 class DBPrivate;
 
 /** Access to the block database (blocks/index/) */
@@ -95,10 +112,21 @@ public:
     }
     void setReindexing(ReindexingState state);
 
-    FastBlock loadBlock(CDiskBlockPos pos);
+    FastBlock loadBlock(CDiskBlockPos pos, AccessPattern pattern = NormalAccess);
     BlockMetaData loadBlockMetaData(CDiskBlockPos pos);
     FastUndoBlock loadUndoBlock(CDiskBlockPos pos);
-    Streaming::ConstBuffer loadBlockFile(int fileIndex);
+    Streaming::ConstBuffer loadBlockFile(int fileIndex, AccessPattern pattern = NormalAccess);
+
+    /**
+     * Tell the kernel that we are done with the block at \a pos and its pages can be
+     * dropped from the page cache.
+     * Typically used after a block has been consumed by a reindex, which will not
+     * come back to that block again.
+     */
+    void releaseBlock(CDiskBlockPos pos, const FastBlock &block);
+
+    /// Returns the major page faults counted by PageFaultCounter instances for this pattern.
+    PageFaultStats pageFaultStats(AccessPattern pattern) const;
 
     /**
      * @brief This method writes out the undo block to a specific file and belonging to a specific /a blockHash.
@@ -150,6 +178,22 @@ private:
     std::shared_ptr<DBPrivate> d;
 };
 
+/**
+ * Counts the major page-faults the current thread incurs during the lifetime of this
+ * object and adds them to the blocks-DB statistics for the access pattern.
+ * Create one on the stack around the code that reads a loaded block.
+ */
+class PageFaultCounter
+{
+public:
+    explicit PageFaultCounter(AccessPattern pattern);
+    ~PageFaultCounter();
+
+private:
+    AccessPattern m_pattern;
+    long m_start;
+};
+
 /** Open a block file (blk?????.dat) */
 FILE* openFile(const CDiskBlockPos &pos, bool fReadOnly);
 /** Open an undo file (rev?????.dat) */
@@ -33,6 +33,7 @@
 #include "BlocksDB.h"
 #include "streaming/ConstBuffer.h"
 
+#include <atomic>
 #include <vector>
 #include <mutex>
 #include <memory>
@@ -48,9 +49,11 @@ namespace Blocks {
 
 struct DataFile {
     DataFile() : filesize(0) {}
+    ~DataFile();
     boost::iostreams::mapped_file file;
     std::weak_ptr<char> buffer;
     size_t filesize;
+    int fd = -1; // for posix_fadvise, opened on first use.
 };
 
 enum BlockType {
@@ -78,6 +81,11 @@ public:
     void foundBlockFile(int index, const CBlockFileInfo &info);
 
     std::shared_ptr<char> mapFile(int fileIndex, BlockType type, size_t *size_out = 0, bool *isWritable = nullptr);
+    /// forward the access pattern to the kernel for \a data, a part of the block file \a fileIndex.
+    void adviseAccess(int fileIndex, const Streaming::ConstBuffer &data, AccessPattern pattern);
+    /// returns a file descriptor for the mapped block file, or -1. Valid as long as the mapping is.
+    int fileDescriptor(int fileIndex);
+    PageFaultStats pageFaultStats(AccessPattern pattern) const;
 
     // close files from filehistory that have been unused for some time.
     void setScheduler(CScheduler *scheduler);
@@ -105,6 +113,10 @@ public:
     BlockMap indexMap;
 
     ReindexingState reindexing = NoReindex;
+
+    // indexed by AccessPattern
+    std::atomic<uint64_t> faultCountedOperations[2];
+    std::atomic<uint64_t> majorPageFaults[2];
 };
 }
 
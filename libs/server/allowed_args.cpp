@@ -233,6 +233,7 @@ static void addGeneralOptions(AllowedArgs& allowedArgs, HelpMessageMode mode)
 
     allowedArgs
         .addArg("maxorphantx=<n>", requiredInt, strprintf(_("Keep at most <n> unconnectable transactions in memory (default: %u)"), DefaultMaxOrphanTransactions))
+        .addArg("maxorphantxsize=<n>", requiredInt, strprintf(_("Keep unconnectable transactions in memory below <n> megabytes (default: %u)"), DefaultMaxOrphanTransactionsSize))
         .addArg("maxmempool=<n>", requiredInt, strprintf(_("Keep the transaction memory pool below <n> megabytes (default: %u)"), DefaultMaxMempoolSize))
         .addArg("mempoolexpiry=<n>", requiredInt, strprintf(_("Do not keep transactions in the mempool longer than <n> hours (default: %u)"), DefaultMempoolExpiry))
 #ifndef WIN32
@@ -241,6 +242,8 @@ static void addGeneralOptions(AllowedArgs& allowedArgs, HelpMessageMode mode)
         .addArg("reindex", optionalBool, _("Rebuild block chain index from current blk000??.dat files on startup"))
         .addArg("blockdatadir=<dir>", requiredStr, "List a fallback directory to find blocks/blk* files")
         .addArg("feesmetadata", optionalBool, "Enable fees to be collected for block meta-data during validation")
+        .addArg("outputsmetadata", optionalBool, "Store the script-hash and amount of each output in the block meta-data")
+        .addArg("filtermetadata", optionalBool, "Store a filter over the output script-hashes and spent outputs in the block meta-data")
         ;
 }
 
@@ -261,6 +264,7 @@ static void addConnectionOptions(AllowedArgs& allowedArgs)
         .addArg("listen", optionalBool, _("Accept connections from outside (default: true if no -proxy or -connect)"))
         .addArg("listenonion", optionalBool, strprintf(_("Automatically create Tor hidden service (default: %d)"), DefaultListenOnion))
         .addArg("maxconnections=<n>", optionalInt, strprintf(_("Maintain at most <n> connections to peers (default: %u)"), DefaultMaxPeerConnections))
+        .addArg("msghandlerthreads=<n>", requiredInt, strprintf(_("Set the number of threads processing messages from peers (default: %d)"), DefaultMessageHandlerThreads))
         .addArg("min-thin-peers=<n>", requiredInt, strprintf(_("Maintain at minimum <n> connections to thin-capable peers (default: %d)"), DefaultMinThinPeers))
         .addArg("maxreceivebuffer=<n>", requiredInt, strprintf(_("Maximum per-connection receive buffer, <n>*1000 bytes (default: %u)"), DefaultMaxReceiveBuffer))
         .addArg("maxsendbuffer=<n>", requiredInt, strprintf(_("Maximum per-connection send buffer, <n>*1000 bytes (default: %u)"), DefaultMaxSendBuffer))
@@ -388,6 +392,7 @@ static void addNodeRelayOptions(AllowedArgs& allowedArgs)
         .addArg("maxexpeditedtxrecipients=<n>", requiredInt, _("The maximum number of nodes this node will forward expedited transactions to"))
         .addArg("minrelaytxfee=<amt>", requiredAmount, strprintf(_("Fees (in BCH/kB) smaller than this are considered zero fee for relaying, mining and transaction creation (default: %s)"),
             FormatMoney(DefaultMinRelayTxFee)))
+        .addArg("use-compactblocks", optionalBool, _("Enable compact blocks (BIP152) to speed up the relay of blocks (default: true)"))
         .addArg("use-thinblocks", optionalBool, _("Enable thin blocks to speed up the relay of blocks (default: false)"))
         ;
 }
@@ -430,6 +435,8 @@ static void addApiServerOptions(AllowedArgs& allowedArgs)
         .addArg("api_connection_per_ip", requiredInt, "Maximum amount of connections from a certain IP")
         .addArg("api_disallow_v6", optionalBool, "Do not allow incoming ipV6 connections")
         .addArg("api_max_addresses", requiredInt, "Maximum amount of addresses a connection can listen on")
+        .addArg("indexer_txid", optionalBool, "Run the TxId indexer inside the Hub and serve it on the api port (default false)")
+        .addArg("indexer_spent", optionalBool, "Run the spent-output indexer inside the Hub and serve it on the api port (default false)")
         .addArg("apilisten=<addr>", requiredStr, strprintf("Bind to given address to listen for api server connections. Use [host]:port notation for IPv6. This option can be specified multiple times (default 127.0.0.1:%s and [::1]:%s)", BaseParams(CBaseChainParams::MAIN).ApiServerPort(), BaseParams(CBaseChainParams::MAIN).ApiServerPort()));
 }
 
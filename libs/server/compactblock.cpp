@@ -0,0 +1,451 @@
+/*
+ * This file is part of the Flowee project
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "compactblock.h"
+
+#include "Application.h"
+#include "BlocksDB.h"
+#include "main.h"
+#include "net.h"
+#include "txmempool.h"
+#include "txorphancache.h"
+#include "consensus/validation.h"
+#include "policy/policy.h"
+#include <validation/Engine.h>
+
+#include <crypto/common.h>
+#include <crypto/sha256.h>
+#include <hash.h>
+#include <merkle.h>
+#include <random.h>
+#include <streaming/BufferPool.h>
+
+namespace {
+// a transaction is at least 60 bytes, use that to limit the amount of items we accept.
+size_t maxTransactionCount()
+{
+    return Policy::blockSizeAcceptLimit() / 60;
+}
+
+// Read a list of differentially encoded indexes, as used by cmpctblock and getblocktxn.
+int readIndex(CDataStream &stream, int &previous)
+{
+    const uint64_t index = ReadCompactSize(stream) + previous + 1;
+    if (index > maxTransactionCount())
+        throw std::runtime_error("transaction index out of range");
+    previous = static_cast<int>(index);
+    return previous;
+}
+
+void writeIndex(CDataStream &stream, int index, int &previous)
+{
+    WriteCompactSize(stream, index - previous - 1);
+    previous = index;
+}
+
+void processReconstructedBlock(CNode *pfrom, const PartialCompactBlock &partial)
+{
+    FastBlock block = partial.createBlock();
+    if (block.isEmpty()) {
+        // most likely a short-id collision, just get the full block.
+        logInfo(Log::ThinBlocks) << "Compact block" << partial.blockHash() << "failed to reconstruct, requesting full block. Peer:" << pfrom->id;
+        std::vector<CInv> invs;
+        invs.push_back(CInv(MSG_BLOCK, partial.blockHash()));
+        pfrom->PushMessage(NetMsgType::GETDATA, invs);
+        return;
+    }
+    logInfo(Log::ThinBlocks) << "Compact block" << partial.blockHash() << "reconstructed. Size:" << block.size();
+    auto *bv = Application::instance()->validation();
+    auto settings = bv->addBlock(block,
+        Validation::ForwardGoodToPeers | Validation::SaveGoodToDisk | Validation::PunishBadNode, pfrom);
+    settings.start();
+}
+}
+
+CompactBlock::CompactBlock(const FastBlock &block)
+{
+    assert(block.isFullBlock());
+    CDataStream headerStream(block.data().begin(), block.data().begin() + 80, SER_NETWORK, PROTOCOL_VERSION);
+    headerStream >> header;
+    GetRandBytes(reinterpret_cast<unsigned char*>(&nonce), sizeof(nonce));
+    createKeys();
+
+    FastBlock copy(block);
+    copy.findTransactions();
+    const auto &transactions = copy.transactions();
+    shortIds.reserve(transactions.size());
+    for (size_t i = 0; i < transactions.size(); ++i) {
+        const Tx &tx = transactions.at(i);
+        if (i == 0) // the coinbase is never in the mempool
+            prefilled.push_back({0, tx});
+        else
+            shortIds.push_back(shortId(tx.createHash()));
+    }
+}
+
+void CompactBlock::write(CDataStream &stream) const
+{
+    stream << header;
+    stream << nonce;
+    WriteCompactSize(stream, shortIds.size());
+    for (const uint64_t id : shortIds) {
+        unsigned char buf[8];
+        WriteLE64(buf, id);
+        stream.write(reinterpret_cast<const char*>(buf), 6);
+    }
+    WriteCompactSize(stream, prefilled.size());
+    int previous = -1;
+    for (const auto &item : prefilled) {
+        writeIndex(stream, item.index, previous);
+        stream.write(item.tx.data().begin(), item.tx.size());
+    }
+}
+
+void CompactBlock::read(CDataStream &stream)
+{
+    stream >> header;
+    stream >> nonce;
+    const uint64_t idCount = ReadCompactSize(stream);
+    if (idCount > maxTransactionCount())
+        throw std::runtime_error("too many short ids");
+    shortIds.clear();
+    shortIds.reserve(idCount);
+    for (uint64_t i = 0; i < idCount; ++i) {
+        unsigned char buf[8] = { 0 };
+        stream.read(reinterpret_cast<char*>(buf), 6);
+        shortIds.push_back(ReadLE64(buf));
+    }
+    const uint64_t prefilledCount = ReadCompactSize(stream);
+    if (prefilledCount > maxTransactionCount())
+        throw std::runtime_error("too many prefilled transactions");
+    prefilled.clear();
+    int previous = -1;
+    for (uint64_t i = 0; i < prefilledCount; ++i) {
+        const int index = readIndex(stream, previous);
+        CTransaction tx;
+        stream >> tx;
+        prefilled.push_back({index, Tx::fromOldTransaction(tx)});
+    }
+    createKeys();
+}
+
+uint64_t CompactBlock::shortId(const uint256 &txid) const
+{
+    return SipHashUint256(m_k0, m_k1, txid) & 0xffffffffffffULL;
+}
+
+void CompactBlock::createKeys()
+{
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << header << nonce;
+    unsigned char hash[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(reinterpret_cast<const unsigned char*>(&stream[0]), stream.size()).Finalize(hash);
+    m_k0 = ReadLE64(hash);
+    m_k1 = ReadLE64(hash + 8);
+}
+
+
+bool PartialCompactBlock::init(const CompactBlock &block)
+{
+    const size_t count = block.transactionCount();
+    if (count == 0 || count > maxTransactionCount())
+        return false;
+    m_compactBlock = block;
+    m_blockHash = block.blockHash();
+    m_transactions.assign(count, Tx());
+    m_txids.assign(count, uint256());
+    m_collided.assign(count, false);
+    m_shortIdToIndex.clear();
+    m_shortIdToIndex.reserve(block.shortIds.size());
+
+    for (const auto &item : block.prefilled) {
+        if (item.index < 0 || static_cast<size_t>(item.index) >= count || m_transactions[item.index].size() > 0)
+            return false;
+        m_transactions[item.index] = item.tx;
+        m_txids[item.index] = item.tx.createHash();
+    }
+
+    // the short ids fill the places not taken by the prefilled transactions.
+    size_t pos = 0;
+    for (const uint64_t id : block.shortIds) {
+        while (m_transactions[pos].size() > 0)
+            ++pos;
+        auto inserted = m_shortIdToIndex.insert(std::make_pair(id, static_cast<int>(pos)));
+        if (!inserted.second) {
+            // two transactions with the same short id, we'll have to ask for both.
+            m_collided[pos] = true;
+            m_collided[inserted.first->second] = true;
+        }
+        ++pos;
+    }
+    return true;
+}
+
+void PartialCompactBlock::offer(const uint256 &txid, const Tx &tx)
+{
+    auto iter = m_shortIdToIndex.find(m_compactBlock.shortId(txid));
+    if (iter == m_shortIdToIndex.end())
+        return;
+    const int index = iter->second;
+    if (m_collided[index])
+        return;
+    if (m_transactions[index].size() > 0) {
+        if (m_txids[index] != txid) { // multiple candidates, we can't know which one is right.
+            m_transactions[index] = Tx();
+            m_txids[index].SetNull();
+            m_collided[index] = true;
+        }
+        return;
+    }
+    m_transactions[index] = tx;
+    m_txids[index] = txid;
+}
+
+void PartialCompactBlock::fillFromMempool(CTxMemPool &pool)
+{
+    {
+        LOCK(pool.cs);
+        for (const CTxMemPoolEntry &entry : pool.mapTx) {
+            offer(entry.GetTx().GetHash(), entry.tx);
+        }
+    }
+    for (const uint256 &txid : CTxOrphanCache::instance()->fetchTransactionIds()) {
+        if (m_shortIdToIndex.find(m_compactBlock.shortId(txid)) == m_shortIdToIndex.end())
+            continue;
+        Tx tx;
+        if (CTxOrphanCache::value(txid, tx))
+            offer(txid, tx);
+    }
+}
+
+std::vector<int> PartialCompactBlock::missingIndexes() const
+{
+    std::vector<int> answer;
+    for (size_t i = 0; i < m_transactions.size(); ++i) {
+        if (m_transactions[i].size() == 0)
+            answer.push_back(static_cast<int>(i));
+    }
+    return answer;
+}
+
+bool PartialCompactBlock::fillMissing(const std::vector<Tx> &transactions)
+{
+    const std::vector<int> missing = missingIndexes();
+    if (missing.size() != transactions.size())
+        return false;
+    for (size_t i = 0; i < missing.size(); ++i) {
+        m_transactions[missing[i]] = transactions[i];
+        m_txids[missing[i]] = transactions[i].createHash();
+    }
+    return true;
+}
+
+bool PartialCompactBlock::isComplete() const
+{
+    for (const Tx &tx : m_transactions) {
+        if (tx.size() == 0)
+            return false;
+    }
+    return !m_transactions.empty();
+}
+
+FastBlock PartialCompactBlock::createBlock() const
+{
+    if (!isComplete())
+        return FastBlock();
+    bool mutated = false;
+    const uint256 merkleRoot = ComputeMerkleRoot(m_txids, &mutated);
+    if (mutated || merkleRoot != m_compactBlock.header.hashMerkleRoot)
+        return FastBlock();
+
+    CDataStream start(SER_NETWORK, PROTOCOL_VERSION);
+    start << m_compactBlock.header;
+    WriteCompactSize(start, m_transactions.size());
+    int blockSize = static_cast<int>(start.size());
+    for (const Tx &tx : m_transactions) {
+        blockSize += tx.size();
+    }
+
+    Streaming::BufferPool pool;
+    pool.reserve(blockSize);
+    char *pos = pool.begin();
+    memcpy(pos, &start[0], start.size());
+    pos += start.size();
+    for (const Tx &tx : m_transactions) {
+        memcpy(pos, tx.data().begin(), tx.size());
+        pos += tx.size();
+    }
+    return FastBlock(pool.commit(blockSize));
+}
+
+
+void SendCompactBlock(CNode *pto, const FastBlock &block)
+{
+    if (!block.isFullBlock())
+        return;
+    CompactBlock compactBlock(block);
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream.reserve(100 + compactBlock.shortIds.size() * 6);
+    compactBlock.write(stream);
+    logDebug(Log::ThinBlocks) << "Sending compact block" << compactBlock.blockHash() << "size:" << stream.size()
+                              << "peer:" << pto->id;
+    pto->PushMessage(NetMsgType::CMPCTBLOCK, stream);
+}
+
+void HandleCompactBlock(CNode *pfrom, CDataStream &vRecv)
+{
+    CompactBlock compactBlock;
+    try {
+        compactBlock.read(vRecv);
+    } catch (const std::exception &e) {
+        logWarning(Log::ThinBlocks) << "Failed to parse compact block" << e << "peer:" << pfrom->id;
+        LOCK(cs_main);
+        Misbehaving(pfrom->GetId(), 100);
+        return;
+    }
+    const uint256 hash = compactBlock.blockHash();
+    CValidationState state;
+    if (!CheckBlockHeader(compactBlock.header, state, true)) {
+        logWarning(Log::ThinBlocks) << "Compact block" << hash << "has a bad header. Peer:" << pfrom->id;
+        LOCK(cs_main);
+        Misbehaving(pfrom->GetId(), 20);
+        return;
+    }
+    {
+        LOCK(cs_main);
+        auto index = Blocks::Index::get(hash);
+        if (index && (index->nStatus & BLOCK_HAVE_DATA)) {
+            logDebug(Log::ThinBlocks) << "Compact block" << hash << "received, but we already have it";
+            return;
+        }
+        if (Blocks::Index::get(compactBlock.header.hashPrevBlock) == nullptr) {
+            // we need the headers first, the block will be fetched after they arrive.
+            pfrom->PushMessage(NetMsgType::GETHEADERS, chainActive.GetLocator(pindexBestHeader), uint256());
+            return;
+        }
+    }
+    pfrom->AddInventoryKnown(CInv(MSG_BLOCK, hash));
+
+    std::unique_ptr<PartialCompactBlock> partial(new PartialCompactBlock());
+    if (!partial->init(compactBlock)) {
+        logWarning(Log::ThinBlocks) << "Compact block" << hash << "is malformed. Peer:" << pfrom->id;
+        LOCK(cs_main);
+        Misbehaving(pfrom->GetId(), 100);
+        return;
+    }
+    partial->fillFromMempool(mempool);
+    if (partial->isComplete()) {
+        processReconstructedBlock(pfrom, *partial);
+        return;
+    }
+
+    const std::vector<int> missing = partial->missingIndexes();
+    CDataStream request(SER_NETWORK, PROTOCOL_VERSION);
+    request << hash;
+    WriteCompactSize(request, missing.size());
+    int previous = -1;
+    for (const int index : missing) {
+        writeIndex(request, index, previous);
+    }
+    pfrom->PushMessage(NetMsgType::GETBLOCKTXN, request);
+    logInfo(Log::ThinBlocks) << "Compact block" << hash << "missing" << missing.size() << "of"
+                             << compactBlock.transactionCount() << "transactions, requesting from peer" << pfrom->id;
+    pfrom->partialCompactBlock = std::move(partial);
+}
+
+void HandleGetBlockTxn(CNode *pfrom, CDataStream &vRecv)
+{
+    uint256 hash;
+    vRecv >> hash;
+    std::vector<int> indexes;
+    try {
+        const uint64_t count = ReadCompactSize(vRecv);
+        if (count > maxTransactionCount())
+            throw std::runtime_error("too many indexes");
+        indexes.reserve(count);
+        int previous = -1;
+        for (uint64_t i = 0; i < count; ++i) {
+            indexes.push_back(readIndex(vRecv, previous));
+        }
+    } catch (const std::exception &e) {
+        logWarning(Log::ThinBlocks) << "Failed to parse getblocktxn" << e << "peer:" << pfrom->id;
+        LOCK(cs_main);
+        Misbehaving(pfrom->GetId(), 100);
+        return;
+    }
+
+    CDiskBlockPos pos;
+    {
+        LOCK(cs_main);
+        auto index = Blocks::Index::get(hash);
+        if (index == nullptr || (index->nStatus & BLOCK_HAVE_DATA) == 0) {
+            logDebug(Log::ThinBlocks) << "Peer" << pfrom->id << "requested transactions from unknown block" << hash;
+            return;
+        }
+        if (chainActive.Height() - index->nHeight > MaxBlockTxnDepth) {
+            // too old for this, let them have the full block.
+            pfrom->vRecvGetData.push_back(CInv(MSG_BLOCK, hash));
+            return;
+        }
+        pos = index->GetBlockPos();
+    }
+
+    FastBlock block = Blocks::DB::instance()->loadBlock(pos);
+    block.findTransactions();
+    const auto &transactions = block.transactions();
+    CDataStream reply(SER_NETWORK, PROTOCOL_VERSION);
+    reply << hash;
+    WriteCompactSize(reply, indexes.size());
+    for (const int index : indexes) {
+        if (static_cast<size_t>(index) >= transactions.size()) {
+            logWarning(Log::ThinBlocks) << "Peer" << pfrom->id << "requested out-of-range transaction" << index << "from" << hash;
+            LOCK(cs_main);
+            Misbehaving(pfrom->GetId(), 100);
+            return;
+        }
+        const Tx &tx = transactions.at(index);
+        reply.write(tx.data().begin(), tx.size());
+    }
+    pfrom->PushMessage(NetMsgType::BLOCKTXN, reply);
+}
+
+void HandleBlockTxn(CNode *pfrom, CDataStream &vRecv)
+{
+    uint256 hash;
+    vRecv >> hash;
+    if (!pfrom->partialCompactBlock || pfrom->partialCompactBlock->blockHash() != hash) {
+        logDebug(Log::ThinBlocks) << "Received blocktxn we did not ask for" << hash << "peer:" << pfrom->id;
+        return;
+    }
+    std::unique_ptr<PartialCompactBlock> partial(std::move(pfrom->partialCompactBlock));
+
+    std::vector<CTransaction> transactions;
+    vRecv >> transactions;
+    Streaming::BufferPool pool;
+    std::vector<Tx> txs;
+    txs.reserve(transactions.size());
+    for (const CTransaction &tx : transactions) {
+        txs.push_back(Tx::fromOldTransaction(tx, &pool));
+    }
+    if (!partial->fillMissing(txs)) {
+        logWarning(Log::ThinBlocks) << "Peer" << pfrom->id << "sent the wrong number of transactions for" << hash;
+        LOCK(cs_main);
+        Misbehaving(pfrom->GetId(), 10);
+        return;
+    }
+    processReconstructedBlock(pfrom, *partial);
+}
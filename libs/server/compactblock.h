@@ -0,0 +1,145 @@
+/*
+ * This file is part of the Flowee project
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef FLOWEE_COMPACTBLOCK_H
+#define FLOWEE_COMPACTBLOCK_H
+
+#include <primitives/block.h>
+#include <primitives/FastBlock.h>
+#include <streaming/streams.h>
+#include <uint256.h>
+#include <util.h>
+
+#include <unordered_map>
+#include <vector>
+
+class CNode;
+class CTxMemPool;
+
+/// Only blocks this close to the tip are sent as compact blocks.
+constexpr int MaxCompactBlockDepth = 5;
+/// Only blocks this close to the tip are used to answer getblocktxn.
+constexpr int MaxBlockTxnDepth = 10;
+
+/**
+ * A compact block as defined in BIP152.
+ *
+ * A compact block carries the block header and, for each transaction, a 6-byte short-id.
+ * The short-ids are SipHash-ed with a key derived from the header and a random nonce so
+ * collisions differ per block and per peer.
+ * The receiving side matches the short-ids against its mempool and only needs to request
+ * the transactions it didn't have, see PartialCompactBlock.
+ */
+class CompactBlock
+{
+public:
+    CompactBlock() = default;
+    /// Create a compact block from \a block, the coinbase is always sent in full.
+    explicit CompactBlock(const FastBlock &block);
+
+    /// Write the cmpctblock message body.
+    void write(CDataStream &stream) const;
+    /// Read a cmpctblock message body. Throws on malformed data.
+    void read(CDataStream &stream);
+
+    /// Returns the short-id for a transaction in this block.
+    uint64_t shortId(const uint256 &txid) const;
+
+    inline uint256 blockHash() const {
+        return header.GetHash();
+    }
+
+    /// The total number of transactions in the block.
+    inline size_t transactionCount() const {
+        return shortIds.size() + prefilled.size();
+    }
+
+    struct PrefilledTx {
+        int index;
+        Tx tx;
+    };
+
+    CBlockHeader header;
+    uint64_t nonce = 0;
+    std::vector<uint64_t> shortIds;
+    std::vector<PrefilledTx> prefilled;
+
+private:
+    void createKeys();
+
+    uint64_t m_k0 = 0;
+    uint64_t m_k1 = 0;
+};
+
+/**
+ * A block being rebuilt from a CompactBlock.
+ *
+ * Transactions are found in the mempool (or offered by the user of this class)
+ * and whatever is left needs to be fetched from the peer with a getblocktxn.
+ */
+class PartialCompactBlock
+{
+public:
+    /// Returns false if the compact block is malformed.
+    bool init(const CompactBlock &block);
+
+    /// Use \a tx for this block, if its short-id is part of the block.
+    void offer(const uint256 &txid, const Tx &tx);
+    /// Offer all transactions from the mempool and the orphan cache.
+    void fillFromMempool(CTxMemPool &pool);
+
+    /// The indexes in the block of the transactions we don't have yet.
+    std::vector<int> missingIndexes() const;
+    /// Fill the missing transactions, in order of missingIndexes(). Returns false on count mismatch.
+    bool fillMissing(const std::vector<Tx> &transactions);
+
+    bool isComplete() const;
+
+    /**
+     * Assemble the full block.
+     * Returns an empty block if the merkle root doesn't match, which can happen due
+     * to a short-id collision. The caller should fetch the full block instead.
+     */
+    FastBlock createBlock() const;
+
+    inline uint256 blockHash() const {
+        return m_blockHash;
+    }
+
+private:
+    CompactBlock m_compactBlock;
+    uint256 m_blockHash;
+    std::unordered_map<uint64_t, int> m_shortIdToIndex;
+    std::vector<Tx> m_transactions;
+    std::vector<uint256> m_txids;
+    std::vector<bool> m_collided;
+};
+
+inline bool IsCompactBlocksEnabled() {
+    return GetBoolArg("-use-compactblocks", true);
+}
+
+/// Send \a block as a cmpctblock message to \a pto.
+void SendCompactBlock(CNode *pto, const FastBlock &block);
+/// process an incoming cmpctblock message
+void HandleCompactBlock(CNode *pfrom, CDataStream &vRecv);
+/// process an incoming getblocktxn message
+void HandleGetBlockTxn(CNode *pfrom, CDataStream &vRecv);
+/// process an incoming blocktxn message
+void HandleBlockTxn(CNode *pfrom, CDataStream &vRecv);
+
+#endif
@@ -766,10 +766,6 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     logInfo(Log::Internals) << nFD << "file descriptors available";
     std::ostringstream strErrors;
 
-    // Start the lightweight task scheduler thread
-    CScheduler::Function serviceLoop = std::bind(&CScheduler::serviceQueue, &scheduler);
-    threadGroup.create_thread(std::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
-
     /* Start the RPC server already.  It will be started in "warmup" mode
      * and not really process calls already (but it will signify connections
      * that the server is there and will be ready later).  Warmup mode will
@@ -783,6 +779,8 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     }
 
     Application::instance()->validation()->enableFeeResolveForMetaData(GetBoolArg("-feesmetadata", false));
+    Application::instance()->validation()->enableOutputsForMetaData(GetBoolArg("-outputsmetadata", false));
+    Application::instance()->validation()->enableFilterForMetaData(GetBoolArg("-filtermetadata", false));
     Application::instance()->validation()->setMempool(&mempool);
     scheduler.scheduleEvery(std::bind(&DoubleSpendProofStorage::periodicCleanup,  mempool.doubleSpendProofStorage()), 60);
 
@@ -973,6 +971,7 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     // ********************************************************* Step 7: network initialization
 
     CTxOrphanCache::instance()->setLimit((unsigned int)std::max((int64_t)0, GetArg("-maxorphantx", Settings::DefaultMaxOrphanTransactions)));
+    CTxOrphanCache::instance()->setByteLimit((uint64_t)std::max((int64_t)0, GetArg("-maxorphantxsize", Settings::DefaultMaxOrphanTransactionsSize)) * 1000000);
 
     RegisterNodeSignals(GetNodeSignals());
 
@@ -34,6 +34,7 @@
 #include "txmempool.h"
 #include "txorphancache.h"
 #include "thinblock.h"
+#include "compactblock.h"
 #include "validation/Engine.h"
 
 #include <Application.h>
@@ -884,12 +885,12 @@ void AlertNotify(const std::string& strMessage, bool fThread)
         runCommand(strCmd);
 }
 
-// Requires cs_main.
 void Misbehaving(NodeId nodeId, int howmuch)
 {
     if (howmuch == 0)
         return;
 
+    LOCK(cs_main);
     CNodeState *state = State(nodeId);
     if (state == nullptr)
         return;
@@ -1187,8 +1188,8 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
 
     std::vector<CInv> vNotFound;
 
-    LOCK(cs_main);
-
+    // cs_main is only held while deciding what to send, reading and sending a
+    // (potentially large) block happens without it to not stall other peers.
     while (it != pfrom->vRecvGetData.end()) {
         // Don't bother if send buffer is too full to respond anyway
         if (pfrom->nSendSize >= SendBufferSize())
@@ -1204,38 +1205,49 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                     || inv.type == MSG_THINBLOCK || inv.type == MSG_XTHINBLOCK)
             {
                 bool send = false;
+                bool compactDepthOk = false;
                 auto mi = Blocks::Index::get(inv.hash);
-                if (mi) {
-                    if (chainActive.Contains(mi)) {
-                        send = true;
-                    } else {
-                        static const int nOneMonth = 30 * 24 * 60 * 60;
-                        // To prevent fingerprinting attacks, only send blocks outside of the active
-                        // chain if they are valid, and no more than a month older (both in time, and in
-                        // best equivalent proof of work) than the best header chain we know about.
-                        send = mi->IsValid(BLOCK_VALID_SCRIPTS) && (pindexBestHeader != nullptr) &&
-                            (pindexBestHeader->GetBlockTime() - mi->GetBlockTime() < nOneMonth) &&
-                            (GetBlockProofEquivalentTime(*pindexBestHeader, *mi, *pindexBestHeader, consensusParams) < nOneMonth);
-                        if (!send) {
-                            logDebug(Log::Net) << "ProcessGetData ignoring request from peer"
-                                                  << pfrom->GetId() << "for old block that isn't in the main chain";
+                {
+                    LOCK(cs_main);
+                    if (mi) {
+                        if (chainActive.Contains(mi)) {
+                            send = true;
+                        } else {
+                            static const int nOneMonth = 30 * 24 * 60 * 60;
+                            // To prevent fingerprinting attacks, only send blocks outside of the active
+                            // chain if they are valid, and no more than a month older (both in time, and in
+                            // best equivalent proof of work) than the best header chain we know about.
+                            send = mi->IsValid(BLOCK_VALID_SCRIPTS) && (pindexBestHeader != nullptr) &&
+                                (pindexBestHeader->GetBlockTime() - mi->GetBlockTime() < nOneMonth) &&
+                                (GetBlockProofEquivalentTime(*pindexBestHeader, *mi, *pindexBestHeader, consensusParams) < nOneMonth);
+                            if (!send) {
+                                logDebug(Log::Net) << "ProcessGetData ignoring request from peer"
+                                                      << pfrom->GetId() << "for old block that isn't in the main chain";
+                            }
                         }
                     }
-                }
-                // disconnect node in case we have reached the outbound limit for serving historical blocks
-                // never disconnect whitelisted nodes
-                static const int nOneWeek = 7 * 24 * 60 * 60; // assume > 1 week = historical
-                if (send && CNode::OutboundTargetReached(true) && ( ((pindexBestHeader != nullptr) && (pindexBestHeader->GetBlockTime() - mi->GetBlockTime() > nOneWeek)) || inv.type == MSG_FILTERED_BLOCK) && !pfrom->fWhitelisted)
-                {
-                    logCritical(Log::Net) << "historical block serving limit reached, disconnect peer" << pfrom->GetId();
+                    // disconnect node in case we have reached the outbound limit for serving historical blocks
+                    // never disconnect whitelisted nodes
+                    static const int nOneWeek = 7 * 24 * 60 * 60; // assume > 1 week = historical
+                    if (send && CNode::OutboundTargetReached(true) && ( ((pindexBestHeader != nullptr) && (pindexBestHeader->GetBlockTime() - mi->GetBlockTime() > nOneWeek)) || inv.type == MSG_FILTERED_BLOCK) && !pfrom->fWhitelisted)
+                    {
+                        logCritical(Log::Net) << "historical block serving limit reached, disconnect peer" << pfrom->GetId();
 
-                    //disconnect node
-                    pfrom->fDisconnect = true;
+                        //disconnect node
+                        pfrom->markForDisconnect();
+                        send = false;
+                    }
+                    // Pruned nodes may have deleted the block, so check whether
+                    // it's available before trying to send.
+                    send = send && (mi->nStatus & BLOCK_HAVE_DATA);
+                    // BIP152: blocks deep in the chain are sent in full.
+                    compactDepthOk = send && chainActive.Height() - mi->nHeight <= MaxCompactBlockDepth;
+                }
+                if (send && inv.type == MSG_CMPCT_BLOCK && pfrom->fSupportsCompactBlocks && compactDepthOk) {
+                    SendCompactBlock(pfrom, Blocks::DB::instance()->loadBlock(mi->GetBlockPos()));
                     send = false;
                 }
-                // Pruned nodes may have deleted the block, so check whether
-                // it's available before trying to send.
-                if (send && (mi->nStatus & BLOCK_HAVE_DATA))
+                if (send)
                 {
                     logDebug(107) << " requested block available";
                     // Send block from disk
@@ -1290,7 +1302,10 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                         // and we want it right after the last block so they don't
                         // wait for other stuff first.
                         std::vector<CInv> vInv;
-                        vInv.push_back(CInv(MSG_BLOCK, chainActive.Tip()->GetBlockHash()));
+                        {
+                            LOCK(cs_main);
+                            vInv.push_back(CInv(MSG_BLOCK, chainActive.Tip()->GetBlockHash()));
+                        }
                         pfrom->PushMessage(NetMsgType::INV, vInv);
                         pfrom->hashContinue.SetNull();
                     }
@@ -1391,7 +1406,7 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
             logWarning(Log::Net) << "peer:" << pfrom->id << "using obsolete version" << nVersion << "disconnecting";
             pfrom->PushMessage(NetMsgType::REJECT, strCommand, REJECT_OBSOLETE,
                                strprintf("Version must be %d or greater", MIN_PEER_PROTO_VERSION));
-            pfrom->fDisconnect = true;
+            pfrom->markForDisconnect();
             addrman.increaseUselessness(pfrom->addr, 2);
             return false;
         }
@@ -1420,7 +1435,7 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
         if (nNonce == nLocalHostNonce && nNonce > 1)
         {
             logCritical(Log::Net) << "connected to self at" << pfrom->addr << "disconnecting";
-            pfrom->fDisconnect = true;
+            pfrom->markForDisconnect();
             return true;
         }
 
@@ -1437,7 +1452,10 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
         pfrom->fClient = !(pfrom->nServices & NODE_NETWORK);
 
         // Potentially mark this peer as a preferred download peer.
-        UpdatePreferredDownload(pfrom, State(pfrom->GetId()));
+        {
+            LOCK(cs_main);
+            UpdatePreferredDownload(pfrom, State(pfrom->GetId()));
+        }
 
         // Change version
         pfrom->PushMessage(NetMsgType::VERACK);
@@ -1486,7 +1504,7 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
     else if (pfrom->nVersion == 0)
     {
         // Must have a version message before anything else
-        pfrom->fDisconnect = true;
+        pfrom->markForDisconnect();
         return false;
     }
 
@@ -1511,6 +1529,10 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
             if (!xthinEnabled)
                 pfrom->PushMessage(NetMsgType::SENDHEADERS);
         }
+        if (pfrom->nVersion >= SHORT_IDS_BLOCKS_VERSION && IsCompactBlocksEnabled()) {
+            // BIP152, we only do the low-bandwidth mode where blocks are requested by getdata.
+            pfrom->PushMessage(NetMsgType::SENDCMPCT, false, static_cast<uint64_t>(1));
+        }
     }
 
 
@@ -1575,7 +1597,7 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
         if (vAddr.size() < 1000)
             pfrom->fGetAddr = false;
         if (pfrom->fOneShot)
-            pfrom->fDisconnect = true;
+            pfrom->markForDisconnect();
     }
 
     else if (strCommand == NetMsgType::SENDHEADERS)
@@ -1588,6 +1610,33 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
             State(pfrom->GetId())->fPreferHeaders = true;
     }
 
+    else if (strCommand == NetMsgType::SENDCMPCT)
+    {
+        bool highBandwidth;
+        uint64_t version;
+        vRecv >> highBandwidth >> version;
+        if (version == 1)
+            pfrom->fSupportsCompactBlocks = true;
+    }
+
+    else if (strCommand == NetMsgType::CMPCTBLOCK && !fReindex) // Ignore blocks received while importing
+    {
+        if (IsCompactBlocksEnabled())
+            HandleCompactBlock(pfrom, vRecv);
+    }
+
+    else if (strCommand == NetMsgType::GETBLOCKTXN)
+    {
+        if (IsCompactBlocksEnabled())
+            HandleGetBlockTxn(pfrom, vRecv);
+    }
+
+    else if (strCommand == NetMsgType::BLOCKTXN && !fReindex)
+    {
+        if (IsCompactBlocksEnabled())
+            HandleBlockTxn(pfrom, vRecv);
+    }
+
 
     else if (strCommand == NetMsgType::INV)
     {
@@ -1600,6 +1649,7 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
 
         bool fBlocksOnly = GetBoolArg("-blocksonly", Settings::DefaultBlocksOnly);
 
+        LOCK(cs_main);
         // When catching up, avoid accepting transactions before we reach the tip, since they could get blacklisted.
         if (Blocks::DB::instance()->headerChain().Height() - chainActive.Height() > 6)
             fBlocksOnly = true;
@@ -1608,8 +1658,6 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
         else if (pfrom->fWhitelisted && GetBoolArg("-whitelistrelay", Settings::DefaultWhitelistRelay))
             fBlocksOnly = false;
 
-        LOCK(cs_main);
-
         std::vector<CInv> vToFetch;
         for (unsigned int nInv = 0; nInv < vInv.size(); nInv++) {
             const CInv &inv = vInv[nInv];
@@ -1669,6 +1717,8 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
                             }
                         }
                         else {
+                            if (IsCompactBlocksEnabled() && pfrom->fSupportsCompactBlocks && IsChainNearlySyncd())
+                                inv2.type = MSG_CMPCT_BLOCK;
                             vToFetch.push_back(inv2);
                             MarkBlockAsInFlight(pfrom->GetId(), inv.hash, chainparams.GetConsensus());
                             LogPrint("thin", "Requesting Regular Block %s from peer %s (%d)\n", inv2.hash.ToString(), pfrom->addrName.c_str(),pfrom->id);
@@ -1877,6 +1927,7 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
         }
         CBlockIndex *pindexLast = futures.back().blockIndex();
         assert(pindexLast);
+        LOCK(cs_main);
         UpdateBlockAvailability(pfrom->GetId(), pindexLast->GetBlockHash());
 
         if (nCount == MAX_HEADERS_RESULTS) {
@@ -1888,8 +1939,6 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
             pfrom->PushMessage(NetMsgType::GETHEADERS, chainActive.GetLocator(pindexLast), uint256());
         }
 
-        LOCK(cs_main);
-
         bool fCanDirectFetch = CanDirectFetch(chainparams.GetConsensus());
         CNodeState *nodestate = State(pfrom->GetId());
         // If this set of headers is valid and ends in a block with at least as
@@ -1929,6 +1978,11 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
                     MarkBlockAsInFlight(pfrom->GetId(), pindex->GetBlockHash(), chainparams.GetConsensus(), pindex);
                     logDebug(Log::Net) << "Requesting block" << pindex->GetBlockHash() << "from  peer:" << pfrom->id;
                 }
+                // a single block on top of our tip is most likely to have its transactions in our mempool.
+                if (vGetData.size() == 1 && pindexLast->pprev == chainActive.Tip()
+                        && IsCompactBlocksEnabled() && pfrom->fSupportsCompactBlocks) {
+                    vGetData[0].type = MSG_CMPCT_BLOCK;
+                }
                 if (vGetData.size() > 1) {
                     logDebug(Log::Net) << "Downloading blocks toward" << pindexLast->GetBlockHash() << "height:" << pindexLast->nHeight;
                 }
@@ -2149,7 +2203,7 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
             vRecv >> block;
         } catch (std::exception &e) {
             LogPrint("net", "ProcessMessage/block failed to parse message and got error: %s\n", e.what());
-            pfrom->fDisconnect = true;
+            pfrom->markForDisconnect();
             return true;
         }
         logDebug(106) << "->" << block.GetHash();
@@ -2190,7 +2244,10 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
         }
         pfrom->fSentAddr = true;
 
-        pfrom->vAddrToSend.clear();
+        {
+            LOCK(pfrom->cs_addr);
+            pfrom->vAddrToSend.clear();
+        }
         std::vector<CAddress> vAddr = addrman.GetAddr();
         for (const CAddress &addr : vAddr)
             pfrom->PushAddress(addr);
@@ -2202,7 +2259,7 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
         if (CNode::OutboundTargetReached(false) && !pfrom->fWhitelisted)
         {
             LogPrint("net", "mempool request with bandwidth limit reached, disconnect peer=%d\n", pfrom->GetId());
-            pfrom->fDisconnect = true;
+            pfrom->markForDisconnect();
             return true;
         }
         LOCK2(cs_main, pfrom->cs_filter);
@@ -2562,6 +2619,7 @@ bool ProcessMessages(CNode* pfrom)
 
         // Process message
         bool fRet = false;
+        const int64_t nStartTime = GetTimeMicros();
         try
         {
             fRet = ProcessMessage(pfrom, strCommand, vRecv, msg.nTime);
@@ -2593,6 +2651,7 @@ bool ProcessMessages(CNode* pfrom)
         } catch (...) {
             PrintExceptionContinue(nullptr, "ProcessMessages()");
         }
+        RecordMessageProcessingTime(strCommand, GetTimeMicros() - nStartTime);
 
         if (!fRet)
             LogPrintf("%s(%s, %u bytes) FAILED peer=%d\n", __func__, SanitizeString(strCommand), nMessageSize, pfrom->id);
@@ -2664,6 +2723,7 @@ bool SendMessages(CNode* pto)
         //
         if (pto->nNextAddrSend < nNow) {
             pto->nNextAddrSend = PoissonNextSend(nNow, AVG_ADDRESS_BROADCAST_INTERVAL);
+            LOCK(pto->cs_addr);
             std::vector<CAddress> vAddr;
             vAddr.reserve(pto->vAddrToSend.size());
             for (const CAddress& addr : pto->vAddrToSend) {
@@ -2689,7 +2749,7 @@ bool SendMessages(CNode* pto)
             if (pto->fWhitelisted)
                 LogPrintf("Warning: not punishing whitelisted peer %s!\n", pto->addr.ToString());
             else {
-                pto->fDisconnect = true;
+                pto->markForDisconnect();
                 if (pto->addr.IsLocal())
                     LogPrintf("Warning: not banning local peer %s!\n", pto->addr.ToString());
                 else
@@ -2897,7 +2957,7 @@ bool SendMessages(CNode* pto)
             // the download window should be much larger than the to-be-downloaded set of blocks, so disconnection
             // should only happen during initial block download.
             logCritical(Log::Net) << "Peer" << pto->id << "is stalling block download, disconnecting";
-            pto->fDisconnect = true;
+            pto->markForDisconnect();
         }
         // In case there is a block that has been in flight from this peer for 2 + 0.5 * N times the block interval
         // (with N the number of peers from which we're downloading validated blocks), disconnect due to timeout.
@@ -2909,7 +2969,7 @@ bool SendMessages(CNode* pto)
             int nOtherPeersWithValidatedDownloads = nPeersWithValidatedDownloads - (state.nBlocksInFlightValidHeaders > 0);
             if (nNow > state.nDownloadingSince + consensusParams.nPowTargetSpacing * (BLOCK_DOWNLOAD_TIMEOUT_BASE + BLOCK_DOWNLOAD_TIMEOUT_PER_PEER * nOtherPeersWithValidatedDownloads)) {
                 logCritical(Log::Net) << "Timeout downloading block" << queuedBlock.hash << "from peer" << pto->id << "disconnecting";
-                pto->fDisconnect = true;
+                pto->markForDisconnect();
             }
         }
 
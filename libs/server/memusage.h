@@ -119,6 +119,12 @@ static inline size_t IncrementalDynamicUsage(const std::map<X, Y, Z>& m)
     return MallocUsage(sizeof(stl_tree_node<std::pair<const X, Y> >));
 }
 
+template<typename X, typename Y, typename Z>
+static inline size_t DynamicUsage(const std::multimap<X, Y, Z>& m)
+{
+    return MallocUsage(sizeof(stl_tree_node<std::pair<const X, Y> >)) * m.size();
+}
+
 // Boost data structures
 
 template<typename X>
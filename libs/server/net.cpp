@@ -39,6 +39,7 @@
 #include <utilstrencodings.h>
 #include "serverutil.h"
 #include "thinblock.h"
+#include "compactblock.h"
 #include "policy/policy.h"
 
 #ifdef WIN32
@@ -47,6 +48,11 @@
 #include <fcntl.h>
 #endif
 
+#ifdef __linux__
+#define USE_EPOLL
+#include <sys/epoll.h>
+#endif
+
 #ifdef USE_UPNP
 #include <miniupnpc/miniupnpc.h>
 #include <miniupnpc/miniwget.h>
@@ -139,6 +145,9 @@ bool fAddressesInitialized = false;
 
 std::vector<CNode*> vNodes;
 CCriticalSection cs_vNodes;
+// nodes marked for disconnect, to be removed from vNodes by the socket handler thread
+static std::vector<CNode*> vNodesToDisconnect;
+static CCriticalSection cs_vNodesToDisconnect;
 std::map<CInv, CDataStream> mapRelay;
 std::deque<std::pair<int64_t, CInv> > vRelayExpiration;
 CCriticalSection cs_mapRelay;
@@ -158,6 +167,10 @@ CCriticalSection cs_nLastNodeId;
 
 static CSemaphore *semOutbound = NULL;
 boost::condition_variable messageHandlerCondition;
+static boost::mutex messageHandlerMutex;
+
+static CCriticalSection cs_messageStats;
+static std::map<std::string, MessageProcessingStats> messageStats;
 
 // Signals for message handling
 static CNodeSignals g_signals;
@@ -427,6 +440,73 @@ CNode* FindNode(int nodeId)
     return nullptr;
 }
 
+#ifdef USE_EPOLL
+namespace {
+// protects the CNode::nPoll* members and the socket-fd while we change the poll set
+CCriticalSection cs_poll;
+// nodes whose receive buffer is full, only used by the socket handler thread
+std::set<CNode*> throttledNodes;
+
+int pollInstance()
+{
+    static const int fd = epoll_create1(EPOLL_CLOEXEC);
+    return fd;
+}
+
+// requires LOCK(cs_poll)
+uint32_t wantedPollEvents(const CNode *pnode)
+{
+    // While there is data to send we only wait for the socket to become
+    // writable, draining the write buffer before receiving more.
+    // See the comment in the select() based ThreadSocketHandler.
+    if (pnode->fPollSendPending)
+        return EPOLLOUT;
+    if (pnode->fPollThrottled)
+        return 0;
+    return EPOLLIN;
+}
+
+// requires LOCK(cs_poll)
+void updatePollEvents(CNode *pnode)
+{
+    const uint32_t events = wantedPollEvents(pnode);
+    if (events == pnode->nPollEvents || pnode->hSocket == INVALID_SOCKET)
+        return;
+    struct epoll_event event;
+    event.events = events;
+    event.data.ptr = pnode;
+    if (epoll_ctl(pollInstance(), EPOLL_CTL_MOD, pnode->hSocket, &event) == 0)
+        pnode->nPollEvents = events;
+}
+
+void setThrottled(CNode *pnode, bool on)
+{
+    LOCK(cs_poll);
+    pnode->fPollThrottled = on;
+    updatePollEvents(pnode);
+}
+}
+#endif
+
+// Add a newly connected node to the set of sockets the socket handler waits on.
+static void startPolling(CNode *pnode)
+{
+#ifdef USE_EPOLL
+    LOCK(cs_poll);
+    if (pnode->hSocket == INVALID_SOCKET)
+        return;
+    struct epoll_event event;
+    event.events = wantedPollEvents(pnode);
+    event.data.ptr = pnode;
+    if (epoll_ctl(pollInstance(), EPOLL_CTL_ADD, pnode->hSocket, &event) == 0)
+        pnode->nPollEvents = event.events;
+    else
+        logCritical(Log::Net) << "Failed to add peer to epoll set" << NetworkErrorString(errno);
+#else
+    (void) pnode;
+#endif
+}
+
 CNode* ConnectNode(CAddress addrConnect, const char *pszDest)
 {
     if (pszDest == NULL) {
@@ -469,6 +549,7 @@ CNode* ConnectNode(CAddress addrConnect, const char *pszDest)
             LOCK(cs_vNodes);
             vNodes.push_back(pnode);
         }
+        startPolling(pnode);
 
         pnode->nTimeConnected = GetTime();
 
@@ -482,12 +563,25 @@ CNode* ConnectNode(CAddress addrConnect, const char *pszDest)
     return NULL;
 }
 
+void CNode::markForDisconnect()
+{
+    LOCK(cs_vNodesToDisconnect);
+    if (!fDisconnect) {
+        fDisconnect = true;
+        vNodesToDisconnect.push_back(this);
+    }
+}
+
 void CNode::CloseSocketDisconnect()
 {
-    fDisconnect = true;
+    markForDisconnect();
     if (hSocket != INVALID_SOCKET)
     {
         logDebug(Log::Net) << "disconnecting peer" << id;
+#ifdef USE_EPOLL
+        // avoid the fd being reused by a new peer while its poll-state is being changed
+        LOCK(cs_poll);
+#endif
         CloseSocket(hSocket);
     }
 
@@ -832,6 +926,12 @@ void SocketSendData(CNode *pnode)
         assert(pnode->nSendSize == 0);
     }
     pnode->vSendMsg.erase(pnode->vSendMsg.begin(), it);
+
+#ifdef USE_EPOLL
+    LOCK(cs_poll);
+    pnode->fPollSendPending = !pnode->vSendMsg.empty();
+    updatePollEvents(pnode);
+#endif
 }
 
 static std::list<CNode*> vNodesDisconnected;
@@ -985,7 +1085,7 @@ static bool AttemptToEvictConnection(bool fPreferNewConnection) {
             return false;
 
     // Disconnect from the network group with the most connections
-    vEvictionCandidates[0]->fDisconnect = true;
+    vEvictionCandidates[0]->markForDisconnect();
 
     return true;
 }
@@ -1017,11 +1117,13 @@ static void AcceptConnection(const ListenSocket& hListenSocket) {
         return;
     }
 
+#ifndef USE_EPOLL
     if (!IsSelectableSocket(hSocket)) {
         logCritical(Log::Net) << "connection from" << addr << "dropped: non-selectable socket";
         CloseSocket(hSocket);
         return;
     }
+#endif
 
     // According to the internet TCP_NODELAY is not carried into accepted sockets
     // on all platforms.  Set it again here just to be sure.
@@ -1057,80 +1159,273 @@ static void AcceptConnection(const ListenSocket& hListenSocket) {
         LOCK(cs_vNodes);
         vNodes.push_back(pnode);
     }
+    startPolling(pnode);
 }
 
-void ThreadSocketHandler()
+static void DisconnectNodes(unsigned int &nPrevNodeCount)
 {
-    unsigned int nPrevNodeCount = 0;
-    while (true)
+    // Every node in vNodes holds a reference until it is marked for disconnect,
+    // so we only have to look at the marked ones.
+    std::vector<CNode*> nodesToDisconnect;
     {
-        //
-        // Disconnect nodes
-        //
-        {
-            LOCK(cs_vNodes);
-            // Disconnect unused nodes
-            std::vector<CNode*> vNodesCopy = vNodes;
-            for (CNode* pnode : vNodesCopy) {
-                if (pnode->fDisconnect ||
-                    (pnode->GetRefCount() <= 0 && pnode->vRecvMsg.empty() && pnode->nSendSize == 0 && pnode->ssSend.empty()))
-                {
-                    // remove from vNodes
-                    vNodes.erase(remove(vNodes.begin(), vNodes.end(), pnode), vNodes.end());
+        LOCK(cs_vNodesToDisconnect);
+        nodesToDisconnect.swap(vNodesToDisconnect);
+    }
+    if (!nodesToDisconnect.empty()) {
+        std::vector<CNode*> notAddedYet;
+        LOCK(cs_vNodes);
+        for (CNode* pnode : nodesToDisconnect) {
+            auto iter = std::find(vNodes.begin(), vNodes.end(), pnode);
+            if (iter == vNodes.end()) {
+                // a node can fail while connecting, before it is added to vNodes.
+                notAddedYet.push_back(pnode);
+            } else {
+                // remove from vNodes
+                vNodes.erase(iter);
 
-                    // release outbound grant (if any)
-                    pnode->grantOutbound.Release();
+                // release outbound grant (if any)
+                pnode->grantOutbound.Release();
 
-                    // close socket and cleanup
-                    pnode->CloseSocketDisconnect();
+                // close socket and cleanup
+                pnode->CloseSocketDisconnect();
+#ifdef USE_EPOLL
+                throttledNodes.erase(pnode);
+#endif
 
-                    // hold in disconnected pool until all refs are released
-                    if (pnode->fNetworkNode || pnode->fInbound)
-                        pnode->Release();
-                    vNodesDisconnected.push_back(pnode);
+                // hold in disconnected pool until all refs are released
+                if (pnode->fNetworkNode || pnode->fInbound)
+                    pnode->Release();
+                vNodesDisconnected.push_back(pnode);
 
-                    if (pnode->nVersion != 0) {
-                        bool xthinCapable = pnode->nServices & NODE_XTHIN;
-                        CAddrInfo *info = addrman.Find(pnode->addr);
-                        if (info)
-                            info->setKnowsXThin(xthinCapable);
-                    }
+                if (pnode->nVersion != 0) {
+                    bool xthinCapable = pnode->nServices & NODE_XTHIN;
+                    CAddrInfo *info = addrman.Find(pnode->addr);
+                    if (info)
+                        info->setKnowsXThin(xthinCapable);
                 }
             }
         }
-        {
-            // Delete disconnected nodes
-            std::list<CNode*> vNodesDisconnectedCopy = vNodesDisconnected;
-            for (CNode* pnode : vNodesDisconnectedCopy) {
-                // wait until threads are done using it
-                if (pnode->GetRefCount() <= 0)
+        if (!notAddedYet.empty()) {
+            LOCK(cs_vNodesToDisconnect);
+            vNodesToDisconnect.insert(vNodesToDisconnect.end(), notAddedYet.begin(), notAddedYet.end());
+        }
+    }
+    {
+        // Delete disconnected nodes
+        std::list<CNode*> vNodesDisconnectedCopy = vNodesDisconnected;
+        for (CNode* pnode : vNodesDisconnectedCopy) {
+            // wait until threads are done using it
+            if (pnode->GetRefCount() <= 0)
+            {
+                bool fDelete = false;
                 {
-                    bool fDelete = false;
+                    TRY_LOCK(pnode->cs_vSend, lockSend);
+                    if (lockSend)
                     {
-                        TRY_LOCK(pnode->cs_vSend, lockSend);
-                        if (lockSend)
+                        TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
+                        if (lockRecv)
                         {
-                            TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
-                            if (lockRecv)
-                            {
-                                TRY_LOCK(pnode->cs_inventory, lockInv);
-                                if (lockInv)
-                                    fDelete = true;
-                            }
+                            TRY_LOCK(pnode->cs_inventory, lockInv);
+                            if (lockInv)
+                                fDelete = true;
                         }
                     }
-                    if (fDelete)
-                    {
-                        vNodesDisconnected.remove(pnode);
-                        delete pnode;
-                    }
+                }
+                if (fDelete)
+                {
+                    vNodesDisconnected.remove(pnode);
+                    delete pnode;
                 }
             }
         }
-        if(vNodes.size() != nPrevNodeCount) {
-            nPrevNodeCount = vNodes.size();
-            uiInterface.NotifyNumConnectionsChanged(nPrevNodeCount);
+    }
+    if(vNodes.size() != nPrevNodeCount) {
+        nPrevNodeCount = vNodes.size();
+        uiInterface.NotifyNumConnectionsChanged(nPrevNodeCount);
+    }
+}
+
+// requires LOCK(pnode->cs_vRecvMsg)
+static void ReceiveFromNode(CNode *pnode)
+{
+    // typical socket buffer is 8K-64K
+    char pchBuf[0x10000];
+    int nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
+    if (nBytes > 0)
+    {
+        if (!pnode->ReceiveMsgBytes(pchBuf, nBytes))
+            pnode->CloseSocketDisconnect();
+        pnode->nLastRecv = GetTime();
+        pnode->nRecvBytes += nBytes;
+        pnode->RecordBytesRecv(nBytes);
+    }
+    else if (nBytes == 0)
+    {
+        // socket closed gracefully
+        if (!pnode->fDisconnect)
+            logDebug(Log::Net) << "socket closed";
+        pnode->CloseSocketDisconnect();
+    }
+    else if (nBytes < 0)
+    {
+        // error
+        int nErr = WSAGetLastError();
+        if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR && nErr != WSAEINPROGRESS)
+        {
+            if (!pnode->fDisconnect)
+                logDebug(Log::Net) << "socket recv error" <<  NetworkErrorString(nErr);
+            pnode->CloseSocketDisconnect();
+        }
+    }
+}
+
+static void CheckInactivity(CNode *pnode)
+{
+    int64_t nTime = GetTime();
+    if (nTime - pnode->nTimeConnected > 60) {
+        if (pnode->nLastRecv == 0 || pnode->nLastSend == 0) {
+            logInfo(Log::Net) << "socket no message in first 60 seconds," << (pnode->nLastRecv != 0) << (pnode->nLastSend != 0) << "from" << pnode->id;
+            pnode->markForDisconnect();
+        }
+        else if (nTime - pnode->nLastSend > TIMEOUT_INTERVAL) {
+            logWarning(Log::Net) << "socket sending timeout:" << (nTime - pnode->nLastSend);
+            pnode->markForDisconnect();
+        }
+        else if (nTime - pnode->nLastRecv > (pnode->nVersion > BIP0031_VERSION ? TIMEOUT_INTERVAL : 90*60)) {
+            logWarning(Log::Net) << "socket receive timeout:" << (nTime - pnode->nLastRecv);
+            pnode->markForDisconnect();
+        }
+        else if (pnode->nPingNonceSent && pnode->nPingUsecStart + TIMEOUT_INTERVAL * 1000000 < GetTimeMicros()) {
+            logWarning(Log::Net) << "ping timeout:" << (0.000001 * (GetTimeMicros() - pnode->nPingUsecStart));
+            pnode->markForDisconnect();
         }
+    }
+}
+
+#ifdef USE_EPOLL
+// requires LOCK(pnode->cs_vRecvMsg)
+static bool IsReceiveFlooded(CNode *pnode)
+{
+    return !pnode->vRecvMsg.empty() && pnode->vRecvMsg.front().complete()
+            && pnode->GetTotalRecvSize() > ReceiveFloodSize();
+}
+
+/*
+ * The epoll based socket handler.
+ * Instead of building fd-sets for all peers on every iteration we keep the
+ * sockets registered and only update a peer's interest when its state changes,
+ * which makes an iteration cost relative to the number of active peers.
+ */
+void ThreadSocketHandler()
+{
+    const int pollFd = pollInstance();
+    if (pollFd == -1) {
+        logFatal(Log::Net) << "Failed to create epoll instance" << NetworkErrorString(errno);
+        return;
+    }
+    for (ListenSocket& hListenSocket : vhListenSocket) {
+        // listen sockets use their ListenSocket as data, peers their CNode.
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.ptr = &hListenSocket;
+        if (epoll_ctl(pollFd, EPOLL_CTL_ADD, hListenSocket.socket, &event) != 0)
+            logCritical(Log::Net) << "Failed to add listen socket to epoll set" << NetworkErrorString(errno);
+    }
+
+    constexpr int MaxEvents = 256;
+    struct epoll_event events[MaxEvents];
+    unsigned int nPrevNodeCount = 0;
+    int64_t nLastInactivityCheck = 0;
+    while (true)
+    {
+        DisconnectNodes(nPrevNodeCount);
+
+        // A throttled node gets its receive interest back once the message
+        // handler thread has processed enough of its buffer.
+        for (auto iter = throttledNodes.begin(); iter != throttledNodes.end();) {
+            CNode *pnode = *iter;
+            TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
+            if (lockRecv && !IsReceiveFlooded(pnode)) {
+                setThrottled(pnode, false);
+                iter = throttledNodes.erase(iter);
+            } else {
+                ++iter;
+            }
+        }
+
+        const int nEvents = epoll_wait(pollFd, events, MaxEvents, 50);
+        boost::this_thread::interruption_point();
+        if (nEvents < 0) {
+            if (errno != EINTR) {
+                logDebug(Log::Net) << "socket epoll error" << NetworkErrorString(errno);
+                MilliSleep(50);
+            }
+            continue;
+        }
+
+        // nodes are only deleted in this thread, in DisconnectNodes(). And a closed
+        // socket is removed from the epoll set, so all nodes we get events for are valid.
+        for (int i = 0; i < nEvents; ++i) {
+            void *data = events[i].data.ptr;
+            auto listenSocket = std::find_if(vhListenSocket.begin(), vhListenSocket.end(),
+                    [data](const ListenSocket &ls) { return &ls == data; });
+            if (listenSocket != vhListenSocket.end()) {
+                if (listenSocket->socket != INVALID_SOCKET)
+                    AcceptConnection(*listenSocket);
+                continue;
+            }
+            CNode *pnode = static_cast<CNode*>(data);
+
+            //
+            // Receive
+            //
+            if (pnode->hSocket == INVALID_SOCKET)
+                continue;
+            if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+                TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
+                if (lockRecv) {
+                    ReceiveFromNode(pnode);
+                    if (IsReceiveFlooded(pnode) && throttledNodes.insert(pnode).second)
+                        setThrottled(pnode, true);
+                }
+            }
+
+            //
+            // Send
+            //
+            if (pnode->hSocket == INVALID_SOCKET)
+                continue;
+            if (events[i].events & EPOLLOUT) {
+                TRY_LOCK(pnode->cs_vSend, lockSend);
+                if (lockSend)
+                    SocketSendData(pnode);
+            }
+        }
+
+        //
+        // Inactivity checking, the timeouts are in seconds, so no need to do this more often.
+        //
+        const int64_t nTime = GetTime();
+        if (nTime != nLastInactivityCheck) {
+            nLastInactivityCheck = nTime;
+            LOCK(cs_vNodes);
+            for (CNode* pnode : vNodes)
+                CheckInactivity(pnode);
+        }
+    }
+}
+
+#else
+
+void ThreadSocketHandler()
+{
+    unsigned int nPrevNodeCount = 0;
+    while (true)
+    {
+        //
+        // Disconnect nodes
+        //
+        DisconnectNodes(nPrevNodeCount);
 
         //
         // Find which sockets have data to receive
@@ -1245,39 +1540,7 @@ void ThreadSocketHandler()
             {
                 TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
                 if (lockRecv)
-                {
-                    {
-                        // typical socket buffer is 8K-64K
-                        char pchBuf[0x10000];
-                        int nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
-                        if (nBytes > 0)
-                        {
-                            if (!pnode->ReceiveMsgBytes(pchBuf, nBytes))
-                                pnode->CloseSocketDisconnect();
-                            pnode->nLastRecv = GetTime();
-                            pnode->nRecvBytes += nBytes;
-                            pnode->RecordBytesRecv(nBytes);
-                        }
-                        else if (nBytes == 0)
-                        {
-                            // socket closed gracefully
-                            if (!pnode->fDisconnect)
-                                logDebug(Log::Net) << "socket closed";
-                            pnode->CloseSocketDisconnect();
-                        }
-                        else if (nBytes < 0)
-                        {
-                            // error
-                            int nErr = WSAGetLastError();
-                            if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR && nErr != WSAEINPROGRESS)
-                            {
-                                if (!pnode->fDisconnect)
-                                    logDebug(Log::Net) << "socket recv error" <<  NetworkErrorString(nErr);
-                                pnode->CloseSocketDisconnect();
-                            }
-                        }
-                    }
-                }
+                    ReceiveFromNode(pnode);
             }
 
             //
@@ -1295,25 +1558,7 @@ void ThreadSocketHandler()
             //
             // Inactivity checking
             //
-            int64_t nTime = GetTime();
-            if (nTime - pnode->nTimeConnected > 60) {
-                if (pnode->nLastRecv == 0 || pnode->nLastSend == 0) {
-                    logInfo(Log::Net) << "socket no message in first 60 seconds," << (pnode->nLastRecv != 0) << (pnode->nLastSend != 0) << "from" << pnode->id;
-                    pnode->fDisconnect = true;
-                }
-                else if (nTime - pnode->nLastSend > TIMEOUT_INTERVAL) {
-                    logWarning(Log::Net) << "socket sending timeout:" << (nTime - pnode->nLastSend);
-                    pnode->fDisconnect = true;
-                }
-                else if (nTime - pnode->nLastRecv > (pnode->nVersion > BIP0031_VERSION ? TIMEOUT_INTERVAL : 90*60)) {
-                    logWarning(Log::Net) << "socket receive timeout:" << (nTime - pnode->nLastRecv);
-                    pnode->fDisconnect = true;
-                }
-                else if (pnode->nPingNonceSent && pnode->nPingUsecStart + TIMEOUT_INTERVAL * 1000000 < GetTimeMicros()) {
-                    logWarning(Log::Net) << "ping timeout:" << (0.000001 * (GetTimeMicros() - pnode->nPingUsecStart));
-                    pnode->fDisconnect = true;
-                }
-            }
+            CheckInactivity(pnode);
         }
         {
             LOCK(cs_vNodes);
@@ -1322,6 +1567,7 @@ void ThreadSocketHandler()
         }
     }
 }
+#endif
 
 
 
@@ -1609,7 +1855,7 @@ void ThreadOpenConnections()
             // Disconnect a node that is not compatible if all outbound slots are full and we
             // have not yet connected to enough nodes.
             if (ptemp && autoConnectedOutboundNodes >= maxOutBound && nThinBlockCapable < minXThinNodes) {
-                ptemp->fDisconnect = true;
+                ptemp->markForDisconnect();
                 nDisconnects++;
                 logWarning(Log::Net).nospace() << "Not enough capable peers xthin ("
                                             << nThinBlockCapable << "/" << minXThinNodes
@@ -1790,11 +2036,14 @@ bool OpenNetworkConnection(const CAddress& addrConnect, CSemaphoreGrant *grantOu
 }
 
 
-void ThreadMessageHandler()
+/*
+ * Each message handler thread walks over all nodes and processes the ones that
+ * are not claimed by another handler thread. A single node is thus only ever
+ * handled by one thread at a time, keeping its messages in order, while a
+ * slow message (like serving a large block) only stalls that one peer.
+ */
+static void ThreadMessageHandler(int threadIndex)
 {
-    boost::mutex condition_mutex;
-    boost::unique_lock<boost::mutex> lock(condition_mutex);
-
     SetThreadPriority(THREAD_PRIORITY_BELOW_NORMAL);
     while (true)
     {
@@ -1807,12 +2056,18 @@ void ThreadMessageHandler()
                 pnode->AddRef();
             }
         }
+        // start at a different node in each thread to avoid them fighting over the same ones
+        if (!vNodesCopy.empty())
+            std::rotate(vNodesCopy.begin(), vNodesCopy.begin() + (threadIndex % vNodesCopy.size()), vNodesCopy.end());
 
         bool fSleep = true;
 
         for (CNode* pnode : vNodesCopy) {
             if (pnode->fDisconnect)
                 continue;
+            bool expected = false;
+            if (!pnode->fInMessageHandler.compare_exchange_strong(expected, true))
+                continue; // an other thread is handling this node
 
             // Receive messages
             {
@@ -1839,6 +2094,7 @@ void ThreadMessageHandler()
                 if (lockSend)
                     g_signals.SendMessages(pnode);
             }
+            pnode->fInMessageHandler = false;
             boost::this_thread::interruption_point();
         }
 
@@ -1848,11 +2104,36 @@ void ThreadMessageHandler()
                 pnode->Release();
         }
 
-        if (fSleep)
+        if (fSleep) {
+            boost::unique_lock<boost::mutex> lock(messageHandlerMutex);
             messageHandlerCondition.timed_wait(lock, boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(50));
+        }
     }
 }
 
+void RecordMessageProcessingTime(const std::string &command, int64_t micros)
+{
+    LOCK(cs_messageStats);
+    auto iter = messageStats.find(command);
+    if (iter == messageStats.end()) {
+        // only known types, we don't want peers to be able to grow this map
+        const auto &types = getAllNetMessageTypes();
+        const bool known = std::find(types.begin(), types.end(), command) != types.end();
+        iter = messageStats.insert(std::make_pair(known ? command : std::string("unknown"),
+                                                  MessageProcessingStats())).first;
+    }
+    MessageProcessingStats &stats = iter->second;
+    ++stats.count;
+    stats.totalMicros += micros;
+    stats.maxMicros = std::max(stats.maxMicros, micros);
+}
+
+std::map<std::string, MessageProcessingStats> GetMessageProcessingStats()
+{
+    LOCK(cs_messageStats);
+    return messageStats;
+}
+
 
 
 
@@ -2059,7 +2340,11 @@ void StartNode(boost::thread_group& threadGroup, CScheduler& scheduler)
     threadGroup.create_thread(std::bind(&TraceThread<void (*)()>, "opencon", &ThreadOpenConnections));
 
     // Process messages
-    threadGroup.create_thread(std::bind(&TraceThread<void (*)()>, "msghand", &ThreadMessageHandler));
+    const int messageHandlerThreads = std::max(1, static_cast<int>(GetArg("-msghandlerthreads", Settings::DefaultMessageHandlerThreads)));
+    for (int i = 0; i < messageHandlerThreads; ++i) {
+        threadGroup.create_thread(std::bind(&TraceThread<std::function<void()> >, "msghand",
+                                            std::function<void()>(std::bind(&ThreadMessageHandler, i))));
+    }
 
     // Dump network addresses
     scheduler.scheduleEvery(&DumpData, DUMP_ADDRESSES_INTERVAL);
@@ -2467,6 +2752,7 @@ CNode::CNode(SOCKET hSocketIn, const CAddress& addrIn, const std::string& addrNa
     fAutoOutbound = false;
     fSuccessfullyConnected = false;
     fDisconnect = false;
+    fInMessageHandler = false;
     nRefCount = 0;
     nSendSize = 0;
     nSendOffset = 0;
@@ -2487,6 +2773,7 @@ CNode::CNode(SOCKET hSocketIn, const CAddress& addrIn, const std::string& addrNa
     fPingQueued = false;
     nMinPingUsecTime = std::numeric_limits<int64_t>::max();
     thinBlockWaitingForTxns = -1;
+    fSupportsCompactBlocks = false;
 
     std::string xmledName;
     if (addrNameIn != "")
@@ -2510,6 +2797,11 @@ CNode::CNode(SOCKET hSocketIn, const CAddress& addrIn, const std::string& addrNa
 CNode::~CNode()
 {
     CloseSocket(hSocket);
+    if (fDisconnect) { // the socket handler may not have seen it yet
+        LOCK(cs_vNodesToDisconnect);
+        vNodesToDisconnect.erase(std::remove(vNodesToDisconnect.begin(), vNodesToDisconnect.end(), this),
+                                 vNodesToDisconnect.end());
+    }
 
     if (pfilter)
         delete pfilter;
@@ -32,7 +32,10 @@
 #include <sync.h>
 #include <uint256.h>
 
+#include <atomic>
 #include <deque>
+#include <map>
+#include <memory>
 
 #ifndef WIN32
 #include <arpa/inet.h>
@@ -47,6 +50,7 @@
 class CAddrMan;
 class CScheduler;
 class CNode;
+class PartialCompactBlock;
 
 namespace boost {
     class thread_group;
@@ -94,6 +98,18 @@ void StartNode(boost::thread_group& threadGroup, CScheduler& scheduler);
 bool StopNode();
 void SocketSendData(CNode *pnode);
 
+struct MessageProcessingStats
+{
+    uint64_t count = 0;
+    int64_t totalMicros = 0;
+    int64_t maxMicros = 0;
+};
+
+/** Record the time the message handler spent on a single \a command message. */
+void RecordMessageProcessingTime(const std::string &command, int64_t micros);
+/** Returns the accumulated processing times per message type. */
+std::map<std::string, MessageProcessingStats> GetMessageProcessingStats();
+
 typedef int NodeId;
 
 struct CombinerAll
@@ -322,10 +338,16 @@ public:
     uint64_t nSendBytes;
     std::deque<std::vector<char>> vSendMsg;
     CCriticalSection cs_vSend;
+    // socket handler poll state (epoll only), guarded by its own lock in net.cpp
+    uint32_t nPollEvents = 0;
+    bool fPollSendPending = false;
+    bool fPollThrottled = false;
 
     std::deque<CInv> vRecvGetData;
     std::deque<CNetMessage> vRecvMsg;
     CCriticalSection cs_vRecvMsg;
+    // claimed by one of the message handler threads, keeps the per-peer processing in order.
+    std::atomic<bool> fInMessageHandler;
     uint64_t nRecvBytes;
     int nRecvVersion;
 
@@ -349,7 +371,7 @@ public:
     bool fAutoOutbound; // any outbound node not connected with -addnode, connect-thinblock or -connect
     bool fNetworkNode; // any outbound node
     bool fSuccessfullyConnected;
-    bool fDisconnect;
+    bool fDisconnect; // use markForDisconnect() to set
     // We use fRelayTxes for two purposes -
     // a) it allows us to not relay tx invs before receiving the peer's version message
     // b) the peer may tell us in its version message that we should not relay tx invs
@@ -375,6 +397,11 @@ public:
     uint64_t nGetXBlockTxLastTime;  // The last time a get_xblocktx request was made
     // Xtreme Thinblocks: end section
 
+    // BIP152 compact blocks, set when the peer sent us a sendcmpct.
+    bool fSupportsCompactBlocks;
+    // the compact block we are waiting for a blocktxn on.
+    std::unique_ptr<PartialCompactBlock> partialCompactBlock;
+
     uint16_t addrFromPort;
 
 protected:
@@ -398,6 +425,9 @@ public:
     int nStartingHeight;
 
     // flood relay
+    // Other nodes' message handlers relay addresses to us, cs_addr protects
+    // vAddrToSend and addrKnown.
+    CCriticalSection cs_addr;
     std::vector<CAddress> vAddrToSend;
     CRollingBloomFilter addrKnown;
     bool fGetAddr;
@@ -498,6 +528,7 @@ public:
 
     void AddAddressKnown(const CAddress& addr)
     {
+        LOCK(cs_addr);
         addrKnown.insert(addr.GetKey());
     }
 
@@ -506,6 +537,7 @@ public:
         // Known checking here is only to save space from duplicates.
         // SendMessages will filter it again for knowns that were added
         // after addresses were pushed.
+        LOCK(cs_addr);
         if (addr.IsValid() && !addrKnown.contains(addr.GetKey())) {
             if (vAddrToSend.size() >= MAX_ADDR_TO_SEND) {
                 vAddrToSend[insecure_rand() % vAddrToSend.size()] = addr;
@@ -712,6 +744,8 @@ public:
     }
 
     void CloseSocketDisconnect();
+    /// Have the socket handler thread disconnect this node.
+    void markForDisconnect();
 
     // Denial-of-service detection/prevention
     // The idea is to detect peers that are behaving
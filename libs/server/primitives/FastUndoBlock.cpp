@@ -1,6 +1,6 @@
 /*
  * This file is part of the Flowee project
- * Copyright (C) 2017,2019 Tom Zander <tom@flowee.org>
+ * Copyright (C) 2017-2021 Tom Zander <tom@flowee.org>
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -22,9 +22,27 @@
 #include <streaming/MessageBuilder.h>
 #include <streaming/BufferPool.h>
 
+#include <algorithm>
+
 enum UndoBlockSpec
 {
     End = 0,
+
+    // Version 2 tags. Version 1 never uses these.
+    Version,
+    /// starts a group of outputs created by this txid, that when undone will be removed
+    RMGroupTxId,
+    /// starts a group of outputs spent from this txid, that when undone will be re-inserted.
+    InsGroupTxId,
+    /// the block height of the group relative to the previous group. Omitted when unchanged.
+    InsHeightDelta,
+    /// the offset in block of the group. Relative to the previous group if the height is unchanged.
+    InsOffset,
+    /// the amount of output-indexes skipped before the next run.
+    OutIndexGap,
+    /// the amount of consecutive output-indexes in this run.
+    OutIndexCount,
+
     StartBlock = 0x10, // with block-hash as arg
     /// an item that was inserted into the UTXO, that when undone will be removed
     RMTxId,
@@ -37,13 +55,115 @@ enum UndoBlockSpec
 };
 
 
+namespace {
+bool itemPositionLessThan(const FastUndoBlock::Item *a, const FastUndoBlock::Item *b)
+{
+    if (a->blockHeight != b->blockHeight)
+        return a->blockHeight < b->blockHeight;
+    if (a->offsetInBlock != b->offsetInBlock)
+        return a->offsetInBlock < b->offsetInBlock;
+    if (a->prevTxId != b->prevTxId)
+        return a->prevTxId < b->prevTxId;
+    return a->outputIndex < b->outputIndex;
+}
+
+// Writes the output indexes of a group as runs of consecutive numbers.
+class IndexRunWriter
+{
+public:
+    IndexRunWriter(Streaming::MessageBuilder &builder) : m_builder(builder) {}
+
+    void startGroup() {
+        flush();
+        m_expected = 0;
+    }
+    void add(int outputIndex) {
+        if (outputIndex != m_expected) {
+            flush();
+            m_builder.add(OutIndexGap, outputIndex - m_expected);
+        }
+        ++m_runLength;
+        m_expected = outputIndex + 1;
+    }
+    void flush() {
+        if (m_runLength > 0)
+            m_builder.add(OutIndexCount, m_runLength);
+        m_runLength = 0;
+    }
+
+private:
+    Streaming::MessageBuilder &m_builder;
+    int m_expected = 0;
+    int m_runLength = 0;
+};
+}
+
 FastUndoBlock::FastUndoBlock(const Streaming::ConstBuffer &rawBlock)
     : m_data(rawBlock),
       m_parser(m_data)
 {
+    readHeader();
+}
+
+void FastUndoBlock::readHeader()
+{
+    m_version = 1;
+    m_height = 0;
+    m_offset = 0;
+    m_remaining = 0;
+    // both versions start with the block-id, only version 2 and later follow that with a version.
+    bool ok;
+    if (m_parser.peekNext(&ok) != StartBlock || !ok)
+        return;
+    m_parser.next();
+    if (m_parser.peekNext(&ok) == Version && ok) {
+        m_parser.next();
+        m_version = std::max(2, m_parser.intData());
+    }
 }
 
 FastUndoBlock::Item FastUndoBlock::nextItem()
+{
+    if (m_version == 1)
+        return nextItemV1();
+
+    while (m_remaining <= 0) {
+        if (m_parser.next() != Streaming::FoundTag)
+            return Item();
+        switch (m_parser.tag()) {
+        case End:
+            return Item();
+        case RMGroupTxId:
+        case InsGroupTxId:
+            m_groupTxId = m_parser.uint256Data();
+            m_groupIsInsert = m_parser.tag() == RMGroupTxId;
+            m_heightChanged = false;
+            m_nextIndex = 0;
+            break;
+        case InsHeightDelta:
+            m_height += m_parser.intData();
+            m_heightChanged = true;
+            break;
+        case InsOffset:
+            m_offset = m_heightChanged ? m_parser.intData() : m_offset + m_parser.intData();
+            break;
+        case OutIndexGap:
+            m_nextIndex += m_parser.intData();
+            break;
+        case OutIndexCount:
+            m_remaining = m_parser.intData();
+            break;
+        default:
+            break;
+        }
+    }
+    --m_remaining;
+    if (m_groupIsInsert)
+        return Item(m_groupTxId, m_nextIndex++);
+    return Item(m_groupTxId, m_nextIndex++, m_height, m_offset);
+}
+
+FastUndoBlock::Item FastUndoBlock::nextItemV1()
 {
     FastUndoBlock::Item answer;
     auto type = m_parser.next();
@@ -82,6 +202,7 @@ FastUndoBlock::Item FastUndoBlock::nextItem()
 void FastUndoBlock::restartStream()
 {
     m_parser = Streaming::MessageParser(m_data);
+    readHeader();
 }
 
 UndoBlockBuilder::UndoBlockBuilder(const uint256 &blockId, Streaming::BufferPool *pool)
@@ -93,6 +214,7 @@ UndoBlockBuilder::UndoBlockBuilder(const uint256 &blockId, Streaming::BufferPool
     m_pool->reserve(40);
     Streaming::MessageBuilder builder(*m_pool);
     builder.add(StartBlock, blockId);
+    builder.add(Version, 2);
     m_data.push_back(builder.buffer());
 }
 
@@ -106,17 +228,48 @@ void UndoBlockBuilder::append(const std::deque<FastUndoBlock::Item> &items)
 {
     m_pool->reserve(items.size() * 60);
     Streaming::MessageBuilder builder(*m_pool);
-    for (auto item : items) {
-        if (item.isInsert()) { // in undo that means we remember the reverse action
-            builder.add(RMTxId, item.prevTxId);
-            builder.add(RMTxOutIndex, item.outputIndex);
-        } else {
-            builder.add(InsTxId, item.prevTxId);
-            builder.add(InsTxOutIndex, item.outputIndex);
-            builder.add(InsBlockHeight, item.blockHeight);
-            builder.add(InsOffsetInBlock, item.offsetInBlock);
+    IndexRunWriter indexes(builder);
+
+    // The outputs a transaction created are consecutive, which makes them a single
+    // group with typically a single run.
+    std::vector<const FastUndoBlock::Item*> deleted;
+    const uint256 *groupTxId = nullptr;
+    for (const auto &item : items) {
+        if (!item.isInsert()) {
+            deleted.push_back(&item);
+            continue;
+        }
+        if (groupTxId == nullptr || *groupTxId != item.prevTxId) {
+            indexes.startGroup();
+            builder.add(RMGroupTxId, item.prevTxId);
+            groupTxId = &item.prevTxId;
+        }
+        indexes.add(item.outputIndex);
+    }
+    indexes.flush();
+
+    // Spent outputs are sorted by their position in the chain, this groups the outputs
+    // of a single transaction and makes the deltas between groups small.
+    std::sort(deleted.begin(), deleted.end(), &itemPositionLessThan);
+    const FastUndoBlock::Item *group = nullptr;
+    for (const auto *item : deleted) {
+        if (group == nullptr || group->prevTxId != item->prevTxId
+                || group->blockHeight != item->blockHeight || group->offsetInBlock != item->offsetInBlock) {
+            indexes.startGroup();
+            builder.add(InsGroupTxId, item->prevTxId);
+            if (item->blockHeight != m_lastHeight) {
+                builder.add(InsHeightDelta, item->blockHeight - m_lastHeight);
+                builder.add(InsOffset, item->offsetInBlock);
+            } else {
+                builder.add(InsOffset, item->offsetInBlock - m_lastOffset);
+            }
+            m_lastHeight = item->blockHeight;
+            m_lastOffset = item->offsetInBlock;
+            group = item;
         }
+        indexes.add(item->outputIndex);
     }
+    indexes.flush();
     m_data.push_back(builder.buffer());
 }
 
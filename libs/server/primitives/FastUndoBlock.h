@@ -1,6 +1,6 @@
 /*
  * This file is part of the Flowee project
- * Copyright (C) 2017,2019 Tom Zander <tom@flowee.org>
+ * Copyright (C) 2017-2021 Tom Zander <tom@flowee.org>
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -28,6 +28,15 @@
 
 class CBlockUndo;
 
+/**
+ * The undo data for a block, as stored in the rev?????.dat files.
+ *
+ * The undo block lists all the changes the block made to the UTXO and it is read back
+ * as a stream of items using nextItem().
+ * Version 1 stores each item as separate tagged fields. Version 2 (written since 2021)
+ * groups the items per txid, run-length encodes the output-indexes and delta-encodes
+ * the block heights and offsets. Both versions can be read.
+ */
 class FastUndoBlock
 {
 public:
@@ -66,19 +75,46 @@ public:
         return m_data;
     }
 
+    /// Returns the next item, or an invalid item at the end of the stream.
     Item nextItem();
     void restartStream();
 
+    /// Returns the format version of this undo block, 1 or 2.
+    inline int version() const {
+        return m_version;
+    }
+
 private:
+    void readHeader();
+    Item nextItemV1();
+
     Streaming::ConstBuffer m_data;
     Streaming::MessageParser m_parser;
+    int m_version = 1;
+
+    // state for the version 2 stream
+    uint256 m_groupTxId;
+    bool m_groupIsInsert = false;
+    bool m_heightChanged = false;
+    int m_height = 0;
+    int m_offset = 0;
+    int m_nextIndex = 0;
+    int m_remaining = 0;
 };
 
+/**
+ * Creates an undo block (in the version 2 format) from the items gathered during validation.
+ */
 class UndoBlockBuilder {
 public:
     UndoBlockBuilder(const uint256 &blockId, Streaming::BufferPool *pool = nullptr);
     ~UndoBlockBuilder();
 
+    /**
+     * Append a chunk of items.
+     * Notice that the order of items is not preserved, inserted items are written first and
+     * deleted items are sorted by their position in the chain.
+     */
     void append(const std::deque<FastUndoBlock::Item> &items);
 
     std::deque<Streaming::ConstBuffer> finish() const;
@@ -87,6 +123,9 @@ private:
     Streaming::BufferPool *m_pool;
     std::deque<Streaming::ConstBuffer> m_data;
     bool m_ownsPool;
+    // the deltas are relative to the previous group, also between chunks.
+    int m_lastHeight = 0;
+    int m_lastOffset = 0;
 };
 
 #endif
@@ -56,6 +56,10 @@ const char *XBLOCKTX="xblocktx";
 const char *GET_XBLOCKTX="get_xblocktx";
 const char *GET_XTHIN="get_xthin";
 // BUIP010 Xtreme Thinblocks - end section
+const char *SENDCMPCT="sendcmpct";
+const char *CMPCTBLOCK="cmpctblock";
+const char *GETBLOCKTXN="getblocktxn";
+const char *BLOCKTXN="blocktxn";
 const char *VERSION2="buversion"; // unfortunately the unlimited team wasn't very creative with naming.
 const char *VERACK2="buverack";
 const char *XPEDITEDREQUEST="req_xpedited";
@@ -97,6 +101,10 @@ const static std::string allNetMessageTypes[] = {
     NetMsgType::GET_XBLOCKTX,
     NetMsgType::GET_XTHIN,
     // BUIP010 Xtreme Thinbocks - end section
+    NetMsgType::SENDCMPCT,
+    NetMsgType::CMPCTBLOCK,
+    NetMsgType::GETBLOCKTXN,
+    NetMsgType::BLOCKTXN,
     NetMsgType::VERSION2,
     NetMsgType::VERACK2,
     NetMsgType::XPEDITEDREQUEST,
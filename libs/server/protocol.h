@@ -169,6 +169,23 @@ extern const char *GET_XBLOCKTX;
  * The get_xthin message transmits a single serialized get_xthin.
  */
 extern const char *GET_XTHIN;
+/**
+ * The sendcmpct message announces the peer wants to receive compact blocks.
+ * @since protocol version 70014 as described by BIP152.
+ */
+extern const char *SENDCMPCT;
+/**
+ * The cmpctblock message transmits a block header with short transaction ids.
+ */
+extern const char *CMPCTBLOCK;
+/**
+ * The getblocktxn message requests the transactions missing to rebuild a compact block.
+ */
+extern const char *GETBLOCKTXN;
+/**
+ * The blocktxn message answers a getblocktxn with the requested transactions.
+ */
+extern const char *BLOCKTXN;
 
 /**
  * The getaddr message requests an addr message from the receiving node,
@@ -402,6 +419,8 @@ enum {
     // BUIP010 Xtreme Thinblocks: an Xtreme thin block contains the first 8 bytes of all the tx hashes 
     // and also provides the missing transactions that are needed at the other end to reconstruct the block
     MSG_XTHINBLOCK,
+    // BIP152: a compact block. Shares its value with the (unused) MSG_THINBLOCK.
+    MSG_CMPCT_BLOCK = MSG_THINBLOCK,
 
     MSG_DOUBLESPENDPROOF = 0x94a0
 };
@@ -603,7 +603,14 @@ UniValue getblockchaininfo(const UniValue& params, bool fHelp)
             "        \"id\": \"xxxx\",        (string) name of the softfork\n"
             "        \"status\": \"xxxx\",    (string) one of \"defined\", \"started\", \"lockedin\", \"active\", \"failed\"\n"
             "     }\n"
-            "  ]\n"
+            "  ],\n"
+            "  \"pagefaults\": {          (object) major page-faults while reading blocks from disk\n"
+            "     \"sequential\": {         (object) reads of whole blocks, front to back\n"
+            "        \"operations\": xx,    (numeric) number of counted read operations\n"
+            "        \"majorfaults\": xx,   (numeric) page faults that had to wait for the disk\n"
+            "     },\n"
+            "     \"other\": { ... }        (object) other reads, like point lookups (same fields as \"sequential\")\n"
+            "  }\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getblockchaininfo", "")
@@ -624,6 +631,16 @@ UniValue getblockchaininfo(const UniValue& params, bool fHelp)
     obj.push_back(Pair("initialblockdownload",
         (Blocks::DB::instance()->headerChain().Height() - chainActive.Height() > 1000)));
     obj.push_back(Pair("pruned",                false));
+
+    UniValue pageFaults(UniValue::VOBJ);
+    for (auto pattern : { Blocks::SequentialAccess, Blocks::NormalAccess }) {
+        const Blocks::PageFaultStats stats = Blocks::DB::instance()->pageFaultStats(pattern);
+        UniValue item(UniValue::VOBJ);
+        item.push_back(Pair("operations", stats.operations));
+        item.push_back(Pair("majorfaults", stats.majorFaults));
+        pageFaults.push_back(Pair(pattern == Blocks::SequentialAccess ? "sequential" : "other", item));
+    }
+    obj.push_back(Pair("pagefaults",            pageFaults));
     return obj;
 }
 
@@ -251,7 +251,7 @@ UniValue disconnectnode(const UniValue& params, bool fHelp)
     if (pNode == NULL)
         throw JSONRPCError(RPC_CLIENT_NODE_NOT_CONNECTED, "Node not found in connected nodes");
 
-    pNode->fDisconnect = true;
+    pNode->markForDisconnect();
 
     return NullUniValue;
 }
@@ -392,6 +392,14 @@ UniValue getnettotals(const UniValue& params, bool fHelp)
             "    \"serve_historical_blocks\": true|false,  (boolean) True if serving historical blocks\n"
             "    \"bytes_left_in_cycle\": t,               (numeric) Bytes left in current time cycle\n"
             "    \"time_left_in_cycle\": t                 (numeric) Seconds left in current time cycle\n"
+            "  },\n"
+            "  \"messages\":\n"
+            "  {\n"
+            "    \"command\": {                              (object) Processing times for this message type\n"
+            "      \"count\": n,                             (numeric) Number of messages processed\n"
+            "      \"totalmicros\": n,                       (numeric) Total processing time in microseconds\n"
+            "      \"maxmicros\": n                          (numeric) Longest processing time in microseconds\n"
+            "    }, ...\n"
             "  }\n"
             "}\n"
             "\nExamples:\n"
@@ -412,6 +420,16 @@ UniValue getnettotals(const UniValue& params, bool fHelp)
     outboundLimit.push_back(Pair("bytes_left_in_cycle", CNode::GetOutboundTargetBytesLeft()));
     outboundLimit.push_back(Pair("time_left_in_cycle", CNode::GetMaxOutboundTimeLeftInCycle()));
     obj.push_back(Pair("uploadtarget", outboundLimit));
+
+    UniValue messages(UniValue::VOBJ);
+    for (const auto &item : GetMessageProcessingStats()) {
+        UniValue stats(UniValue::VOBJ);
+        stats.push_back(Pair("count", item.second.count));
+        stats.push_back(Pair("totalmicros", item.second.totalMicros));
+        stats.push_back(Pair("maxmicros", item.second.maxMicros));
+        messages.push_back(Pair(item.first, stats));
+    }
+    obj.push_back(Pair("messages", messages));
     return obj;
 }
 
@@ -556,7 +574,7 @@ UniValue setban(const UniValue& params, bool fHelp)
 
         //disconnect possible nodes
         while(CNode *bannedNode = (isSubnet ? FindNode(subNet) : FindNode(netAddr)))
-            bannedNode->fDisconnect = true;
+            bannedNode->markForDisconnect();
     }
     else if(strCommand == "remove")
     {
@@ -18,110 +18,40 @@
 
 #include "scheduler.h"
 
-#include <cassert>
-#include <boost/thread/reverse_lock.hpp>
-#include <utility>
+// tasks are scheduled in seconds, a quarter second resolution is plenty.
+static constexpr int TickMs = 250;
 
-CScheduler::CScheduler() : nThreadsServicingQueue(0), stopRequested(false), stopWhenEmpty(false)
+CScheduler::CScheduler(boost::asio::io_service &service)
+    : m_wheel(service, TickMs)
 {
 }
 
 CScheduler::~CScheduler()
 {
-    assert(nThreadsServicingQueue == 0);
 }
 
-void CScheduler::serviceQueue()
+CScheduler::Handle CScheduler::schedule(CScheduler::Function f, boost::chrono::system_clock::time_point t)
 {
-    boost::unique_lock<boost::mutex> lock(newTaskMutex);
-    ++nThreadsServicingQueue;
-
-    // newTaskMutex is locked throughout this loop EXCEPT
-    // when the thread is waiting or when the user's function
-    // is called.
-    while (!shouldStop()) {
-        try {
-            while (!shouldStop() && taskQueue.empty()) {
-                // Wait until there is something to do.
-                newTaskScheduled.wait(lock);
-            }
-
-            // Wait until either there is a new task, or until
-            // the time of the first item on the queue:
-
-            // Some boost versions have a conflicting overload of wait_until that returns void.
-            // Explicitly use a template here to avoid hitting that overload.
-            while (!shouldStop() && !taskQueue.empty() &&
-                   newTaskScheduled.wait_until<>(lock, taskQueue.begin()->first) != boost::cv_status::timeout) {
-                // Keep waiting until timeout
-            }
-            // If there are multiple threads, the queue can empty while we're waiting (another
-            // thread may service the task we were waiting on).
-            if (shouldStop() || taskQueue.empty())
-                continue;
-
-            Function f = taskQueue.begin()->second;
-            taskQueue.erase(taskQueue.begin());
-
-            {
-                // Unlock before calling f, so it can reschedule itself or another task
-                // without deadlocking:
-                boost::reverse_lock<boost::unique_lock<boost::mutex> > rlock(lock);
-                f();
-            }
-        } catch (...) {
-            --nThreadsServicingQueue;
-            throw;
-        }
-    }
-    --nThreadsServicingQueue;
-}
-
-void CScheduler::stop(bool drain)
-{
-    {
-        boost::unique_lock<boost::mutex> lock(newTaskMutex);
-        if (drain)
-            stopWhenEmpty = true;
-        else
-            stopRequested = true;
-    }
-    newTaskScheduled.notify_all();
-}
-
-void CScheduler::schedule(CScheduler::Function f, boost::chrono::system_clock::time_point t)
-{
-    {
-        boost::unique_lock<boost::mutex> lock(newTaskMutex);
-        taskQueue.insert(std::make_pair(t, f));
-    }
-    newTaskScheduled.notify_one();
+    const auto delay = boost::chrono::duration_cast<boost::chrono::milliseconds>(t - boost::chrono::system_clock::now());
+    return m_wheel.schedule(f, std::max<int64_t>(0, delay.count()));
 }
 
-void CScheduler::scheduleFromNow(CScheduler::Function f, int64_t deltaSeconds)
+CScheduler::Handle CScheduler::scheduleFromNow(CScheduler::Function f, int64_t deltaSeconds)
 {
-    schedule(f, boost::chrono::system_clock::now() + boost::chrono::seconds(deltaSeconds));
+    return m_wheel.schedule(f, deltaSeconds * 1000);
 }
 
-static void Repeat(CScheduler* s, CScheduler::Function f, int64_t deltaSeconds)
+CScheduler::Handle CScheduler::scheduleEvery(CScheduler::Function f, int64_t deltaSeconds)
 {
-    f();
-    s->scheduleFromNow(std::bind(&Repeat, s, f, deltaSeconds), deltaSeconds);
+    return m_wheel.scheduleEvery(f, deltaSeconds * 1000);
 }
 
-void CScheduler::scheduleEvery(CScheduler::Function f, int64_t deltaSeconds)
+void CScheduler::stop()
 {
-    scheduleFromNow(std::bind(&Repeat, this, f, deltaSeconds), deltaSeconds);
+    m_wheel.stop();
 }
 
-size_t CScheduler::getQueueInfo(boost::chrono::system_clock::time_point &first,
-                             boost::chrono::system_clock::time_point &last) const
+size_t CScheduler::taskCount() const
 {
-    boost::unique_lock<boost::mutex> lock(newTaskMutex);
-    size_t result = taskQueue.size();
-    if (!taskQueue.empty()) {
-        first = taskQueue.begin()->first;
-        last = taskQueue.rbegin()->first;
-    }
-    return result;
+    return m_wheel.size();
 }
@@ -19,79 +19,61 @@
 #ifndef FLOWEE_SCHEDULER_H
 #define FLOWEE_SCHEDULER_H
 
-//
-// NOTE:
-// boost::thread / boost::function / boost::chrono should be ported to
-// std::thread / std::function / std::chrono when we support C++11.
-//
-#include <boost/function.hpp>
+#include <TimerWheel.h>
+
 #include <boost/chrono/chrono.hpp>
-#include <boost/thread.hpp>
-#include <map>
 
 //
 // Simple class for background tasks that should be run
 // periodically or once "after a while"
 //
+// The tasks are run on the io_service passed in the constructor, typically
+// the one owned by the Application. There is no thread dedicated to the
+// scheduler, the timer-wheel only wakes up when a task expires.
+//
 // Usage:
 //
-// CScheduler* s = new CScheduler();
-// s->scheduleFromNow(doSomething, 11); // Assuming a: void doSomething() { }
-// s->scheduleFromNow(std::bind(Class::func, this, argument), 3);
-// boost::thread* t = new boost::thread(std::bind(CScheduler::serviceQueue, s));
+// CScheduler s(Application::instance()->ioService());
+// s.scheduleFromNow(doSomething, 11); // Assuming a: void doSomething() { }
+// auto handle = s.scheduleEvery(std::bind(Class::func, this, argument), 3);
+// handle.cancel(); // stop running the periodic task.
 //
-// ... then at program shutdown, clean up the thread running serviceQueue:
-// t->interrupt();
-// t->join();
-// delete t;
-// delete s; // Must be done after thread is interrupted/joined.
+// ... then at program shutdown, before the io_service stops:
+// s.stop();
 //
 
 class CScheduler
 {
 public:
-    CScheduler();
+    explicit CScheduler(boost::asio::io_service &service);
     ~CScheduler();
 
-    typedef boost::function<void(void)> Function;
+    typedef TimerWheel::Function Function;
+    typedef TimerWheel::Handle Handle;
 
     // Call func at/after time t
-    void schedule(Function f, boost::chrono::system_clock::time_point t);
+    Handle schedule(Function f, boost::chrono::system_clock::time_point t);
 
     // Convenience method: call f once deltaSeconds from now
-    void scheduleFromNow(Function f, int64_t deltaSeconds);
+    Handle scheduleFromNow(Function f, int64_t deltaSeconds);
 
     // Another convenience method: call f approximately
     // every deltaSeconds forever, starting deltaSeconds from now.
     // To be more precise: every time f is finished, it
     // is rescheduled to run deltaSeconds later. If you
     // need more accurate scheduling, don't use this method.
-    void scheduleEvery(Function f, int64_t deltaSeconds);
-
-    // To keep things as simple as possible, there is no unschedule.
-
-    // Services the queue 'forever'. Should be run in a thread,
-    // and interrupted using boost::interrupt_thread
-    void serviceQueue();
+    Handle scheduleEvery(Function f, int64_t deltaSeconds);
 
-    // Tell any threads running serviceQueue to stop as soon as they're
-    // done servicing whatever task they're currently servicing (drain=false)
-    // or when there is no work left to be done (drain=true)
-    void stop(bool drain=false);
+    // Cancel all tasks, no new ones will be started. Tasks that are
+    // running at this time are allowed to finish, stop() returns after
+    // they did.
+    void stop();
 
-    // Returns number of tasks waiting to be serviced,
-    // and first and last task times
-    size_t getQueueInfo(boost::chrono::system_clock::time_point &first,
-                        boost::chrono::system_clock::time_point &last) const;
+    // Returns number of tasks waiting to be serviced
+    size_t taskCount() const;
 
 private:
-    std::multimap<boost::chrono::system_clock::time_point, Function> taskQueue;
-    boost::condition_variable newTaskScheduled;
-    mutable boost::mutex newTaskMutex;
-    int nThreadsServicingQueue;
-    bool stopRequested;
-    bool stopWhenEmpty;
-    bool shouldStop() { return stopRequested || (stopWhenEmpty && taskQueue.empty()); }
+    TimerWheel m_wheel;
 };
 
 #endif
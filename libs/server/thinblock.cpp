@@ -37,6 +37,10 @@
 #include <boost/thread.hpp>
 #include <boost/lexical_cast.hpp>
 
+// the message handler runs in multiple threads, these protect the globals below.
+static CCriticalSection cs_thinBlockTimer;
+static CCriticalSection cs_xpedited;
+
 std::map<uint256, uint64_t> mapThinBlockTimer;
 
 std::vector<CNode*> xpeditedBlk; // Who requested expedited blocks from us
@@ -87,9 +91,8 @@ bool CXThinBlock::process(CNode* pfrom)
 
     std::map<uint64_t, uint256> orphanLookup;
     {
-        auto orphans = CTxOrphanCache::instance()->mapOrphanTransactions();
-        BOOST_FOREACH (auto iter, orphans) {
-            orphanLookup.insert(std::make_pair(iter.first.GetCheapHash(), iter.first));
+        for (const uint256 &txid : CTxOrphanCache::instance()->fetchTransactionIds()) {
+            orphanLookup.insert(std::make_pair(txid.GetCheapHash(), txid));
         }
     }
 
@@ -137,9 +140,12 @@ bool CXThinBlock::process(CNode* pfrom)
             auto foundInOrphan = orphanLookup.find(cheapHash);
             if (foundInOrphan != orphanLookup.end()) {
                 if (tx.IsNull()) {
-                    bool found = CTxOrphanCache::value(foundInOrphan->second, tx);
-                    if (found) // a race condition may have caused it to be removed from the orphans cache
+                    Tx orphan;
+                    // a race condition may have caused it to be removed from the orphans cache
+                    if (CTxOrphanCache::value(foundInOrphan->second, orphan)) {
+                        tx = orphan.createOldTransaction();
                         orphansUsed.push_back(foundInOrphan->second);
+                    }
                 } else {
                     ++collisionCount;
                 }
@@ -231,6 +237,7 @@ bool HaveThinblockNodes()
 
 bool CheckThinblockTimer(const uint256 &hash)
 {
+    LOCK(cs_thinBlockTimer);
     if (!mapThinBlockTimer.count(hash)) {
         mapThinBlockTimer[hash] = GetTimeMillis();
         LogPrint("thin", "Starting Preferential Thinblock timer\n");
@@ -306,7 +313,10 @@ void HandleBlockMessage(CNode *pfrom, const std::string &strCommand, const CBloc
         Validation::ForwardGoodToPeers | Validation::SaveGoodToDisk | Validation::PunishBadNode, pfrom);
 
     // Clear the thinblock timer used for preferential download
-    mapThinBlockTimer.erase(inv.hash);
+    {
+        LOCK(cs_thinBlockTimer);
+        mapThinBlockTimer.erase(inv.hash);
+    }
 
     // settings.setPreApprovedTx(vector<int>) // TODO
     // settings.setIsReassembledBlock(true); // TODO, avoid punishing a peer when the error is only merkle-root based
@@ -378,6 +388,7 @@ void HandleBlockMessage(CNode *pfrom, const std::string &strCommand, const CBloc
 
 void CheckAndRequestExpeditedBlocks(CNode* pfrom)
 {
+    LOCK(cs_xpedited);
     if (pfrom->nVersion >= EXPEDITED_VERSION) {
         BOOST_FOREACH(std::string& strAddr, mapMultiArgs["-expeditedblock"]) {
             // Add the peer's listening port if it is empty
@@ -417,6 +428,7 @@ void CheckAndRequestExpeditedBlocks(CNode* pfrom)
 
 void SendExpeditedBlock(CXThinBlock& thinBlock, unsigned char hops, const CNode* skip)
 {
+    LOCK(cs_xpedited);
     std::vector<CNode*>::iterator end = xpeditedBlk.end();
     for (std::vector<CNode*>::iterator it = xpeditedBlk.begin(); it != end; it++) {
         CNode* node = *it;
@@ -442,7 +454,7 @@ void SendExpeditedBlock(const CBlock& block,const CNode* skip)
 }
 void HandleExpeditedRequest(CDataStream& vRecv,CNode* pfrom)
 {
-    // TODO locks
+    LOCK(cs_xpedited);
     uint64_t options;
     vRecv >> options;
     bool stop = ((options & EXPEDITED_STOP) != 0);  // Are we starting or stopping expedited service?
@@ -525,6 +537,7 @@ int xpeditedBlkSendPos=0;
 
 bool IsRecentlyExpeditedAndStore(const uint256& hash)
 {
+    LOCK(cs_xpedited);
     for (int i=0;i<NUM_XPEDITED_STORE;i++)
         if (xpeditedBlkSent[i]==hash) return true;
     xpeditedBlkSent[xpeditedBlkSendPos] = hash;
@@ -24,6 +24,8 @@
 
 #include "scheduler.h"
 
+#include <boost/thread.hpp>
+
 void StartTorControl(boost::thread_group& threadGroup, CScheduler& scheduler);
 void InterruptTorControl();
 void StopTorControl();
@@ -404,6 +404,7 @@ void CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
     // (When we update the entry for in-mempool parents, memory usage will be
     // further updated.)
     cachedInnerUsage += entry.DynamicMemoryUsage();
+    updateScriptHashIndex(newit, true);
 
     const CTransaction& tx = newit->GetTx();
     std::set<uint256> setParentTransactions;
@@ -536,6 +537,7 @@ void CTxMemPool::removeUnchecked(txiter it)
         m_dspStorage->remove(it->dsproof);
     for (const CTxIn& txin : it->GetTx().vin)
         mapNextTx.erase(txin.prevout);
+    updateScriptHashIndex(it, false);
 
     totalTxSize -= it->GetTxSize();
     cachedInnerUsage -= it->DynamicMemoryUsage();
@@ -683,6 +685,7 @@ void CTxMemPool::_clear()
     mapLinks.clear();
     mapTx.clear();
     mapNextTx.clear();
+    m_scriptHashIndex.clear();
     totalTxSize = 0;
     cachedInnerUsage = 0;
     ++nTransactionsUpdated;
@@ -784,7 +787,52 @@ bool CTxMemPool::HasNoInputsOf(const CTransaction &tx) const
 size_t CTxMemPool::DynamicMemoryUsage() const {
     LOCK(cs);
     // Estimate the overhead of mapTx to be 12 pointers + an allocation, as no exact formula for boost::multi_index_contained is implemented.
-    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 12 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(mapLinks) + cachedInnerUsage;
+    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 12 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(mapLinks) + memusage::DynamicUsage(m_scriptHashIndex) + cachedInnerUsage;
+}
+
+std::vector<CTxMemPool::ScriptHashMatch> CTxMemPool::findByScriptHash(const uint256 &scriptHash, size_t maxResults) const
+{
+    AssertLockHeld(cs);
+    std::vector<ScriptHashMatch> answer;
+    auto range = m_scriptHashIndex.equal_range(scriptHash);
+    for (auto iter = range.first; iter != range.second && answer.size() < maxResults; ++iter) {
+        answer.push_back(iter->second);
+    }
+    return answer;
+}
+
+void CTxMemPool::updateScriptHashIndex(txiter entry, bool add)
+{
+    Tx::Iterator iter(entry->tx);
+    int outIndex = 0;
+    int64_t amount = 0;
+    try {
+        auto type = iter.next();
+        while (type != Tx::End) {
+            if (type == Tx::OutputValue) {
+                amount = iter.longData();
+            }
+            else if (type == Tx::OutputScript) {
+                const uint256 hash = iter.hashedByteData();
+                if (add) {
+                    m_scriptHashIndex.insert(std::make_pair(hash, ScriptHashMatch { entry, outIndex, amount }));
+                } else {
+                    auto range = m_scriptHashIndex.equal_range(hash);
+                    for (auto i = range.first; i != range.second;) {
+                        if (i->second.entry == entry)
+                            i = m_scriptHashIndex.erase(i);
+                        else
+                            ++i;
+                    }
+                }
+                ++outIndex;
+            }
+            type = iter.next();
+        }
+    } catch (const std::runtime_error &) {
+        // Only unvalidated transactions (as used in unit tests) can fail to parse.
+        // Add and remove stop at the same place, keeping the index consistent.
+    }
 }
 
 void CTxMemPool::RemoveStaged(setEntries &stage) {
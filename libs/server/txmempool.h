@@ -22,6 +22,7 @@
 #define FLOWEE_TXMEMPOOL_H
 
 #include <list>
+#include <map>
 #include <set>
 
 #include "amount.h"
@@ -438,6 +439,22 @@ public:
      */
     bool doubleSpendProofFor(const uint256 &txid, DoubleSpendProof &dsp);
 
+    /// An output of a mempool entry, as found by findByScriptHash()
+    struct ScriptHashMatch {
+        txiter entry;
+        int outIndex;
+        int64_t amount;
+    };
+    /**
+     * Return the outputs of all mempool transactions that pay to an output-script
+     * whose (single) sha256 hash is \a scriptHash.
+     * This uses an index maintained on insert and remove, the cost is relative to the
+     * number of matches.
+     * At most \a maxResults matches are returned.
+     * The caller needs to hold cs for as long as the returned entries are used.
+     */
+    std::vector<ScriptHashMatch> findByScriptHash(const uint256 &scriptHash, size_t maxResults = SIZE_MAX) const;
+
 private:
     typedef std::map<txiter, setEntries, CompareIteratorByHash> cacheMap;
 
@@ -615,8 +632,12 @@ private:
      */
     void removeUnchecked(txiter entry);
 
+    /// add or remove the outputs of \a entry from m_scriptHashIndex
+    void updateScriptHashIndex(txiter entry, bool add);
+
     UnspentOutputDatabase *m_utxo;
     DoubleSpendProofStorage *m_dspStorage;
+    std::multimap<uint256, ScriptHashMatch> m_scriptHashIndex;
 };
 
 // We want to sort transactions by coin age priority
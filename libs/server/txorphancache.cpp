@@ -1,6 +1,6 @@
 /*
  * This file is part of the Flowee project
- * Copyright (C) 2017 Tom Zander <tom@flowee.org>
+ * Copyright (C) 2017-2021 Tom Zander <tom@flowee.org>
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -22,8 +22,11 @@
 #include "util.h"
 #include "net.h"
 
+#include <algorithm>
+
 CTxOrphanCache::CTxOrphanCache()
-    : m_limit(Settings::DefaultMaxOrphanTransactions)
+    : m_limit(Settings::DefaultMaxOrphanTransactions),
+      m_byteLimit(static_cast<uint64_t>(Settings::DefaultMaxOrphanTransactionsSize) * 1000000)
 {
 }
 
@@ -35,95 +38,112 @@ CTxOrphanCache* CTxOrphanCache::instance()
     return s_instance;
 }
 
-bool CTxOrphanCache::addOrphanTx(const CTransaction& tx, NodeId peer, uint32_t onResultFlags, uint64_t originalEntryTime)
+bool CTxOrphanCache::addOrphanTx(const Tx &tx, NodeId peer, uint32_t onResultFlags, uint64_t originalEntryTime)
 {
-    LOCK(m_lock);
-
-    uint256 hash = tx.GetHash();
-    if (m_mapOrphanTransactions.count(hash))
-        return false;
-
     // Ignore big transactions, to avoid a
     // send-big-orphans memory exhaustion attack. If a peer has a legitimate
     // large transaction with a missing parent then we assume
     // it will rebroadcast it later, after the parent transaction(s)
     // have been mined or received.
-    // 5000 orphans, each of which is at most 100,000 bytes big is
-    // at most 500 megabytes of orphans:
-
-    unsigned int sz = tx.GetSerializeSize(SER_NETWORK, CTransaction::CURRENT_VERSION);
+    const int sz = tx.size();
+    const uint256 hash = tx.createHash();
     if (sz > 100000) {
-        logDebug(Log::Mempool) << "ignoring large orphan tx. Size:" << sz << "hash:" << hash.ToString();
+        logDebug(Log::Mempool) << "ignoring large orphan tx. Size:" << sz << "hash:" << hash;
         return false;
     }
 
-    COrphanTx &entry = m_mapOrphanTransactions[hash];
-    entry.tx = tx;
-    entry.fromPeer = peer;
+    std::vector<uint256> parents;
+    Tx::Iterator iter(tx);
+    while (iter.next(Tx::PrevTxHash) != Tx::End) {
+        const uint256 prevTxId = iter.uint256Data();
+        if (std::find(parents.begin(), parents.end(), prevTxId) == parents.end())
+            parents.push_back(prevTxId);
+    }
+
+    LOCK(m_lock);
+    auto inserted = m_orphans.insert(std::make_pair(hash, Entry()));
+    if (!inserted.second)
+        return false;
+    Entry &entry = inserted.first->second;
+    entry.orphan.tx = tx;
+    entry.orphan.fromPeer = peer;
     if (originalEntryTime == 0)
         originalEntryTime = GetTime();
-    entry.nEntryTime = originalEntryTime;
-    entry.onResultFlags = onResultFlags;
-    for (const CTxIn& txin : tx.vin) {
-        m_mapOrphanTransactionsByPrev[txin.prevout.hash].insert(hash);
+    entry.orphan.nEntryTime = originalEntryTime;
+    entry.orphan.onResultFlags = onResultFlags;
+    entry.byTime = m_orphansByTime.insert(std::make_pair(originalEntryTime, hash));
+    for (const uint256 &prevTxId : parents) {
+        m_orphansByPrev[prevTxId].push_back(hash);
     }
+    entry.parents = std::move(parents);
+    m_bytes += static_cast<uint64_t>(sz);
 
     logDebug(Log::Mempool) << "stored orphan tx" << hash << "(mapsz"
-        << m_mapOrphanTransactions.size() << "prevsz " << m_mapOrphanTransactionsByPrev.size() << ')';
+        << m_orphans.size() << "prevsz " << m_orphansByPrev.size() << "bytes" << m_bytes << ')';
     return true;
 }
 
-void CTxOrphanCache::eraseOrphanTx(uint256 hash)
+bool CTxOrphanCache::addOrphanTx(const CTransaction &tx, int peerId, uint32_t onResultFlags, uint64_t originalEntryTime)
+{
+    return addOrphanTx(Tx::fromOldTransaction(tx), peerId, onResultFlags, originalEntryTime);
+}
+
+void CTxOrphanCache::eraseOrphanTx(const uint256 &hash)
 {
-    std::map<uint256, COrphanTx>::iterator it = m_mapOrphanTransactions.find(hash);
-    if (it == m_mapOrphanTransactions.end())
+    auto it = m_orphans.find(hash);
+    if (it == m_orphans.end())
         return;
-    for (const CTxIn& txin : it->second.tx.vin) {
-        auto itPrev = m_mapOrphanTransactionsByPrev.find(txin.prevout.hash);
-        if (itPrev == m_mapOrphanTransactionsByPrev.end())
+    for (const uint256 &prevTxId : it->second.parents) {
+        auto itPrev = m_orphansByPrev.find(prevTxId);
+        if (itPrev == m_orphansByPrev.end())
             continue;
-        itPrev->second.erase(hash);
-        if (itPrev->second.empty())
-            m_mapOrphanTransactionsByPrev.erase(itPrev);
+        auto &children = itPrev->second;
+        auto child = std::find(children.begin(), children.end(), hash);
+        if (child != children.end()) {
+            *child = children.back();
+            children.pop_back();
+        }
+        if (children.empty())
+            m_orphansByPrev.erase(itPrev);
     }
-    m_mapOrphanTransactions.erase(it);
+    m_orphansByTime.erase(it->second.byTime);
+    m_bytes -= static_cast<uint64_t>(it->second.orphan.tx.size());
+    m_orphans.erase(it);
 }
 
 void CTxOrphanCache::eraseOrphansByTime()
 {
     LOCK(m_lock);
-    static int64_t nLastOrphanCheck = GetTime();
+    const int64_t now = GetTime();
+    if (m_lastOrphanCheck == 0)
+        m_lastOrphanCheck = now;
 
-    // Because we have to iterate through the entire orphan cache which can be large we don't want to check this
-    // every time a tx enters the mempool but just once every 5 minutes is good enough.
-    if (GetTime() <  nLastOrphanCheck + 5 * 60)
+    // We don't want to check this every time a tx enters the mempool but just once every 5 minutes is good enough.
+    if (now < m_lastOrphanCheck + 5 * 60)
         return;
-    int64_t nOrphanTxCutoffTime = GetTime() - GetArg("-mempoolexpiry", Settings::DefaultMempoolExpiry) * 60 * 60;
-    std::map<uint256, COrphanTx>::iterator iter = m_mapOrphanTransactions.begin();
-    while (iter != m_mapOrphanTransactions.end()) {
-        const auto entry = iter++;
-        int64_t nEntryTime = entry->second.nEntryTime;
-        if (nEntryTime < nOrphanTxCutoffTime) {
-            uint256 txHash = entry->second.tx.GetHash();
-            eraseOrphanTx(txHash);
-            logDebug(Log::Mempool) << "Erased old orphan tx" << txHash << "of age" << (GetTime() - nEntryTime) << "seconds";
-        }
+    const int64_t nOrphanTxCutoffTime = now - GetArg("-mempoolexpiry", Settings::DefaultMempoolExpiry) * 60 * 60;
+    // the time-index is sorted, the expired ones are at the start.
+    while (!m_orphansByTime.empty()) {
+        const auto oldest = m_orphansByTime.begin();
+        const int64_t nEntryTime = static_cast<int64_t>(oldest->first);
+        if (nEntryTime >= nOrphanTxCutoffTime)
+            break;
+        const uint256 txHash = oldest->second;
+        eraseOrphanTx(txHash);
+        logDebug(Log::Mempool) << "Erased old orphan tx" << txHash << "of age" << (now - nEntryTime) << "seconds";
     }
 
-    nLastOrphanCheck = GetTime();
+    m_lastOrphanCheck = now;
 }
 
 std::uint32_t CTxOrphanCache::limitOrphanTxSize(std::uint32_t nMaxOrphans)
 {
     LOCK(m_lock);
     unsigned int nEvicted = 0;
-    while (m_mapOrphanTransactions.size() > nMaxOrphans) {
-        // Evict a random orphan:
-        uint256 randomhash = GetRandHash();
-        std::map<uint256, COrphanTx>::iterator it = m_mapOrphanTransactions.lower_bound(randomhash);
-        if (it == m_mapOrphanTransactions.end())
-            it = m_mapOrphanTransactions.begin();
-        eraseOrphanTx(it->first);
+    while (!m_orphansByTime.empty() && (m_orphans.size() > nMaxOrphans || m_bytes > m_byteLimit)) {
+        // Evict the oldest orphan
+        const uint256 hash = m_orphansByTime.begin()->second;
+        eraseOrphanTx(hash);
         ++nEvicted;
     }
     return nEvicted;
@@ -131,6 +151,7 @@ std::uint32_t CTxOrphanCache::limitOrphanTxSize(std::uint32_t nMaxOrphans)
 
 uint32_t CTxOrphanCache::limitOrphanTxSize()
 {
+    LOCK(m_lock);
     return limitOrphanTxSize(m_limit);
 }
 
@@ -138,19 +159,21 @@ void CTxOrphanCache::clear()
 {
     if (s_instance) {
         LOCK(s_instance->m_lock);
-        s_instance->m_mapOrphanTransactions.clear();
-        s_instance->m_mapOrphanTransactionsByPrev.clear();
+        s_instance->m_orphans.clear();
+        s_instance->m_orphansByPrev.clear();
+        s_instance->m_orphansByTime.clear();
+        s_instance->m_bytes = 0;
     }
 }
 
-bool CTxOrphanCache::value(const uint256 &txid, CTransaction &output)
+bool CTxOrphanCache::value(const uint256 &txid, Tx &output)
 {
     CTxOrphanCache *s = instance();
     LOCK(s->m_lock);
-    auto iter = s->m_mapOrphanTransactions.find(txid);
-    if (iter == s->m_mapOrphanTransactions.end())
+    auto iter = s->m_orphans.find(txid);
+    if (iter == s->m_orphans.end())
         return false;
-    output = iter->second.tx;
+    output = iter->second.orphan.tx;
     return true;
 }
 
@@ -158,34 +181,58 @@ bool CTxOrphanCache::contains(const uint256 &txid)
 {
     CTxOrphanCache *s = instance();
     LOCK(s->m_lock);
-    return s->m_mapOrphanTransactions.count(txid) > 0;
+    return s->m_orphans.find(txid) != s->m_orphans.end();
 }
 
 std::vector<uint256> CTxOrphanCache::fetchTransactionIds() const
 {
     LOCK(m_lock);
     std::vector<uint256> answer;
-    answer.reserve(m_mapOrphanTransactions.size());
-    for (auto iter = m_mapOrphanTransactions.begin(); iter != m_mapOrphanTransactions.end(); ++iter)
-        answer.push_back((*iter).first);
+    answer.reserve(m_orphans.size());
+    for (auto iter = m_orphans.begin(); iter != m_orphans.end(); ++iter)
+        answer.push_back(iter->first);
     return answer;
 }
 
 void CTxOrphanCache::setLimit(uint32_t limit)
 {
+    LOCK(m_lock);
     m_limit = limit;
 }
 
-std::vector<CTxOrphanCache::COrphanTx> CTxOrphanCache::fetchTransactionsByPrev(const uint256 &txid) const
+void CTxOrphanCache::setByteLimit(uint64_t bytes)
+{
+    LOCK(m_lock);
+    m_byteLimit = bytes;
+}
+
+size_t CTxOrphanCache::size() const
+{
+    LOCK(m_lock);
+    return m_orphans.size();
+}
+
+uint64_t CTxOrphanCache::byteSize() const
+{
+    LOCK(m_lock);
+    return m_bytes;
+}
+
+std::vector<CTxOrphanCache::COrphanTx> CTxOrphanCache::takeTransactionsByPrev(const uint256 &txid)
 {
     LOCK(m_lock);
     std::vector<CTxOrphanCache::COrphanTx> answer;
-    auto itByPrev = m_mapOrphanTransactionsByPrev.find(txid);
-    if (itByPrev == m_mapOrphanTransactionsByPrev.end())
+    auto itByPrev = m_orphansByPrev.find(txid);
+    if (itByPrev == m_orphansByPrev.end())
         return answer;
-    for (auto mi = itByPrev->second.begin(); mi != itByPrev->second.end(); ++mi) {
-        const uint256& orphanHash = *mi;
-        answer.push_back(m_mapOrphanTransactions.at(orphanHash));
+    // copy, as eraseOrphanTx() changes the list.
+    const std::vector<uint256> children = itByPrev->second;
+    answer.reserve(children.size());
+    for (const uint256 &orphanHash : children) {
+        auto iter = m_orphans.find(orphanHash);
+        assert(iter != m_orphans.end());
+        answer.push_back(iter->second.orphan);
+        eraseOrphanTx(orphanHash);
     }
     return answer;
 }
@@ -193,19 +240,7 @@ std::vector<CTxOrphanCache::COrphanTx> CTxOrphanCache::fetchTransactionsByPrev(c
 void CTxOrphanCache::eraseOrphans(const std::vector<uint256> &txIds)
 {
     LOCK(m_lock);
-    for (auto hashIter = txIds.begin(); hashIter != txIds.end(); ++hashIter) {
-        auto it = m_mapOrphanTransactions.find(*hashIter);
-        if (it == m_mapOrphanTransactions.end())
-            continue;
-
-        for (const CTxIn& txin : it->second.tx.vin) {
-            auto itPrev = m_mapOrphanTransactionsByPrev.find(txin.prevout.hash);
-            if (itPrev == m_mapOrphanTransactionsByPrev.end())
-                continue;
-            itPrev->second.erase(*hashIter);
-            if (itPrev->second.empty())
-                m_mapOrphanTransactionsByPrev.erase(itPrev);
-        }
-        m_mapOrphanTransactions.erase(it);
+    for (const uint256 &txid : txIds) {
+        eraseOrphanTx(txid);
     }
 }
@@ -1,6 +1,6 @@
 /*
  * This file is part of the Flowee project
- * Copyright (C) 2017 Tom Zander <tom@flowee.org>
+ * Copyright (C) 2017-2021 Tom Zander <tom@flowee.org>
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -19,8 +19,27 @@
 #define TXORPHANCACHE_H
 
 #include "sync.h"
-#include "primitives/transaction.h"
+#include <primitives/FastTransaction.h>
+#include <uint256.h>
 
+#include <boost/unordered_map.hpp>
+#include <map>
+#include <vector>
+
+class CTransaction;
+
+/**
+ * The orphan cache holds transactions we could not validate yet because one or more
+ * of their inputs spend a transaction we have not seen (yet).
+ *
+ * Transactions are stored as Tx, sharing the buffer they were received in.
+ * The cache is indexed by txid and by the txid of each of the transactions
+ * an orphan spends, which makes finding the orphans a newly accepted transaction
+ * unlocks a constant-time operation.
+ *
+ * The size of the cache is limited both in the amount of transactions and in bytes,
+ * the oldest orphans are evicted first.
+ */
 class CTxOrphanCache
 {
 public:
@@ -28,46 +47,71 @@ public:
     static CTxOrphanCache *instance();
 
     struct COrphanTx {
-        CTransaction tx;
+        Tx tx;
         int fromPeer;
         uint64_t nEntryTime;
         uint32_t onResultFlags;
     };
-    bool addOrphanTx(const CTransaction& tx, int peerId, uint32_t onResultFlags = 0, uint64_t originalEntryTime = 0);
+    bool addOrphanTx(const Tx &tx, int peerId, uint32_t onResultFlags = 0, uint64_t originalEntryTime = 0);
+    bool addOrphanTx(const CTransaction &tx, int peerId, uint32_t onResultFlags = 0, uint64_t originalEntryTime = 0);
 
     void eraseOrphansByTime();
 
+    /// Evict the oldest orphans until we are within limits, returns the amount evicted.
     std::uint32_t limitOrphanTxSize();
 
-    inline const std::map<uint256, COrphanTx> & mapOrphanTransactions() const {
-        return m_mapOrphanTransactions;
-    }
-
     static void clear();
-    static bool value(const uint256 &txid, CTransaction &output);
+    static bool value(const uint256 &txid, Tx &output);
     static bool contains(const uint256 &txid);
 
     std::vector<uint256> fetchTransactionIds() const;
 
+    /// the amount of transactions we keep at most.
     void setLimit(std::uint32_t limit);
+    /// the total size, in bytes, of the transactions we keep at most.
+    void setByteLimit(std::uint64_t bytes);
+
+    /// returns the amount of orphans in the cache
+    size_t size() const;
+    /// returns the sum of the sizes of all the orphans in the cache.
+    std::uint64_t byteSize() const;
 
-    std::vector<COrphanTx> fetchTransactionsByPrev(const uint256 &txid) const;
+    /**
+     * Removes all orphans that spend an output of \a txid from the cache and returns them.
+     * This is used when \a txid got accepted and the returned orphans can be validated again.
+     */
+    std::vector<COrphanTx> takeTransactionsByPrev(const uint256 &txid);
 
     void eraseOrphans(const std::vector<uint256> &txIds);
 
 protected:
+    typedef std::multimap<uint64_t, uint256> EntryTimeIndex;
+    struct Entry {
+        COrphanTx orphan;
+        std::vector<uint256> parents; ///< unique txids of the transactions this orphan spends
+        EntryTimeIndex::iterator byTime;
+    };
+    typedef boost::unordered_map<uint256, Entry, HashShortener> OrphanMap;
+    typedef boost::unordered_map<uint256, std::vector<uint256>, HashShortener> ByPrevMap;
+
     mutable CCriticalSection m_lock;
-    std::map<uint256, COrphanTx> m_mapOrphanTransactions;
-    std::map<uint256, std::set<uint256> > m_mapOrphanTransactionsByPrev;
+    OrphanMap m_orphans;
+    ByPrevMap m_orphansByPrev;
+    EntryTimeIndex m_orphansByTime;
+    std::uint64_t m_bytes = 0;
 
     static CTxOrphanCache *s_instance;
 
     // this one doesn't lock!
-    void eraseOrphanTx(uint256 hash);
+    void eraseOrphanTx(const uint256 &hash);
+    // evicts the oldest until we have at most nMaxOrphans orphans, and are within the byte-limit.
     uint32_t limitOrphanTxSize(uint32_t nMaxOrphans);
 
 private:
+    // protected by m_lock
     std::uint32_t m_limit;
+    std::uint64_t m_byteLimit;
+    int64_t m_lastOrphanCheck = 0;
 };
 
 #endif // TXORPHANCACHE_H
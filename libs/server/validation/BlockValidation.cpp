@@ -44,7 +44,11 @@
 #include <utxo/UnspentOutputDatabase.h>
 
 #include <UnspentOutputData.h>
+#include <condition_variable>
+#include <exception>
 #include <fstream>
+#include <map>
+#include <set>
 
 #include <streaming/MessageBuilder.h>
 
@@ -576,12 +580,16 @@ void ValidationEnginePrivate::processNewBlock(std::shared_ptr<BlockValidationSta
                     // there already is one.
                     try {
                         BlockMetaData meta = Blocks::DB::instance()->loadBlockMetaData(index->GetMetaDataPos());
-                        createMeta = state->m_fetchFees && !meta.hasFeesData(); // we have fees now, replace.
+                        // replace if we have fees now, or the old one lacks the script-hash filter or outputs.
+                        createMeta = (state->m_fetchFees && !meta.hasFeesData())
+                                || (filterForMetaBlocks && !meta.hasScriptHashFilter())
+                                || (outputsForMetaBlocks && !meta.hasOutputData());
                     } catch (const std::exception &e) {} // loading may throw
                 }
                 Streaming::BufferPool pool;
                 if (createMeta) {
-                    auto metaData = BlockMetaData::parseBlock(index->nHeight, state->m_block, state->m_perTxFees, pool);
+                    auto metaData = BlockMetaData::parseBlock(index->nHeight, state->m_block, state->m_perTxFees, pool,
+                                                              outputsForMetaBlocks, filterForMetaBlocks);
                     try {
                         CDiskBlockPos metaDataPos = Blocks::DB::instance()->writeMetaBlock(metaData);
                         if (!metaDataPos.IsNull()) {
@@ -765,6 +773,81 @@ void ValidationEnginePrivate::handleFailedBlock(const std::shared_ptr<BlockValid
     // TODO rememeber to ignore this blockhash in the 'recently failed' list
 }
 
+namespace {
+/*
+ * Splits the range [0, count) into chunks and calls \a job for each of them, in parallel
+ * on the application's thread-pool. The calling thread processes chunks as well which makes
+ * this safe to use from the strand, it returns when all chunks have been processed.
+ */
+class ChunkRunner
+{
+public:
+    ChunkRunner(int count, const std::function<void(int, int)> &job)
+        : m_job(job),
+          m_count(count),
+          m_chunks(std::max(1, std::min<int>((count + 499) / 500, boost::thread::hardware_concurrency()))),
+          m_itemsPerChunk((count + m_chunks - 1) / m_chunks),
+          m_chunkToStart(0),
+          m_chunksLeft(m_chunks)
+    {
+    }
+
+    inline int chunks() const {
+        return m_chunks;
+    }
+
+    void run() {
+        while (true) {
+            const int chunk = m_chunkToStart.fetch_add(1);
+            if (chunk >= m_chunks)
+                return;
+            try {
+                const int begin = chunk * m_itemsPerChunk;
+                m_job(begin, std::min(m_count, begin + m_itemsPerChunk));
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(m_lock);
+                if (!m_error)
+                    m_error = std::current_exception();
+            }
+            if (m_chunksLeft.fetch_sub(1) == 1) {
+                std::lock_guard<std::mutex> lock(m_lock);
+                m_finished.notify_all();
+            }
+        }
+    }
+
+    void waitUntilFinished() {
+        std::unique_lock<std::mutex> lock(m_lock);
+        m_finished.wait(lock, [this] { return m_chunksLeft.load() == 0; });
+        if (m_error)
+            std::rethrow_exception(m_error);
+    }
+
+private:
+    const std::function<void(int, int)> m_job;
+    const int m_count;
+    const int m_chunks;
+    const int m_itemsPerChunk;
+    std::atomic<int> m_chunkToStart;
+    std::atomic<int> m_chunksLeft;
+    std::mutex m_lock;
+    std::condition_variable m_finished;
+    std::exception_ptr m_error;
+};
+
+void forEachChunk(int count, const std::function<void(int, int)> &job)
+{
+    if (count <= 0)
+        return;
+    auto runner = std::make_shared<ChunkRunner>(count, job);
+    for (int i = 1; i < runner->chunks(); ++i) {
+        Application::instance()->ioService().post(std::bind(&ChunkRunner::run, runner));
+    }
+    runner->run();
+    runner->waitUntilFinished();
+}
+}
+
 /*
  * The 'main chain' is determined by the Blocks::DB::headersChain()
  * This method does nothing more than update the real chain to remove blocks that are
@@ -778,58 +861,119 @@ void ValidationEnginePrivate::prepareChain()
         return;
     DEBUGBV << "PrepareChain actually has work to do!";
 
+    const int64_t start = GetTimeMicros();
     std::vector<FastBlock> revertedBlocks;
-
     CBlockIndex *oldTip = blockchain->Tip();
-    LOCK(mempool->cs);
-    while (!Blocks::DB::instance()->headerChain().Contains(blockchain->Tip())) {
-        CBlockIndex *index = blockchain->Tip();
-        logInfo(Log::BlockValidation) << "Removing (rollback) chain tip at" << index->nHeight << index->GetBlockHash();
-        FastBlock block;
-        try {
-            block = Blocks::DB::instance()->loadBlock(index->GetBlockPos());
-            revertedBlocks.push_back(block);
-            block.findTransactions();
-        } catch (const std::runtime_error &error) {
-            logFatal(Log::BlockValidation) << "ERROR: Can't undo the tip because I can't find it on disk";
-            fatal(error.what());
-        }
-        if (block.size() == 0)
-            fatal("BlockValidationPrivate::prepareChainForBlock: got no block, can't continue.");
-        if (!disconnectTip(index))
-            fatal("Failed to disconnect block");
+    {
+        LOCK(mempool->cs);
+        while (!Blocks::DB::instance()->headerChain().Contains(blockchain->Tip())) {
+            CBlockIndex *index = blockchain->Tip();
+            logInfo(Log::BlockValidation) << "Removing (rollback) chain tip at" << index->nHeight << index->GetBlockHash();
+            FastBlock block;
+            try {
+                block = Blocks::DB::instance()->loadBlock(index->GetBlockPos());
+                revertedBlocks.push_back(block);
+                block.findTransactions();
+            } catch (const std::runtime_error &error) {
+                logFatal(Log::BlockValidation) << "ERROR: Can't undo the tip because I can't find it on disk";
+                fatal(error.what());
+            }
+            if (block.size() == 0)
+                fatal("BlockValidationPrivate::prepareChainForBlock: got no block, can't continue.");
+            if (!disconnectTip(index))
+                fatal("Failed to disconnect block");
 
-        tip.store(index->pprev);
+            tip.store(index->pprev);
+        }
+        mempool->removeForReorg(blockchain->Tip()->nHeight + 1, STANDARD_LOCKTIME_VERIFY_FLAGS);
     }
-    mempool->removeForReorg(blockchain->Tip()->nHeight + 1, STANDARD_LOCKTIME_VERIFY_FLAGS);
+
+    if (revertedBlocks.size() <= 3)
+        reAddTransactions(revertedBlocks);
+
+    const int64_t duration = GetTimeMicros() - start;
+    logCritical(Log::BlockValidation) << "Reorg removed" << revertedBlocks.size() << "blocks in"
+                                      << duration / 1000 << "ms";
     if (!revertedBlocks.empty())
-        ValidationNotifier().chainReorged(oldTip, revertedBlocks);
+        ValidationNotifier().chainReorged(oldTip, revertedBlocks, duration);
+}
 
-    if (revertedBlocks.size() > 3)
-        return;
+void ValidationEnginePrivate::reAddTransactions(const std::vector<FastBlock> &revertedBlocks)
+{
     // Add transactions. Only after we have flushed our removal of transactions from the UTXO view.
     // Otherwise the mempool would object because they would be in conflict with themselves.
+    std::vector<Tx> transactions;
+    size_t confirmedCount = 0;
     Streaming::BufferPool pool;
-    for (int index = revertedBlocks.size() - 1; index >= 0; --index) {
-        FastBlock block = revertedBlocks.at(index);
-        block.findTransactions();
-        for (size_t txIndex = 1; txIndex < block.transactions().size(); txIndex++) {
-            Tx tx = block.transactions().at(txIndex);
+    {
+        LOCK(mempool->cs);
+        for (int index = revertedBlocks.size() - 1; index >= 0; --index) {
+            FastBlock block = revertedBlocks.at(index);
+            block.findTransactions();
+            for (size_t txIndex = 1; txIndex < block.transactions().size(); txIndex++)
+                transactions.push_back(block.transactions().at(txIndex));
+        }
+        confirmedCount = transactions.size();
+        for (size_t i = 0; i < confirmedCount; ++i) {
             std::list<CTransaction> deps;
-            mempool->remove(tx.createOldTransaction(), deps, true);
-
-            std::shared_ptr<TxValidationState> state(new TxValidationState(me, tx, TxValidationState::FromMempool));
-            state->checkTransaction();
+            mempool->remove(transactions.at(i).createOldTransaction(), deps, true);
+            for (const CTransaction &tx2 : deps) // dependent transactions
+                transactions.push_back(Tx::fromOldTransaction(tx2, &pool));
+        }
+    }
 
-            for (const CTransaction &tx2 : deps) {// dependent transactions
-                state.reset(new TxValidationState(me, Tx::fromOldTransaction(tx2, &pool), TxValidationState::FromMempool));
+    /*
+     * Transactions are validated in parallel, in generations. A transaction is only
+     * validated after all the transactions it spends from, in the previous generations.
+     */
+    std::map<uint256, size_t> txIndexes;
+    for (size_t i = 0; i < transactions.size(); ++i) {
+        txIndexes.insert(std::make_pair(transactions.at(i).createHash(), i));
+    }
+    std::vector<std::vector<size_t> > children(transactions.size());
+    std::vector<int> parentCount(transactions.size(), 0);
+    for (size_t i = 0; i < transactions.size(); ++i) {
+        std::set<size_t> parents;
+        Tx::Iterator iter(transactions.at(i));
+        while (iter.next(Tx::PrevTxHash) != Tx::End) {
+            auto parent = txIndexes.find(iter.uint256Data());
+            if (parent != txIndexes.end() && parent->second != i)
+                parents.insert(parent->second);
+        }
+        for (size_t parent : parents) {
+            children[parent].push_back(i);
+        }
+        parentCount[i] = static_cast<int>(parents.size());
+    }
+    std::vector<size_t> generation;
+    for (size_t i = 0; i < transactions.size(); ++i) {
+        if (parentCount[i] == 0)
+            generation.push_back(i);
+    }
+    while (!generation.empty()) {
+        forEachChunk(static_cast<int>(generation.size()), [this, &transactions, &generation](int begin, int end) {
+            for (int i = begin; i < end; ++i) {
+                std::shared_ptr<TxValidationState> state(new TxValidationState(me,
+                        transactions.at(generation.at(static_cast<size_t>(i))), TxValidationState::FromMempool));
                 state->checkTransaction();
             }
-            // Let wallets know transactions went from 1-confirmed to
-            // 0-confirmed or conflicted:
-            ValidationNotifier().syncTransaction(tx.createOldTransaction());
-            ValidationNotifier().syncTx(tx);
+        });
+        std::vector<size_t> next;
+        for (size_t i : generation) {
+            for (size_t child : children[i]) {
+                if (--parentCount[child] == 0)
+                    next.push_back(child);
+            }
         }
+        generation.swap(next);
+    }
+
+    // Let wallets know transactions went from 1-confirmed to
+    // 0-confirmed or conflicted:
+    for (size_t i = 0; i < confirmedCount; ++i) {
+        const Tx &tx = transactions.at(i);
+        ValidationNotifier().syncTransaction(tx.createOldTransaction());
+        ValidationNotifier().syncTx(tx);
     }
     mempool->AddTransactionsUpdated(1);
     LimitMempoolSize(*mempool, GetArg("-maxmempool", Settings::DefaultMaxMempoolSize) * 1000000, GetArg("-mempoolexpiry", Settings::DefaultMempoolExpiry) * 60 * 60);
@@ -939,25 +1083,39 @@ bool ValidationEnginePrivate::disconnectTip(CBlockIndex *index, bool *userClean,
         return false;
     }
 
-    UnspentOutputDatabase *utxo = mempool->utxo();
+    std::vector<FastUndoBlock::Item> spentOutputs, createdOutputs;
     while (true) {
         FastUndoBlock::Item item = blockUndoFast.nextItem();
         if (!item.isValid())
             break;
-        if (!item.isInsert())
-            utxo->insert(item.prevTxId, item.outputIndex, item.blockHeight, item.offsetInBlock);
+        if (item.isInsert())
+            createdOutputs.push_back(item);
+        else
+            spentOutputs.push_back(item);
     }
-    blockUndoFast.restartStream();
-    bool clean = true;
-    while (true) {
-        FastUndoBlock::Item item = blockUndoFast.nextItem();
-        if (!item.isValid())
-            break;
-        if (item.isInsert()) {
+
+    /*
+     * The UTXO is safe to modify from many threads, just like in block-connect we split the work
+     * into chunks.
+     * All spent outputs need to be back before we remove the created ones because outputs
+     * created and spent in the same block are listed in both.
+     */
+    UnspentOutputDatabase *utxo = mempool->utxo();
+    forEachChunk(static_cast<int>(spentOutputs.size()), [utxo, &spentOutputs](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            const FastUndoBlock::Item &item = spentOutputs[static_cast<size_t>(i)];
+            utxo->insert(item.prevTxId, item.outputIndex, item.blockHeight, item.offsetInBlock);
+        }
+    });
+    std::atomic<bool> cleanRemove(true);
+    forEachChunk(static_cast<int>(createdOutputs.size()), [utxo, &createdOutputs, &cleanRemove](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            const FastUndoBlock::Item &item = createdOutputs[static_cast<size_t>(i)];
             if (!utxo->remove(item.prevTxId, item.outputIndex).isValid())
-                clean = false;
+                cleanRemove = false;
         }
-    }
+    });
+    const bool clean = cleanRemove.load();
 
     // move best block pointer to prevout block
     utxo->blockFinished(index->pprev->nHeight, index->pprev->GetBlockHash());
@@ -1108,6 +1266,12 @@ BlockValidationState::~BlockValidationState()
     }
     if (m_ownsIndex)
         delete m_blockIndex;
+    if (!m_blockPos.IsNull() && m_block.isFullBlock()) {
+        // A reindex reads each block exactly once, no need to keep it in memory.
+        auto blocksDb = Blocks::DB::instance();
+        if (blocksDb && blocksDb->reindexing() == Blocks::ParsingBlocks)
+            blocksDb->releaseBlock(m_blockPos, m_block);
+    }
     if (m_block.size() >= 80)
         DEBUGBV << "Finished" << blockId;
 }
@@ -1117,7 +1281,7 @@ void BlockValidationState::load()
 #ifdef ENABLE_BENCHMARKS
     int64_t start = GetTimeMicros();
 #endif
-    m_block = Blocks::DB::instance()->loadBlock(m_blockPos);
+    m_block = Blocks::DB::instance()->loadBlock(m_blockPos, Blocks::SequentialAccess);
 #ifdef ENABLE_BENCHMARKS
     int64_t end = GetTimeMicros();
     auto parent = m_parent.lock();
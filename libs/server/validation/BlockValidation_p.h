@@ -221,6 +221,8 @@ public:
     void processNewBlock(std::shared_ptr<BlockValidationState> state);
     void startOrphanWithParent(std::list<std::shared_ptr<BlockValidationState> > &adoptees, const std::shared_ptr<BlockValidationState> &state);
     void prepareChain();
+    /// Re-add the transactions of blocks removed in a reorg to the mempool.
+    void reAddTransactions(const std::vector<FastBlock> &revertedBlocks);
     void prepareChain_priv();
     void createBlockIndexFor(const std::shared_ptr<BlockValidationState> &state);
     /// called (from strand) to speed up shutdown
@@ -288,6 +290,8 @@ public:
     const Validation::EngineType engineType;
 
     bool fetchFeeForMetaBlocks = false;
+    bool outputsForMetaBlocks = false;
+    bool filterForMetaBlocks = false;
 
 private:
     int lastFullBlockScheduled;
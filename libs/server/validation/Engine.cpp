@@ -102,7 +102,7 @@ Validation::Settings Validation::Engine::addBlock(const CDiskBlockPos &pos, std:
 
 std::future<std::string> Validation::Engine::addTransaction(const Tx &tx, uint32_t onResultFlags, CNode *pFrom)
 {
-    assert(onResultFlags < 0x40);
+    assert(onResultFlags < 0x80);
     assert((onResultFlags & SaveGoodToDisk) == 0);
     if (!d.get() || d->shuttingDown) {
         std::promise<std::string> promise;
@@ -218,6 +218,20 @@ void Validation::Engine::enableFeeResolveForMetaData(bool on)
     d->fetchFeeForMetaBlocks = on;
 }
 
+void Validation::Engine::enableOutputsForMetaData(bool on)
+{
+    if (!d.get() || d->shuttingDown)
+        return;
+    d->outputsForMetaBlocks = on;
+}
+
+void Validation::Engine::enableFilterForMetaData(bool on)
+{
+    if (!d.get() || d->shuttingDown)
+        return;
+    d->filterForMetaBlocks = on;
+}
+
 void ValidationEnginePrivate::prepareChain_priv()
 {
     prepareChain();
@@ -48,7 +48,8 @@ enum ResultHandlingFlags {
     PunishBadNode = 4,     ///< Ban a bad node that gave us this block.
     RateLimitFreeTx = 8,
     RejectAbsurdFeeTx = 0x10,
-    TxValidateOnly = 0x20
+    TxValidateOnly = 0x20,
+    KeepOrphanTx = 0x40    ///< A tx that misses inputs goes into the orphan-cache, also when it didn't come from a peer.
 };
 
 /// throws exception if transaction is malformed.
@@ -143,6 +144,19 @@ public:
      */
     void enableFeeResolveForMetaData(bool on);
 
+    /**
+     * When enabled the BlockMetaData stores the script-hash and amount of every output,
+     * which allows API users to skip hashing output scripts.
+     * This roughly doubles the size of the metadata.
+     */
+    void enableOutputsForMetaData(bool on);
+
+    /**
+     * When enabled the BlockMetaData stores a filter over the output script-hashes and
+     * the spent outputs, which allows API users to skip blocks that are of no interest to them.
+     */
+    void enableFilterForMetaData(bool on);
+
     /**
      * Undo the effects of this block (with given index) on the UTXO set represented by view.
      * @param index the blockindex representing the block that we should undo.
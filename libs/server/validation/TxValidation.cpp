@@ -403,18 +403,12 @@ void TxValidationState::checkTransaction()
         if ((m_validationFlags & Validation::TxValidateOnly) == 0)
             RelayTransaction(tx);
 
-        auto orphans = CTxOrphanCache::instance()->fetchTransactionsByPrev(txid);
-        std::vector<uint256> scheduled;
-        scheduled.reserve(orphans.size());
-        for (auto orphan : orphans) {
-            std::shared_ptr<TxValidationState> state(new TxValidationState(m_parent, Tx::fromOldTransaction(orphan.tx), orphan.onResultFlags));
+        for (const auto &orphan : CTxOrphanCache::instance()->takeTransactionsByPrev(txid)) {
+            std::shared_ptr<TxValidationState> state(new TxValidationState(m_parent, orphan.tx, orphan.onResultFlags));
             state->m_originatingNodeId = orphan.fromPeer;
             state->m_originalInsertTime = orphan.nEntryTime;
-            scheduled.push_back(state->m_tx.createHash());
             Application::instance()->ioService().post(std::bind(&TxValidationState::checkTransaction, state));
         }
-
-        CTxOrphanCache::instance()->eraseOrphans(scheduled);
         CTxOrphanCache::instance()->eraseOrphansByTime();
 
         parent->strand.post(std::bind(&TxValidationState::sync, shared_from_this()));
@@ -435,11 +429,12 @@ void TxValidationState::checkTransaction()
         raii.result = strprintf("%i: %s", ex.rejectCode(), ex.what());
         if (inputsMissing) {// if missing inputs, add to orphan cache
             DEBUGTX << "Tx missed inputs, can't add to mempool" << txid;
-            if ((m_validationFlags & Validation::TxValidateOnly) || m_originatingNodeId < 0)
+            if ((m_validationFlags & Validation::TxValidateOnly)
+                    || (m_originatingNodeId < 0 && (m_validationFlags & Validation::KeepOrphanTx) == 0))
                 return;
             CTxOrphanCache *cache = CTxOrphanCache::instance();
             // DoS prevention: do not allow CTxOrphanCache to grow unbounded
-            cache->addOrphanTx(tx, m_originatingNodeId, m_validationFlags, m_originalInsertTime);
+            cache->addOrphanTx(m_tx, m_originatingNodeId, m_validationFlags, m_originalInsertTime);
             std::uint32_t nEvicted = cache->limitOrphanTxSize();
             if (nEvicted > 0)
                 logDebug(Log::TxValidation) << "mapOrphan overflow, removed" << nEvicted << "tx";
@@ -0,0 +1,219 @@
+/*
+ * This file is part of the Flowee project
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "GolombCodedSet.h"
+#include "streaming/BufferPool.h"
+
+#include <crypto/common.h>
+#include <crypto/sha256.h>
+
+#include <algorithm>
+#include <string.h>
+
+// the Golomb-Rice parameter and the inverse of the false positive rate.
+constexpr int P = 19;
+constexpr uint64_t M = 784931;
+
+namespace {
+uint64_t mix64(uint64_t x)
+{
+    // splitmix64 finalizer, spreads the key over all bits.
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+// maps \a x uniformly onto the range [0, n), the upper 64 bits of the 128 bit product.
+uint64_t fastRange64(uint64_t x, uint64_t n)
+{
+    const uint64_t xHi = x >> 32, xLo = x & 0xFFFFFFFF;
+    const uint64_t nHi = n >> 32, nLo = n & 0xFFFFFFFF;
+    const uint64_t ac = xHi * nHi;
+    const uint64_t ad = xHi * nLo;
+    const uint64_t bc = xLo * nHi;
+    const uint64_t bd = xLo * nLo;
+    const uint64_t mid34 = (bd >> 32) + (bc & 0xFFFFFFFF) + (ad & 0xFFFFFFFF);
+    return ac + (bc >> 32) + (ad >> 32) + (mid34 >> 32);
+}
+
+class BitWriter
+{
+public:
+    void write(uint64_t value, int bits) {
+        while (bits > 0) {
+            if (m_bitPos == 0)
+                m_data.push_back(0);
+            const int chunk = std::min(8 - m_bitPos, bits);
+            const uint8_t part = static_cast<uint8_t>((value >> (bits - chunk)) & ((1 << chunk) - 1));
+            m_data.back() |= part << (8 - m_bitPos - chunk);
+            m_bitPos = (m_bitPos + chunk) % 8;
+            bits -= chunk;
+        }
+    }
+
+    void writeUnary(uint64_t value) {
+        for (; value >= 32; value -= 32)
+            write(0xFFFFFFFF, 32);
+        write(((1ULL << value) - 1) << 1, static_cast<int>(value) + 1);
+    }
+
+    const std::vector<uint8_t> &data() const {
+        return m_data;
+    }
+
+private:
+    std::vector<uint8_t> m_data;
+    int m_bitPos = 0;
+};
+
+class BitReader
+{
+public:
+    BitReader(const Streaming::ConstBuffer &data)
+        : m_pos(reinterpret_cast<const uint8_t*>(data.begin())),
+          m_end(reinterpret_cast<const uint8_t*>(data.end()))
+    {
+    }
+
+    uint64_t read(int bits) {
+        uint64_t answer = 0;
+        while (bits > 0) {
+            if (m_pos >= m_end)
+                throw std::runtime_error("GolombCodedSet: data too short");
+            const int chunk = std::min(8 - m_bitPos, bits);
+            const uint8_t part = (*m_pos >> (8 - m_bitPos - chunk)) & ((1 << chunk) - 1);
+            answer = (answer << chunk) | part;
+            m_bitPos += chunk;
+            if (m_bitPos == 8) {
+                m_bitPos = 0;
+                ++m_pos;
+            }
+            bits -= chunk;
+        }
+        return answer;
+    }
+
+    uint64_t readUnary() {
+        uint64_t answer = 0;
+        while (read(1))
+            ++answer;
+        return answer;
+    }
+
+private:
+    const uint8_t *m_pos;
+    const uint8_t *m_end;
+    int m_bitPos = 0;
+};
+}
+
+GolombCodedSet::GolombCodedSet(const uint256 &key, const std::vector<uint256> &items, Streaming::BufferPool &pool)
+    : m_key(key.GetCheapHash()),
+      m_itemCount(static_cast<int>(items.size())),
+      m_valid(true)
+{
+    std::vector<uint64_t> values;
+    values.reserve(items.size());
+    for (const auto &item : items) {
+        values.push_back(hashToRange(item));
+    }
+    std::sort(values.begin(), values.end());
+
+    BitWriter writer;
+    uint64_t last = 0;
+    for (const uint64_t value : values) {
+        const uint64_t delta = value - last;
+        writer.writeUnary(delta >> P);
+        writer.write(delta, P);
+        last = value;
+    }
+    const auto &encoded = writer.data();
+    pool.reserve(static_cast<int>(encoded.size()));
+    if (!encoded.empty())
+        memcpy(pool.begin(), encoded.data(), encoded.size());
+    m_data = pool.commit(static_cast<int>(encoded.size()));
+}
+
+GolombCodedSet::GolombCodedSet(const uint256 &key, int itemCount, const Streaming::ConstBuffer &encoded)
+    : m_key(key.GetCheapHash()),
+      m_itemCount(itemCount),
+      m_valid(itemCount >= 0),
+      m_data(encoded)
+{
+}
+
+bool GolombCodedSet::contains(const uint256 &item) const
+{
+    std::vector<uint64_t> query;
+    query.push_back(hashToRange(item));
+    return matchSorted(query);
+}
+
+bool GolombCodedSet::containsAny(const std::set<uint256> &items) const
+{
+    std::vector<uint64_t> queries;
+    queries.reserve(items.size());
+    for (const auto &item : items) {
+        queries.push_back(hashToRange(item));
+    }
+    std::sort(queries.begin(), queries.end());
+    return matchSorted(queries);
+}
+
+uint256 GolombCodedSet::hashOutPoint(const uint256 &txid, int outIndex)
+{
+    unsigned char index[4];
+    WriteLE32(index, static_cast<uint32_t>(outIndex));
+    uint256 answer;
+    CSHA256().Write(txid.begin(), 32).Write(index, 4).Finalize(answer.begin());
+    return answer;
+}
+
+uint64_t GolombCodedSet::hashToRange(const uint256 &item) const
+{
+    const uint64_t range = static_cast<uint64_t>(m_itemCount) * M;
+    return fastRange64(mix64(item.GetCheapHash() ^ m_key), range);
+}
+
+bool GolombCodedSet::matchSorted(const std::vector<uint64_t> &sortedQueries) const
+{
+    if (!m_valid || m_itemCount == 0 || sortedQueries.empty())
+        return false;
+
+    // walk the set and the queries side by side, both are sorted.
+    BitReader reader(m_data);
+    auto query = sortedQueries.begin();
+    uint64_t value = 0;
+    try {
+        for (int i = 0; i < m_itemCount; ++i) {
+            const uint64_t delta = (reader.readUnary() << P) + reader.read(P);
+            value += delta;
+            while (*query < value) {
+                if (++query == sortedQueries.end())
+                    return false;
+            }
+            if (*query == value)
+                return true;
+        }
+    } catch (const std::runtime_error &) {
+        return true; // corrupt data, we can't prove a mismatch.
+    }
+    return false;
+}
@@ -0,0 +1,87 @@
+/*
+ * This file is part of the Flowee project
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef FLOWEE_GOLOMBCODEDSET_H
+#define FLOWEE_GOLOMBCODEDSET_H
+
+#include "uint256.h"
+#include "streaming/ConstBuffer.h"
+
+#include <set>
+#include <vector>
+
+namespace Streaming {
+    class BufferPool;
+}
+
+/**
+ * A compact probabilistic set of 256-bit hashes, as used for per-block filters.
+ *
+ * Each item is mapped onto the range [0, N * M) and the sorted values are
+ * stored as Golomb-Rice coded deltas. With the parameters used (P=19, M=784931)
+ * this takes about 20 bits per item and has a false positive rate of 1/M per
+ * queried item.
+ *
+ * The items are expected to be hashes already (script-hashes, see hashOutPoint()),
+ * they are mixed with the \a key (typically the block-id) so a false positive in
+ * one block doesn't repeat in the next.
+ *
+ * Notice that a match may be a false positive, a non-match is always correct.
+ */
+class GolombCodedSet
+{
+public:
+    /// creates an invalid set
+    GolombCodedSet() = default;
+    /// build a new set from \a items, storing the encoded data in \a pool.
+    GolombCodedSet(const uint256 &key, const std::vector<uint256> &items, Streaming::BufferPool &pool);
+    /// load a set from previously encoded data.
+    GolombCodedSet(const uint256 &key, int itemCount, const Streaming::ConstBuffer &encoded);
+
+    /// Returns true if this set has been build or loaded.
+    bool isValid() const {
+        return m_valid;
+    }
+
+    int itemCount() const {
+        return m_itemCount;
+    }
+
+    /// The Golomb-Rice encoded data.
+    Streaming::ConstBuffer data() const {
+        return m_data;
+    }
+
+    /// Returns true if \a item is (likely) in the set.
+    bool contains(const uint256 &item) const;
+    /// Returns true if any of the \a items is (likely) in the set.
+    bool containsAny(const std::set<uint256> &items) const;
+
+    /// Creates the item to use for a spent output (txid and output index).
+    static uint256 hashOutPoint(const uint256 &txid, int outIndex);
+
+private:
+    uint64_t hashToRange(const uint256 &item) const;
+    bool matchSorted(const std::vector<uint64_t> &sortedQueries) const;
+
+    uint64_t m_key = 0;
+    int m_itemCount = 0;
+    bool m_valid = false;
+    Streaming::ConstBuffer m_data;
+};
+
+#endif
@@ -17,16 +17,21 @@
  */
 #include "Logger.h"
 #include "LogChannels_p.h"
+#include "Logger_p.h"
 #include "utiltime.h"
 #include "chainparamsbase.h"
 
+#include <algorithm>
+#include <condition_variable>
 #include <fstream>
 #include <list>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <set>
 #include <sstream>
 #include <string>
+#include <thread>
 
 #include <boost/thread.hpp>
 #include <boost/date_time/gregorian/gregorian.hpp>
@@ -46,8 +51,25 @@ struct ErrorLogger {
 };
 }
 
+namespace {
+struct RingHolder {
+    ~RingHolder() {
+        if (ring)
+            ring->orphaned = true;
+    }
+    std::shared_ptr<Log::LogRing> ring;
+    uint64_t owner = 0; // the id of the manager the ring is registered with
+};
+thread_local RingHolder s_threadRing;
+std::atomic<uint64_t> s_lastManagerId { 0 };
+}
+
 class Log::ManagerPrivate {
 public:
+    /// writes one line to all channels, requires the lock to be held.
+    void write(const LogRecord &record);
+    void writerLoop();
+
     std::list<Channel*> channels;
     std::mutex lock;
     std::string lastTime, lastDateTime;
@@ -57,8 +79,127 @@ public:
 
     bool inUnitTests = false; // if true, assumes testNameFunctor is non-empty
     std::function<const char*()> testNameFunctor;
+
+    // async logging
+    const uint64_t id = ++s_lastManagerId;
+    std::atomic<bool> async { false };
+    std::atomic<int> producers { 0 }; // threads that may be pushing into a ring
+    std::atomic<uint64_t> droppedLines { 0 };
+    std::mutex asyncLock; // serializes setAsync()
+    std::thread writer;
+    std::mutex ringsLock; // protects 'rings'
+    std::list<std::shared_ptr<LogRing>> rings;
+
+    // waking up the writer
+    void wakeWriter();
+    std::atomic<bool> hasWork { false };
+    bool stopWriter = false; // protected by wakeLock
+    std::mutex wakeLock;
+    std::condition_variable wakeup;
 };
 
+void Log::ManagerPrivate::wakeWriter()
+{
+    // only the first producer after the writer started a round has to notify.
+    if (!hasWork.exchange(true, std::memory_order_acq_rel)) {
+        std::lock_guard<std::mutex> lock(wakeLock);
+        wakeup.notify_one();
+    }
+}
+
+void Log::ManagerPrivate::write(const LogRecord &record)
+{
+    std::string newTime;
+    std::string newDateTime;
+    for (auto channel : channels) {
+        std::string *timeStamp = nullptr;
+        switch (channel->timeStampFormat()) {
+        case Channel::NoTime: break;
+        case Channel::DateTime:
+            if (newDateTime.empty()) {
+                newDateTime = DateTimeStrFormat("%Y-%m-%d %H:%M:%S", record.timeMillis/1000);
+                if (channel->showSubSecondPrecision() && newDateTime == lastDateTime) {
+                    std::ostringstream millis;
+                    millis << std::setw(3) << record.timeMillis % 1000;
+                    newDateTime = "               ." + millis.str();
+                } else {
+                    lastDateTime = newDateTime;
+                }
+            }
+            timeStamp = &newDateTime;
+            break;
+        case Channel::TimeOnly:
+            if (newTime.empty()) {
+                newTime = DateTimeStrFormat("%H:%M:%S", record.timeMillis/1000);
+                if (channel->showSubSecondPrecision() && newTime == lastTime) {
+                    std::ostringstream millis;
+                    millis << std::setw(3) << record.timeMillis % 1000;
+                    newTime = "    ." + millis.str();
+                } else {
+                    lastTime = newTime;
+                }
+            }
+            timeStamp = &newTime;
+            break;
+        }
+        try {
+            channel->pushLog(record.timeMillis, timeStamp, record.line, record.filename, record.lineNumber,
+                             record.methodName, record.section, record.verbosity);
+        } catch (...) {}
+    }
+}
+
+void Log::ManagerPrivate::writerLoop()
+{
+    std::vector<LogRecord> batch;
+    uint64_t reportedDrops = droppedLines.load();
+    while (true) {
+        bool stopping;
+        {
+            std::unique_lock<std::mutex> lock(wakeLock);
+            wakeup.wait(lock, [this] { return stopWriter || hasWork.load(); });
+            stopping = stopWriter;
+        }
+        // clearing this before draining makes any later push wake us again.
+        hasWork.exchange(false, std::memory_order_acq_rel);
+        {
+            std::lock_guard<std::mutex> ringLock(ringsLock);
+            for (auto iter = rings.begin(); iter != rings.end();) {
+                // check before draining, the thread may still push till it exits.
+                const bool orphaned = (*iter)->orphaned;
+                (*iter)->drain(batch);
+                if (orphaned)
+                    iter = rings.erase(iter);
+                else
+                    ++iter;
+            }
+        }
+        const uint64_t drops = droppedLines.load();
+        if (!batch.empty() || drops != reportedDrops) {
+            // each thread has its own ring, put the lines from all threads in order.
+            std::stable_sort(batch.begin(), batch.end(), [](const LogRecord &a, const LogRecord &b) {
+                return a.timeMillis < b.timeMillis;
+            });
+            std::lock_guard<std::mutex> channelLock(lock);
+            for (const auto &record : batch) {
+                write(record);
+            }
+            if (drops != reportedDrops) {
+                LogRecord record;
+                record.timeMillis = GetTimeMillis();
+                record.line = "Logger dropped " + std::to_string(drops - reportedDrops)
+                        + " lines, the async buffers were full";
+                record.verbosity = Log::WarningLevel;
+                write(record);
+                reportedDrops = drops;
+            }
+            batch.clear();
+        }
+        if (stopping)
+            break;
+    }
+}
+
 Log::Manager::Manager()
     : d(new ManagerPrivate())
 {
@@ -114,6 +255,7 @@ Log::Manager::Manager()
 
 Log::Manager::~Manager()
 {
+    setAsync(false);
     clearChannels();
     delete d;
 }
@@ -159,45 +301,73 @@ Log::Manager *Log::Manager::instance()
 
 void Log::Manager::log(Log::Item *item)
 {
-    const int64_t timeMillis = GetTimeMillis();
-    std::string newTime;
-    std::string newDateTime;
-    std::lock_guard<std::mutex> lock(d->lock);
-    for (auto channel : d->channels) {
-        std::string *timeStamp = nullptr;
-        switch (channel->timeStampFormat()) {
-        case Channel::NoTime: break;
-        case Channel::DateTime:
-            if (newDateTime.empty()) {
-                newDateTime = DateTimeStrFormat("%Y-%m-%d %H:%M:%S", timeMillis/1000);
-                if (channel->showSubSecondPrecision() && newDateTime == d->lastDateTime) {
-                    std::ostringstream millis;
-                    millis << std::setw(3) << timeMillis % 1000;
-                    newDateTime = "               ." + millis.str();
-                } else {
-                    d->lastDateTime = newDateTime;
-                }
-            }
-            timeStamp = &newDateTime;
-            break;
-        case Channel::TimeOnly:
-            if (newTime.empty()) {
-                newTime = DateTimeStrFormat("%H:%M:%S", timeMillis/1000);
-                if (channel->showSubSecondPrecision() && newTime == d->lastTime) {
-                    std::ostringstream millis;
-                    millis << std::setw(3) << timeMillis % 1000;
-                    newTime = "    ." + millis.str();
-                } else {
-                    d->lastTime = newTime;
-                }
+    LogRecord record;
+    record.timeMillis = GetTimeMillis();
+    record.line = item->d->stream.str();
+    record.filename = item->d->filename;
+    record.methodName = item->d->methodName;
+    record.lineNumber = item->d->lineNum;
+    record.section = item->d->section;
+    record.verbosity = item->d->verbosity;
+
+    // fatal lines are written directly, the app is likely about to stop.
+    if (record.verbosity < Log::FatalLevel) {
+        // setAsync(false) waits for 'producers' to drop to zero before it stops the writer.
+        d->producers.fetch_add(1);
+        if (d->async.load()) {
+            if (s_threadRing.owner != d->id) {
+                if (s_threadRing.ring) // registered with another manager
+                    s_threadRing.ring->orphaned = true;
+                s_threadRing.ring = std::make_shared<LogRing>();
+                s_threadRing.owner = d->id;
+                std::lock_guard<std::mutex> lock(d->ringsLock);
+                d->rings.push_back(s_threadRing.ring);
             }
-            timeStamp = &newTime;
-            break;
+            if (!s_threadRing.ring->push(std::move(record)))
+                d->droppedLines.fetch_add(1, std::memory_order_relaxed);
+            d->wakeWriter();
+            d->producers.fetch_sub(1);
+            return;
         }
-        try {
-            channel->pushLog(timeMillis, timeStamp, item->d->stream.str(), item->d->filename, item->d->lineNum, item->d->methodName, item->d->section, item->d->verbosity);
-        } catch (...) {}
+        d->producers.fetch_sub(1);
     }
+    std::lock_guard<std::mutex> lock(d->lock);
+    d->write(record);
+}
+
+void Log::Manager::setAsync(bool on)
+{
+    std::lock_guard<std::mutex> asyncLock(d->asyncLock);
+    if (on == d->async)
+        return;
+    if (on) {
+        d->stopWriter = false;
+        d->writer = std::thread(&ManagerPrivate::writerLoop, d);
+        d->async = true;
+    } else {
+        d->async = false;
+        // A thread that saw async mode before we turned it off may still be pushing,
+        // wait for it so the last drain of the writer includes its line.
+        while (d->producers.load() > 0)
+            std::this_thread::yield();
+        {
+            std::lock_guard<std::mutex> lock(d->wakeLock);
+            d->stopWriter = true;
+        }
+        d->wakeup.notify_one();
+        if (d->writer.joinable())
+            d->writer.join();
+    }
+}
+
+bool Log::Manager::isAsync() const
+{
+    return d->async;
+}
+
+uint64_t Log::Manager::droppedLines() const
+{
+    return d->droppedLines;
 }
 
 void Log::Manager::reopenLogFiles()
@@ -232,8 +402,9 @@ void Log::Manager::loadDefaultTestSetup(const std::function<const char*()> &test
 void Log::Manager::parseConfig(const boost::filesystem::path &configfile, const boost::filesystem::path &logfilename)
 {
     ErrorLogger errorLogger; // logging only after the lock has been released and we are sure that everything is initialized.
-    std::lock_guard<std::mutex> lock(d->lock);
+    std::unique_lock<std::mutex> lock(d->lock);
     d->enabledSections.clear();
+    bool async = false;
 
     clearChannels();
     Log::Channel *channel = nullptr;
@@ -269,6 +440,10 @@ void Log::Manager::parseConfig(const boost::filesystem::path &configfile, const
                     d->channels.push_back(channel);
                 continue;
             }
+            if (line.find("async") == 0) {
+                async = InterpretBool(line.substr(5));
+                continue;
+            }
             if (line.find("option") == 0) {
                 std::string type = line.substr(6);
                 std::string cleaned = boost::trim_copy(type);
@@ -355,6 +530,9 @@ void Log::Manager::parseConfig(const boost::filesystem::path &configfile, const
 
     if (!loadedConsoleLog && fallbackToConsole)
         d->channels.push_back(new ConsoleLogChannel());
+
+    lock.unlock(); // the writer thread needs it
+    setAsync(async);
 }
 
 const std::string &Log::Manager::sectionString(short section)
@@ -382,6 +560,13 @@ void Log::Manager::addConsoleChannel(bool printSections)
     d->channels.push_back(channel);
 }
 
+void Log::Manager::addChannel(Log::Channel *channel)
+{
+    assert(channel);
+    std::lock_guard<std::mutex> lock(d->lock);
+    d->channels.push_back(channel);
+}
+
 void Log::Manager::addFileChannel(const boost::filesystem::path &logfilename, bool printSections)
 {
     auto channel = new FileLogChannel(logfilename);
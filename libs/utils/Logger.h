@@ -153,6 +153,19 @@ public:
     /// This is only called by the Item to log its data on the logging channels.
     void log(Item *item);
 
+    /**
+     * In async mode the logging thread doesn't write the log lines itself, it
+     * hands them to a writer thread using a lock-free per-thread buffer.
+     * When a buffer is full, lines are dropped (and counted) instead of
+     * making the logging thread wait.
+     * Fatal lines are always written directly.
+     */
+    void setAsync(bool on);
+    /// Returns true if async mode is enabled, see setAsync()
+    bool isAsync() const;
+    /// Returns the amount of lines dropped because an async buffer was full.
+    uint64_t droppedLines() const;
+
     /// Request files to be closed and opened anew.
     void reopenLogFiles();
 
@@ -188,6 +201,9 @@ public:
      *     # path is optional, default goes to XDG dir (~/.local/share/flowee/app/app.log)
      *     option path [path]
      *
+     * # write the logs from a separate thread. Lines are dropped if it can't keep up.
+     * async true
+     *
      * # Log sections from Log::Sections and verbosity
      * # default value for all log sections that are not specifically added here is `warning`
      * 1000 quiet   # multiple of 1000 is a group, changes apply to all unset items in that group (1000-1999)
@@ -214,6 +230,8 @@ public:
     void addConsoleChannel(bool printSections = true);
     /// add a file logging channel
     void addFileChannel(const boost::filesystem::path &logfilename, bool printSections = true);
+    /// add a custom channel, the manager takes ownership.
+    void addChannel(Channel *channel);
 
     void clearLogLevels(Log::Verbosity defaultVerbosity = Log::WarningLevel);
     void setLogLevel(short section, Log::Verbosity verbosity);
@@ -0,0 +1,90 @@
+/*
+ * This file is part of the Flowee project
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LOGGER_P_H
+#define LOGGER_P_H
+
+/*
+ * WARNING USAGE OF THIS HEADER IS RESTRICTED.
+ * This Header file is part of the private API and is meant to be used solely by the Logger component.
+ *
+ * Usage of this API will likely mean your code will break in interesting ways in the future,
+ * or even stop to compile.
+ *
+ * YOU HAVE BEEN WARNED!!
+ */
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Log {
+
+/// One log line, as handed from a logging thread to the async writer.
+struct LogRecord {
+    int64_t timeMillis = 0;
+    std::string line;
+    const char *filename = nullptr;
+    const char *methodName = nullptr;
+    int lineNumber = 0;
+    short section = 0;
+    short verbosity = 0;
+};
+
+/*
+ * A single-producer, single-consumer ring buffer of log records.
+ * Each thread that logs in async mode owns one, the writer thread is the consumer.
+ */
+class LogRing
+{
+public:
+    enum { Capacity = 2048 };
+
+    /// called by the owning thread only, returns false if the ring is full.
+    bool push(LogRecord &&record) {
+        const uint32_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == Capacity)
+            return false;
+        m_records[tail % Capacity] = std::move(record);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// called by the writer thread only.
+    void drain(std::vector<LogRecord> &out) {
+        const uint32_t tail = m_tail.load(std::memory_order_acquire);
+        uint32_t head = m_head.load(std::memory_order_relaxed);
+        for (; head != tail; ++head) {
+            out.push_back(std::move(m_records[head % Capacity]));
+        }
+        m_head.store(head, std::memory_order_release);
+    }
+
+    /// set when the owning thread exited.
+    std::atomic<bool> orphaned { false };
+
+private:
+    std::array<LogRecord, Capacity> m_records;
+    std::atomic<uint32_t> m_head { 0 };
+    std::atomic<uint32_t> m_tail { 0 };
+};
+
+}
+
+#endif
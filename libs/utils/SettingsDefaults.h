@@ -64,6 +64,9 @@ constexpr uint64_t DefaultMaxUploadTarget = 0;
 /** The maximum number of peer connections to maintain. */
 constexpr uint32_t DefaultMaxPeerConnections = 125;
 
+/** The number of threads processing messages from legacy peers. */
+constexpr int DefaultMessageHandlerThreads = 4;
+
 /** The default minimum number of thin nodes to connect to */
 constexpr int DefaultMinThinPeers = 0;
 
@@ -88,6 +91,9 @@ constexpr bool DefaultWhitelistForceRelay = true;
 /** Default for -maxorphantx, maximum number of orphan transactions kept in memory */
 constexpr uint32_t DefaultMaxOrphanTransactions = 5000;
 
+/** Default for -maxorphantxsize, maximum megabytes of orphan transactions kept in memory */
+constexpr uint32_t DefaultMaxOrphanTransactionsSize = 50;
+
 /** Default for -maxmempool, maximum megabytes of mempool memory usage */
 constexpr uint32_t DefaultMaxMempoolSize = 300;
 
@@ -0,0 +1,313 @@
+/*
+ * This file is part of the Flowee project
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "TimerWheel.h"
+#include "Logger.h"
+
+#include <boost/asio/deadline_timer.hpp>
+
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+namespace {
+constexpr int Levels = 4;
+constexpr int SlotBits = 6;
+constexpr int Slots = 1 << SlotBits;
+constexpr uint64_t SlotMask = Slots - 1;
+// the amount of ticks the entire wheel covers, tasks further out are parked in the last level.
+constexpr uint64_t MaxTicks = uint64_t(1) << (SlotBits * Levels);
+}
+
+class TimerWheelPrivate;
+// the wheel whose task the current thread is running, if any.
+static thread_local const TimerWheelPrivate *s_runningWheel = nullptr;
+
+struct TimerWheel::Task
+{
+    TimerWheel::Function function;
+    uint64_t interval = 0; // in ticks, zero for single-shot tasks
+    uint64_t expiry = 0; // in ticks
+    std::atomic<bool> active { true };
+};
+
+typedef std::shared_ptr<TimerWheel::Task> TaskPtr;
+
+class TimerWheelPrivate : public std::enable_shared_from_this<TimerWheelPrivate>
+{
+public:
+    TimerWheelPrivate(boost::asio::io_service &service, int tickMs)
+        : ioService(service),
+        timer(service),
+        // tick zero is in the past, that way a scheduled task never lands on it.
+        start(boost::posix_time::microsec_clock::universal_time() - boost::posix_time::milliseconds(tickMs)),
+        tickMs(tickMs)
+    {
+        assert(tickMs > 0);
+    }
+
+    /// returns the tick that \a ms milliseconds from now falls in, rounded up.
+    uint64_t tickFromNow(int64_t ms) const {
+        const int64_t tickUs = tickMs * 1000;
+        const int64_t elapsed = std::max<int64_t>(0, (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds());
+        const int64_t tick = (elapsed + std::max<int64_t>(0, ms) * 1000 + tickUs - 1) / tickUs;
+        return std::max<uint64_t>(next, static_cast<uint64_t>(tick));
+    }
+
+    // this and the below methods expect the lock to be held
+    void insert(const TaskPtr &task) {
+        assert(task->expiry >= next);
+        uint64_t expiry = task->expiry;
+        if (expiry - next >= MaxTicks)
+            expiry = next + MaxTicks - 1;
+        const uint64_t delta = expiry - next;
+        int level = 0;
+        while (level < Levels - 1 && delta >= (uint64_t(1) << (SlotBits * (level + 1))))
+            ++level;
+        slots[level][(expiry >> (SlotBits * level)) & SlotMask].push_back(task);
+        ++levelCount[level];
+    }
+
+    // move the tasks in the slot of \a level that tick \a t starts into the lower levels.
+    void cascade(int level, uint64_t t) {
+        std::vector<TaskPtr> tasks;
+        tasks.swap(slots[level][(t >> (SlotBits * level)) & SlotMask]);
+        levelCount[level] -= tasks.size();
+        for (auto &task : tasks) {
+            if (task->active)
+                insert(task);
+        }
+    }
+
+    // process all ticks that passed, appending the expired tasks to \a expired
+    void advance(std::vector<TaskPtr> &expired) {
+        const int64_t elapsed = (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds();
+        const uint64_t now = static_cast<uint64_t>(std::max<int64_t>(0, elapsed / (tickMs * 1000)));
+        while (next <= now) {
+            if (size() == 0) { // nothing to do, skip ahead
+                next = now + 1;
+                break;
+            }
+            const uint64_t t = next;
+            for (int level = 1; level < Levels; ++level) {
+                if (((t >> (SlotBits * (level - 1))) & SlotMask) != 0)
+                    break;
+                cascade(level, t);
+            }
+            auto &slot = slots[0][t & SlotMask];
+            levelCount[0] -= slot.size();
+            for (auto &task : slot) {
+                if (task->active)
+                    expired.push_back(std::move(task));
+            }
+            slot.clear();
+            ++next;
+        }
+    }
+
+    // (re)start the timer to wake us up at the first tick that needs processing.
+    void arm() {
+        if (stopped || size() == 0)
+            return;
+        uint64_t wakeup = 0;
+        if (levelCount[0] > 0) {
+            // all tasks in level zero expire within one rotation.
+            for (uint64_t t = next; t < next + Slots; ++t) {
+                if (!slots[0][t & SlotMask].empty()) {
+                    wakeup = t;
+                    break;
+                }
+            }
+        }
+        if (levelCount[0] < size()) { // the next cascade
+            const uint64_t cascadeTick = (next + SlotMask) & ~SlotMask;
+            if (wakeup == 0 || cascadeTick < wakeup)
+                wakeup = cascadeTick;
+        }
+        assert(wakeup >= next);
+        if (armedTick != 0 && armedTick <= wakeup)
+            return;
+        armedTick = wakeup;
+        timer.expires_at(start + boost::posix_time::milliseconds(wakeup * tickMs));
+        timer.async_wait(std::bind(&TimerWheelPrivate::timerFired, shared_from_this(), std::placeholders::_1));
+    }
+
+    void timerFired(const boost::system::error_code &error) {
+        if (error)
+            return;
+        std::vector<TaskPtr> expired;
+        {
+            std::lock_guard<std::mutex> locker(lock);
+            if (stopped)
+                return;
+            armedTick = 0;
+            advance(expired);
+            arm();
+        }
+        auto me = shared_from_this();
+        for (auto &task : expired) {
+            ioService.post(std::bind(&TimerWheelPrivate::run, me, task));
+        }
+    }
+
+    void run(const TaskPtr &task) {
+        {
+            // stop() waits for 'running' to drop to zero
+            std::lock_guard<std::mutex> locker(runLock);
+            if (stopped || !task->active)
+                return;
+            ++running;
+        }
+        if (task->interval == 0)
+            task->active = false;
+        const TimerWheelPrivate *previous = s_runningWheel;
+        s_runningWheel = this;
+        try {
+            task->function();
+        } catch (const std::exception &e) {
+            logCritical() << "TimerWheel: task threw" << e;
+        }
+        s_runningWheel = previous;
+        {
+            std::lock_guard<std::mutex> locker(runLock);
+            --running;
+            taskFinished.notify_all();
+        }
+        if (task->interval > 0 && task->active) {
+            std::lock_guard<std::mutex> locker(lock);
+            if (stopped)
+                return;
+            task->expiry = tickFromNow(0) + task->interval;
+            insert(task);
+            arm();
+        }
+    }
+
+    size_t size() const {
+        size_t answer = 0;
+        for (int i = 0; i < Levels; ++i) {
+            answer += levelCount[i];
+        }
+        return answer;
+    }
+
+    boost::asio::io_service &ioService;
+    mutable std::mutex lock;
+    boost::asio::deadline_timer timer;
+    const boost::posix_time::ptime start;
+    const int tickMs;
+    uint64_t next = 1; // the next tick to process
+    uint64_t armedTick = 0; // the tick the timer is waiting for, zero if it is not waiting
+    std::vector<TaskPtr> slots[Levels][Slots];
+    size_t levelCount[Levels] = { 0, 0, 0, 0 };
+    std::atomic<bool> stopped { false };
+
+    std::mutex runLock; // protects 'running'
+    std::condition_variable taskFinished;
+    int running = 0; // the amount of tasks running right now
+};
+
+
+TimerWheel::Handle::Handle(const std::shared_ptr<TimerWheel::Task> &task)
+    : m_task(task)
+{
+}
+
+bool TimerWheel::Handle::cancel()
+{
+    auto task = m_task.lock();
+    if (!task)
+        return false;
+    return task->active.exchange(false);
+}
+
+bool TimerWheel::Handle::isActive() const
+{
+    auto task = m_task.lock();
+    return task && task->active;
+}
+
+
+TimerWheel::TimerWheel(boost::asio::io_service &service, int tickMs)
+    : d(std::make_shared<TimerWheelPrivate>(service, tickMs))
+{
+}
+
+TimerWheel::~TimerWheel()
+{
+    stop();
+}
+
+TimerWheel::Handle TimerWheel::schedule(const Function &function, int64_t delayMs)
+{
+    return insert(function, delayMs, 0);
+}
+
+TimerWheel::Handle TimerWheel::scheduleEvery(const Function &function, int64_t intervalMs)
+{
+    assert(intervalMs > 0);
+    return insert(function, intervalMs, intervalMs);
+}
+
+TimerWheel::Handle TimerWheel::insert(const Function &function, int64_t delayMs, int64_t intervalMs)
+{
+    auto task = std::make_shared<Task>();
+    task->function = function;
+    std::lock_guard<std::mutex> locker(d->lock);
+    if (d->stopped) {
+        task->active = false;
+        return Handle(task);
+    }
+    if (intervalMs > 0)
+        task->interval = static_cast<uint64_t>(std::max<int64_t>(1, (intervalMs + d->tickMs - 1) / d->tickMs));
+    task->expiry = d->tickFromNow(delayMs);
+    d->insert(task);
+    d->arm();
+    return Handle(task);
+}
+
+void TimerWheel::stop()
+{
+    {
+        std::unique_lock<std::mutex> runLocker(d->runLock);
+        d->stopped = true;
+        // wait for the tasks that are running, except the one calling us.
+        const int self = s_runningWheel == d.get() ? 1 : 0;
+        d->taskFinished.wait(runLocker, [this, self] { return d->running <= self; });
+    }
+    std::lock_guard<std::mutex> locker(d->lock);
+    for (int level = 0; level < Levels; ++level) {
+        for (int slot = 0; slot < Slots; ++slot) {
+            for (auto &task : d->slots[level][slot]) {
+                task->active = false;
+            }
+            d->slots[level][slot].clear();
+        }
+        d->levelCount[level] = 0;
+    }
+    d->armedTick = 0;
+    boost::system::error_code error;
+    d->timer.cancel(error);
+}
+
+size_t TimerWheel::size() const
+{
+    std::lock_guard<std::mutex> locker(d->lock);
+    return d->size();
+}
@@ -0,0 +1,98 @@
+/*
+ * This file is part of the Flowee project
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <boost/asio/io_service.hpp>
+
+#include <functional>
+#include <memory>
+
+class TimerWheelPrivate;
+
+/**
+ * A hierarchical timer wheel that runs tasks on an io_service.
+ *
+ * Scheduling and cancelling a task are constant-time operations. Time is counted in
+ * ticks and tasks are sorted into 4 levels of 64 slots each, the first level has one
+ * slot per tick, every next level's slots cover 64 times as many ticks as the previous.
+ * Tasks move down a level when the wheel below it wraps around.
+ *
+ * The wheel does not have a thread of its own, it uses a single asio timer that is
+ * only armed when there is something to do. Tasks are posted to the io_service when
+ * they expire, which means that tasks can run in parallel on a multi-threaded io_service.
+ */
+class TimerWheel
+{
+public:
+    typedef std::function<void()> Function;
+    struct Task;
+
+    /**
+     * A handle to a scheduled task, allowing the task to be cancelled.
+     * Handles are cheap to copy and stay valid after the wheel is deleted.
+     */
+    class Handle
+    {
+    public:
+        Handle() = default;
+
+        /// Stop the task from running (again), returns false if it was not scheduled.
+        bool cancel();
+        /// returns true if the task is still waiting to be ran.
+        bool isActive() const;
+
+    private:
+        friend class TimerWheel;
+        explicit Handle(const std::shared_ptr<Task> &task);
+        std::weak_ptr<Task> m_task;
+    };
+
+    /**
+     * Create a wheel with a resolution of \a tickMs milliseconds.
+     * Tasks never run before their time, but may run up to one tick late.
+     */
+    explicit TimerWheel(boost::asio::io_service &service, int tickMs = 100);
+    ~TimerWheel();
+
+    /// Run \a function once, \a delayMs milliseconds from now.
+    Handle schedule(const Function &function, int64_t delayMs);
+
+    /**
+     * Run \a function every \a intervalMs milliseconds, starting intervalMs from now.
+     * The task is rescheduled after it finished running, so a slow task
+     * will never run in parallel with itself.
+     */
+    Handle scheduleEvery(const Function &function, int64_t intervalMs);
+
+    /**
+     * Cancel all tasks, no tasks will be started after this returns.
+     * Tasks that are already running are waited for, unless stop() is called from one of them.
+     */
+    void stop();
+
+    /// Returns the amount of scheduled tasks, including cancelled tasks that have not expired yet.
+    size_t size() const;
+
+private:
+    Handle insert(const Function &function, int64_t delayMs, int64_t intervalMs);
+
+    std::shared_ptr<TimerWheelPrivate> d;
+};
+
+#endif
@@ -20,6 +20,55 @@
 #include <hash.h>
 #include <primitives/pubkey.h>
 #include <primitives/transaction.h>
+#include <streaming/BufferPool.h>
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace {
+/*
+ * Call \a job for each number in [0, count) using up to \a threadCount threads.
+ * The calling thread participates, the first exception thrown by a job is rethrown.
+ */
+void runParallel(size_t count, int threadCount, const std::function<void(size_t)> &job)
+{
+    if (threadCount <= 0)
+        threadCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    threadCount = static_cast<int>(std::min<size_t>(static_cast<size_t>(threadCount), count));
+    std::atomic<size_t> next(0);
+    std::exception_ptr error;
+    std::mutex errorLock;
+    auto worker = [&]() {
+        while (true) {
+            const size_t i = next++;
+            if (i >= count)
+                return;
+            try {
+                job(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(errorLock);
+                if (!error)
+                    error = std::current_exception();
+                next = count; // stop the others
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int i = 1; i < threadCount; ++i) {
+        threads.push_back(std::thread(worker));
+    }
+    worker();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    if (error)
+        std::rethrow_exception(error);
+}
+}
 
 
 class TransactionBuilderPrivate
@@ -28,6 +77,19 @@ public:
     void checkCurInput();
     void checkCurOutput();
 
+    /// The parts of the (FORKID) signature-hash that are shared between inputs.
+    struct SigHashMidstate {
+        uint256 hashPrevouts;
+        uint256 hashSequence;
+        uint256 hashOutputs;
+    };
+    SigHashMidstate createMidstate() const;
+    inline bool canSign(size_t input) const {
+        return !signInfo[input].prevOutScript.empty();
+    }
+    /// Sign \a input, this only touches the scriptSig of that input so inputs can be signed in parallel.
+    void signInput(size_t input, const SigHashMidstate &midstate);
+
     CMutableTransaction transaction;
 
     TransactionBuilder::LockingOptions defaultLocking = TransactionBuilder::NoLocking;
@@ -222,64 +284,132 @@ Tx TransactionBuilder::createTransaction(Streaming::BufferPool *pool)
 {
     // sign all inputs we can.
     assert(d->transaction.vin.size() == d->signInfo.size());
+    TransactionBuilderPrivate::SigHashMidstate midstate;
+    bool first = true;
     for (size_t i = 0; i < d->transaction.vin.size(); ++i) {
-        const TransactionBuilderPrivate::SignInfo &si = d->signInfo[i];
-        if (si.prevOutScript.empty())
+        if (!d->canSign(i))
             continue;
-
-        uint256 hashPrevouts;
-        if (!(si.hashType & SignOnlyThisInput)) {
-            CHashWriter ss(SER_GETHASH, 0);
-            for (size_t n = 0; n < d->transaction.vin.size(); ++n) {
-                ss << d->transaction.vin[n].prevout;
-            }
-            hashPrevouts = ss.finalizeHash();
-        }
-        uint256 hashSequence;
-        if (!(si.hashType & SignOnlyThisInput) && (si.hashType & 0x1f) != SignSingleOutput
-                && (si.hashType & 0x1f) != SignNoOutputs) {
-            CHashWriter ss(SER_GETHASH, 0);
-            for (size_t n = 0; n < d->transaction.vin.size(); ++n) {
-                ss << d->transaction.vin[n].nSequence;
-            }
-            hashSequence = ss.finalizeHash();
+        if (first) {
+            midstate = d->createMidstate();
+            first = false;
         }
-        uint256 hashOutputs;
-        if ((si.hashType & 0x1f) != SignSingleOutput && (si.hashType & 0x1f) != SignNoOutputs) {
-            CHashWriter ss(SER_GETHASH, 0);
-            for (size_t n = 0; n < d->transaction.vout.size(); ++n) {
-                ss << d->transaction.vout[n];
-            }
-            hashOutputs = ss.finalizeHash();
-        } else if ((si.hashType & 0x1f) == SignSingleOutput && i < d->transaction.vout.size()) {
-            CHashWriter ss(SER_GETHASH, 0);
-            ss << d->transaction.vout[i];
-            hashOutputs = ss.finalizeHash();
+        d->signInput(i, midstate);
+    }
+
+    return Tx::fromOldTransaction(d->transaction, pool);
+}
+
+std::vector<Tx> TransactionBuilder::createTransactions(const std::vector<TransactionBuilder *> &builders, Streaming::BufferPool *pool, int threadCount)
+{
+    // one job per input, pointing to the transaction in toSign.
+    typedef std::pair<size_t, size_t> Job;
+    std::vector<Job> jobs;
+    std::vector<TransactionBuilderPrivate*> toSign;
+    for (auto builder : builders) {
+        assert(builder);
+        TransactionBuilderPrivate *d = builder->d;
+        assert(d->transaction.vin.size() == d->signInfo.size());
+        const size_t before = jobs.size();
+        for (size_t i = 0; i < d->transaction.vin.size(); ++i) {
+            if (d->canSign(i))
+                jobs.push_back(std::make_pair(toSign.size(), i));
         }
+        if (jobs.size() > before)
+            toSign.push_back(d);
+    }
 
-        // use FORKID based creation of the hash we will sign.
+    if (!jobs.empty()) {
+        std::vector<TransactionBuilderPrivate::SigHashMidstate> midstates(toSign.size());
+        runParallel(toSign.size(), threadCount, [&](size_t index) {
+            midstates[index] = toSign.at(index)->createMidstate();
+        });
+        runParallel(jobs.size(), threadCount, [&](size_t index) {
+            const Job &job = jobs.at(index);
+            toSign.at(job.first)->signInput(job.second, midstates.at(job.first));
+        });
+    }
+
+    // serialize them all into one buffer.
+    std::unique_ptr<Streaming::BufferPool> localPool;
+    if (pool == nullptr) {
+        localPool.reset(new Streaming::BufferPool());
+        pool = localPool.get();
+    }
+    CSizeComputer sc(0, 0);
+    for (auto builder : builders) {
+        sc << builder->d->transaction;
+    }
+    pool->reserve(static_cast<int>(sc.size()));
+    std::vector<Tx> answer;
+    answer.reserve(builders.size());
+    for (auto builder : builders) {
+        builder->d->transaction.Serialize(*pool, 0, 0);
+        answer.push_back(Tx(pool->commit()));
+    }
+    return answer;
+}
+
+TransactionBuilderPrivate::SigHashMidstate TransactionBuilderPrivate::createMidstate() const
+{
+    SigHashMidstate answer;
+    CHashWriter prevouts(SER_GETHASH, 0);
+    CHashWriter sequences(SER_GETHASH, 0);
+    for (size_t n = 0; n < transaction.vin.size(); ++n) {
+        prevouts << transaction.vin[n].prevout;
+        sequences << transaction.vin[n].nSequence;
+    }
+    answer.hashPrevouts = prevouts.finalizeHash();
+    answer.hashSequence = sequences.finalizeHash();
+    CHashWriter outputs(SER_GETHASH, 0);
+    for (size_t n = 0; n < transaction.vout.size(); ++n) {
+        outputs << transaction.vout[n];
+    }
+    answer.hashOutputs = outputs.finalizeHash();
+    return answer;
+}
+
+void TransactionBuilderPrivate::signInput(size_t i, const SigHashMidstate &midstate)
+{
+    const SignInfo &si = signInfo[i];
+    assert(!si.prevOutScript.empty());
+    const int outputs = si.hashType & 0x1f;
+    const bool allInputs = !(si.hashType & TransactionBuilder::SignOnlyThisInput);
+
+    uint256 hashPrevouts;
+    if (allInputs)
+        hashPrevouts = midstate.hashPrevouts;
+    uint256 hashSequence;
+    if (allInputs && outputs != TransactionBuilder::SignSingleOutput && outputs != TransactionBuilder::SignNoOutputs)
+        hashSequence = midstate.hashSequence;
+    uint256 hashOutputs;
+    if (outputs != TransactionBuilder::SignSingleOutput && outputs != TransactionBuilder::SignNoOutputs) {
+        hashOutputs = midstate.hashOutputs;
+    } else if (outputs == TransactionBuilder::SignSingleOutput && i < transaction.vout.size()) {
         CHashWriter ss(SER_GETHASH, 0);
-        ss << d->transaction.nVersion << hashPrevouts << hashSequence;
-        ss << d->transaction.vin[i].prevout;
-        ss << static_cast<const CScriptBase &>(si.prevOutScript);
-        ss << si.amount << d->transaction.vin[i].nSequence << hashOutputs;
-        ss << d->transaction.nLockTime << (int) si.hashType;
-        const uint256 hash = ss.finalizeHash();
-
-        // the rest assumes P2PKH for now.
-        std::vector<unsigned char> vchSig;
-        if (si.signatureType == ECDSA)
-            si.privKey.signECDSA(hash, vchSig);
-        else
-            si.privKey.signSchnorr(hash, vchSig);
-        vchSig.push_back((uint8_t) si.hashType);
-
-        d->transaction.vin[i].scriptSig = CScript();
-        d->transaction.vin[i].scriptSig << vchSig;
-        d->transaction.vin[i].scriptSig << ToByteVector(si.privKey.GetPubKey());
+        ss << transaction.vout[i];
+        hashOutputs = ss.finalizeHash();
     }
 
-    return Tx::fromOldTransaction(d->transaction, pool);
+    // use FORKID based creation of the hash we will sign.
+    CHashWriter ss(SER_GETHASH, 0);
+    ss << transaction.nVersion << hashPrevouts << hashSequence;
+    ss << transaction.vin[i].prevout;
+    ss << static_cast<const CScriptBase &>(si.prevOutScript);
+    ss << si.amount << transaction.vin[i].nSequence << hashOutputs;
+    ss << transaction.nLockTime << (int) si.hashType;
+    const uint256 hash = ss.finalizeHash();
+
+    // the rest assumes P2PKH for now.
+    std::vector<unsigned char> vchSig;
+    if (si.signatureType == TransactionBuilder::ECDSA)
+        si.privKey.signECDSA(hash, vchSig);
+    else
+        si.privKey.signSchnorr(hash, vchSig);
+    vchSig.push_back((uint8_t) si.hashType);
+
+    transaction.vin[i].scriptSig = CScript();
+    transaction.vin[i].scriptSig << vchSig;
+    transaction.vin[i].scriptSig << ToByteVector(si.privKey.GetPubKey());
 }
 
 void TransactionBuilderPrivate::checkCurInput()
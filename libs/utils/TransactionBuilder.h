@@ -239,6 +239,20 @@ public:
      */
     Tx createTransaction(Streaming::BufferPool *pool = nullptr);
 
+    /**
+     * Render and sign many transactions in one go.
+     *
+     * This does the same as calling createTransaction() on each of the \a builders, but the
+     * signing of all their inputs is spread over \a threadCount threads, with the default
+     * of zero using one thread per core. The signature-hash parts shared between inputs
+     * are calculated only once per transaction.
+     *
+     * The returned transactions are in the same order as the builders and share one
+     * buffer allocated from \a pool, or from a new pool if none is passed.
+     */
+    static std::vector<Tx> createTransactions(const std::vector<TransactionBuilder*> &builders,
+                                              Streaming::BufferPool *pool = nullptr, int threadCount = 0);
+
     /// Signatures imported may break because we removed/added or altered parts that signature relied on.
     /// This method returns which inputs used to have signatures that likely stopped working.
     // std::set<int> brokenSignatures() const;
@@ -25,7 +25,11 @@
 #include "random.h"
 #include "streaming/streams.h"
 
+#include <crypto/common.h>
+
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 
 #include <streaming/P2PBuilder.h>
 
@@ -68,73 +72,92 @@ bool CBloomFilter::isEmpty() const
     return m_isEmpty;
 }
 
-uint32_t CBloomFilter::hash(uint32_t nHashNum, const std::vector<uint8_t> &vDataToHash) const
-{
-    // 0xFBA4C795 chosen as it guarantees a reasonable bit difference between nHashNum values.
-    return MurmurHash3(nHashNum * 0xFBA4C795 + m_tweak, vDataToHash) % (m_data.size() * 8);
-}
+// 0xFBA4C795 chosen as it guarantees a reasonable bit difference between nHashNum values.
+constexpr uint32_t SeedStep = 0xFBA4C795;
 
-void CBloomFilter::insert(const std::vector<unsigned char> &vKey)
+void CBloomFilter::insert(const unsigned char *data, size_t size)
 {
     if (m_isFull)
         return;
-    for (unsigned int i = 0; i < m_numHashFuncs; i++)
-    {
-        unsigned int nIndex = hash(i, vKey);
-        // Sets bit nIndex of vData
-        m_data[nIndex >> 3] |= (1 << (7 & nIndex));
+    const MurmurHash3Multi hasher(data, size);
+    const uint32_t bitCount = m_data.size() * 8;
+    uint32_t hashes[MurmurHash3Multi::Lanes];
+    for (uint32_t i = 0; i < m_numHashFuncs; i += MurmurHash3Multi::Lanes) {
+        hasher.hash(i * SeedStep + m_tweak, SeedStep, hashes);
+        const uint32_t count = std::min<uint32_t>(MurmurHash3Multi::Lanes, m_numHashFuncs - i);
+        for (uint32_t lane = 0; lane < count; ++lane) {
+            const uint32_t index = hashes[lane] % bitCount;
+            m_data[index >> 3] |= (1 << (7 & index));
+        }
     }
     m_isEmpty = false;
 }
 
+bool CBloomFilter::contains(const unsigned char *data, size_t size) const
+{
+    if (m_isFull)
+        return true;
+    if (m_isEmpty)
+        return false;
+    const MurmurHash3Multi hasher(data, size);
+    const uint32_t bitCount = m_data.size() * 8;
+    uint32_t hashes[MurmurHash3Multi::Lanes];
+    for (uint32_t i = 0; i < m_numHashFuncs; i += MurmurHash3Multi::Lanes) {
+        hasher.hash(i * SeedStep + m_tweak, SeedStep, hashes);
+        const uint32_t count = std::min<uint32_t>(MurmurHash3Multi::Lanes, m_numHashFuncs - i);
+        for (uint32_t lane = 0; lane < count; ++lane) {
+            const uint32_t index = hashes[lane] % bitCount;
+            if (!(m_data[index >> 3] & (1 << (7 & index))))
+                return false;
+        }
+    }
+    return true;
+}
+
+void CBloomFilter::insert(const std::vector<unsigned char> &vKey)
+{
+    insert(vKey.data(), vKey.size());
+}
+
+// the serialized form of an outpoint, without going through a stream
+static void writeOutPoint(const COutPoint &outpoint, unsigned char *buf)
+{
+    memcpy(buf, outpoint.hash.begin(), 32);
+    WriteLE32(buf + 32, outpoint.n);
+}
+
 void CBloomFilter::insert(const COutPoint &outpoint)
 {
-    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
-    stream << outpoint;
-    std::vector<unsigned char> data(stream.begin(), stream.end());
-    insert(data);
+    unsigned char data[36];
+    writeOutPoint(outpoint, data);
+    insert(data, sizeof(data));
 }
 
 void CBloomFilter::insert(const uint256 &hash)
 {
-    std::vector<unsigned char> data(hash.begin(), hash.end());
-    insert(data);
+    insert(hash.begin(), hash.size());
 }
 
 void CBloomFilter::insert(const Streaming::ConstBuffer &buf)
 {
-    std::vector<unsigned char> data(buf.begin(), buf.end());
-    insert(data);
+    insert(reinterpret_cast<const unsigned char*>(buf.begin()), static_cast<size_t>(buf.size()));
 }
 
 bool CBloomFilter::contains(const std::vector<unsigned char> &vKey) const
 {
-    if (m_isFull)
-        return true;
-    if (m_isEmpty)
-        return false;
-    for (unsigned int i = 0; i < m_numHashFuncs; i++)
-    {
-        unsigned int nIndex = hash(i, vKey);
-        // Checks bit nIndex of vData
-        if (!(m_data[nIndex >> 3] & (1 << (7 & nIndex))))
-            return false;
-    }
-    return true;
+    return contains(vKey.data(), vKey.size());
 }
 
 bool CBloomFilter::contains(const COutPoint &outpoint) const
 {
-    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
-    stream << outpoint;
-    std::vector<unsigned char> data(stream.begin(), stream.end());
-    return contains(data);
+    unsigned char data[36];
+    writeOutPoint(outpoint, data);
+    return contains(data, sizeof(data));
 }
 
 bool CBloomFilter::contains(const uint256 &hash) const
 {
-    std::vector<unsigned char> data(hash.begin(), hash.end());
-    return contains(data);
+    return contains(hash.begin(), hash.size());
 }
 
 void CBloomFilter::clear()
@@ -155,6 +178,20 @@ bool CBloomFilter::isWithinSizeConstraints() const
     return m_data.size() <= MAX_BLOOM_FILTER_SIZE && m_numHashFuncs <= MAX_HASH_FUNCS;
 }
 
+bool CBloomFilter::scriptMatches(const CScript &script, std::vector<unsigned char> &buffer) const
+{
+    // Match if the filter contains any arbitrary script data element in the script
+    CScript::const_iterator pc = script.begin();
+    while (pc < script.end()) {
+        opcodetype opcode;
+        if (!script.GetOp(pc, opcode, buffer))
+            break;
+        if (buffer.size() != 0 && contains(buffer.data(), buffer.size()))
+            return true;
+    }
+    return false;
+}
+
 bool CBloomFilter::matchAndInsertOutputs(const CTransaction& tx)
 {
     bool fFound = false;
@@ -168,34 +205,25 @@ bool CBloomFilter::matchAndInsertOutputs(const CTransaction& tx)
     if (contains(hash))
         fFound = true;
 
+    const std::vector<bool> matches = matchOutputs(tx);
     for (unsigned int i = 0; i < tx.vout.size(); i++)
     {
         const CTxOut& txout = tx.vout[i];
-        // Match if the filter contains any arbitrary script data element in any scriptPubKey in tx
         // If this matches, also add the specific output that was matched.
         // This means clients don't have to update the filter themselves when a new relevant tx 
         // is discovered in order to find spending transactions, which avoids round-tripping and race conditions.
-        CScript::const_iterator pc = txout.scriptPubKey.begin();
-        std::vector<unsigned char> data;
-        while (pc < txout.scriptPubKey.end())
+        if (matches[i])
         {
-            opcodetype opcode;
-            if (!txout.scriptPubKey.GetOp(pc, opcode, data))
-                break;
-            if (data.size() != 0 && contains(data))
+            fFound = true;
+            if ((m_flags & BLOOM_UPDATE_MASK) == BLOOM_UPDATE_ALL)
+                insert(COutPoint(hash, i));
+            else if ((m_flags & BLOOM_UPDATE_MASK) == BLOOM_UPDATE_P2PUBKEY_ONLY)
             {
-                fFound = true;
-                if ((m_flags & BLOOM_UPDATE_MASK) == BLOOM_UPDATE_ALL)
+                Script::TxnOutType type;
+                std::vector<std::vector<unsigned char> > vSolutions;
+                if (Script::solver(txout.scriptPubKey, type, vSolutions) &&
+                        (type == Script::TX_PUBKEY || type == Script::TX_MULTISIG))
                     insert(COutPoint(hash, i));
-                else if ((m_flags & BLOOM_UPDATE_MASK) == BLOOM_UPDATE_P2PUBKEY_ONLY)
-                {
-                    Script::TxnOutType type;
-                    std::vector<std::vector<unsigned char> > vSolutions;
-                    if (Script::solver(txout.scriptPubKey, type, vSolutions) &&
-                            (type == Script::TX_PUBKEY || type == Script::TX_MULTISIG))
-                        insert(COutPoint(hash, i));
-                }
-                break;
             }
         }
     }
@@ -203,26 +231,31 @@ bool CBloomFilter::matchAndInsertOutputs(const CTransaction& tx)
     return fFound;
 }
 
+std::vector<bool> CBloomFilter::matchOutputs(const CTransaction &tx) const
+{
+    std::vector<bool> answer(tx.vout.size(), m_isFull);
+    if (m_isFull || m_isEmpty)
+        return answer;
+    std::vector<unsigned char> data;
+    for (size_t i = 0; i < tx.vout.size(); ++i) {
+        answer[i] = scriptMatches(tx.vout[i].scriptPubKey, data);
+    }
+    return answer;
+}
+
 bool CBloomFilter::matchInputs(const CTransaction &tx) {
     if (m_isEmpty)
         return false;
 
+    std::vector<unsigned char> data;
     for (const CTxIn& txin : tx.vin) {
         // Match if the filter contains an outpoint tx spends
         if (contains(txin.prevout))
             return true;
 
         // Match if the filter contains any arbitrary script data element in any scriptSig in tx
-        CScript::const_iterator pc = txin.scriptSig.begin();
-        std::vector<unsigned char> data;
-        while (pc < txin.scriptSig.end())
-        {
-            opcodetype opcode;
-            if (!txin.scriptSig.GetOp(pc, opcode, data))
-                break;
-            if (data.size() != 0 && contains(data))
-                return true;
-        }
+        if (scriptMatches(txin.scriptSig, data))
+            return true;
     }
 
     return false;
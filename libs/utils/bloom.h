@@ -26,6 +26,7 @@
 #include <vector>
 
 class COutPoint;
+class CScript;
 class CTransaction;
 class uint256;
 namespace Streaming {
@@ -70,7 +71,9 @@ private:
     uint32_t m_tweak;
     uint8_t m_flags;
 
-    uint32_t hash(uint32_t nHashNum, const std::vector<uint8_t> &vDataToHash) const;
+    void insert(const unsigned char *data, size_t size);
+    bool contains(const unsigned char *data, size_t size) const;
+    bool scriptMatches(const CScript &script, std::vector<unsigned char> &buffer) const;
 
     // Private constructor for CRollingBloomFilter, no restrictions on size
     CBloomFilter(unsigned int nElements, double nFPRate, unsigned int tweak);
@@ -119,11 +122,15 @@ public:
     //! (catch a filter which was just deserialized which was too big)
     bool isWithinSizeConstraints() const;
 
-    //! Scans output scripts for matches and adds those outpoints to the filter
-    //! for spend detection. Returns true if any output matched, or the txid
-    //! matches.
+    //! Scans output scripts for matches (see matchOutputs()) and adds those outpoints
+    //! to the filter for spend detection. Returns true if any output matched, or the
+    //! txid matches.
     bool matchAndInsertOutputs(const CTransaction &tx);
 
+    //! Returns for each output of \a tx if its output script has a data element that
+    //! matches the filter. This doesn't update the filter.
+    std::vector<bool> matchOutputs(const CTransaction &tx) const;
+
     //! Scan inputs to see if the spent outpoints are a match, or the input
     //! scripts contain matching elements.
     bool matchInputs(const CTransaction &tx);
@@ -85,6 +85,69 @@ unsigned int MurmurHash3(unsigned int nHashSeed, const std::vector<unsigned char
     return h1;
 }
 
+MurmurHash3Multi::MurmurHash3Multi(const unsigned char *data, size_t size)
+    : m_blockCount(static_cast<int>(size / 4)),
+      m_tail(0),
+      m_size(static_cast<uint32_t>(size))
+{
+    const uint32_t c1 = 0xcc9e2d51;
+    const uint32_t c2 = 0x1b873593;
+    uint32_t *blocks = m_inline;
+    if (m_blockCount > InlineBlocks) {
+        m_extra.resize(m_blockCount);
+        blocks = m_extra.data();
+    }
+    for (int i = 0; i < m_blockCount; ++i) {
+        uint32_t k1 = ReadLE32(data + i * 4);
+        k1 *= c1;
+        k1 = ROTL32(k1, 15);
+        k1 *= c2;
+        blocks[i] = k1;
+    }
+    m_blocks = blocks;
+
+    const uint8_t *tail = data + m_blockCount * 4;
+    uint32_t k1 = 0;
+    switch (size & 3) {
+    case 3:
+        k1 ^= tail[2] << 16;
+    case 2:
+        k1 ^= tail[1] << 8;
+    case 1:
+        k1 ^= tail[0];
+        k1 *= c1;
+        k1 = ROTL32(k1, 15);
+        k1 *= c2;
+        m_tail = k1;
+    };
+}
+
+void MurmurHash3Multi::hash(uint32_t seed, uint32_t seedStep, uint32_t out[Lanes]) const
+{
+    // a fixed amount of lanes makes the compiler use SIMD registers for the lanes.
+    uint32_t h[Lanes];
+    for (int lane = 0; lane < Lanes; ++lane) {
+        h[lane] = seed + lane * seedStep;
+    }
+    for (int i = 0; i < m_blockCount; ++i) {
+        const uint32_t k1 = m_blocks[i];
+        for (int lane = 0; lane < Lanes; ++lane) {
+            uint32_t h1 = h[lane] ^ k1;
+            h1 = (h1 << 13) | (h1 >> 19);
+            h[lane] = h1 * 5 + 0xe6546b64;
+        }
+    }
+    for (int lane = 0; lane < Lanes; ++lane) {
+        uint32_t h1 = h[lane] ^ m_tail ^ m_size;
+        h1 ^= h1 >> 16;
+        h1 *= 0x85ebca6b;
+        h1 ^= h1 >> 13;
+        h1 *= 0xc2b2ae35;
+        h1 ^= h1 >> 16;
+        out[lane] = h1;
+    }
+}
+
 void BIP32Hash(const ChainCode &chainCode, unsigned int nChild, unsigned char header, const unsigned char data[32], unsigned char output[64])
 {
     unsigned char num[4];
@@ -94,3 +157,38 @@ void BIP32Hash(const ChainCode &chainCode, unsigned int nChild, unsigned char he
     num[3] = (nChild >>  0) & 0xFF;
     CHMAC_SHA512(chainCode.begin(), chainCode.size()).Write(&header, 1).Write(data, 32).Write(num, 4).Finalize(output);
 }
+
+#define SIPROUND do { \
+    v0 += v1; v1 = (v1 << 13) | (v1 >> 51); v1 ^= v0; v0 = (v0 << 32) | (v0 >> 32); \
+    v2 += v3; v3 = (v3 << 16) | (v3 >> 48); v3 ^= v2; \
+    v0 += v3; v3 = (v3 << 21) | (v3 >> 43); v3 ^= v0; \
+    v2 += v1; v1 = (v1 << 17) | (v1 >> 47); v1 ^= v2; v2 = (v2 << 32) | (v2 >> 32); \
+} while (0)
+
+uint64_t SipHashUint256(uint64_t k0, uint64_t k1, const uint256 &val)
+{
+    uint64_t v0 = 0x736f6d6570736575ULL ^ k0;
+    uint64_t v1 = 0x646f72616e646f6dULL ^ k1;
+    uint64_t v2 = 0x6c7967656e657261ULL ^ k0;
+    uint64_t v3 = 0x7465646279746573ULL ^ k1;
+
+    for (int i = 0; i < 4; ++i) {
+        const uint64_t d = ReadLE64(val.begin() + i * 8);
+        v3 ^= d;
+        SIPROUND;
+        SIPROUND;
+        v0 ^= d;
+    }
+    // the final block holds only the message length (32 bytes) in its top byte
+    v3 ^= 32ULL << 56;
+    SIPROUND;
+    SIPROUND;
+    v0 ^= 32ULL << 56;
+    v2 ^= 0xFF;
+    SIPROUND;
+    SIPROUND;
+    SIPROUND;
+    SIPROUND;
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+#undef SIPROUND
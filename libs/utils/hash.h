@@ -185,6 +185,37 @@ uint256 SerializeHash(const T& obj, int nType=SER_GETHASH, int nVersion=PROTOCOL
 
 unsigned int MurmurHash3(unsigned int nHashSeed, const std::vector<unsigned char>& vDataToHash);
 
+/**
+ * MurmurHash3 of one piece of data for a series of seeds, as used by bloom filters.
+ *
+ * Most of the work of MurmurHash3 is independent of the seed, this class does that
+ * part only once in the constructor. The per-seed part in hash() is written to
+ * process all seeds side by side, which the compiler turns into SIMD instructions.
+ */
+class MurmurHash3Multi
+{
+public:
+    MurmurHash3Multi(const unsigned char *data, size_t size);
+    MurmurHash3Multi(const MurmurHash3Multi&) = delete;
+    MurmurHash3Multi &operator=(const MurmurHash3Multi&) = delete;
+
+    enum { Lanes = 4 };
+    /// Fills \a out with the hashes for the seeds \a seed, \a seed + \a seedStep, etc.
+    void hash(uint32_t seed, uint32_t seedStep, uint32_t out[Lanes]) const;
+
+private:
+    enum { InlineBlocks = 130 }; // fits the max script element size
+    uint32_t m_inline[InlineBlocks];
+    std::vector<uint32_t> m_extra;
+    const uint32_t *m_blocks;
+    int m_blockCount;
+    uint32_t m_tail;
+    uint32_t m_size;
+};
+
 void BIP32Hash(const ChainCode &chainCode, unsigned int nChild, unsigned char header, const unsigned char data[32], unsigned char output[64]);
 
+/** SipHash-2-4 of a 256-bit value with key (k0, k1), as used for the BIP152 short transaction ids. */
+uint64_t SipHashUint256(uint64_t k0, uint64_t k1, const uint256 &val);
+
 #endif
@@ -56,6 +56,24 @@ public:
         m_data += bytes;
     }
 
+    /**
+     * Returns a pointer to the next \a bytes bytes and skips them.
+     * This allows a list of fixed-size items to be validated once and
+     * then be read directly from the message buffer, without copies.
+     */
+    inline const char *readRawBytes(int32_t bytes) {
+        if (bytes < 0 || m_end - m_data < bytes)
+            throw Streaming::ParsingException("Out of range");
+        const char *answer = m_data;
+        m_data += bytes;
+        return answer;
+    }
+
+    /// The amount of bytes not yet read.
+    inline int32_t bytesLeft() const {
+        return static_cast<int32_t>(m_end - m_data);
+    }
+
 private:
     Streaming::ConstBuffer m_constBuffer;
 
@@ -0,0 +1,68 @@
+/*
+ * This file is part of the Flowee project
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef INDEXERKEYS_H
+#define INDEXERKEYS_H
+
+#include "UnspentOutputDatabase.h"
+
+/*
+ * The indexers re-use the UnspentOutputDatabase as a key/value store, the key
+ * being a (txid, index) pair and the value a position in the blockchain.
+ * The stand-alone indexer and the one embedded in the Hub share the databases,
+ * this is the one place that defines what goes into the keys.
+ */
+namespace IndexerKeys {
+
+/// The tx-index stores a transaction under its own txid, the value is where it was mined.
+inline void insertTransaction(UnspentOutputDatabase &db, const uint256 &txid, int blockHeight, int offsetInBlock)
+{
+    db.insert(txid, 0, blockHeight, offsetInBlock);
+}
+
+inline UnspentOutput findTransaction(const UnspentOutputDatabase &db, const uint256 &txid)
+{
+    return db.find(txid, 0);
+}
+
+inline void removeTransaction(UnspentOutputDatabase &db, const uint256 &txid)
+{
+    db.remove(txid, 0);
+}
+
+/**
+ * The spent-output index stores the output that is spent, the value is where the
+ * transaction spending it was mined.
+ */
+inline void insertSpentOutput(UnspentOutputDatabase &db, const uint256 &prevTxId, int prevOutIndex, int blockHeight, int offsetInBlock)
+{
+    db.insert(prevTxId, prevOutIndex, blockHeight, offsetInBlock);
+}
+
+inline UnspentOutput findSpentOutput(const UnspentOutputDatabase &db, const uint256 &prevTxId, int prevOutIndex)
+{
+    return db.find(prevTxId, prevOutIndex);
+}
+
+inline void removeSpentOutput(UnspentOutputDatabase &db, const uint256 &prevTxId, int prevOutIndex)
+{
+    db.remove(prevTxId, prevOutIndex);
+}
+
+}
+
+#endif
@@ -294,6 +294,60 @@ QJsonObject toJson(const Blockchain::BlockHeader &header, QJsonObject &answer)
     return answer;
 }
 
+// writes the details of one address, without first building it all in memory.
+static void writeAddressJson(HttpEngine::JsonStreamWriter &writer, const AnswerListingDataSingle &item, const std::deque<Blockchain::Transaction> &answer)
+{
+    qint64 balance = 0;
+    qint64 received = 0;
+    qint64 sent = 0;
+    qint64 balanceUnconfirmed = 0;
+    for (const auto &utxo : item.utxos) {
+        if (utxo.blockHeight == -1) {
+            assert(utxo.unspent);
+            balanceUnconfirmed += utxo.amount;
+            continue;
+        }
+        if (utxo.unspent)
+            balance += utxo.amount;
+        else
+            sent += utxo.amount;
+        received += utxo.amount;
+    }
+    // a map sorts by key. Key uses blockheight
+    QMap<TransactionId, const Blockchain::Transaction*> sortedTx;
+    for (auto i : item.transactions) {
+        const Blockchain::Transaction *tx = &answer[i];
+        sortedTx.insert({tx->blockHeight, int(tx->offsetInBlock)}, tx);
+    }
+
+    // members in the same (sorted) order as QJsonObject would write them.
+    writer.beginObject();
+    writer.write("balance", balance / 1E8);
+    writer.write("balanceSat", balance);
+    writer.write("cashAddress", ripeToCashAddress(item.address.hash, item.address.type));
+    writer.write("legacyAddress", ripeToLegacyAddress(item.address.hash, item.address.type));
+    writer.write("totalReceived", received / 1E8);
+    writer.write("totalReceivedSat", received);
+    writer.write("totalSent", sent / 1E8);
+    writer.write("totalSentSat", sent);
+    // root.insert("txAppearances", appearences); // no clue what this means
+    writer.writeName("transactions");
+    writer.beginArray();
+    // we want to list the most recent hits first, which are the highest blockchain ones.
+    if (!sortedTx.empty()) {
+        auto iter = sortedTx.end();
+        do {
+            const Blockchain::Transaction *tx = *(--iter);
+            writer.writeValue(uint256ToString(tx->txid));
+        } while (sortedTx.begin() != iter);
+    }
+    writer.endArray();
+    writer.write("unconfirmedBalance", balanceUnconfirmed / 1E8);
+    writer.write("unconfirmedBalanceSat", (double) balanceUnconfirmed);
+    // "unconfirmedTxApperances":0,
+    writer.endObject();
+}
+
 QString parseOutScriptAddAddresses(QJsonArray &addresses, QJsonArray &cashAddresses, const Streaming::ConstBuffer &script)
 {
     CScript scriptPubKey(script);
@@ -933,84 +987,46 @@ void RestServiceWebRequest::threadSafeFinished()
         break;
     }
     case TransactionDetailsList: {
-        QJsonArray root;
-        for (const auto &tx : answer) {
-            if (tx.fullTxData.size() > 0) {
-                QJsonObject o = renderTransactionToJSon(tx);
-                auto header = blockHeaders.find(tx.blockHeight);
-                if (header != blockHeaders.end())
-                    toJson(header->second, o);
-                root.append(o);
-            }
+        // lists can get big, render one transaction at a time and stream it out.
+        std::vector<int> indexes;
+        for (size_t i = 0; i < answer.size(); ++i) {
+            if (answer.at(i).fullTxData.size() > 0)
+                indexes.push_back(static_cast<int>(i));
         }
-        socket()->writeJson(QJsonDocument(root), s_JsonFormat);
-        break;
+        streamJsonArray(static_cast<int>(indexes.size()),
+                        [this, indexes](HttpEngine::JsonStreamWriter &writer, int index) {
+            const auto &tx = answer.at(indexes.at(index));
+            QJsonObject o = renderTransactionToJSon(tx);
+            auto header = blockHeaders.find(tx.blockHeight);
+            if (header != blockHeaders.end())
+                toJson(header->second, o);
+            writer.writeValue(o);
+        });
+        return; // the streamer closes the socket
     }
-    case AddressDetails:
-    case AddressDetailsList: {
+    case AddressDetails: {
         auto *ald = dynamic_cast<AddressListingData*>(answerData);
         assert(ald);
-        QJsonArray root; // should we want a list
-        for (auto &item : ald->items) {
-            QJsonObject oneAddress;
-            QJsonArray transactionHashes;
-            qint64 balance = 0;
-            qint64 received = 0;
-            qint64 sent = 0;
-            qint64 balanceUnconfirmed = 0;
-            for (const auto &utxo : item.utxos) {
-                if (utxo.blockHeight == -1) {
-                    assert(utxo.unspent);
-                    balanceUnconfirmed += utxo.amount;
-                    continue;
-                }
-                if (utxo.unspent)
-                    balance += utxo.amount;
-                else
-                    sent += utxo.amount;
-                received += utxo.amount;
-            }
-            // a map sorts by key. Key uses blockheight
-            QMap<TransactionId, Blockchain::Transaction*> sortedTx;
-            for (auto i : item.transactions) {
-                Blockchain::Transaction *tx = &answer[i];
-                sortedTx.insert({tx->blockHeight, int(tx->offsetInBlock)}, tx);
-            }
-
-            // we want to list the most recent hits first, which are the highest blockchain ones.
-            if (!sortedTx.empty()) {
-                auto iter = sortedTx.end();
-                do {
-                    Blockchain::Transaction *tx = *(--iter);
-                    transactionHashes.append(uint256ToString(tx->txid));
-                } while (sortedTx.begin() != iter);
-            }
-
-            oneAddress.insert("balance", balance / 1E8);
-            oneAddress.insert("balanceSat", balance);
-            oneAddress.insert("totalReceived", received / 1E8);
-            oneAddress.insert("totalReceivedSat", received);
-            oneAddress.insert("totalSent", sent / 1E8);
-            oneAddress.insert("totalSentSat", sent);
-            // root.insert("txAppearances", appearences); // no clue what this means
-            oneAddress.insert("transactions", transactionHashes);
-            oneAddress.insert("legacyAddress", ripeToLegacyAddress(item.address.hash, item.address.type));
-            oneAddress.insert("cashAddress", ripeToCashAddress(item.address.hash, item.address.type));
-
-            oneAddress.insert("unconfirmedBalance", balanceUnconfirmed / 1E8);
-            oneAddress.insert("unconfirmedBalanceSat", (double) balanceUnconfirmed);
-            // "unconfirmedTxApperances":0,
-
-            if (answerType == AddressDetails) { // just the one
-                socket()->writeJson(QJsonDocument(oneAddress), s_JsonFormat);
-                socket()->close();
-                return;
-            }
-            root.append(oneAddress);
+        if (ald->items.isEmpty()) // nothing found, we still answer with valid json
+            socket()->writeJson(QJsonDocument(QJsonArray()), s_JsonFormat);
+        else { // just the one
+            socket()->setHeader("Content-Type", "application/json");
+            socket()->beginStreamingResponse();
+            HttpEngine::JsonStreamWriter writer(socket());
+            writer.setIndented(s_JsonFormat == QJsonDocument::Indented);
+            writeAddressJson(writer, ald->items.first(), answer);
+            writer.flush();
         }
-        socket()->writeJson(QJsonDocument(root), s_JsonFormat);
         break;
     }
+    case AddressDetailsList: {
+        auto *ald = dynamic_cast<AddressListingData*>(answerData);
+        assert(ald);
+        streamJsonArray(ald->items.size(), [this, ald](HttpEngine::JsonStreamWriter &writer, int index) {
+            writeAddressJson(writer, ald->items.at(index), answer);
+        });
+        return; // the streamer closes the socket
+    }
     // case AddressDetailsList: TODO
     case AddressUTXO: {
         QJsonObject root;
@@ -1108,6 +1124,16 @@ void RestServiceWebRequest::threadSafeFinished()
     socket()->close();
 }
 
+void RestServiceWebRequest::streamJsonArray(int itemCount, const HttpEngine::JsonArrayStreamer::ItemWriter &writeItem)
+{
+    socket()->setHeader("Content-Type", "application/json");
+    socket()->beginStreamingResponse();
+    auto streamer = new HttpEngine::JsonArrayStreamer(socket(), itemCount, writeItem, this);
+    streamer->setIndented(s_JsonFormat == QJsonDocument::Indented);
+    connect (streamer, &HttpEngine::JsonArrayStreamer::finished, socket(), &HttpEngine::Socket::close);
+    streamer->start();
+}
+
 QJsonObject RestServiceWebRequest::renderTransactionToJSon(const Blockchain::Transaction &tx) const
 {
     QJsonObject answer;
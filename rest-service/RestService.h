@@ -22,6 +22,7 @@
 #include <QJsonObject>
 
 #include <Blockchain.h>
+#include <httpengine/jsonstreamwriter.h>
 #include <httpengine/server.h>
 
 class RestServiceWebRequest;
@@ -89,6 +90,8 @@ private slots:
 
 private:
     QJsonObject renderTransactionToJSon(const Blockchain::Transaction &tx) const;
+    /// reply with a chunked json array, used for answers of unbounded size.
+    void streamJsonArray(int itemCount, const HttpEngine::JsonArrayStreamer::ItemWriter &writeItem);
 };
 
 class RestService : public QObject, public Blockchain::SearchEngine
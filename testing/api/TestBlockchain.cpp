@@ -150,6 +150,53 @@ void TestApiBlockchain::testGetTransaction()
     QCOMPARE(p.next(), Streaming::EndOfDocument);
 }
 
+void TestApiBlockchain::testGetTransactions()
+{
+    startHubs();
+    feedDefaultBlocksToHub(0);
+
+    Streaming::BufferPool pool;
+    Streaming::MessageBuilder builder(pool);
+    builder.add(Api::BlockChain::Include_TxId, true);
+    builder.add(Api::BlockChain::BlockHeight, 112);
+    builder.add(Api::BlockChain::Tx_OffsetInBlock, 1019);
+    builder.add(Api::BlockChain::BlockHeight, 2);
+    builder.add(Api::BlockChain::Tx_OffsetInBlock, 81);
+    builder.add(Api::BlockChain::BlockHeight, 112);
+    builder.add(Api::BlockChain::Tx_OffsetInBlock, 81);
+    Message m = waitForReply(0, builder.message(Api::BlockChainService, Api::BlockChain::GetTransactions), Api::BlockChain::GetTransactionsReply);
+    QCOMPARE(m.serviceId(), (int) Api::BlockChainService);
+    QCOMPARE(m.messageId(), (int) Api::BlockChain::GetTransactionsReply);
+
+    // the reply is in request order, not in the order the hub read them.
+    const int heights[] = { 112, 2, 112 };
+    const int offsets[] = { 1019, 81, 81 };
+    Streaming::MessageParser p(m.body());
+    for (int i = 0; i < 3; ++i) {
+        QCOMPARE(p.next(), Streaming::FoundTag);
+        QCOMPARE(p.tag(), (uint32_t) Api::BlockChain::BlockHeight);
+        QCOMPARE(p.intData(), heights[i]);
+        QCOMPARE(p.next(), Streaming::FoundTag);
+        QCOMPARE(p.tag(), (uint32_t) Api::BlockChain::Tx_OffsetInBlock);
+        QCOMPARE(p.intData(), offsets[i]);
+        QCOMPARE(p.next(), Streaming::FoundTag);
+        QCOMPARE(p.tag(), (uint32_t) Api::BlockChain::TxId);
+        if (i == 0)
+            QCOMPARE(p.uint256Data(), uint256S("0xe455fc2cb76d11a015fe120c18cb590203b6a217640afcf7b3be898db7527a44"));
+        QCOMPARE(p.next(), Streaming::FoundTag);
+        QCOMPARE(p.tag(), (uint32_t) Api::BlockChain::Separator);
+    }
+    QCOMPARE(p.next(), Streaming::EndOfDocument);
+
+    // a bad item fails the whole request.
+    builder.add(Api::BlockChain::BlockHeight, 112);
+    builder.add(Api::BlockChain::Tx_OffsetInBlock, 1019);
+    builder.add(Api::BlockChain::Tx_OffsetInBlock, 10);
+    m = waitForReply(0, builder.message(Api::BlockChainService, Api::BlockChain::GetTransactions),
+                     Api::APIService, Api::Meta::CommandFailed);
+    QCOMPARE(m.serviceId(), (int) Api::APIService);
+}
+
 void TestApiBlockchain::testGetScript()
 {
     startHubs();
@@ -19,12 +19,56 @@
 #include "TestLive.h"
 
 #include <Message.h>
+#include <TransactionBuilder.h>
 
 #include <streaming/BufferPool.h>
 #include <streaming/MessageBuilder.h>
 #include <streaming/MessageParser.h>
 
 #include <primitives/FastTransaction.h>
+#include <primitives/key.h>
+#include <primitives/script.h>
+
+namespace {
+// spend output zero of \a prevTxId, which pays \a amount to \a key, back to the same key.
+Tx spendToSelf(const uint256 &prevTxId, int64_t amount, const CKey &key)
+{
+    const CScript script = CScript() << OP_DUP << OP_HASH160 << ToByteVector(key.GetPubKey().getKeyId())
+                                     << OP_EQUALVERIFY << OP_CHECKSIG;
+    TransactionBuilder builder;
+    builder.appendInput(prevTxId, 0);
+    builder.pushInputSignature(key, script, amount, TransactionBuilder::Schnorr);
+    builder.appendOutput(amount - 1000);
+    builder.pushOutputPay2Address(key.GetPubKey().getKeyId());
+    return builder.createTransaction();
+}
+
+int64_t firstOutputAmount(const Tx &tx)
+{
+    Tx::Iterator iter(tx);
+    if (iter.next(Tx::OutputValue) == Tx::OutputValue)
+        return static_cast<int64_t>(iter.longData());
+    return 0;
+}
+
+struct BatchResult {
+    uint256 txid;
+    std::string rejectReason;
+};
+
+std::vector<BatchResult> parseBatchReply(const Message &m)
+{
+    std::vector<BatchResult> answer;
+    Streaming::MessageParser parser(m.body());
+    while (parser.next() == Streaming::FoundTag) {
+        if (parser.tag() == Api::LiveTransactions::TxId)
+            answer.push_back({parser.uint256Data(), std::string()});
+        else if (parser.tag() == Api::LiveTransactions::RejectReason && !answer.empty())
+            answer.back().rejectReason = parser.stringData();
+    }
+    return answer;
+}
+}
 
 void TestApiLive::testBasic()
 {
@@ -78,6 +122,119 @@ void TestApiLive::testSendTx()
     }
 }
 
+void TestApiLive::testSendTxBatch()
+{
+    startHubs(1);
+    feedDefaultBlocksToHub(0);
+
+    // known valid transaction on this chain.
+    Streaming::BufferPool pool;
+    pool.writeHex("0x01000000010b9d14b709aa59bd594edca17db2951c6660ebc8daa31ceae233a5550314f158000000006b483045022100b34a120e69bc933ae16c10db0f565cb2da1b80a9695a51707e8a80c9aa5c22bf02206c390cb328763ab9ab2d45f874d308af2837d6d8cfc618af76744b9eeb69c3934121022708a547a1d14ba6df79ec0f4216eeec65808cf0a32f09ad1cf730b44e8e14a6ffffffff01faa7be00000000001976a9148438266ad57aa9d9160e99a046e39027e4fb6b2a88ac00000000");
+    Tx tx1(pool.commit());
+    pool.writeHex("0x0100000001");
+    Tx broken(pool.commit());
+
+    Streaming::MessageBuilder builder(pool);
+    builder.add(Api::LiveTransactions::Transaction, tx1.data());
+    builder.add(Api::LiveTransactions::Transaction, broken.data());
+    Message m = waitForReply(0, builder.message(Api::LiveTransactionService, Api::LiveTransactions::SendTransactions),
+                             Api::LiveTransactionService, Api::LiveTransactions::SendTransactionsReply);
+    QCOMPARE(m.serviceId(), (int) Api::LiveTransactionService);
+    QCOMPARE(m.messageId(), (int) Api::LiveTransactions::SendTransactionsReply);
+
+    // one entry per transaction, in order.
+    std::vector<uint256> txids;
+    std::vector<bool> rejected;
+    Streaming::MessageParser parser(m.body());
+    while (parser.next() == Streaming::FoundTag) {
+        if (parser.tag() == Api::LiveTransactions::TxId) {
+            txids.push_back(parser.uint256Data());
+            rejected.push_back(false);
+        }
+        else if (parser.tag() == Api::LiveTransactions::RejectReason) {
+            QVERIFY(!rejected.empty());
+            QVERIFY(parser.isString());
+            rejected.back() = true;
+        }
+    }
+    QCOMPARE((int) txids.size(), 2);
+    QVERIFY(txids.at(0) == tx1.createHash());
+    QVERIFY(txids.at(1) == broken.createHash());
+    QCOMPARE(rejected.at(0), false);
+    QCOMPARE(rejected.at(1), true);
+}
+
+void TestApiLive::testSendTxBatchDependencies()
+{
+    ECC_Start();
+    startHubs();
+    CKey key;
+    key.MakeNewKey();
+    const CKeyID address = key.GetPubKey().getKeyId();
+    Streaming::MessageBuilder builder(Streaming::NoHeader, 100000);
+    builder.addByteArray(Api::RegTest::BitcoinP2PKHAddress, address.begin(), address.size());
+    builder.add(Api::RegTest::Amount, 110);
+    Message m = waitForReply(0, builder.message(Api::RegTestService, Api::RegTest::GenerateBlock), Api::RegTest::GenerateBlockReply);
+    QCOMPARE(m.serviceId(), (int) Api::RegTestService);
+
+    // the coinbases of the first blocks pay to our key.
+    std::vector<Tx> coinbases;
+    for (int height = 1; height <= 3; ++height) {
+        builder.add(Api::BlockChain::BlockHeight, height);
+        m = waitForReply(0, builder.message(Api::BlockChainService, Api::BlockChain::GetBlock), Api::BlockChain::GetBlockReply);
+        Streaming::MessageParser parser(m.body());
+        while (parser.next() == Streaming::FoundTag) {
+            if (parser.tag() == Api::BlockChain::GenericByteData) {
+                coinbases.push_back(Tx(parser.bytesDataBuffer()));
+                break;
+            }
+        }
+    }
+    QCOMPARE((int) coinbases.size(), 3);
+
+    const Tx parent = spendToSelf(coinbases[0].createHash(), firstOutputAmount(coinbases[0]), key);
+    const Tx child = spendToSelf(parent.createHash(), firstOutputAmount(parent), key);
+    // spends an output that doesn't exist, so it is rejected.
+    const Tx badParent = spendToSelf(uint256S("0x1111111111111111111111111111111111111111111111111111111111111111"), 50000, key);
+    const Tx badChild = spendToSelf(badParent.createHash(), firstOutputAmount(badParent), key);
+    const Tx parent2 = spendToSelf(coinbases[1].createHash(), firstOutputAmount(coinbases[1]), key);
+    const Tx child2 = spendToSelf(parent2.createHash(), firstOutputAmount(parent2), key);
+    const Tx grandChild2 = spendToSelf(child2.createHash(), firstOutputAmount(child2), key);
+
+    // children listed before their parents are sorted into place.
+    const std::vector<Tx> batch = { grandChild2, child2, parent, child, badChild, badParent, parent2 };
+    Streaming::BufferPool pool;
+    Streaming::MessageBuilder batchBuilder(pool);
+    for (const Tx &tx : batch) {
+        batchBuilder.add(Api::LiveTransactions::Transaction, tx.data());
+    }
+    m = waitForReply(0, batchBuilder.message(Api::LiveTransactionService, Api::LiveTransactions::SendTransactions),
+                     Api::LiveTransactionService, Api::LiveTransactions::SendTransactionsReply);
+    QCOMPARE(m.messageId(), (int) Api::LiveTransactions::SendTransactionsReply);
+    auto results = parseBatchReply(m);
+    QCOMPARE(results.size(), batch.size());
+    for (size_t i = 0; i < batch.size(); ++i) {
+        QVERIFY(results.at(i).txid == batch.at(i).createHash());
+        const bool shouldFail = i == 4 || i == 5;
+        QCOMPARE(results.at(i).rejectReason.empty(), !shouldFail);
+    }
+    QCOMPARE(results.at(4).rejectReason, std::string("parent-in-batch-rejected"));
+
+    // with validate-only nothing enters the mempool, children can't be validated.
+    const Tx parent3 = spendToSelf(coinbases[2].createHash(), firstOutputAmount(coinbases[2]), key);
+    const Tx child3 = spendToSelf(parent3.createHash(), firstOutputAmount(parent3), key);
+    batchBuilder.add(Api::LiveTransactions::ValidateOnly, true);
+    batchBuilder.add(Api::LiveTransactions::Transaction, parent3.data());
+    batchBuilder.add(Api::LiveTransactions::Transaction, child3.data());
+    m = waitForReply(0, batchBuilder.message(Api::LiveTransactionService, Api::LiveTransactions::SendTransactions),
+                     Api::LiveTransactionService, Api::LiveTransactions::SendTransactionsReply);
+    results = parseBatchReply(m);
+    QCOMPARE(results.size(), (size_t) 2);
+    QVERIFY(results.at(0).rejectReason.empty());
+    QCOMPARE(results.at(1).rejectReason, std::string("validate-only-with-parent-in-batch"));
+    ECC_Stop();
+}
+
 void TestApiLive::testUtxo()
 {
     startHubs();
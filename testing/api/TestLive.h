@@ -26,6 +26,8 @@ class TestApiLive : public BlackBoxTest
 private slots:
     void testBasic();
     void testSendTx();
+    void testSendTxBatch();
+    void testSendTxBatchDependencies();
     void testUtxo();
     void testGetMempoolInfo();
     void testGetTransaction();
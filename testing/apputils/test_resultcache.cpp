@@ -0,0 +1,215 @@
+/*
+ * This file is part of the Flowee project
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_resultcache.h"
+
+#include <Blockchain_p.h>
+
+#include <algorithm>
+
+namespace {
+Blockchain::Job createJob(Blockchain::JobType type, int blockHeight, int offsetInBlock = 0)
+{
+    Blockchain::Job job;
+    job.type = type;
+    job.intData = blockHeight;
+    job.intData2 = offsetInBlock;
+    return job;
+}
+
+Message createReply(Streaming::BufferPool &pool, int size, char fill)
+{
+    pool.reserve(size);
+    memset(pool.begin(), fill, static_cast<size_t>(size));
+    return Message(pool.commit(size), Api::BlockChainService, Api::BlockChain::GetTransactionReply);
+}
+
+Blockchain::ResultCache::Key txKey(int blockHeight, int offsetInBlock)
+{
+    return Blockchain::ResultCache::Key(createJob(Blockchain::FetchTx, blockHeight, offsetInBlock));
+}
+}
+
+void TestResultCache::keys()
+{
+    using Blockchain::ResultCache;
+    QVERIFY(txKey(100, 81).isValid());
+    QVERIFY(!txKey(100, 0).isValid()); // not a mined transaction
+    QVERIFY(!txKey(0, 81).isValid());
+    QVERIFY(ResultCache::Key(createJob(Blockchain::FetchBlockHeader, 100)).isValid());
+    QVERIFY(!ResultCache::Key(createJob(Blockchain::FetchBlockHeader, 0)).isValid());
+    QVERIFY(!ResultCache::Key(createJob(Blockchain::FetchUTXOUnspent, 100, 81)).isValid());
+    QVERIFY(!ResultCache::Key(createJob(Blockchain::FindTxInMempool, 100, 81)).isValid());
+
+    // different filters give a different answer, so a different key.
+    Blockchain::Job job = createJob(Blockchain::FetchTx, 100, 81);
+    ResultCache::Key key1(job);
+    job.transactionFilters = 3;
+    ResultCache::Key key2(job);
+    QVERIFY(key1 < key2 || key2 < key1);
+    QVERIFY(!(key1 < txKey(100, 81)) && !(txKey(100, 81) < key1));
+}
+
+void TestResultCache::insertAndFind()
+{
+    Streaming::BufferPool pool;
+    Blockchain::ResultCache cache;
+    QCOMPARE(cache.find(txKey(100, 81)).serviceId(), -1);
+
+    cache.insert(txKey(100, 81), createReply(pool, 200, 'a'));
+    Message found = cache.find(txKey(100, 81));
+    QCOMPARE(found.serviceId(), (int) Api::BlockChainService);
+    QCOMPARE(found.messageId(), (int) Api::BlockChain::GetTransactionReply);
+    QCOMPARE(found.body().size(), 200);
+    QCOMPARE(found.body().begin()[199], 'a');
+    QCOMPARE(cache.find(txKey(100, 82)).serviceId(), -1);
+
+    auto stats = cache.stats();
+    QCOMPARE(stats.hits, (uint64_t) 1);
+    QCOMPARE(stats.misses, (uint64_t) 2);
+    QCOMPARE(stats.entries, 1);
+    QCOMPARE(stats.bytes, 200);
+
+    // a size of zero disables the cache
+    cache.setMaxSize(0);
+    QCOMPARE(cache.stats().entries, 0);
+    QCOMPARE(cache.stats().bytes, 0);
+    cache.insert(txKey(100, 81), createReply(pool, 200, 'a'));
+    QCOMPARE(cache.find(txKey(100, 81)).serviceId(), -1);
+}
+
+void TestResultCache::eviction()
+{
+    Streaming::BufferPool pool;
+    Blockchain::ResultCache cache;
+    cache.setMaxSize(1000);
+    for (int i = 1; i <= 10; ++i) {
+        cache.insert(txKey(100, i), createReply(pool, 100, 'a'));
+    }
+    QCOMPARE(cache.stats().entries, 10);
+    QCOMPARE(cache.stats().bytes, 1000);
+
+    // a single item bigger than a tenth of the cache is never stored.
+    cache.insert(txKey(200, 1), createReply(pool, 101, 'b'));
+    QCOMPARE(cache.stats().entries, 10);
+    QCOMPARE(cache.find(txKey(200, 1)).serviceId(), -1);
+
+    // the least recently used one goes first.
+    QVERIFY(cache.find(txKey(100, 1)).serviceId() != -1);
+    cache.insert(txKey(100, 11), createReply(pool, 100, 'a'));
+    QCOMPARE(cache.stats().entries, 10);
+    QVERIFY(cache.find(txKey(100, 1)).serviceId() != -1);
+    QCOMPARE(cache.find(txKey(100, 2)).serviceId(), -1);
+    QVERIFY(cache.find(txKey(100, 11)).serviceId() != -1);
+
+    cache.setMaxSize(500);
+    QCOMPARE(cache.stats().entries, 5);
+    QCOMPARE(cache.stats().bytes, 500);
+    QVERIFY(cache.find(txKey(100, 11)).serviceId() != -1);
+}
+
+void TestResultCache::reorg()
+{
+    Streaming::BufferPool pool;
+    Blockchain::ResultCache cache;
+    cache.setTipHeight(100);
+    QCOMPARE(cache.tipHeight(), 100);
+    for (int height = 95; height <= 101; ++height) {
+        cache.insert(txKey(height, 81), createReply(pool, 100, 'a'));
+    }
+    cache.insert(Blockchain::ResultCache::Key(createJob(Blockchain::FetchBlockHeader, 98)), createReply(pool, 100, 'h'));
+    // not (yet) on our chain, not cached
+    QCOMPARE(cache.find(txKey(101, 81)).serviceId(), -1);
+    QCOMPARE(cache.stats().entries, 7);
+
+    cache.removeFromHeight(98);
+    QCOMPARE(cache.tipHeight(), 97);
+    QCOMPARE(cache.stats().entries, 3);
+    QCOMPARE(cache.stats().bytes, 300);
+    QVERIFY(cache.find(txKey(97, 81)).serviceId() != -1);
+    QCOMPARE(cache.find(txKey(98, 81)).serviceId(), -1);
+    QCOMPARE(cache.find(Blockchain::ResultCache::Key(createJob(Blockchain::FetchBlockHeader, 98))).serviceId(), -1);
+
+    // a new tip that is not higher than the old one is a reorg too.
+    cache.setTipHeight(99);
+    cache.insert(txKey(99, 81), createReply(pool, 100, 'a'));
+    QCOMPARE(cache.stats().entries, 4);
+    cache.setTipHeight(96);
+    QCOMPARE(cache.stats().entries, 1);
+    QVERIFY(cache.find(txKey(95, 81)).serviceId() != -1);
+}
+
+void TestResultCache::coalescing()
+{
+    typedef Blockchain::ResultCache::JobRef JobRef;
+    Blockchain::ResultCache cache;
+    const JobRef job1(1, 0), job2(2, 3), job3(3, 1), job4(4, 0);
+    QVERIFY(cache.startRequest(txKey(100, 81), job1));
+    QVERIFY(!cache.startRequest(txKey(100, 81), job2));
+    QVERIFY(!cache.startRequest(txKey(100, 81), job3));
+    QVERIFY(cache.startRequest(txKey(100, 82), job4)); // a different request
+    QCOMPARE(cache.stats().coalesced, (uint64_t) 2);
+
+    Blockchain::ResultCache::Key key((Blockchain::Job()));
+    std::vector<JobRef> waiting;
+    // only the job that sent the request gets a reply from the Hub.
+    QVERIFY(!cache.finishRequest(job2, &key, waiting));
+    QVERIFY(waiting.empty());
+
+    QVERIFY(cache.finishRequest(job1, &key, waiting));
+    QCOMPARE(key.blockHeight, 100);
+    QCOMPARE(key.offsetInBlock, 81);
+    QCOMPARE(waiting.size(), (size_t) 2);
+    QVERIFY(waiting.at(0) == job2);
+    QVERIFY(waiting.at(1) == job3);
+    QVERIFY(!cache.finishRequest(job1, &key, waiting));
+
+    waiting.clear();
+    QVERIFY(cache.finishRequest(job4, &key, waiting));
+    QCOMPARE(key.offsetInBlock, 82);
+    QVERIFY(waiting.empty());
+
+    // nothing in flight anymore, the next one has to send the request again.
+    QVERIFY(cache.startRequest(txKey(100, 81), job2));
+}
+
+void TestResultCache::abortRequests()
+{
+    typedef Blockchain::ResultCache::JobRef JobRef;
+    Blockchain::ResultCache cache;
+    const JobRef job1(1, 0), job2(2, 3), job3(3, 1);
+    QVERIFY(cache.startRequest(txKey(100, 81), job1));
+    QVERIFY(!cache.startRequest(txKey(100, 81), job2));
+    QVERIFY(cache.startRequest(txKey(100, 82), job3));
+
+    // the senders and the waiters all need to be told.
+    std::vector<JobRef> jobs;
+    cache.abortRequests(jobs);
+    std::sort(jobs.begin(), jobs.end());
+    QCOMPARE(jobs.size(), (size_t) 3);
+    QVERIFY(jobs.at(0) == job1);
+    QVERIFY(jobs.at(1) == job2);
+    QVERIFY(jobs.at(2) == job3);
+
+    Blockchain::ResultCache::Key key((Blockchain::Job()));
+    std::vector<JobRef> waiting;
+    QVERIFY(!cache.finishRequest(job1, &key, waiting));
+    QVERIFY(cache.startRequest(txKey(100, 81), job2));
+}
+
+QTEST_MAIN(TestResultCache)
@@ -0,0 +1,272 @@
+/*
+ * This file is part of the Flowee project
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Bench.h"
+
+#include <clientversion.h>
+#include <utiltime.h>
+#include <univalue.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <map>
+
+namespace {
+struct Entry {
+    Bench::Function function;
+    int iterations;
+};
+
+std::map<std::string, Entry> &registry()
+{
+    static std::map<std::string, Entry> s_registry;
+    return s_registry;
+}
+
+Bench::Options s_options;
+std::vector<std::function<void()> > s_cleanups;
+
+std::string formatTime(int64_t nanoSeconds)
+{
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2);
+    if (nanoSeconds < 10000)
+        out << nanoSeconds << " ns";
+    else if (nanoSeconds < 10000000)
+        out << nanoSeconds / 1E3 << " us";
+    else if (nanoSeconds < 10000000000LL)
+        out << nanoSeconds / 1E6 << " ms";
+    else
+        out << nanoSeconds / 1E9 << " s";
+    return out.str();
+}
+
+double perSecond(int64_t amount, int64_t nanoSeconds)
+{
+    if (nanoSeconds <= 0)
+        return 0;
+    return amount * 1E9 / nanoSeconds;
+}
+}
+
+Bench::State::State(int iterations)
+    : m_iterations(std::max(1, iterations))
+{
+    m_laps.reserve(m_iterations);
+}
+
+bool Bench::State::keepRunning()
+{
+    const auto now = Clock::now();
+    if (m_current >= 0 && !m_paused) {
+        m_lap += std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_start).count();
+    }
+    if (m_current >= 0)
+        m_laps.push_back(m_lap);
+    if (!m_error.empty() || ++m_current >= m_iterations)
+        return false;
+    m_lap = 0;
+    m_paused = false;
+    m_start = Clock::now();
+    return true;
+}
+
+void Bench::State::pauseTiming()
+{
+    if (m_paused)
+        return;
+    m_lap += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - m_start).count();
+    m_paused = true;
+}
+
+void Bench::State::resumeTiming()
+{
+    if (!m_paused)
+        return;
+    m_paused = false;
+    m_start = Clock::now();
+}
+
+void Bench::State::setError(const std::string &error)
+{
+    m_error = error;
+}
+
+
+Bench::Registration::Registration(const char *name, const Function &function, int iterations)
+{
+    registry().insert(std::make_pair(std::string(name), Entry{function, iterations}));
+}
+
+const Bench::Options &Bench::options()
+{
+    return s_options;
+}
+
+void Bench::addCleanup(const std::function<void()> &cleanup)
+{
+    s_cleanups.push_back(cleanup);
+}
+
+std::vector<std::string> Bench::names()
+{
+    std::vector<std::string> answer;
+    for (auto i = registry().begin(); i != registry().end(); ++i) {
+        answer.push_back(i->first);
+    }
+    return answer;
+}
+
+std::vector<Bench::Result> Bench::run(const Options &options)
+{
+    s_options = options;
+    std::vector<Result> answer;
+    for (auto i = registry().begin(); i != registry().end(); ++i) {
+        if (!options.filter.empty() && i->first.find(options.filter) == std::string::npos)
+            continue;
+        std::cerr << "Running " << i->first << "..." << std::flush;
+        State state(static_cast<int>(i->second.iterations * options.iterationScale));
+        try {
+            i->second.function(state);
+        } catch (const std::exception &e) {
+            state.setError(e.what());
+        }
+
+        Result result;
+        result.name = i->first;
+        result.iterations = static_cast<int>(state.laps().size());
+        result.items = state.items();
+        result.bytes = state.bytes();
+        result.error = state.error();
+        if (result.error.empty() && state.laps().empty())
+            result.error = "benchmark did not run";
+        if (result.error.empty()) {
+            std::vector<int64_t> laps(state.laps());
+            std::sort(laps.begin(), laps.end());
+            result.min = laps.front();
+            result.max = laps.back();
+            result.median = laps[laps.size() / 2];
+            int64_t total = 0;
+            for (auto lap : laps) {
+                total += lap;
+            }
+            result.mean = total / static_cast<int64_t>(laps.size());
+            std::cerr << " " << formatTime(result.median) << std::endl;
+        } else {
+            std::cerr << " FAILED: " << result.error << std::endl;
+        }
+        answer.push_back(result);
+    }
+    for (auto i = s_cleanups.rbegin(); i != s_cleanups.rend(); ++i) {
+        (*i)();
+    }
+    s_cleanups.clear();
+    return answer;
+}
+
+void Bench::printTable(const std::vector<Result> &results, std::ostream &out)
+{
+    size_t width = 9;
+    for (const auto &result : results) {
+        width = std::max(width, result.name.size());
+    }
+    out << std::left << std::setw(width + 2) << "benchmark"
+        << std::right << std::setw(8) << "runs"
+        << std::setw(13) << "median" << std::setw(13) << "min" << std::setw(13) << "max"
+        << std::setw(16) << "items/s" << std::setw(12) << "MB/s" << std::endl;
+    for (const auto &result : results) {
+        out << std::left << std::setw(width + 2) << result.name << std::right;
+        if (!result.error.empty()) {
+            out << "  FAILED: " << result.error << std::endl;
+            continue;
+        }
+        out << std::setw(8) << result.iterations
+            << std::setw(13) << formatTime(result.median)
+            << std::setw(13) << formatTime(result.min)
+            << std::setw(13) << formatTime(result.max) << std::fixed << std::setprecision(0);
+        if (result.items > 0)
+            out << std::setw(16) << perSecond(result.items, result.median);
+        else
+            out << std::setw(16) << '-';
+        out << std::setprecision(1);
+        if (result.bytes > 0)
+            out << std::setw(12) << perSecond(result.bytes, result.median) / 1E6;
+        else
+            out << std::setw(12) << '-';
+        out << std::endl;
+    }
+}
+
+void Bench::printJson(const std::vector<Result> &results, std::ostream &out)
+{
+    UniValue benchmarks(UniValue::VARR);
+    for (const auto &result : results) {
+        UniValue item(UniValue::VOBJ);
+        item.pushKV("name", result.name);
+        if (result.error.empty()) {
+            item.pushKV("iterations", result.iterations);
+            item.pushKV("items_per_iteration", result.items);
+            item.pushKV("bytes_per_iteration", result.bytes);
+            item.pushKV("ns_min", result.min);
+            item.pushKV("ns_median", result.median);
+            item.pushKV("ns_mean", result.mean);
+            item.pushKV("ns_max", result.max);
+            if (result.items > 0)
+                item.pushKV("items_per_second", perSecond(result.items, result.median));
+            if (result.bytes > 0)
+                item.pushKV("bytes_per_second", perSecond(result.bytes, result.median));
+        } else {
+            item.pushKV("error", result.error);
+        }
+        benchmarks.push_back(item);
+    }
+
+    UniValue root(UniValue::VOBJ);
+    root.pushKV("suite", "bench_hub");
+    root.pushKV("version", FormatFullVersion());
+    root.pushKV("time", GetTime());
+    root.pushKV("utxo_entries", s_options.utxoEntries);
+    root.pushKV("iteration_scale", s_options.iterationScale);
+    root.pushKV("benchmarks", benchmarks);
+    out << root.write(2) << std::endl;
+}
+
+
+uint64_t Bench::Random::next()
+{
+    uint64_t z = (m_state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+uint256 Bench::Random::nextHash()
+{
+    uint256 answer;
+    uint64_t *words = reinterpret_cast<uint64_t*>(answer.begin());
+    for (int i = 0; i < 4; ++i) {
+        words[i] = next();
+    }
+    return answer;
+}
+
+uint256 Bench::Random::hashFor(uint64_t seed, uint64_t index)
+{
+    Random random(seed ^ (index * 0xd1342543de82ef95ULL));
+    return random.nextHash();
+}
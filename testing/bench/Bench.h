@@ -0,0 +1,182 @@
+/*
+ * This file is part of the Flowee project
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef FLOWEE_BENCH_H
+#define FLOWEE_BENCH_H
+
+#include <uint256.h>
+
+#include <boost/filesystem.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * A minimal benchmark framework for the bench_hub target.
+ *
+ * A benchmark is a function that gets a State and loops on keepRunning():
+ * @code
+ *   void myBench(Bench::State &state) {
+ *       auto data = createData(); // not timed
+ *       while (state.keepRunning()) {
+ *           process(data);
+ *       }
+ *       state.setItemsPerIteration(data.size());
+ *   }
+ *   static Bench::Registration r("group/name", &myBench, 50);
+ * @endcode
+ * Each iteration is timed separately so we can report the median, which is
+ * much more stable between runs than the mean.
+ */
+namespace Bench {
+
+class State
+{
+public:
+    explicit State(int iterations);
+
+    /// Returns true as long as the benchmark should run another iteration.
+    bool keepRunning();
+
+    /// Stop the clock, for instance to reset state between iterations.
+    void pauseTiming();
+    void resumeTiming();
+
+    /// The amount of items (transactions, lookups, messages) one iteration processed.
+    inline void setItemsPerIteration(int64_t items) {
+        m_items = items;
+    }
+    /// The amount of bytes one iteration processed.
+    inline void setBytesPerIteration(int64_t bytes) {
+        m_bytes = bytes;
+    }
+    /// Mark the run as failed, the message is reported instead of the timings.
+    void setError(const std::string &error);
+
+    inline int iterations() const {
+        return m_iterations;
+    }
+    inline int64_t items() const {
+        return m_items;
+    }
+    inline int64_t bytes() const {
+        return m_bytes;
+    }
+    inline const std::string &error() const {
+        return m_error;
+    }
+    /// The time, in nanoseconds, each iteration took.
+    inline const std::vector<int64_t> &laps() const {
+        return m_laps;
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+    const int m_iterations;
+    int m_current = -1;
+    bool m_paused = false;
+    Clock::time_point m_start;
+    int64_t m_lap = 0;
+    int64_t m_items = 0;
+    int64_t m_bytes = 0;
+    std::string m_error;
+    std::vector<int64_t> m_laps;
+};
+
+typedef std::function<void(State&)> Function;
+
+/// Static instances of this class add a benchmark to the suite.
+class Registration
+{
+public:
+    Registration(const char *name, const Function &function, int iterations);
+};
+
+struct Result
+{
+    std::string name;
+    int iterations = 0;
+    int64_t items = 0;
+    int64_t bytes = 0;
+    // all in nanoseconds per iteration
+    int64_t min = 0;
+    int64_t median = 0;
+    int64_t mean = 0;
+    int64_t max = 0;
+    std::string error;
+};
+
+struct Options
+{
+    std::string filter;  ///< substring the benchmark name has to contain.
+    double iterationScale = 1; ///< multiplier on the registered iteration counts.
+    int utxoEntries = 10000000;
+    boost::filesystem::path fixture; ///< the blk00000.dat chain, regtest.
+    boost::filesystem::path tempDir; ///< scratch space, removed on exit.
+};
+
+/// The options the benchmarks run with.
+const Options &options();
+
+/**
+ * Register \a cleanup to be called after the last benchmark ran.
+ * Used for fixtures that are expensive to create and are shared between benchmarks.
+ */
+void addCleanup(const std::function<void()> &cleanup);
+
+/// Returns the names of all registered benchmarks, sorted.
+std::vector<std::string> names();
+
+/// Runs all benchmarks matching the options' filter, progress is printed on stderr.
+std::vector<Result> run(const Options &options);
+
+void printTable(const std::vector<Result> &results, std::ostream &out);
+void printJson(const std::vector<Result> &results, std::ostream &out);
+
+/**
+ * A small deterministic random generator (splitmix64).
+ * The benchmarks use this instead of the system random so their data,
+ * and thus their timings, is identical between runs and between releases.
+ */
+class Random
+{
+public:
+    explicit Random(uint64_t seed = 0x466c6f776565ULL) : m_state(seed) {}
+
+    uint64_t next();
+    inline uint32_t next32() {
+        return static_cast<uint32_t>(next() >> 32);
+    }
+    /// Returns a random number in the range [0, max)
+    inline uint64_t next(uint64_t max) {
+        return next() % max;
+    }
+    uint256 nextHash();
+
+    /// Returns the hash for \a index, without needing any state.
+    static uint256 hashFor(uint64_t seed, uint64_t index);
+
+private:
+    uint64_t m_state;
+};
+
+}
+
+#endif
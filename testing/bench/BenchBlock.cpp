@@ -0,0 +1,107 @@
+/*
+ * This file is part of the Flowee project
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Bench.h"
+#include "BenchData.h"
+
+#include <primitives/FastTransaction.h>
+
+namespace {
+void findTransactions(Bench::State &state)
+{
+    const FastBlock &block = Bench::p2pkhBlock().block;
+    size_t found = 0;
+    while (state.keepRunning()) {
+        FastBlock copy(block.data());
+        copy.findTransactions();
+        found = copy.transactions().size();
+    }
+    state.setItemsPerIteration(static_cast<int64_t>(found));
+    state.setBytesPerIteration(block.size());
+}
+
+void iterateBlock(Bench::State &state)
+{
+    const FastBlock &block = Bench::p2pkhBlock().block;
+    FastBlock copy(block.data());
+    copy.findTransactions();
+    const int txCount = static_cast<int>(copy.transactions().size());
+
+    uint64_t checksum = 0;
+    while (state.keepRunning()) {
+        Tx::Iterator iter(block);
+        int ends = 0;
+        while (ends < txCount) {
+            switch (iter.next()) {
+            case Tx::End: ++ends; break;
+            case Tx::PrevTxHash: checksum += iter.uint256Data().GetCheapHash(); break;
+            case Tx::PrevTxIndex: checksum += iter.intData(); break;
+            case Tx::OutputValue: checksum += iter.longData(); break;
+            case Tx::TxInScript:
+            case Tx::OutputScript: checksum += iter.dataLength(); break;
+            default: break;
+            }
+        }
+    }
+    if (checksum == 0)
+        state.setError("iterator found no data");
+    state.setItemsPerIteration(txCount);
+    state.setBytesPerIteration(block.size());
+}
+
+void iterateTransactions(Bench::State &state)
+{
+    FastBlock block(Bench::p2pkhBlock().block.data());
+    block.findTransactions();
+
+    uint64_t checksum = 0;
+    while (state.keepRunning()) {
+        for (const Tx &tx : block.transactions()) {
+            Tx::Iterator iter(tx);
+            while (iter.next(Tx::OutputValue) == Tx::OutputValue) {
+                checksum += iter.longData();
+            }
+        }
+    }
+    if (checksum == 0)
+        state.setError("iterator found no outputs");
+    state.setItemsPerIteration(static_cast<int64_t>(block.transactions().size()));
+    state.setBytesPerIteration(block.size());
+}
+
+void hashTransactions(Bench::State &state)
+{
+    FastBlock block(Bench::p2pkhBlock().block.data());
+    block.findTransactions();
+
+    uint64_t checksum = 0;
+    while (state.keepRunning()) {
+        for (const Tx &tx : block.transactions()) {
+            checksum += tx.createHash().GetCheapHash();
+        }
+    }
+    if (checksum == 0)
+        state.setError("no hashes");
+    state.setItemsPerIteration(static_cast<int64_t>(block.transactions().size()));
+    state.setBytesPerIteration(block.size());
+}
+}
+
+static Bench::Registration r1("block/findTransactions", &findTransactions, 200);
+static Bench::Registration r2("block/txIterator", &iterateBlock, 200);
+static Bench::Registration r3("block/txIteratorOutputs", &iterateTransactions, 200);
+static Bench::Registration r4("block/txHash", &hashTransactions, 50);
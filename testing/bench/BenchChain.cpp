@@ -0,0 +1,176 @@
+/*
+ * This file is part of the Flowee project
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Bench.h"
+#include "BenchData.h"
+
+#include <Application.h>
+#include <BlocksDB.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <main.h>
+#include <txmempool.h>
+#include <util.h>
+#include <utxo/UnspentOutputDatabase.h>
+#include <validation/Engine.h>
+#include <validation/ValidationSettings.h>
+
+extern UnspentOutputDatabase *g_utxo;
+
+namespace {
+void setDataDir(const boost::filesystem::path &dir)
+{
+    boost::filesystem::create_directories(dir / "regtest/blocks/index");
+    mapArgs["-datadir"] = dir.string();
+    ClearDatadirCache();
+}
+
+/*
+ * A fresh regtest node, with only the genesis block.
+ * This is the same setup the unit tests use, minus the wallet and the networking.
+ */
+class Node
+{
+public:
+    explicit Node(const boost::filesystem::path &dir)
+        : m_dir(dir)
+    {
+        setDataDir(dir);
+        Blocks::DB::createTestInstance(1 << 20);
+        g_utxo = new UnspentOutputDatabase(Application::instance()->ioService(), GetDataDir(true) / "unspent");
+        m_mempool.setUtxo(g_utxo);
+        m_engine.reset(new Validation::Engine());
+        m_engine->setMempool(&m_mempool);
+        chainActive.SetTip(nullptr);
+        m_engine->setBlockchain(&chainActive);
+        m_engine->addBlock(FastBlock::fromOldBlock(Params().GenesisBlock()), Validation::SaveGoodToDisk);
+        m_engine->waitValidationFinished();
+    }
+
+    ~Node() {
+        m_engine->shutdown();
+        m_engine.reset();
+        UnloadBlockIndex();
+        delete g_utxo;
+        g_utxo = nullptr;
+        Blocks::DB::shutdown();
+        boost::system::error_code error;
+        boost::filesystem::remove_all(m_dir, error);
+    }
+
+    inline Validation::Engine *engine() const {
+        return m_engine.get();
+    }
+
+private:
+    boost::filesystem::path m_dir;
+    CTxMemPool m_mempool;
+    std::unique_ptr<Validation::Engine> m_engine;
+};
+
+/*
+ * Validate and connect all blocks of the fixture chain on top of the genesis.
+ * This covers the entire pipeline; header checks, script validation, UTXO updates,
+ * writing the block and undo files and updating the tip.
+ */
+void connectBlocks(Bench::State &state)
+{
+    const auto blocks = Bench::loadFixtureBlocks();
+    int64_t bytes = 0;
+    for (size_t i = 1; i < blocks.size(); ++i) {
+        bytes += blocks.at(i).size();
+    }
+
+    int run = 0;
+    while (state.keepRunning()) {
+        state.pauseTiming();
+        std::unique_ptr<Node> node(new Node(Bench::options().tempDir / strprintf("connect-%d", ++run)));
+        state.resumeTiming();
+
+        // Only wait for the header checks before offering the next block, this allows the
+        // engine to pipeline the rest of the validation like it does during the initial download.
+        std::vector<Validation::Settings> jobs;
+        jobs.reserve(blocks.size());
+        for (size_t i = 1; i < blocks.size(); ++i) {
+            jobs.push_back(node->engine()->addBlock(blocks.at(i), Validation::SaveGoodToDisk).start());
+            jobs.back().waitHeaderFinished();
+        }
+        for (const auto &job : jobs) {
+            job.waitUntilFinished();
+        }
+        // a block that finished before its parent got connected is appended later, wait for the tip.
+        const int target = static_cast<int>(blocks.size()) - 1;
+        int timeouts = 0;
+        {
+            boost::unique_lock<boost::mutex> lock(csBestBlock);
+            while (chainActive.Height() < target && timeouts < 10000) {
+                if (!cvBlockChange.timed_wait(lock, boost::posix_time::milliseconds(1)))
+                    ++timeouts;
+            }
+        }
+        node->engine()->waitValidationFinished();
+
+        state.pauseTiming();
+        const int height = chainActive.Height();
+        node.reset();
+        if (height != static_cast<int>(blocks.size()) - 1) {
+            state.setError(strprintf("chain ended at height %d, expected %d", height, blocks.size() - 1));
+            return;
+        }
+        state.resumeTiming();
+    }
+    state.setItemsPerIteration(static_cast<int64_t>(blocks.size()) - 1);
+    state.setBytesPerIteration(bytes);
+}
+
+// load all blocks from the blk00000.dat file through the blocks database.
+void loadBlocks(Bench::State &state)
+{
+    const auto blocks = Bench::loadFixtureBlocks();
+    const auto dir = Bench::options().tempDir / "blocksdb";
+    setDataDir(dir);
+    boost::filesystem::copy_file(Bench::options().fixture, dir / "regtest/blocks/blk00000.dat");
+    Blocks::DB::createTestInstance(1 << 20);
+
+    // the positions are the offsets just after the 8 byte magic + size prefix.
+    std::vector<CDiskBlockPos> positions;
+    uint32_t offset = 0;
+    int64_t bytes = 0;
+    for (const auto &block : blocks) {
+        positions.push_back(CDiskBlockPos(0, offset + 8));
+        offset += 8 + static_cast<uint32_t>(block.size());
+        bytes += block.size();
+    }
+
+    uint256 checksum;
+    while (state.keepRunning()) {
+        for (const auto &pos : positions) {
+            FastBlock block = Blocks::DB::instance()->loadBlock(pos);
+            block.findTransactions();
+            checksum = block.merkleRoot();
+        }
+    }
+    Blocks::DB::shutdown();
+    if (checksum != blocks.back().merkleRoot())
+        state.setError("loaded the wrong block");
+    state.setItemsPerIteration(static_cast<int64_t>(blocks.size()));
+    state.setBytesPerIteration(bytes);
+}
+}
+
+static Bench::Registration r1("chain/connectBlocks", &connectBlocks, 10);
+static Bench::Registration r2("chain/loadBlocks", &loadBlocks, 200);
@@ -0,0 +1,136 @@
+/*
+ * This file is part of the Flowee project
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "BenchData.h"
+#include "Bench.h"
+
+#include <chainparams.h>
+#include <crypto/common.h>
+#include <keystore.h>
+#include <merkle.h>
+#include <primitives/key.h>
+#include <primitives/block.h>
+#include <script/sign.h>
+#include <streaming/BufferPool.h>
+
+#include <boost/filesystem/fstream.hpp>
+
+#include <memory>
+#include <string.h>
+
+namespace {
+constexpr int TransactionCount = 2000;
+constexpr int KeyCount = 16;
+
+Bench::P2PKHBlock *createP2PKHBlock()
+{
+    Bench::Random random(42);
+    CBasicKeyStore keystore;
+    std::vector<CScript> scripts;
+    for (int i = 0; i < KeyCount; ++i) {
+        const uint256 secret = random.nextHash();
+        CKey key;
+        key.Set(secret.begin(), secret.end(), true);
+        assert(key.IsValid());
+        keystore.AddKey(key);
+        scripts.push_back(CScript() << OP_DUP << OP_HASH160 << ToByteVector(key.GetPubKey().getKeyId())
+                          << OP_EQUALVERIFY << OP_CHECKSIG);
+    }
+
+    std::unique_ptr<Bench::P2PKHBlock> answer(new Bench::P2PKHBlock());
+    CBlock block;
+    block.nVersion = 4;
+    block.hashPrevBlock = random.nextHash();
+    block.nTime = 1600000000;
+    block.nBits = 0x207fffff;
+
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].scriptSig = CScript() << 1000 << OP_0 << std::vector<uint8_t>(90);
+    coinbase.vout.resize(1);
+    coinbase.vout[0].nValue = 50 * COIN;
+    coinbase.vout[0].scriptPubKey = scripts[0];
+    block.vtx.push_back(coinbase);
+
+    for (int i = 0; i < TransactionCount; ++i) {
+        CMutableTransaction tx;
+        tx.vin.resize(2);
+        std::vector<CTxOut> spent;
+        for (size_t in = 0; in < tx.vin.size(); ++in) {
+            tx.vin[in].prevout = COutPoint(random.nextHash(), random.next(4));
+            spent.push_back(CTxOut(static_cast<int64_t>(random.next(100 * COIN) + 10000),
+                                   scripts[random.next(KeyCount)]));
+        }
+        int64_t total = 0;
+        for (const auto &out : spent) {
+            total += out.nValue;
+        }
+        tx.vout.resize(2);
+        tx.vout[0].nValue = total / 3;
+        tx.vout[0].scriptPubKey = scripts[random.next(KeyCount)];
+        tx.vout[1].nValue = total - tx.vout[0].nValue - 500;
+        tx.vout[1].scriptPubKey = scripts[random.next(KeyCount)];
+
+        for (size_t in = 0; in < tx.vin.size(); ++in) {
+            if (!SignSignature(keystore, spent[in].scriptPubKey, tx, in, spent[in].nValue, SIGHASH_ALL | SIGHASH_FORKID))
+                throw std::runtime_error("Failed to sign benchmark transaction");
+        }
+        block.vtx.push_back(tx);
+        answer->spentOutputs.insert(answer->spentOutputs.end(), spent.begin(), spent.end());
+    }
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+    answer->inputCount = static_cast<int>(answer->spentOutputs.size());
+
+    Streaming::BufferPool pool(static_cast<int>(::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION)) + 100);
+    answer->block = FastBlock::fromOldBlock(block, &pool);
+    return answer.release();
+}
+}
+
+const Bench::P2PKHBlock &Bench::p2pkhBlock()
+{
+    static std::unique_ptr<P2PKHBlock> s_block(createP2PKHBlock());
+    return *s_block;
+}
+
+std::vector<FastBlock> Bench::loadFixtureBlocks()
+{
+    const auto &path = options().fixture;
+    boost::filesystem::ifstream in(path, std::ios::binary);
+    if (!in.is_open())
+        throw std::runtime_error("Failed to open fixture " + path.string());
+    const auto fileSize = boost::filesystem::file_size(path);
+    Streaming::BufferPool pool(static_cast<int>(fileSize));
+    in.read(pool.begin(), static_cast<std::streamsize>(fileSize));
+    if (static_cast<uint64_t>(in.gcount()) != fileSize)
+        throw std::runtime_error("Failed to read fixture");
+    Streaming::ConstBuffer file = pool.commit(static_cast<int>(fileSize));
+
+    std::vector<FastBlock> answer;
+    const char *pos = file.begin();
+    while (pos + 8 <= file.end()) {
+        if (memcmp(pos, Params().MessageStart(), 4) != 0)
+            throw std::runtime_error("Fixture is not a regtest blocks file");
+        const uint32_t size = ReadLE32(reinterpret_cast<const unsigned char*>(pos + 4));
+        pos += 8;
+        if (size < 80 || pos + size > file.end())
+            throw std::runtime_error("Fixture is truncated");
+        answer.push_back(FastBlock(file.mid(static_cast<int>(pos - file.begin()), static_cast<int>(size))));
+        pos += size;
+    }
+    return answer;
+}
@@ -0,0 +1,53 @@
+/*
+ * This file is part of the Flowee project
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef FLOWEE_BENCHDATA_H
+#define FLOWEE_BENCHDATA_H
+
+#include <primitives/FastBlock.h>
+#include <primitives/transaction.h>
+
+#include <vector>
+
+namespace Bench {
+
+/**
+ * A block filled with standard pay-to-pubkey-hash transactions.
+ * Each transaction has two signed inputs and two outputs, which is close to
+ * the average transaction seen on the network.
+ */
+struct P2PKHBlock
+{
+    FastBlock block;
+    /// For each non-coinbase input, in block order, the output it spends.
+    std::vector<CTxOut> spentOutputs;
+    int inputCount = 0;
+};
+
+/// Returns the (deterministic) block, it is created on first call.
+const P2PKHBlock &p2pkhBlock();
+
+/**
+ * Returns the blocks stored in the fixture file, which is in the standard
+ * blk?????.dat format. The genesis is included.
+ * Throws on a missing or corrupt file.
+ */
+std::vector<FastBlock> loadFixtureBlocks();
+
+}
+
+#endif
@@ -0,0 +1,56 @@
+/*
+ * This file is part of the Flowee project
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Bench.h"
+#include "BenchData.h"
+
+#include <policy/policy.h>
+#include <primitives/block.h>
+#include <script/interpreter.h>
+
+namespace {
+/*
+ * Verify all inputs of a block full of P2PKH transactions, single threaded and without
+ * the signature cache. This is the cost the hub pays on a block it never saw in its mempool.
+ */
+void verifyP2PKHBlock(Bench::State &state)
+{
+    const auto &data = Bench::p2pkhBlock();
+    const CBlock block = data.block.createOldBlock();
+    const uint32_t flags = STANDARD_SCRIPT_VERIFY_FLAGS | SCRIPT_ENABLE_SIGHASH_FORKID;
+
+    while (state.keepRunning()) {
+        size_t spentIndex = 0;
+        for (size_t i = 1; i < block.vtx.size(); ++i) {
+            const CTransaction &tx = block.vtx.at(i);
+            for (size_t in = 0; in < tx.vin.size(); ++in) {
+                const CTxOut &spent = data.spentOutputs.at(spentIndex++);
+                Script::State scriptState(flags);
+                TransactionSignatureChecker checker(&tx, static_cast<unsigned int>(in), spent.nValue);
+                if (!Script::verify(tx.vin[in].scriptSig, spent.scriptPubKey, checker, scriptState)) {
+                    state.setError(std::string("script failed: ") + scriptState.errorString());
+                    return;
+                }
+            }
+        }
+    }
+    state.setItemsPerIteration(data.inputCount);
+    state.setBytesPerIteration(data.block.size());
+}
+}
+
+static Bench::Registration r1("script/verifyP2PKHBlock", &verifyP2PKHBlock, 5);
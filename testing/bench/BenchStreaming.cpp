@@ -0,0 +1,149 @@
+/*
+ * This file is part of the Flowee project
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Bench.h"
+
+#include <Message.h>
+#include <streaming/BufferPool.h>
+#include <streaming/MessageBuilder.h>
+#include <streaming/MessageParser.h>
+
+namespace {
+/*
+ * The rows a typical API reply carries, like a GetTransaction or an address-monitor
+ * notification: a txid, a couple of integers, an amount and an output-script.
+ */
+constexpr int Rows = 1000;
+constexpr int RowSize = 35 + 6 + 6 + 10 + 28;
+
+enum Tags {
+    Separator = 0,
+    TxId,
+    BlockHeight,
+    OffsetInBlock,
+    Amount,
+    OutputScript
+};
+
+struct Row {
+    uint256 txid;
+    int blockHeight;
+    int offsetInBlock;
+    uint64_t amount;
+    std::vector<uint8_t> script;
+};
+
+std::vector<Row> createRows()
+{
+    Bench::Random random(7);
+    std::vector<Row> rows;
+    rows.reserve(Rows);
+    for (int i = 0; i < Rows; ++i) {
+        Row row;
+        row.txid = random.nextHash();
+        row.blockHeight = 600000 + static_cast<int>(random.next(100000));
+        row.offsetInBlock = 81 + static_cast<int>(random.next(32000000));
+        row.amount = random.next(21000000) * 100000000ULL;
+        row.script.resize(25);
+        for (auto &byte : row.script) {
+            byte = static_cast<uint8_t>(random.next());
+        }
+        rows.push_back(row);
+    }
+    return rows;
+}
+
+Message build(Streaming::BufferPool &pool, const std::vector<Row> &rows)
+{
+    pool.reserve(Rows * RowSize);
+    Streaming::MessageBuilder builder(pool);
+    for (const Row &row : rows) {
+        builder.add(TxId, row.txid);
+        builder.add(BlockHeight, row.blockHeight);
+        builder.add(OffsetInBlock, row.offsetInBlock);
+        builder.add(Amount, row.amount);
+        builder.add(OutputScript, row.script);
+        builder.add(Separator, true);
+    }
+    return builder.message(4, 1);
+}
+
+uint64_t parse(const Message &message)
+{
+    uint64_t checksum = 0;
+    Streaming::MessageParser parser(message);
+    while (parser.next() == Streaming::FoundTag) {
+        switch (parser.tag()) {
+        case TxId: checksum += parser.uint256Data().GetCheapHash(); break;
+        case BlockHeight:
+        case OffsetInBlock: checksum += parser.intData(); break;
+        case Amount: checksum += parser.longData(); break;
+        case OutputScript: checksum += parser.bytesDataBuffer().size(); break;
+        default: break;
+        }
+    }
+    return checksum;
+}
+
+void messageBuilder(Bench::State &state)
+{
+    const auto rows = createRows();
+    Streaming::BufferPool pool(Rows * RowSize * 4);
+    int size = 0;
+    while (state.keepRunning()) {
+        size = build(pool, rows).body().size();
+    }
+    state.setItemsPerIteration(Rows);
+    state.setBytesPerIteration(size);
+}
+
+void messageParser(Bench::State &state)
+{
+    const auto rows = createRows();
+    Streaming::BufferPool pool;
+    const Message message = build(pool, rows);
+    uint64_t checksum = 0;
+    while (state.keepRunning()) {
+        checksum += parse(message);
+    }
+    if (checksum == 0)
+        state.setError("nothing parsed");
+    state.setItemsPerIteration(Rows);
+    state.setBytesPerIteration(message.body().size());
+}
+
+void messageRoundTrip(Bench::State &state)
+{
+    const auto rows = createRows();
+    Streaming::BufferPool pool(Rows * RowSize * 4);
+    uint64_t checksum = 0;
+    int size = 0;
+    while (state.keepRunning()) {
+        const Message message = build(pool, rows);
+        size = message.body().size();
+        checksum += parse(message);
+    }
+    if (checksum == 0)
+        state.setError("nothing parsed");
+    state.setItemsPerIteration(Rows);
+    state.setBytesPerIteration(size);
+}
+}
+
+static Bench::Registration r1("streaming/messageBuilder", &messageBuilder, 1000);
+static Bench::Registration r2("streaming/messageParser", &messageParser, 1000);
+static Bench::Registration r3("streaming/roundTrip", &messageRoundTrip, 1000);
@@ -0,0 +1,189 @@
+/*
+ * This file is part of the Flowee project
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Bench.h"
+
+#include <Application.h>
+#include <utxo/UnspentOutputDatabase.h>
+
+#include <memory>
+
+namespace {
+constexpr uint64_t TxIdSeed = 0x7478;
+constexpr uint64_t BlockIdSeed = 0x626c;
+constexpr int OutputsPerTx = 2;
+constexpr int OutputsPerBlock = 10000;
+constexpr int OperationsPerIteration = 100000;
+
+/*
+ * A UTXO filled with options().utxoEntries outputs. Entry 'n' is output n % 2
+ * of the transaction with id hashFor(TxIdSeed, n / 2), which allows us to find
+ * back any entry without keeping all the txids in memory.
+ */
+class UtxoFixture
+{
+public:
+    static UtxoFixture *instance() {
+        if (s_instance == nullptr) {
+            s_instance = new UtxoFixture();
+            Bench::addCleanup([]() {
+                delete s_instance;
+                s_instance = nullptr;
+            });
+        }
+        return s_instance;
+    }
+
+    /// Adds entries [first, first + count) in blocks of OutputsPerBlock.
+    void addEntries(int first, int count) {
+        const int end = first + count;
+        while (first < end) {
+            UnspentOutputDatabase::BlockData data;
+            data.blockHeight = ++m_height;
+            const int blockEnd = std::min(end, first + OutputsPerBlock);
+            for (int n = first; n < blockEnd; n += OutputsPerTx) {
+                const int offset = 81 + (n % OutputsPerBlock) * 113;
+                data.outputs.push_back(UnspentOutputDatabase::BlockData::TxOutputs(
+                            Bench::Random::hashFor(TxIdSeed, n / OutputsPerTx), offset, 0, OutputsPerTx - 1));
+            }
+            m_db->insertAll(data);
+            m_db->blockFinished(m_height, Bench::Random::hashFor(BlockIdSeed, m_height));
+            first = blockEnd;
+        }
+        m_nextEntry = std::max(m_nextEntry, end);
+    }
+
+    inline UnspentOutputDatabase *db() const {
+        return m_db.get();
+    }
+    inline int populated() const {
+        return m_populated;
+    }
+    inline int nextEntry() const {
+        return m_nextEntry;
+    }
+    inline int finishBlock() {
+        ++m_height;
+        m_db->blockFinished(m_height, Bench::Random::hashFor(BlockIdSeed, m_height));
+        return m_height;
+    }
+
+private:
+    UtxoFixture()
+        : m_populated(Bench::options().utxoEntries / OutputsPerTx * OutputsPerTx)
+    {
+        const auto dir = Bench::options().tempDir / "utxo";
+        boost::filesystem::create_directories(dir);
+        m_db.reset(new UnspentOutputDatabase(Application::instance()->ioService(), dir));
+        addEntries(0, m_populated);
+    }
+
+    static UtxoFixture *s_instance;
+    std::unique_ptr<UnspentOutputDatabase> m_db;
+    const int m_populated;
+    int m_nextEntry = 0;
+    int m_height = 0;
+};
+
+UtxoFixture *UtxoFixture::s_instance = nullptr;
+
+// small databases (for a quick run) get less operations per iteration
+int operationCount(const UtxoFixture *fixture)
+{
+    return std::max(1, std::min(OperationsPerIteration, fixture->populated() / 50));
+}
+
+// insert new outputs on top of the filled database, as a block would.
+void utxoInsert(Bench::State &state)
+{
+    UtxoFixture *fixture = UtxoFixture::instance();
+    const int operations = operationCount(fixture);
+    while (state.keepRunning()) {
+        fixture->addEntries(fixture->nextEntry(), operations);
+    }
+    state.setItemsPerIteration(operations);
+}
+
+// look up random existing outputs, the main cost of validating a transaction.
+void utxoFind(Bench::State &state)
+{
+    UtxoFixture *fixture = UtxoFixture::instance();
+    const int operations = operationCount(fixture);
+    const uint64_t entries = static_cast<uint64_t>(fixture->populated());
+    Bench::Random random(11);
+    while (state.keepRunning()) {
+        for (int i = 0; i < operations; ++i) {
+            const uint64_t n = random.next(entries);
+            auto output = fixture->db()->find(Bench::Random::hashFor(TxIdSeed, n / OutputsPerTx), n % OutputsPerTx);
+            if (!output.isValid()) {
+                state.setError("entry not found");
+                return;
+            }
+        }
+    }
+    state.setItemsPerIteration(operations);
+}
+
+// look up outputs that are not there, like a double spend or an orphan would.
+void utxoFindMissing(Bench::State &state)
+{
+    UtxoFixture *fixture = UtxoFixture::instance();
+    const int operations = operationCount(fixture);
+    Bench::Random random(12);
+    while (state.keepRunning()) {
+        for (int i = 0; i < operations; ++i) {
+            auto output = fixture->db()->find(random.nextHash(), 0);
+            if (output.isValid()) {
+                state.setError("found non-existing entry");
+                return;
+            }
+        }
+    }
+    state.setItemsPerIteration(operations);
+}
+
+// spend existing outputs, each iteration removes a distinct set and ends the block.
+void utxoRemove(Bench::State &state)
+{
+    UtxoFixture *fixture = UtxoFixture::instance();
+    const int operations = operationCount(fixture);
+    const int stride = fixture->populated() / operations;
+    if (stride <= state.iterations()) {
+        state.setError("not enough utxo-entries for this benchmark");
+        return;
+    }
+    int iteration = 0;
+    while (state.keepRunning()) {
+        for (int i = 0; i < operations; ++i) {
+            const int n = i * stride + iteration;
+            auto spent = fixture->db()->remove(Bench::Random::hashFor(TxIdSeed, n / OutputsPerTx), n % OutputsPerTx);
+            if (!spent.isValid()) {
+                state.setError("entry not found");
+                return;
+            }
+        }
+        fixture->finishBlock();
+        ++iteration;
+    }
+    state.setItemsPerIteration(operations);
+}
+}
+
+static Bench::Registration r1("utxo/find", &utxoFind, 20);
+static Bench::Registration r2("utxo/findMissing", &utxoFindMissing, 20);
+static Bench::Registration r3("utxo/insert", &utxoInsert, 10);
+static Bench::Registration r4("utxo/remove", &utxoRemove, 10);
@@ -0,0 +1,163 @@
+/*
+ * This file is part of the Flowee project
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Bench.h"
+
+#include <Application.h>
+#include <chainparams.h>
+#include <chainparamsbase.h>
+#include <init.h>
+#include <Logger.h>
+#include <primitives/key.h>
+#include <primitives/pubkey.h>
+#include <script/sigcache.h>
+#include <server/serverutil.h>
+#include <UiInterface.h>
+#include <utxo/UnspentOutputDatabase.h>
+
+#include <fstream>
+#include <iostream>
+#include <unistd.h>
+
+CClientUIInterface uiInterface; // Declared but not defined in UiInterface.h
+
+UnspentOutputDatabase *g_utxo = nullptr;
+
+extern void noui_connect();
+
+void StartShutdown()
+{
+    exit(0);
+}
+
+bool ShutdownRequested()
+{
+    return false;
+}
+
+namespace {
+void usage(const char *name)
+{
+    std::cout << "Usage: " << name << " [options]" << std::endl << std::endl
+              << "Runs the Hub benchmark suite." << std::endl << std::endl
+              << "Options:" << std::endl
+              << "  --list               List the benchmarks and exit" << std::endl
+              << "  --filter=TEXT        Only run benchmarks whose name contains TEXT" << std::endl
+              << "  --json=FILE          Write the results as JSON to FILE, use '-' for stdout" << std::endl
+              << "  --scale=FACTOR       Multiply the amount of iterations by FACTOR (default 1)" << std::endl
+              << "  --utxo-entries=N     Size of the UTXO database benchmarked (default 10000000)" << std::endl
+              << "  --fixture=FILE       The regtest blk00000.dat used for the chain benchmarks" << std::endl
+              << "  --tmpdir=DIR         Directory to create scratch data in" << std::endl;
+}
+
+bool startsWith(const std::string &arg, const char *prefix, std::string &value)
+{
+    const size_t length = strlen(prefix);
+    if (arg.compare(0, length, prefix) != 0)
+        return false;
+    value = arg.substr(length);
+    return true;
+}
+}
+
+int main(int argc, char **argv)
+{
+    Bench::Options options;
+    options.fixture = BENCH_FIXTURE;
+    options.tempDir = boost::filesystem::temp_directory_path();
+    std::string jsonFile;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg(argv[i]);
+            std::string value;
+            if (arg == "--help" || arg == "-h") {
+                usage(argv[0]);
+                return 0;
+            }
+            if (arg == "--list") {
+                for (const auto &name : Bench::names()) {
+                    std::cout << name << std::endl;
+                }
+                return 0;
+            }
+            if (startsWith(arg, "--filter=", value))
+                options.filter = value;
+            else if (startsWith(arg, "--json=", value))
+                jsonFile = value;
+            else if (startsWith(arg, "--scale=", value))
+                options.iterationScale = std::stod(value);
+            else if (startsWith(arg, "--utxo-entries=", value))
+                options.utxoEntries = std::stoi(value);
+            else if (startsWith(arg, "--fixture=", value))
+                options.fixture = value;
+            else if (startsWith(arg, "--tmpdir=", value))
+                options.tempDir = value;
+            else {
+                std::cerr << "Unknown argument: " << arg << std::endl;
+                usage(argv[0]);
+                return 1;
+            }
+        }
+    } catch (const std::exception &) {
+        std::cerr << "Failed to parse arguments" << std::endl;
+        return 1;
+    }
+    if (options.iterationScale <= 0 || options.utxoEntries < 1000) {
+        std::cerr << "Invalid scale or utxo-entries" << std::endl;
+        return 1;
+    }
+    options.tempDir /= strprintf("bench_hub_%d", getpid());
+
+    // the hub is very chatty on block-connect, keep the output to the results.
+    Log::Manager::instance()->clearChannels();
+    ECC_Start();
+    std::unique_ptr<ECCVerifyHandle> verifyHandle(new ECCVerifyHandle());
+    SetupEnvironment();
+    InitSignatureCache();
+    SelectParams(CBaseChainParams::REGTEST);
+    noui_connect();
+
+    boost::filesystem::create_directories(options.tempDir);
+    auto results = Bench::run(options);
+    boost::system::error_code error;
+    boost::filesystem::remove_all(options.tempDir, error);
+
+    if (jsonFile == "-") {
+        Bench::printJson(results, std::cout);
+    } else if (!jsonFile.empty()) {
+        std::ofstream out(jsonFile);
+        Bench::printJson(results, out);
+        if (!out.good()) {
+            std::cerr << "Failed to write " << jsonFile << std::endl;
+            return 1;
+        }
+    }
+    if (jsonFile != "-") {
+        std::cout << std::endl;
+        Bench::printTable(results, std::cout);
+    }
+
+    verifyHandle.reset();
+    ECC_Stop();
+    Application::quit(0);
+
+    for (const auto &result : results) {
+        if (!result.error.empty())
+            return 2;
+    }
+    return 0;
+}
@@ -665,3 +665,89 @@ void TestBloom::rolling_bloom()
     }
 }
 
+
+static CTransaction matchTx()
+{
+    // Random real transaction (b4749f017444b051c44dfd2720e88f314ff94f3dd6d56d40ef65854fcd7fff6b)
+    CTransaction tx;
+    CDataStream stream(ParseHex("01000000010b26e9b7735eb6aabdf358bab62f9816a21ba9ebdb719d5299e88607d722c190000000008b4830450220070aca44506c5cef3a16ed519d7c3c39f8aab192c4e1c90d065f37b8a4af6141022100a8e160b856c2d43d27d8fba71e5aef6405b8643ac4cb7cb3c462aced7f14711a0141046d11fee51b0e60666d5049a9101a72741df480b96ee26488a4d3466b95c9a40ac5eeef87e10a5cd336c19a84565f80fa6c547957b7700ff4dfbdefe76036c339ffffffff021bff3d11000000001976a91404943fdd508053c75000106d3bc6e2754dbcff1988ac2f15de00000000001976a914a266436d2965547608b9e15d9032a7b9d64fa43188ac00000000"), SER_DISK, CLIENT_VERSION);
+    stream >> tx;
+    return tx;
+}
+
+void TestBloom::match_outputs()
+{
+    const CTransaction tx = matchTx();
+    CBloomFilter filter(10, 0.000001, 0, BLOOM_UPDATE_ALL);
+    filter.insert(ParseHex("a266436d2965547608b9e15d9032a7b9d64fa431"));
+    auto matches = filter.matchOutputs(tx);
+    QCOMPARE(matches.size(), (size_t) 2);
+    QVERIFY(!matches[0]);
+    QVERIFY(matches[1]);
+    // matchOutputs doesn't update the filter
+    QVERIFY(!filter.contains(COutPoint(tx.GetHash(), 1)));
+
+    filter.insert(ParseHex("04943fdd508053c75000106d3bc6e2754dbcff19"));
+    matches = filter.matchOutputs(tx);
+    QVERIFY(matches[0]);
+    QVERIFY(matches[1]);
+
+    filter = CBloomFilter(10, 0.000001, 0, BLOOM_UPDATE_ALL);
+    filter.insert(ParseHex("0000006d2965547608b9e15d9032a7b9d64fa431"));
+    matches = filter.matchOutputs(tx);
+    QVERIFY(!matches[0]);
+    QVERIFY(!matches[1]);
+}
+
+void TestBloom::benchInsert()
+{
+    // the size of a wallet with a couple thousand keys.
+    std::vector<std::vector<unsigned char> > keys;
+    for (int i = 0; i < 5000; ++i) {
+        keys.push_back(RandomData());
+    }
+    QBENCHMARK {
+        CBloomFilter filter(keys.size(), 0.0001, 0, BLOOM_UPDATE_ALL);
+        for (const auto &key : keys) {
+            filter.insert(key);
+        }
+    }
+}
+
+void TestBloom::benchContains()
+{
+    CBloomFilter filter(5000, 0.0001, 0, BLOOM_UPDATE_ALL);
+    std::vector<std::vector<unsigned char> > keys;
+    for (int i = 0; i < 5000; ++i) {
+        keys.push_back(RandomData());
+        filter.insert(keys.back());
+    }
+    // mostly items not in the filter, like a server checking transactions.
+    std::vector<std::vector<unsigned char> > lookups;
+    for (int i = 0; i < 20000; ++i) {
+        lookups.push_back(i % 10 == 0 ? keys.at(i / 10) : RandomData());
+    }
+    int found = 0;
+    QBENCHMARK {
+        for (const auto &item : lookups) {
+            if (filter.contains(item))
+                ++found;
+        }
+    }
+    QVERIFY(found > 0);
+}
+
+void TestBloom::benchMatchTx()
+{
+    const CTransaction tx = matchTx();
+    CBloomFilter filter(5000, 0.0001, 0, BLOOM_UPDATE_NONE);
+    for (int i = 0; i < 5000; ++i) {
+        filter.insert(RandomData());
+    }
+    QBENCHMARK {
+        for (int i = 0; i < 1000; ++i) {
+            filter.matchOutputs(tx);
+            filter.matchInputs(tx);
+        }
+    }
+}
@@ -40,6 +40,11 @@ private slots:
     void merkle_block_4_test_p2pubkey_only();
     void merkle_block_4_test_update_none();
     void rolling_bloom();
+
+    void match_outputs();
+    void benchInsert();
+    void benchContains();
+    void benchMatchTx();
 };
 
 #endif
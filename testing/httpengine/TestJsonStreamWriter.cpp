@@ -0,0 +1,120 @@
+/*
+ * This file is part of the Flowee project
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "TestJsonStreamWriter.h"
+#include <QBuffer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSignalSpy>
+#include <QTest>
+
+#include <httpengine/jsonstreamwriter.h>
+#include <httpengine/socket.h>
+
+#include "common/qsimplehttpclient.h"
+#include "common/qsocketpair.h"
+
+void TestJsonStreamWriter::testEmptyArray()
+{
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+
+    HttpEngine::JsonArrayStreamer streamer(&buffer, 0, [](HttpEngine::JsonStreamWriter&, int) {
+        QFAIL("No items to write");
+    });
+    streamer.setIndented(false);
+    QSignalSpy finishedSpy(&streamer, SIGNAL(finished()));
+    streamer.start();
+
+    QCOMPARE(finishedSpy.count(), 1);
+    QCOMPARE(streamer.itemsWritten(), 0);
+    QCOMPARE(data, QByteArray("[]"));
+}
+
+void TestJsonStreamWriter::testArray()
+{
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+
+    HttpEngine::JsonArrayStreamer streamer(&buffer, 3, [](HttpEngine::JsonStreamWriter &writer, int index) {
+        QJsonObject item;
+        item.insert("index", index);
+        item.insert("name", QString("item %1").arg(index));
+        writer.writeValue(item);
+    });
+    QSignalSpy finishedSpy(&streamer, SIGNAL(finished()));
+    streamer.start();
+
+    QCOMPARE(finishedSpy.count(), 1);
+    QCOMPARE(streamer.itemsWritten(), 3);
+    QJsonParseError error;
+    const QJsonDocument doc = QJsonDocument::fromJson(data, &error);
+    QCOMPARE(error.error, QJsonParseError::NoError);
+    QVERIFY(doc.isArray());
+    const QJsonArray array = doc.array();
+    QCOMPARE(array.size(), 3);
+    QCOMPARE(array.at(2).toObject().value("index").toInt(), 2);
+    QCOMPARE(array.at(1).toObject().value("name").toString(), QString("item 1"));
+}
+
+void TestJsonStreamWriter::testLargeStream()
+{
+    QSocketPair pair;
+    QTRY_VERIFY(pair.isConnected());
+    QSimpleHttpClient client(pair.client());
+    HttpEngine::Socket *server = new HttpEngine::Socket(pair.server(), &pair);
+
+    client.sendHeaders("GET", "/test");
+    QTRY_VERIFY(server->isHeadersParsed());
+
+    const int ItemCount = 20000;
+    const QString filler(100, 'x');
+    server->beginStreamingResponse();
+    auto streamer = new HttpEngine::JsonArrayStreamer(server, ItemCount,
+            [&filler](HttpEngine::JsonStreamWriter &writer, int index) {
+        QJsonObject item;
+        item.insert("index", index);
+        item.insert("data", filler);
+        writer.writeValue(item);
+    }, server);
+    streamer->setIndented(false);
+    streamer->setMaxPendingBytes(50000);
+    QSignalSpy finishedSpy(streamer, SIGNAL(finished()));
+    connect(streamer, SIGNAL(finished()), server, SLOT(close()));
+    streamer->start();
+
+    // nothing has been sent yet, so the streamer has to wait for the client.
+    QVERIFY(streamer->itemsWritten() > 0);
+    QVERIFY(streamer->itemsWritten() < ItemCount);
+    QVERIFY(server->bytesToWrite() < 100000);
+
+    QTRY_COMPARE_WITH_TIMEOUT(finishedSpy.count(), 1, 20000);
+    QTRY_COMPARE(pair.client()->state(), QAbstractSocket::UnconnectedState);
+
+    QJsonParseError error;
+    const QJsonDocument doc = QJsonDocument::fromJson(client.data(), &error);
+    QCOMPARE(error.error, QJsonParseError::NoError);
+    QVERIFY(doc.isArray());
+    const QJsonArray array = doc.array();
+    QCOMPARE(array.size(), ItemCount);
+    for (int i = 0; i < ItemCount; ++i) {
+        QCOMPARE(array.at(i).toObject().value("index").toInt(), i);
+    }
+}
@@ -55,6 +55,43 @@ void TestServer::testServer()
     QTRY_COMPARE(handler.mPath, QString("/test"));
 }
 
+void TestServer::testKeepAlive()
+{
+    HttpEngine::Server server([](HttpEngine::WebRequest *request) {
+        auto socket = request->socket();
+        QObject::connect(socket, SIGNAL(disconnected()), request, SLOT(deleteLater()));
+        const QByteArray body = request->path().toLatin1();
+        socket->setHeader("Content-Length", QByteArray::number(body.size()));
+        socket->write(body);
+        socket->close();
+    });
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    QTcpSocket socket;
+    socket.connectToHost(server.serverAddress(), server.serverPort());
+    QTRY_COMPARE(socket.state(), QAbstractSocket::ConnectedState);
+
+    // two pipelined requests, answered in order on the same connection
+    socket.write("GET /first HTTP/1.1\r\nHost: localhost\r\n\r\n"
+                 "GET /second HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    QByteArray response;
+    QTRY_VERIFY((response += socket.readAll()).endsWith("/second"));
+    QCOMPARE(response.count("HTTP/1.1 200 OK"), 2);
+    QVERIFY(response.indexOf("/first") < response.indexOf("/second"));
+    QVERIFY(!response.contains("Connection: close"));
+
+    // and the connection is still usable
+    response.clear();
+    socket.write("GET /third HTTP/1.1\r\nConnection: close\r\n\r\n");
+    QTRY_VERIFY((response += socket.readAll()).endsWith("/third"));
+    QVERIFY(response.contains("Connection: close"));
+    QTRY_COMPARE(socket.state(), QAbstractSocket::UnconnectedState);
+
+    auto stats = server.statistics();
+    QCOMPARE(stats.connectionsAccepted, 1ull);
+    QCOMPARE(stats.requests, 3ull);
+}
+
 #if !defined(QT_NO_SSL)
 void TestServer::testSsl()
 {
@@ -38,6 +38,7 @@ class TestServer : public QObject
 private Q_SLOTS:
 
     void testServer();
+    void testKeepAlive();
 
 #if !defined(QT_NO_SSL)
     void testSsl();
@@ -19,6 +19,7 @@
 #include "TestFilesystemHandler.h"
 #include "TestParser.h"
 #include "TestHandler.h"
+#include "TestJsonStreamWriter.h"
 #include "TestLocalFile.h"
 #include "TestLocalAuthMiddleware.h"
 #include "TestMiddleware.h"
@@ -47,6 +48,10 @@ int main(int x, char **y)
         TestHandler test;
         rc = QTest::qExec(&test);
     }
+    if (!rc) {
+        TestJsonStreamWriter test;
+        rc = QTest::qExec(&test);
+    }
     if (!rc) {
         TestLocalFile test;
         rc = QTest::qExec(&test);
@@ -86,3 +86,117 @@ void TestMetaBlock::testCreation()
         QFAIL("Out of bounds, should have thrown");
     } catch (...) { }
 }
+
+void TestMetaBlock::testScriptHashFilter()
+{
+    QFile input(":/blockdata");
+    Streaming::BufferPool pool;
+    bool ok = input.open(QIODevice::ReadOnly);
+    QVERIFY(ok);
+    auto size = input.read(pool.begin(), pool.capacity());
+    FastBlock block(pool.commit(size));
+
+    std::vector<std::unique_ptr<std::deque<std::int32_t> > > feesVector;
+    BlockMetaData noFilter = BlockMetaData::parseBlock(13451, block, feesVector, pool);
+    QCOMPARE(noFilter.hasScriptHashFilter(), false);
+    QVERIFY(!noFilter.scriptHashFilter().isValid());
+
+    BlockMetaData md = BlockMetaData::parseBlock(13451, block, feesVector, pool, false, true);
+    QVERIFY(md.hasScriptHashFilter());
+    BlockMetaData md2(md.data());
+    QVERIFY(md2.hasScriptHashFilter());
+    GolombCodedSet filter = md2.scriptHashFilter();
+    QVERIFY(filter.isValid());
+    QVERIFY(filter.itemCount() > 94);
+
+    // every output and every spent output should be found.
+    Tx::Iterator iter(block);
+    uint256 prevTxId, spentOutput;
+    bool coinbase = true, oneEnd = false;
+    int found = 0;
+    auto type = iter.next();
+    while (true) {
+        if (type == Tx::End) {
+            if (oneEnd) // end of block
+                break;
+            oneEnd = true;
+            coinbase = false;
+        } else {
+            oneEnd = false;
+        }
+        if (type == Tx::OutputScript) {
+            QVERIFY(filter.contains(iter.hashedByteData()));
+            ++found;
+        }
+        else if (type == Tx::PrevTxHash) {
+            prevTxId = iter.uint256Data();
+        }
+        else if (type == Tx::PrevTxIndex && !coinbase) {
+            spentOutput = GolombCodedSet::hashOutPoint(prevTxId, iter.intData());
+            QVERIFY(filter.contains(spentOutput));
+            ++found;
+        }
+        type = iter.next();
+    }
+    QVERIFY(found >= filter.itemCount());
+
+    std::set<uint256> unknown;
+    for (int i = 0; i < 100; ++i) {
+        unknown.insert(uint256S(QString("0xdead%1").arg(i).toStdString()));
+    }
+    QCOMPARE(filter.containsAny(unknown), false);
+    unknown.insert(spentOutput);
+    QCOMPARE(filter.containsAny(unknown), true);
+}
+
+void TestMetaBlock::testOutputData()
+{
+    QFile input(":/blockdata");
+    Streaming::BufferPool pool;
+    bool ok = input.open(QIODevice::ReadOnly);
+    QVERIFY(ok);
+    auto size = input.read(pool.begin(), pool.capacity());
+    FastBlock block(pool.commit(size));
+
+    std::vector<std::unique_ptr<std::deque<std::int32_t> > > feesVector;
+    BlockMetaData noOutputs = BlockMetaData::parseBlock(13451, block, feesVector, pool);
+    QCOMPARE(noOutputs.hasOutputData(), false);
+    QCOMPARE(noOutputs.outputCount(1), 0);
+    QVERIFY(noOutputs.outputs(1) == nullptr);
+
+    BlockMetaData md = BlockMetaData::parseBlock(13451, block, feesVector, pool, true);
+    BlockMetaData md2(md.data());
+    QVERIFY(md2.hasOutputData());
+    QCOMPARE(md2.txCount(), 94);
+
+    Tx::Iterator iter(block);
+    int txIndex = 0, outIndex = 0, outputs = 0;
+    uint64_t amount = 0;
+    bool oneEnd = false;
+    auto type = iter.next();
+    while (true) {
+        if (type == Tx::End) {
+            if (oneEnd) // end of block
+                break;
+            oneEnd = true;
+            QCOMPARE(md2.outputCount(txIndex), outIndex);
+            ++txIndex;
+            outIndex = 0;
+        } else {
+            oneEnd = false;
+        }
+        if (type == Tx::OutputValue) {
+            amount = iter.longData();
+        }
+        else if (type == Tx::OutputScript) {
+            const BlockMetaData::OutputData &out = md2.outputs(txIndex)[outIndex++];
+            QVERIFY(uint256(out.scriptHash) == iter.hashedByteData());
+            QCOMPARE(out.amount, amount);
+            ++outputs;
+        }
+        type = iter.next();
+    }
+    QCOMPARE(txIndex, 94);
+    QCOMPARE(outputs, 188);
+    QCOMPARE(md2.outputCount(94), 0);
+}
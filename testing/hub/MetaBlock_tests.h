@@ -28,6 +28,8 @@ public:
 
 private slots:
     void testCreation();
+    void testScriptHashFilter();
+    void testOutputData();
 };
 
 #endif
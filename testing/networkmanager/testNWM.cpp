@@ -21,6 +21,8 @@
 #include <networkmanager/NetworkManager_p.h>
 #include <WorkerThreads.h>
 #include <Message.h>
+#include <crypto/common.h>
+#include <streaming/P2PParser.h>
 
 TestNWM::TestNWM()
 {
@@ -293,4 +295,64 @@ void TestNWM::testChunkReadQueue()
     QTRY_COMPARE(parser.ok, true);
 }
 
+void TestNWM::benchLegacyDispatch()
+{
+    std::map<int, std::string> table;
+    table.insert(std::make_pair(1, "version"));
+    table.insert(std::make_pair(2, "verack"));
+    table.insert(std::make_pair(3, "addr"));
+    table.insert(std::make_pair(4, "inv"));
+    table.insert(std::make_pair(5, "getdata"));
+    table.insert(std::make_pair(6, "getheaders"));
+    table.insert(std::make_pair(7, "headers"));
+    table.insert(std::make_pair(8, "block"));
+    table.insert(std::make_pair(9, "merkleblock"));
+    table.insert(std::make_pair(10, "ping"));
+    table.insert(std::make_pair(11, "pong"));
+    table.insert(std::make_pair(12, "tx"));
+    LegacyCommandTable commands;
+    commands.set(table);
+
+    const char unknown[12] = { 'i', 'n', 'v', 'x', 0 };
+    QCOMPARE(commands.lookup(unknown), -1);
+    const char merkleBlock[12] = { 'm', 'e', 'r', 'k', 'l', 'e', 'b', 'l', 'o', 'c', 'k', 0 };
+    QCOMPARE(commands.lookup(merkleBlock), 9);
+
+    // a buffer filled with inv messages, each with one item, the way they arrive during an inv storm.
+    const int MessageCount = 10000;
+    const int BodySize = 1 + 36;
+    Streaming::BufferPool pool(MessageCount * (24 + BodySize));
+    for (int i = 0; i < MessageCount; ++i) {
+        char *header = pool.data();
+        memset(header, 0, 24);
+        memcpy(header + 4, "inv", 3);
+        WriteLE32(reinterpret_cast<uint8_t*>(header + 16), BodySize);
+        header[24] = 1; // count
+        WriteLE32(reinterpret_cast<uint8_t*>(header + 25), 1); // type
+        memset(header + 29, i & 0xFF, 32); // hash
+        pool.markUsed(24 + BodySize);
+    }
+    const Streaming::ConstBuffer buffer = pool.commit();
+
+    // The benchmark time divided by MessageCount is the per-message cost of the legacy receive path.
+    int dispatched = 0;
+    QBENCHMARK {
+        dispatched = 0;
+        const char *data = buffer.begin();
+        while (data < buffer.end()) {
+            const int bodyLength = ReadLE32(reinterpret_cast<const uint8_t*>(data + 16));
+            const int messageId = commands.lookup(data + 4);
+            Message message(buffer.internal_buffer(), data, data + 24, data + 24 + bodyLength);
+            message.setMessageId(messageId);
+            Streaming::P2PParser parser(message);
+            const size_t count = parser.readCompactInt();
+            const char *item = parser.readRawBytes(static_cast<int32_t>(count) * 36);
+            if (ReadLE32(reinterpret_cast<const uint8_t*>(item)) == 1)
+                ++dispatched;
+            data += 24 + bodyLength;
+        }
+    }
+    QCOMPARE(dispatched, MessageCount);
+}
+
 QTEST_MAIN(TestNWM)
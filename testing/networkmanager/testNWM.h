@@ -35,6 +35,8 @@ private slots:
     void testHeaderInt();
 
     void testChunkReadQueue();
+
+    void benchLegacyDispatch();
 };
 
 #endif
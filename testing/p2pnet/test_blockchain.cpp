@@ -24,6 +24,8 @@
 #include <streaming/P2PBuilder.h>
 #include <utiltime.h>
 
+#include <thread>
+
 constexpr const char *genesisHash = "0x000000000019d6689c085ae165831e934ff763ae46a2a6c172b3f1b60a8ce26f";
 
 void TestP2PBlockchain::init()
@@ -151,6 +153,73 @@ void TestP2PBlockchain::blockHeightAtTime()
     }
 }
 
+void TestP2PBlockchain::headersParallel()
+{
+    boost::asio::io_service ioService;
+    boost::filesystem::path basedir(m_tmpPath.toStdString());
+    DownloadManager dlm(ioService, basedir, P2PNet::MainChain);
+    Blockchain &blockchain = dlm.blockchain();
+    const QByteArray headers = readHeaders();
+
+    // let worker threads take part in checking the headers.
+    std::unique_ptr<boost::asio::io_service::work> work(new boost::asio::io_service::work(ioService));
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 3; ++i) {
+        threads.emplace_back([&ioService]() { ioService.run(); });
+    }
+    // a broken proof of work in the last, or the first, batch rejects the whole message.
+    for (int index : { 110, 104, 0 }) {
+        QByteArray bad(headers);
+        bad[index * 80 + 76] = bad[index * 80 + 76] ^ 1; // the nonce
+        blockchain.processBlockHeaders(createHeadersMessage(bad), 1);
+        QCOMPARE(blockchain.height(), 0);
+    }
+    work.reset();
+    ioService.stop();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    ioService.restart();
+
+    // the good ones are accepted, on the strand like the ConnectionManager does it.
+    dlm.strand().post(std::bind(&Blockchain::processBlockHeaders, &blockchain, createHeadersMessage(headers), 1));
+    ioService.poll();
+    QCOMPARE(blockchain.height(), 111);
+    QCOMPARE(blockchain.block(111).createHash(), uint256S("000000004d6a6dd8b882deec7b54421949dddd2c166bd51ee7f62a52091a6c35"));
+}
+
+void TestP2PBlockchain::loadDamaged()
+{
+    boost::asio::io_service ioService;
+    boost::filesystem::path basedir(m_tmpPath.toStdString());
+    DownloadManager dlm(ioService, basedir, P2PNet::MainChain);
+
+    QFile genesisFile(QString("%1/headers0-99").arg(SRCDIR));
+    QVERIFY(genesisFile.open(QIODevice::ReadOnly));
+    QByteArray file = genesisFile.read(80) + readHeaders();
+    const QString dest(m_tmpPath + "/blockchain");
+    auto writeFile = [&dest](const QByteArray &data) {
+        QFile out(dest);
+        if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate))
+            return false;
+        return out.write(data) == data.size();
+    };
+    QVERIFY(writeFile(file));
+    {
+        Blockchain blockchain(&dlm, basedir, P2PNet::MainChain);
+        QCOMPARE(blockchain.height(), 111);
+        QCOMPARE(blockchain.blockHeightFor(uint256S("000000004d6a6dd8b882deec7b54421949dddd2c166bd51ee7f62a52091a6c35")), 111);
+    }
+
+    // the hash of block 110 is taken from block 111, which no longer matches.
+    file[110 * 80 + 76] = file[110 * 80 + 76] ^ 1;
+    QVERIFY(writeFile(file));
+    {
+        Blockchain blockchain(&dlm, basedir, P2PNet::MainChain);
+        QCOMPARE(blockchain.height(), 0);
+    }
+}
+
 QByteArray TestP2PBlockchain::prepareStaticFile()
 {
     // we copy our static data from a file, more flexible.
@@ -162,4 +231,28 @@ QByteArray TestP2PBlockchain::prepareStaticFile()
     return data;
 }
 
+QByteArray TestP2PBlockchain::readHeaders()
+{
+    QFile first(QString("%1/headers0-99").arg(SRCDIR));
+    QFile second(QString("%1/headers100-111").arg(SRCDIR));
+    bool ok = first.open(QIODevice::ReadOnly);
+    ok = ok && second.open(QIODevice::ReadOnly);
+    assert(ok);
+    first.seek(80); // skip genesis
+    return first.readAll() + second.readAll();
+}
+
+Message TestP2PBlockchain::createHeadersMessage(const QByteArray &headers)
+{
+    const int count = headers.size() / 80;
+    Streaming::BufferPool pool(count * 81 + 10);
+    Streaming::P2PBuilder builder(pool);
+    builder.writeCompactSize(count);
+    for (int i = 0; i < count; ++i) {
+        builder.writeByteArray(headers.constData() + i * 80, 80, Streaming::RawBytes);
+        builder.writeCompactSize(0); // transaction count
+    }
+    return builder.message(Api::P2P::Headers);
+}
+
 QTEST_MAIN(TestP2PBlockchain)
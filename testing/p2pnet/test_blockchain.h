@@ -19,6 +19,7 @@
 #define TEST_BLOCKCHAIN_H
 
 #include <common/TestFloweeBase.h>
+#include <Message.h>
 
 class TestP2PBlockchain : public TestFloweeBase
 {
@@ -31,9 +32,13 @@ private slots:
     void staticChain();
 
     void blockHeightAtTime();
+    void headersParallel();
+    void loadDamaged();
 
 private:
     QByteArray prepareStaticFile();
+    QByteArray readHeaders(); // headers 1 till 111
+    Message createHeadersMessage(const QByteArray &headers);
 
     QString m_tmpPath;
 };
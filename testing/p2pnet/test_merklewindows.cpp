@@ -0,0 +1,181 @@
+/*
+ * This file is part of the Flowee project
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_merklewindows.h"
+
+#include <p2p/MerkleWindows.h>
+
+#include <vector>
+
+namespace {
+// the peer sends the merkle block at \a blockHeight, without transactions.
+void receiveBlock(MerkleWindows &windows, int blockHeight)
+{
+    if (windows.startBlock(blockHeight)) {
+        MerkleWindows::Block block;
+        block.blockHeight = blockHeight;
+        windows.addBlock(std::move(block));
+    }
+}
+
+std::vector<int> heights(const MerkleWindows::Window &window)
+{
+    std::vector<int> answer;
+    for (const auto &block : window.blocks) {
+        answer.push_back(block.blockHeight);
+    }
+    return answer;
+}
+}
+
+void TestMerkleWindows::inOrder()
+{
+    MerkleWindows windows;
+    QCOMPARE(windows.startBlock(10), false); // nothing requested
+    const uint32_t id1 = windows.add(10, 12);
+    const uint32_t id2 = windows.add(13, 15);
+    QVERIFY(id1 != id2);
+    QCOMPARE(windows.pending(), 2);
+
+    for (int i = 10; i <= 12; ++i) {
+        receiveBlock(windows, i);
+    }
+    QVERIFY(windows.takeCompleted().empty()); // not complete until the pong
+    QVERIFY(windows.pongReceived(id1));
+    QCOMPARE(windows.pending(), 1);
+    for (int i = 13; i <= 15; ++i) {
+        receiveBlock(windows, i);
+    }
+    QVERIFY(windows.pongReceived(id2));
+    QVERIFY(!windows.pongReceived(id2));
+    QCOMPARE(windows.pending(), 0);
+
+    auto completed = windows.takeCompleted();
+    QCOMPARE(completed.size(), (size_t) 2);
+    QCOMPARE(completed.at(0).id, id1);
+    compare(heights(completed.at(0)), std::vector<int>({10, 11, 12}));
+    QVERIFY(!completed.at(0).firstBlockTime.is_not_a_date_time());
+    QVERIFY(!completed.at(0).completeTime.is_not_a_date_time());
+    QCOMPARE(completed.at(1).id, id2);
+    compare(heights(completed.at(1)), std::vector<int>({13, 14, 15}));
+    QVERIFY(windows.takeCompleted().empty());
+}
+
+void TestMerkleWindows::skippedBlocks()
+{
+    MerkleWindows windows;
+    const uint32_t id1 = windows.add(10, 12);
+    const uint32_t id2 = windows.add(13, 15);
+    receiveBlock(windows, 10);
+    receiveBlock(windows, 12); // the peer did not send 11
+    QVERIFY(windows.pongReceived(id1));
+    // and the next window does not take blocks it didn't ask for.
+    receiveBlock(windows, 12);
+    receiveBlock(windows, 13);
+    receiveBlock(windows, 20);
+    QVERIFY(windows.pongReceived(id2));
+
+    auto completed = windows.takeCompleted();
+    QCOMPARE(completed.size(), (size_t) 2);
+    compare(heights(completed.at(0)), std::vector<int>({10, 12}));
+    compare(heights(completed.at(1)), std::vector<int>({13}));
+}
+
+void TestMerkleWindows::cancelledWindow()
+{
+    MerkleWindows windows;
+    const uint32_t id1 = windows.add(10, 12);
+    const uint32_t id2 = windows.add(13, 15);
+    // the filter changed, the same ranges are requested again.
+    windows.cancel(id1);
+    windows.cancel(id2);
+    QCOMPARE(windows.pending(), 0);
+    const uint32_t id3 = windows.add(10, 12);
+    const uint32_t id4 = windows.add(13, 15);
+    QCOMPARE(windows.pending(), 2);
+
+    // the answers to the first requests are incomplete, and ignored.
+    receiveBlock(windows, 10);
+    QVERIFY(windows.pongReceived(id1));
+    receiveBlock(windows, 13);
+    receiveBlock(windows, 14);
+    QVERIFY(windows.pongReceived(id2));
+    QVERIFY(windows.takeCompleted().empty());
+
+    // the blocks sent for the new requests end up in those.
+    for (int i = 10; i <= 15; ++i) {
+        receiveBlock(windows, i);
+        if (i == 12)
+            QVERIFY(windows.pongReceived(id3));
+    }
+    QVERIFY(windows.pongReceived(id4));
+    auto completed = windows.takeCompleted();
+    QCOMPARE(completed.size(), (size_t) 2);
+    QCOMPARE(completed.at(0).id, id3);
+    compare(heights(completed.at(0)), std::vector<int>({10, 11, 12}));
+    QCOMPARE(completed.at(1).id, id4);
+    compare(heights(completed.at(1)), std::vector<int>({13, 14, 15}));
+
+    // cancelling a completed window removes it.
+    const uint32_t id5 = windows.add(16, 16);
+    receiveBlock(windows, 16);
+    QVERIFY(windows.pongReceived(id5));
+    windows.cancel(id5);
+    QVERIFY(windows.takeCompleted().empty());
+}
+
+void TestMerkleWindows::cancelAll()
+{
+    MerkleWindows windows;
+    const uint32_t id1 = windows.add(10, 12);
+    const uint32_t id2 = windows.add(13, 15);
+    receiveBlock(windows, 10);
+    receiveBlock(windows, 11);
+    receiveBlock(windows, 12);
+    QVERIFY(windows.pongReceived(id1));
+    windows.cancelAll();
+    QCOMPARE(windows.pending(), 0);
+    QVERIFY(windows.takeCompleted().empty());
+    receiveBlock(windows, 13);
+    QVERIFY(windows.pongReceived(id2));
+    QVERIFY(windows.takeCompleted().empty());
+    QCOMPARE(windows.startBlock(16), false);
+}
+
+void TestMerkleWindows::lostPong()
+{
+    MerkleWindows windows;
+    const uint32_t id1 = windows.add(10, 11);
+    const uint32_t id2 = windows.add(12, 13);
+    receiveBlock(windows, 10);
+    receiveBlock(windows, 11);
+    receiveBlock(windows, 12);
+    receiveBlock(windows, 13);
+    QVERIFY(!windows.pongReceived(12345));
+    // the answers come in order, the later pong completes the earlier window too.
+    QVERIFY(windows.pongReceived(id2));
+    auto completed = windows.takeCompleted();
+    QCOMPARE(completed.size(), (size_t) 2);
+    QCOMPARE(completed.at(0).id, id1);
+    compare(heights(completed.at(0)), std::vector<int>({10, 11}));
+    // without the pong we can't tell which window the blocks were for, the caller requests it again.
+    QCOMPARE(completed.at(1).id, id2);
+    QVERIFY(completed.at(1).blocks.empty());
+}
+
+QTEST_MAIN(TestMerkleWindows)
@@ -32,6 +32,7 @@
 
 #include "test/test_bitcoin.h"
 
+#include <algorithm>
 #include <stdint.h>
 
 #include <boost/date_time/posix_time/posix_time_types.hpp>
@@ -48,11 +49,11 @@ CService ip(uint32_t i)
 class OrphanCacheMock : public CTxOrphanCache
 {
 public:
-    std::map<uint256, COrphanTx> mapOrphanTransactions() {
-        return m_mapOrphanTransactions;
+    const OrphanMap &mapOrphanTransactions() {
+        return m_orphans;
     }
-    std::map<uint256, std::set<uint256> > mapOrphanTransactionsByPrev() {
-        return m_mapOrphanTransactionsByPrev;
+    const ByPrevMap &mapOrphanTransactionsByPrev() {
+        return m_orphansByPrev;
     }
 
    void LimitOrphanTxSizePublic(unsigned int max) {
@@ -61,10 +62,12 @@ public:
 
     CTransaction RandomOrphan()
     {
-        auto it = m_mapOrphanTransactions.lower_bound(GetRandHash());
-        if (it == m_mapOrphanTransactions.end())
-            it = m_mapOrphanTransactions.begin();
-        return it->second.tx;
+        auto ids = fetchTransactionIds();
+        std::sort(ids.begin(), ids.end());
+        auto it = std::lower_bound(ids.begin(), ids.end(), GetRandHash());
+        if (it == ids.end())
+            it = ids.begin();
+        return m_orphans.at(*it).orphan.tx.createOldTransaction();
     }
 };
 
@@ -265,4 +268,60 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
     }
 }
 
+BOOST_AUTO_TEST_CASE(DoS_orphanLimits)
+{
+    OrphanCacheMock cache;
+    const int64_t nStartTime = GetTime();
+    std::vector<CTransaction> parents;
+    for (int i = 0; i < 10; i++) {
+        SetMockTime(nStartTime + i); // makes the first one the oldest
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout.n = 0;
+        tx.vin[0].prevout.hash = GetRandHash();
+        tx.vin[0].scriptSig << OP_1;
+        tx.vout.resize(1);
+        tx.vout[0].nValue = 1*CENT;
+        tx.vout[0].scriptPubKey = CScript() << OP_1;
+        BOOST_CHECK(cache.addOrphanTx(tx, i));
+        parents.push_back(tx);
+    }
+    SetMockTime(0);
+    BOOST_CHECK(!cache.addOrphanTx(parents.front(), 1)); // duplicate
+    BOOST_CHECK_EQUAL(cache.size(), 10);
+    const uint64_t txSize = cache.byteSize() / 10;
+    BOOST_CHECK(txSize > 0);
+
+    // two children spending both outputs of one orphan, one spends two inputs from it.
+    CMutableTransaction child;
+    child.vin.resize(2);
+    child.vin[0].prevout.hash = parents.back().GetHash();
+    child.vin[0].prevout.n = 0;
+    child.vin[1].prevout.hash = parents.back().GetHash();
+    child.vin[1].prevout.n = 1;
+    child.vout.resize(1);
+    child.vout[0].nValue = 1*CENT;
+    BOOST_CHECK(cache.addOrphanTx(child, 1));
+    child.vin.resize(1);
+    BOOST_CHECK(cache.addOrphanTx(child, 1));
+    BOOST_CHECK_EQUAL(cache.size(), 12);
+
+    auto taken = cache.takeTransactionsByPrev(parents.back().GetHash());
+    BOOST_CHECK_EQUAL(taken.size(), 2);
+    BOOST_CHECK_EQUAL(cache.size(), 10);
+    BOOST_CHECK_EQUAL(cache.byteSize(), txSize * 10);
+    BOOST_CHECK(cache.takeTransactionsByPrev(parents.back().GetHash()).empty());
+
+    // the byte-limit evicts the oldest first.
+    cache.setByteLimit(txSize * 4);
+    BOOST_CHECK_EQUAL(cache.limitOrphanTxSize(), 6);
+    BOOST_CHECK_EQUAL(cache.size(), 4);
+    for (size_t i = 0; i < parents.size(); ++i) {
+        BOOST_CHECK_EQUAL(cache.mapOrphanTransactions().count(parents.at(i).GetHash()), i >= 6 ? 1 : 0);
+    }
+    cache.eraseOrphans(std::vector<uint256>(1, parents.back().GetHash()));
+    BOOST_CHECK_EQUAL(cache.size(), 3);
+    BOOST_CHECK_EQUAL(cache.byteSize(), txSize * 3);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
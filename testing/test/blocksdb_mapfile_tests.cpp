@@ -28,7 +28,9 @@
 #include <primitives/FastBlock.h>
 #include <primitives/FastUndoBlock.h>
 
+#include <boost/filesystem.hpp>
 #include <boost/test/unit_test.hpp>
+#include <fstream>
 
 
 BOOST_FIXTURE_TEST_SUITE(blocksdb_mapfile_tests, TestingSetup)
@@ -91,4 +93,88 @@ BOOST_AUTO_TEST_CASE(mapFile_write)
     }
 }
 
+BOOST_AUTO_TEST_CASE(mapFile_accessPattern)
+{
+    BOOST_CHECK_EQUAL(vinfoBlockFile.size(), 1);
+    vinfoBlockFile[0].nSize = MAX_BLOCKFILE_SIZE - 107;
+
+    Blocks::DB *db = Blocks::DB::instance();
+    Streaming::BufferPool pool;
+    std::vector<CDiskBlockPos> positions;
+    for (int b = 0; b < 6; ++b) {
+        pool.reserve(10000);
+        for (int i = 0; i < 10000; ++i) {
+            pool.begin()[i] = static_cast<char>(i + b);
+        }
+        CDiskBlockPos pos;
+        db->writeBlock(FastBlock(pool.commit(10000)), pos);
+        BOOST_CHECK_EQUAL(pos.nFile, 1);
+        positions.push_back(pos);
+    }
+
+    std::vector<FastBlock> blocks;
+    for (auto pattern : { Blocks::NormalAccess, Blocks::SequentialAccess }) {
+        for (size_t b = 0; b < positions.size(); ++b) {
+            FastBlock block = db->loadBlock(positions.at(b), pattern);
+            BOOST_CHECK_EQUAL(block.size(), 10000);
+            BOOST_CHECK_EQUAL(block.data().begin()[0], static_cast<char>(b));
+            BOOST_CHECK_EQUAL(block.data().begin()[9999], static_cast<char>(9999 + b));
+            blocks.push_back(block);
+        }
+    }
+    Streaming::ConstBuffer file = db->loadBlockFile(1, Blocks::SequentialAccess);
+    BOOST_CHECK(file.size() > 60000);
+
+#ifdef __linux__
+    // the advice should not have split the mapping of the block file.
+    std::ifstream maps("/proc/self/maps");
+    int mappings = 0;
+    std::string line;
+    while (std::getline(maps, line)) {
+        if (line.find("blk00001.dat") != std::string::npos)
+            ++mappings;
+    }
+    BOOST_CHECK_EQUAL(mappings, 1);
+
+    // the file used for the advice is opened once, not per read.
+    auto countOpenFiles = []() {
+        int count = 0;
+        boost::filesystem::directory_iterator end;
+        for (boost::filesystem::directory_iterator iter("/proc/self/fd"); iter != end; ++iter) {
+            boost::system::error_code error;
+            const auto target = boost::filesystem::read_symlink(iter->path(), error);
+            if (!error && target.filename() == "blk00001.dat")
+                ++count;
+        }
+        return count;
+    };
+    const int openFiles = countOpenFiles();
+    BOOST_CHECK(openFiles > 0);
+    for (size_t b = 0; b < positions.size(); ++b) {
+        blocks.push_back(db->loadBlock(positions.at(b), Blocks::SequentialAccess));
+    }
+    BOOST_CHECK_EQUAL(countOpenFiles(), openFiles);
+#endif
+
+    // releasing the pages doesn't lose data, a next read faults them in again.
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        db->releaseBlock(positions.at(i % positions.size()), blocks.at(i));
+    }
+    for (size_t b = 0; b < positions.size(); ++b) {
+        BOOST_CHECK_EQUAL(blocks.at(b).data().begin()[0], static_cast<char>(b));
+        BOOST_CHECK_EQUAL(blocks.at(b).data().begin()[5000], static_cast<char>(5000 + b));
+    }
+
+    const auto before = db->pageFaultStats(Blocks::NormalAccess);
+    {
+        Blocks::PageFaultCounter counter(Blocks::NormalAccess);
+        FastBlock block = db->loadBlock(positions.front(), Blocks::NormalAccess);
+        BOOST_CHECK_EQUAL(block.size(), 10000);
+    }
+    const auto after = db->pageFaultStats(Blocks::NormalAccess);
+    BOOST_CHECK_EQUAL(after.operations, before.operations + 1);
+    BOOST_CHECK(after.majorFaults >= before.majorFaults);
+    BOOST_CHECK_EQUAL(db->pageFaultStats(Blocks::SequentialAccess).operations, 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
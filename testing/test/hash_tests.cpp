@@ -57,4 +57,27 @@ BOOST_AUTO_TEST_CASE(murmurhash3)
 #undef T
 }
 
+BOOST_AUTO_TEST_CASE(murmurhash3_multi)
+{
+    std::vector<unsigned char> data;
+    for (int size = 0; size < 70; ++size) {
+        const MurmurHash3Multi hasher(data.data(), data.size());
+        for (uint32_t seed = 0x1234; seed < 0x1240; seed += MurmurHash3Multi::Lanes) {
+            uint32_t hashes[MurmurHash3Multi::Lanes];
+            hasher.hash(seed * 0xFBA4C795, 0xFBA4C795, hashes);
+            for (uint32_t i = 0; i < MurmurHash3Multi::Lanes; ++i) {
+                BOOST_CHECK_EQUAL(hashes[i], MurmurHash3((seed + i) * 0xFBA4C795, data));
+            }
+        }
+        data.push_back(static_cast<unsigned char>(size * 37 + 11));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(siphash)
+{
+    // test vector from the BIP152 reference implementation.
+    const uint256 x = uint256S("1f1e1d1c1b1a191817161514131211100f0e0d0c0b0a09080706050403020100");
+    BOOST_CHECK_EQUAL(SipHashUint256(0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL, x), 0x7127512f72f27cceULL);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
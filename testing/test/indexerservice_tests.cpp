@@ -0,0 +1,114 @@
+/*
+ * This file is part of the Flowee project
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test/test_bitcoin.h"
+
+#include <IndexerService.h>
+#include <TransactionBuilder.h>
+#include <WorkerThreads.h>
+#include <chain.h>
+#include <utiltime.h>
+
+#include <boost/test/unit_test.hpp>
+
+namespace {
+Tx spend(const Tx &prevTx, int64_t amount, const CKey &key, const CScript &scriptPubKey)
+{
+    TransactionBuilder builder;
+    builder.appendInput(prevTx.createHash(), 0);
+    builder.pushInputSignature(key, scriptPubKey, amount, TransactionBuilder::Schnorr);
+    builder.appendOutput(amount - 10000);
+    builder.pushOutputScript(scriptPubKey);
+    return builder.createTransaction();
+}
+
+// wait until the indexer reached \a height, or a couple of seconds passed.
+bool waitForHeight(const IndexerService &indexer, int height)
+{
+    for (int i = 0; i < 500; ++i) {
+        if (indexer.blockheight() == height)
+            return true;
+        MilliSleep(10);
+    }
+    return indexer.blockheight() == height;
+}
+}
+
+BOOST_FIXTURE_TEST_SUITE(indexerservice_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(indexerservice_index)
+{
+    CKey coinbaseKey;
+    std::vector<FastBlock> blocks = bv.appendChain(110, coinbaseKey, MockBlockValidation::FullOutScript);
+    const CScript scriptPubKey = CScript() << OP_DUP << OP_HASH160 << ToByteVector(coinbaseKey.GetPubKey().getKeyId())
+                                           << OP_EQUALVERIFY << OP_CHECKSIG;
+    FastBlock first = blocks.front();
+    first.findTransactions();
+    const Tx coinbase = first.transactions().front();
+    const Tx tx1 = spend(coinbase, 50 * COIN, coinbaseKey, scriptPubKey);
+
+    WorkerThreads threads;
+    const boost::filesystem::path basedir = pathTemp / "indexer";
+    {
+        // catch up from the block files.
+        IndexerService indexer(threads.ioService(), basedir, true, true);
+        BOOST_CHECK(waitForHeight(indexer, 110));
+        auto item = indexer.findTransaction(coinbase.createHash());
+        BOOST_CHECK(item.isValid());
+        BOOST_CHECK_EQUAL(item.blockHeight(), 1);
+        BOOST_CHECK_EQUAL(item.offsetInBlock(), 81);
+        BOOST_CHECK(!indexer.findSpentOutput(coinbase.createHash(), 0).isValid());
+
+        // and follow validation.
+        std::vector<CTransaction> transactions;
+        transactions.push_back(tx1.createOldTransaction());
+        FastBlock block = bv.createBlock(bv.blockchain()->Tip(), scriptPubKey, transactions);
+        auto future = bv.addBlock(block, Validation::SaveGoodToDisk).start();
+        future.waitUntilFinished();
+        BOOST_CHECK_EQUAL(future.error(), std::string());
+        BOOST_CHECK(waitForHeight(indexer, 111));
+
+        item = indexer.findTransaction(tx1.createHash());
+        BOOST_CHECK(item.isValid());
+        BOOST_CHECK_EQUAL(item.blockHeight(), 111);
+        const int tx1Offset = item.offsetInBlock();
+        BOOST_CHECK(tx1Offset > 81);
+        item = indexer.findSpentOutput(coinbase.createHash(), 0);
+        BOOST_CHECK(item.isValid());
+        BOOST_CHECK_EQUAL(item.blockHeight(), 111);
+        BOOST_CHECK_EQUAL(item.offsetInBlock(), tx1Offset);
+
+        // a reorg reverts the block.
+        bv.invalidateBlock(bv.blockchain()->Tip());
+        BOOST_CHECK_EQUAL(bv.blockchain()->Height(), 110);
+        BOOST_CHECK(waitForHeight(indexer, 110));
+        BOOST_CHECK(indexer.findTransaction(coinbase.createHash()).isValid());
+        BOOST_CHECK(!indexer.findTransaction(tx1.createHash()).isValid());
+        BOOST_CHECK(!indexer.findSpentOutput(coinbase.createHash(), 0).isValid());
+    }
+
+    // a restart continues from what was saved and ends up on the current chain.
+    bv.appendChain(2, coinbaseKey, MockBlockValidation::FullOutScript);
+    IndexerService indexer(threads.ioService(), basedir, true, false);
+    BOOST_CHECK(waitForHeight(indexer, 112));
+    BOOST_CHECK(indexer.findTransaction(coinbase.createHash()).isValid());
+    BOOST_CHECK(!indexer.findTransaction(tx1.createHash()).isValid());
+    BOOST_CHECK(!indexer.findSpentOutput(coinbase.createHash(), 0).isValid()); // not enabled
+}
+
+BOOST_AUTO_TEST_SUITE_END()
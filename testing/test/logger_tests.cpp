@@ -0,0 +1,207 @@
+/*
+ * This file is part of the Flowee project
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test/test_bitcoin.h"
+
+#include <LogChannels_p.h>
+#include <Logger_p.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <thread>
+
+namespace {
+// Remembers the line-numbers of what it got, optionally blocks the writer.
+class TestChannel : public Log::Channel
+{
+public:
+    TestChannel() : Channel(NoTime) {}
+
+    void pushLog(int64_t, std::string*, const std::string &, const char *,
+                 int lineNumber, const char *, short, short logLevel) override {
+        std::unique_lock<std::mutex> lock(mutex);
+        lineNumbers.push_back(lineNumber);
+        levels.push_back(logLevel);
+        entered = true;
+        changed.notify_all();
+        changed.wait(lock, [this] { return !blocked; });
+    }
+
+    bool waitForEntered() {
+        std::unique_lock<std::mutex> lock(mutex);
+        return changed.wait_for(lock, std::chrono::seconds(5), [this] { return entered; });
+    }
+    void unblock() {
+        std::lock_guard<std::mutex> lock(mutex);
+        blocked = false;
+        changed.notify_all();
+    }
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool blocked = false;
+    bool entered = false;
+    std::vector<int> lineNumbers;
+    std::vector<short> levels;
+};
+
+// section 30000 is not enabled in the test setup, so the item itself doesn't log to the global manager.
+void logTo(Log::Manager &manager, int lineNumber)
+{
+    Log::Item item(__FILE__, lineNumber, "logTo", 30000, Log::InfoLevel);
+    manager.log(&item);
+}
+}
+
+BOOST_FIXTURE_TEST_SUITE(logger_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(logring_full)
+{
+    Log::LogRing ring;
+    for (int i = 0; i < Log::LogRing::Capacity; ++i) {
+        Log::LogRecord record;
+        record.lineNumber = i;
+        BOOST_CHECK(ring.push(std::move(record)));
+    }
+    Log::LogRecord record;
+    record.lineNumber = -1;
+    BOOST_CHECK(!ring.push(std::move(record)));
+
+    std::vector<Log::LogRecord> out;
+    ring.drain(out);
+    BOOST_CHECK_EQUAL(out.size(), Log::LogRing::Capacity);
+    for (size_t i = 0; i < out.size(); ++i) {
+        BOOST_CHECK_EQUAL(out.at(i).lineNumber, static_cast<int>(i));
+    }
+    out.clear();
+    ring.drain(out);
+    BOOST_CHECK(out.empty());
+
+    // space again.
+    record.lineNumber = 12;
+    BOOST_CHECK(ring.push(std::move(record)));
+    ring.drain(out);
+    BOOST_CHECK_EQUAL(out.size(), 1);
+    BOOST_CHECK_EQUAL(out.front().lineNumber, 12);
+}
+
+BOOST_AUTO_TEST_CASE(logring_threads)
+{
+    constexpr int Count = 200000;
+    Log::LogRing ring;
+    std::thread producer([&ring]() {
+        for (int i = 0; i < Count; ++i) {
+            Log::LogRecord record;
+            record.lineNumber = i;
+            record.line = std::to_string(i);
+            while (!ring.push(std::move(record))) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    std::vector<Log::LogRecord> out;
+    int expected = 0;
+    bool ok = true;
+    while (expected < Count) {
+        ring.drain(out);
+        for (const auto &record : out) {
+            ok = ok && record.lineNumber == expected && record.line == std::to_string(expected);
+            ++expected;
+        }
+        out.clear();
+    }
+    producer.join();
+    BOOST_CHECK(ok);
+    BOOST_CHECK_EQUAL(expected, Count);
+}
+
+BOOST_AUTO_TEST_CASE(async_drops)
+{
+    Log::Manager manager;
+    manager.clearChannels();
+    TestChannel *channel = new TestChannel();
+    channel->blocked = true;
+    manager.addChannel(channel);
+    manager.setAsync(true);
+
+    // the writer takes the first line and then blocks in the channel.
+    logTo(manager, 0);
+    BOOST_REQUIRE(channel->waitForEntered());
+    // which makes our ring fill up.
+    for (int i = 1; i <= Log::LogRing::Capacity + 5; ++i) {
+        logTo(manager, i);
+    }
+    BOOST_CHECK_EQUAL(manager.droppedLines(), 5);
+
+    channel->unblock();
+    manager.setAsync(false);
+    BOOST_CHECK(!manager.isAsync());
+    // all lines that fit, and the warning about the dropped ones.
+    BOOST_REQUIRE_EQUAL(channel->lineNumbers.size(), Log::LogRing::Capacity + 2);
+    for (int i = 0; i <= Log::LogRing::Capacity; ++i) {
+        BOOST_CHECK_EQUAL(channel->lineNumbers.at(i), i);
+    }
+    BOOST_CHECK_EQUAL(channel->levels.back(), Log::WarningLevel);
+
+    // in sync mode lines are written directly.
+    logTo(manager, 42);
+    BOOST_CHECK_EQUAL(channel->lineNumbers.back(), 42);
+}
+
+BOOST_AUTO_TEST_CASE(async_toggle)
+{
+    constexpr int ThreadCount = 4;
+    constexpr int Lines = 5000;
+    Log::Manager manager;
+    manager.clearChannels();
+    TestChannel *channel = new TestChannel();
+    manager.addChannel(channel);
+
+    // switching the mode while threads log should not lose lines.
+    std::atomic<int> running(ThreadCount);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < ThreadCount; ++t) {
+        threads.emplace_back([&manager, &running]() {
+            for (int i = 0; i < Lines; ++i) {
+                logTo(manager, i);
+            }
+            --running;
+        });
+    }
+    bool on = true;
+    while (running > 0) {
+        manager.setAsync(on);
+        on = !on;
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    manager.setAsync(false);
+
+    size_t lines = 0;
+    for (auto level : channel->levels) {
+        if (level == Log::InfoLevel)
+            ++lines;
+    }
+    BOOST_CHECK_EQUAL(lines + manager.droppedLines(), ThreadCount * Lines);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
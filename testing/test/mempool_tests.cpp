@@ -19,6 +19,7 @@
 #include "txmempool.h"
 #include "util.h"
 #include <hash.h>
+#include <crypto/sha256.h>
 
 #include "test/test_bitcoin.h"
 
@@ -117,6 +118,60 @@ BOOST_AUTO_TEST_CASE(MempoolRemoveTest)
     removed.clear();
 }
 
+BOOST_AUTO_TEST_CASE(MempoolScriptHashIndexTest)
+{
+    TestMemPoolEntryHelper entry;
+    const CScript script1 = CScript() << OP_11 << OP_EQUAL;
+    const CScript script2 = CScript() << OP_12 << OP_EQUAL;
+    uint256 hash1, hash2;
+    CSHA256().Write(&script1[0], script1.size()).Finalize(hash1.begin());
+    CSHA256().Write(&script2[0], script2.size()).Finalize(hash2.begin());
+
+    CMutableTransaction tx1;
+    tx1.vin.resize(1);
+    tx1.vin[0].scriptSig = CScript() << OP_11;
+    tx1.vout.resize(3);
+    tx1.vout[0].scriptPubKey = script1;
+    tx1.vout[0].nValue = 1000;
+    tx1.vout[1].scriptPubKey = script2;
+    tx1.vout[1].nValue = 2000;
+    tx1.vout[2].scriptPubKey = script1;
+    tx1.vout[2].nValue = 3000;
+    CMutableTransaction tx2;
+    tx2.vin.resize(1);
+    tx2.vin[0].scriptSig = CScript() << OP_12;
+    tx2.vout.resize(1);
+    tx2.vout[0].scriptPubKey = script2;
+    tx2.vout[0].nValue = 4000;
+
+    CTxMemPool testPool;
+    testPool.addUnchecked(tx1.GetHash(), entry.FromTx(tx1));
+    testPool.addUnchecked(tx2.GetHash(), entry.FromTx(tx2));
+
+    LOCK(testPool.cs);
+    auto matches = testPool.findByScriptHash(hash1);
+    BOOST_CHECK_EQUAL(matches.size(), 2);
+    for (const auto &match : matches) {
+        BOOST_CHECK(match.entry->GetTx().GetHash() == tx1.GetHash());
+        BOOST_CHECK(match.outIndex == 0 || match.outIndex == 2);
+        BOOST_CHECK_EQUAL(match.amount, match.outIndex == 0 ? 1000 : 3000);
+    }
+    BOOST_CHECK_EQUAL(testPool.findByScriptHash(hash2).size(), 2);
+    BOOST_CHECK_EQUAL(testPool.findByScriptHash(hash1, 1).size(), 1);
+    BOOST_CHECK_EQUAL(testPool.findByScriptHash(hash1, 0).size(), 0);
+
+    std::list<CTransaction> removed;
+    testPool.remove(tx1, removed);
+    BOOST_CHECK_EQUAL(testPool.findByScriptHash(hash1).size(), 0);
+    matches = testPool.findByScriptHash(hash2);
+    BOOST_CHECK_EQUAL(matches.size(), 1);
+    BOOST_CHECK(matches.front().entry->GetTx().GetHash() == tx2.GetHash());
+    BOOST_CHECK_EQUAL(matches.front().amount, 4000);
+
+    testPool._clear();
+    BOOST_CHECK_EQUAL(testPool.findByScriptHash(hash2).size(), 0);
+}
+
 template<int index>
 void CheckSort(CTxMemPool &pool, std::vector<std::string> &sortedOrder)
 {
@@ -0,0 +1,228 @@
+/*
+ * This file is part of the Flowee project
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test/test_bitcoin.h"
+
+#include <chainparams.h>
+#include <hash.h>
+#include <main.h>
+#include <net.h>
+#include <protocol.h>
+#include <streaming/streams.h>
+#include <timedata.h>
+#include <util.h>
+#include <utiltime.h>
+#include <version.h>
+
+#include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <memory>
+#include <thread>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+// Wrap the payload in a message as a peer would send it on the wire.
+std::vector<char> createMessage(const char *command, const CDataStream &payload)
+{
+    CDataStream message(SER_NETWORK, PROTOCOL_VERSION);
+    message << CMessageHeader(Params().magic(), command, payload.size());
+    const uint256 hash = Hash(payload.begin(), payload.end());
+    memcpy(&message[CMessageHeader::CHECKSUM_OFFSET], &hash, CMessageHeader::CHECKSUM_SIZE);
+    message.insert(message.end(), payload.begin(), payload.end());
+    return std::vector<char>(message.begin(), message.end());
+}
+
+std::vector<char> createVersionMessage()
+{
+    CDataStream payload(SER_NETWORK, PROTOCOL_VERSION);
+    payload << PROTOCOL_VERSION << uint64_t(NODE_NETWORK | NODE_BITCOIN_CASH) << GetTime()
+            << CAddress() << CAddress() << uint64_t(1) << std::string("/test:1.0/") << 0 << true;
+    return createMessage(NetMsgType::VERSION, payload);
+}
+
+CService ip(uint32_t i)
+{
+    struct in_addr s;
+    s.s_addr = i;
+    return CService(CNetAddr(s), Params().GetDefaultPort());
+}
+}
+
+BOOST_FIXTURE_TEST_SUITE(messagehandler_tests, TestingSetup)
+
+// The message handler threads process different peers at the same time,
+// the per-peer state they reach should stay consistent.
+BOOST_AUTO_TEST_CASE(parallel_peers)
+{
+    constexpr int NodeCount = 16;
+    constexpr int ThreadCount = 4;
+    std::vector<std::unique_ptr<CNode>> nodes;
+    std::vector<int> remoteSockets;
+    const std::vector<char> version = createVersionMessage();
+    for (int i = 0; i < NodeCount; ++i) {
+        // the replies need to go somewhere, a failing send disconnects the peer.
+        int sockets[2];
+        BOOST_REQUIRE_EQUAL(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), 0);
+        remoteSockets.push_back(sockets[1]);
+        nodes.emplace_back(new CNode(sockets[0], CAddress(ip(0xa0b0c001 + i)), "", true));
+        CNode *node = nodes.back().get();
+        node->fWhitelisted = true; // makes it a preferred download peer.
+        LOCK(node->cs_vRecvMsg);
+        // the second one is a protocol violation and makes the peer misbehave.
+        BOOST_CHECK(node->ReceiveMsgBytes(version.data(), version.size()));
+        BOOST_CHECK(node->ReceiveMsgBytes(version.data(), version.size()));
+    }
+
+    // like the message handler threads, each node is only processed by one thread.
+    std::vector<std::thread> threads;
+    for (int t = 0; t < ThreadCount; ++t) {
+        threads.emplace_back([&nodes, t]() {
+            for (int i = t; i < NodeCount; i += ThreadCount) {
+                CNode *node = nodes.at(i).get();
+                for (int tries = 0; tries < 10; ++tries) {
+                    LOCK(node->cs_vRecvMsg);
+                    if (node->vRecvMsg.empty())
+                        break;
+                    ProcessMessages(node);
+                }
+                SendMessages(node);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    for (const auto &node : nodes) {
+        BOOST_CHECK(!node->fDisconnect);
+        BOOST_CHECK_EQUAL(node->nVersion, PROTOCOL_VERSION);
+        BOOST_CHECK(node->fSuccessfullyConnected);
+        CNodeStateStats stats;
+        BOOST_CHECK(GetNodeStateStats(node->GetId(), stats));
+        BOOST_CHECK_EQUAL(stats.nMisbehavior, 10);
+    }
+    // FinalizeNode checks the preferred-download and in-flight counters add up to
+    // zero when the last node is removed.
+    nodes.clear();
+    for (int socket : remoteSockets) {
+        close(socket);
+    }
+}
+
+// Relaying an ADDR message changes the address state of other nodes, which
+// another message handler thread may be sending at the same time.
+BOOST_AUTO_TEST_CASE(parallel_addr_relay)
+{
+    constexpr int NodeCount = 12;
+    constexpr int ThreadCount = 4;
+    constexpr int AddressCount = 8;
+    std::vector<std::unique_ptr<CNode>> nodes;
+    std::vector<int> remoteSockets;
+    const std::vector<char> version = createVersionMessage();
+    const std::vector<char> verack = createMessage(NetMsgType::VERACK, CDataStream(SER_NETWORK, PROTOCOL_VERSION));
+    for (int i = 0; i < NodeCount; ++i) {
+        int sockets[2];
+        BOOST_REQUIRE_EQUAL(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), 0);
+        remoteSockets.push_back(sockets[1]);
+        nodes.emplace_back(new CNode(sockets[0], CAddress(ip(0xa0b0c101 + i)), "", true));
+        CNode *node = nodes.back().get();
+        LOCK(node->cs_vRecvMsg);
+        BOOST_CHECK(node->ReceiveMsgBytes(version.data(), version.size()));
+        BOOST_CHECK(node->ReceiveMsgBytes(verack.data(), verack.size()));
+        ProcessMessages(node);
+        BOOST_CHECK(node->fSuccessfullyConnected);
+    }
+    {
+        LOCK(cs_vNodes);
+        for (const auto &node : nodes) {
+            vNodes.push_back(node.get());
+        }
+    }
+
+    // each node tells us about a couple of new addresses, one per message so they get relayed.
+    std::vector<CAddress> addresses;
+    for (int i = 0; i < NodeCount; ++i) {
+        CNode *node = nodes.at(i).get();
+        LOCK(node->cs_vRecvMsg);
+        for (int a = 0; a < AddressCount; ++a) {
+            CAddress addr(CService(CNetAddr(strprintf("8.%d.%d.1", i + 1, a + 1)), Params().GetDefaultPort()));
+            addr.nTime = GetAdjustedTime();
+            addresses.push_back(addr);
+            CDataStream payload(SER_NETWORK, PROTOCOL_VERSION);
+            payload << std::vector<CAddress>(1, addr);
+            const std::vector<char> message = createMessage(NetMsgType::ADDR, payload);
+            BOOST_CHECK(node->ReceiveMsgBytes(message.data(), message.size()));
+        }
+    }
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < ThreadCount; ++t) {
+        threads.emplace_back([&nodes, t]() {
+            for (int round = 0; round < AddressCount + 1; ++round) {
+                for (int i = t; i < NodeCount; i += ThreadCount) {
+                    CNode *node = nodes.at(i).get();
+                    {
+                        LOCK(node->cs_vRecvMsg);
+                        ProcessMessages(node);
+                    }
+                    node->nNextAddrSend = 0;
+                    SendMessages(node);
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    // send what was relayed after the last round of each node.
+    for (const auto &node : nodes) {
+        node->nNextAddrSend = 0;
+        SendMessages(node.get());
+    }
+
+    int relayed = 0;
+    for (int i = 0; i < NodeCount; ++i) {
+        CNode *node = nodes.at(i).get();
+        BOOST_CHECK(!node->fDisconnect);
+        LOCK(node->cs_addr);
+        BOOST_CHECK(node->vAddrToSend.empty());
+        for (size_t a = 0; a < addresses.size(); ++a) {
+            const bool known = node->addrKnown.contains(addresses.at(a).GetKey());
+            if (static_cast<int>(a) / AddressCount == i)
+                BOOST_CHECK(known); // the node that told us about it
+            else if (known)
+                ++relayed;
+        }
+    }
+    BOOST_CHECK(relayed > 0);
+
+    {
+        LOCK(cs_vNodes);
+        for (const auto &node : nodes) {
+            vNodes.erase(std::find(vNodes.begin(), vNodes.end(), node.get()));
+        }
+    }
+    nodes.clear();
+    for (int socket : remoteSockets) {
+        close(socket);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,108 @@
+/*
+ * This file is part of the Flowee project
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test/test_bitcoin.h"
+
+#include <chain.h>
+#include <BlocksDB.h>
+#include <TransactionBuilder.h>
+#include <txmempool.h>
+#include <utxo/UnspentOutputDatabase.h>
+#include <validationinterface.h>
+
+#include <boost/test/unit_test.hpp>
+
+namespace {
+class ReorgListener : public ValidationInterface
+{
+public:
+    ReorgListener() {
+        ValidationNotifier().addListener(this);
+    }
+    ~ReorgListener() {
+        ValidationNotifier().removeListener(this);
+    }
+    void chainReorged(CBlockIndex *oldTip, const std::vector<FastBlock> &revertedBlocks, int64_t duration) override {
+        this->oldTip = oldTip;
+        reverted = static_cast<int>(revertedBlocks.size());
+        this->duration = duration;
+    }
+
+    CBlockIndex *oldTip = nullptr;
+    int reverted = 0;
+    int64_t duration = -1;
+};
+
+Tx spend(const Tx &prevTx, int64_t amount, const CKey &key, const CScript &scriptPubKey)
+{
+    TransactionBuilder builder;
+    builder.appendInput(prevTx.createHash(), 0);
+    builder.pushInputSignature(key, scriptPubKey, amount, TransactionBuilder::Schnorr);
+    builder.appendOutput(amount - 10000);
+    builder.pushOutputScript(scriptPubKey);
+    return builder.createTransaction();
+}
+}
+
+BOOST_FIXTURE_TEST_SUITE(reorg_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(reorg_undo)
+{
+    CKey coinbaseKey;
+    std::vector<FastBlock> blocks = bv.appendChain(110, coinbaseKey, MockBlockValidation::FullOutScript);
+    const CScript scriptPubKey = CScript() << OP_DUP << OP_HASH160 << ToByteVector(coinbaseKey.GetPubKey().getKeyId())
+                                           << OP_EQUALVERIFY << OP_CHECKSIG;
+    FastBlock first = blocks.front();
+    first.findTransactions();
+    const Tx coinbase = first.transactions().front();
+
+    // a chain of transactions in a single block.
+    const Tx tx1 = spend(coinbase, 50 * COIN, coinbaseKey, scriptPubKey);
+    const Tx tx2 = spend(tx1, 50 * COIN - 10000, coinbaseKey, scriptPubKey);
+    std::vector<CTransaction> transactions;
+    transactions.push_back(tx1.createOldTransaction());
+    transactions.push_back(tx2.createOldTransaction());
+    FastBlock block = bv.createBlock(bv.blockchain()->Tip(), scriptPubKey, transactions);
+    auto future = bv.addBlock(block, Validation::SaveGoodToDisk).start();
+    future.waitUntilFinished();
+    BOOST_CHECK_EQUAL(future.error(), std::string());
+    BOOST_CHECK_EQUAL(bv.blockchain()->Height(), 111);
+
+    UnspentOutputDatabase *utxo = bv.mempool()->utxo();
+    BOOST_CHECK(!utxo->find(coinbase.createHash(), 0).isValid());
+    BOOST_CHECK(!utxo->find(tx1.createHash(), 0).isValid());
+    BOOST_CHECK(utxo->find(tx2.createHash(), 0).isValid());
+
+    ReorgListener listener;
+    CBlockIndex *tip = bv.blockchain()->Tip();
+    bv.invalidateBlock(tip);
+    BOOST_CHECK_EQUAL(bv.blockchain()->Height(), 110);
+    BOOST_CHECK_EQUAL(listener.oldTip, tip);
+    BOOST_CHECK_EQUAL(listener.reverted, 1);
+    BOOST_CHECK(listener.duration >= 0);
+
+    BOOST_CHECK(utxo->find(coinbase.createHash(), 0).isValid());
+    BOOST_CHECK(!utxo->find(tx1.createHash(), 0).isValid());
+    BOOST_CHECK(!utxo->find(tx2.createHash(), 0).isValid());
+
+    // both transactions are back in the mempool.
+    BOOST_CHECK(bv.mempool()->exists(tx1.createHash()));
+    BOOST_CHECK(bv.mempool()->exists(tx2.createHash()));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -25,6 +25,8 @@
 #include "serialize.h"
 #include "utilstrencodings.h"
 #include "thinblock.h"
+#include "compactblock.h"
+#include <primitives/FastBlock.h>
 #include <boost/test/unit_test.hpp>
 
 
@@ -80,4 +82,47 @@ BOOST_AUTO_TEST_CASE(thinblock_test) {
     BOOST_CHECK(xthinblock3.collision);
 }
 
+BOOST_AUTO_TEST_CASE(compactblock_test) {
+    FastBlock block = FastBlock::fromOldBlock(TestBlock());
+    CompactBlock compactBlock(block);
+    BOOST_CHECK_EQUAL(compactBlock.transactionCount(), 9);
+    BOOST_CHECK_EQUAL(compactBlock.prefilled.size(), 1);
+    BOOST_CHECK(compactBlock.blockHash() == block.createHash());
+
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    compactBlock.write(stream);
+    CompactBlock copy;
+    copy.read(stream);
+    BOOST_CHECK(stream.empty());
+    BOOST_CHECK(copy.shortIds == compactBlock.shortIds);
+    BOOST_CHECK_EQUAL(copy.nonce, compactBlock.nonce);
+    BOOST_CHECK(copy.blockHash() == block.createHash());
+    BOOST_CHECK_EQUAL(copy.prefilled.at(0).index, 0);
+
+    block.findTransactions();
+    const std::vector<Tx> transactions = block.transactions();
+    PartialCompactBlock partial;
+    BOOST_CHECK(partial.init(copy));
+    // offer some, as if they came from the mempool.
+    for (size_t i = 1; i < transactions.size(); i += 2) {
+        partial.offer(transactions.at(i).createHash(), transactions.at(i));
+    }
+    partial.offer(uint256S("3fba505b48865fccda4e248cecc39d5dfbc6b8ef7b4adc9cd27242c1193c7133"), transactions.at(3));
+    BOOST_CHECK(!partial.isComplete());
+    const std::vector<int> missing = partial.missingIndexes();
+    BOOST_CHECK_EQUAL(missing.size(), 4);
+    std::vector<Tx> missingTxs;
+    for (const int index : missing) {
+        BOOST_CHECK_EQUAL(index % 2, 0);
+        missingTxs.push_back(transactions.at(index));
+    }
+    BOOST_CHECK(!partial.fillMissing(std::vector<Tx>()));
+    BOOST_CHECK(partial.fillMissing(missingTxs));
+    BOOST_CHECK(partial.isComplete());
+    FastBlock rebuilt = partial.createBlock();
+    BOOST_CHECK_EQUAL(rebuilt.size(), block.size());
+    BOOST_CHECK(rebuilt.createHash() == block.createHash());
+    BOOST_CHECK(memcmp(rebuilt.data().begin(), block.data().begin(), block.size()) == 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,134 @@
+/*
+ * This file is part of the Flowee project
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test/test_bitcoin.h"
+
+#include <TimerWheel.h>
+#include <WorkerThreads.h>
+#include <utiltime.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+
+namespace {
+// wait until \a condition is true, or a couple of seconds passed.
+template<typename F>
+bool waitFor(F condition)
+{
+    for (int i = 0; i < 400; ++i) {
+        if (condition())
+            return true;
+        MilliSleep(10);
+    }
+    return condition();
+}
+}
+
+BOOST_FIXTURE_TEST_SUITE(timerwheel_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(timerwheel_schedule)
+{
+    WorkerThreads threads;
+    TimerWheel wheel(threads.ioService(), 5);
+
+    std::atomic<int64_t> ranAt(0);
+    const int64_t start = GetTimeMillis();
+    auto handle = wheel.schedule([&ranAt]() { ranAt = GetTimeMillis(); }, 30);
+    BOOST_CHECK(handle.isActive());
+    BOOST_CHECK_EQUAL(wheel.size(), 1);
+    BOOST_CHECK(waitFor([&ranAt]() { return ranAt != 0; }));
+    BOOST_CHECK_GE(ranAt - start, 30);
+    BOOST_CHECK(!handle.isActive());
+    BOOST_CHECK(!handle.cancel());
+    BOOST_CHECK_EQUAL(wheel.size(), 0);
+
+    // further out than the first level of the wheel covers, needs a cascade.
+    std::atomic<int64_t> ranAt2(0);
+    const int64_t start2 = GetTimeMillis();
+    wheel.schedule([&ranAt2]() { ranAt2 = GetTimeMillis(); }, 700);
+    BOOST_CHECK(waitFor([&ranAt2]() { return ranAt2 != 0; }));
+    BOOST_CHECK_GE(ranAt2 - start2, 700);
+}
+
+BOOST_AUTO_TEST_CASE(timerwheel_cancel)
+{
+    WorkerThreads threads;
+    TimerWheel wheel(threads.ioService(), 5);
+
+    std::atomic<int> cancelled(0);
+    std::atomic<int> ran(0);
+    auto handle = wheel.schedule([&cancelled]() { ++cancelled; }, 20);
+    wheel.schedule([&ran]() { ++ran; }, 40);
+    BOOST_CHECK(handle.cancel());
+    BOOST_CHECK(!handle.isActive());
+    BOOST_CHECK(!handle.cancel());
+    BOOST_CHECK(waitFor([&ran]() { return ran == 1; }));
+    BOOST_CHECK_EQUAL(cancelled, 0);
+
+    // a repeating task runs until cancelled.
+    std::atomic<int> repeats(0);
+    auto repeating = wheel.scheduleEvery([&repeats]() { ++repeats; }, 10);
+    BOOST_CHECK(waitFor([&repeats]() { return repeats >= 3; }));
+    BOOST_CHECK(repeating.isActive());
+    BOOST_CHECK(repeating.cancel());
+    MilliSleep(30); // a run that already started is allowed to finish
+    const int count = repeats;
+    MilliSleep(50);
+    BOOST_CHECK_EQUAL(repeats, count);
+
+    // stop cancels everything.
+    std::atomic<int> afterStop(0);
+    auto last = wheel.schedule([&afterStop]() { ++afterStop; }, 10);
+    wheel.stop();
+    BOOST_CHECK(!last.isActive());
+    BOOST_CHECK_EQUAL(wheel.size(), 0);
+    BOOST_CHECK(!wheel.schedule([&afterStop]() { ++afterStop; }, 10).isActive());
+    MilliSleep(50);
+    BOOST_CHECK_EQUAL(afterStop, 0);
+}
+
+BOOST_AUTO_TEST_CASE(timerwheel_stopWaits)
+{
+    WorkerThreads threads;
+    TimerWheel wheel(threads.ioService(), 5);
+
+    // stop() returns only after a running task finished.
+    std::atomic<bool> started(false);
+    std::atomic<bool> finished(false);
+    wheel.schedule([&started, &finished]() {
+        started = true;
+        MilliSleep(100);
+        finished = true;
+    }, 5);
+    BOOST_CHECK(waitFor([&started]() { return started.load(); }));
+    wheel.stop();
+    BOOST_CHECK(finished);
+
+    // a task may stop its own wheel.
+    TimerWheel wheel2(threads.ioService(), 5);
+    std::atomic<bool> stopped(false);
+    wheel2.schedule([&wheel2, &stopped]() {
+        wheel2.stop();
+        stopped = true;
+    }, 5);
+    BOOST_CHECK(waitFor([&stopped]() { return stopped.load(); }));
+    BOOST_CHECK_EQUAL(wheel2.size(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
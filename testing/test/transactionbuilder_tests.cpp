@@ -0,0 +1,101 @@
+/*
+ * This file is part of the Flowee project
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test/test_bitcoin.h"
+
+#include <TransactionBuilder.h>
+#include <primitives/transaction.h>
+#include <random.h>
+#include <script/interpreter.h>
+#include <streaming/BufferPool.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <memory>
+
+namespace {
+struct SpentOutput {
+    CScript script;
+    int64_t amount;
+};
+}
+
+BOOST_FIXTURE_TEST_SUITE(transactionbuilder_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(transactionbuilder_bulk)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    const CScript script = CScript() << OP_DUP << OP_HASH160 << ToByteVector(key.GetPubKey().getKeyId())
+                                     << OP_EQUALVERIFY << OP_CHECKSIG;
+
+    std::vector<std::unique_ptr<TransactionBuilder>> builders;
+    std::vector<std::vector<SpentOutput> > spent;
+    for (int tx = 0; tx < 25; ++tx) {
+        builders.push_back(std::unique_ptr<TransactionBuilder>(new TransactionBuilder()));
+        TransactionBuilder *builder = builders.back().get();
+        spent.push_back(std::vector<SpentOutput>());
+        for (int in = 0; in < 1 + tx * 3 % 17; ++in) {
+            builder->appendInput(GetRandHash(), in % 3);
+            const int64_t amount = 10000 + in * 1000 + tx;
+            // mix the signature types and a couple of sighash types.
+            const auto type = (tx + in) % 2 ? TransactionBuilder::ECDSA : TransactionBuilder::Schnorr;
+            const auto inputs = in % 5 == 3 ? TransactionBuilder::SignOnlyThisInput : TransactionBuilder::SignAllInputs;
+            const auto outputs = in % 7 == 4 ? TransactionBuilder::SignSingleOutput : TransactionBuilder::SignAllOuputs;
+            builder->pushInputSignature(key, script, amount, type, inputs, outputs);
+            spent.back().push_back({script, amount});
+        }
+        for (int out = 0; out < 2; ++out) {
+            builder->appendOutput(5000 + out);
+            builder->pushOutputPay2Address(key.GetPubKey().getKeyId());
+        }
+    }
+
+    std::vector<TransactionBuilder*> list;
+    for (auto &builder : builders) {
+        list.push_back(builder.get());
+    }
+    Streaming::BufferPool pool;
+    const std::vector<Tx> bulk = TransactionBuilder::createTransactions(list, &pool, 4);
+    BOOST_CHECK_EQUAL(bulk.size(), builders.size());
+
+    const uint32_t flags = SCRIPT_VERIFY_STRICTENC | SCRIPT_ENABLE_SIGHASH_FORKID | SCRIPT_ENABLE_SCHNORR;
+    for (size_t i = 0; i < bulk.size(); ++i) {
+        // the same as signing them one by one.
+        const Tx single = builders.at(i)->createTransaction();
+        BOOST_CHECK(single.data() == bulk.at(i).data());
+
+        const CTransaction tx = bulk.at(i).createOldTransaction();
+        BOOST_CHECK_EQUAL(tx.vin.size(), spent.at(i).size());
+        for (size_t in = 0; in < tx.vin.size(); ++in) {
+            Script::State state(flags);
+            TransactionSignatureChecker checker(&tx, static_cast<unsigned int>(in), spent.at(i).at(in).amount);
+            BOOST_CHECK_MESSAGE(Script::verify(tx.vin[in].scriptSig, spent.at(i).at(in).script, checker, state),
+                                state.errorString());
+        }
+    }
+
+    // all transactions are stored back to back in one buffer.
+    for (size_t i = 1; i < bulk.size(); ++i) {
+        BOOST_CHECK(bulk.at(i - 1).data().end() == bulk.at(i).data().begin());
+    }
+
+    BOOST_CHECK(TransactionBuilder::createTransactions(std::vector<TransactionBuilder*>()).empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
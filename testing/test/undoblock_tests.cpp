@@ -0,0 +1,161 @@
+/*
+ * This file is part of the Flowee project
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test/test_bitcoin.h"
+
+#include <primitives/FastUndoBlock.h>
+#include <random.h>
+#include <streaming/BufferPool.h>
+#include <streaming/MessageBuilder.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <string.h>
+#include <tuple>
+
+namespace {
+typedef std::tuple<uint256, int, int, int> ItemKey;
+
+ItemKey key(const FastUndoBlock::Item &item)
+{
+    return std::make_tuple(item.prevTxId, item.outputIndex, item.blockHeight, item.offsetInBlock);
+}
+
+Streaming::ConstBuffer join(const std::deque<Streaming::ConstBuffer> &chunks)
+{
+    int size = 0;
+    for (const auto &chunk : chunks) {
+        size += chunk.size();
+    }
+    Streaming::BufferPool pool(size);
+    char *pos = pool.begin();
+    for (const auto &chunk : chunks) {
+        memcpy(pos, chunk.begin(), static_cast<size_t>(chunk.size()));
+        pos += chunk.size();
+    }
+    return pool.commit(size);
+}
+
+std::vector<ItemKey> readAll(FastUndoBlock &block)
+{
+    std::vector<ItemKey> answer;
+    while (true) {
+        auto item = block.nextItem();
+        if (!item.isValid())
+            break;
+        answer.push_back(key(item));
+    }
+    std::sort(answer.begin(), answer.end());
+    return answer;
+}
+
+std::deque<FastUndoBlock::Item> createItems(int transactions, uint32_t seed)
+{
+    std::deque<FastUndoBlock::Item> items;
+    for (int tx = 0; tx < transactions; ++tx) {
+        // two inputs, one of them spending two outputs of the same transaction
+        uint256 prevTx = GetRandHash();
+        const int height = 1000 + static_cast<int>(seed % 50) + tx % 7;
+        items.push_back(FastUndoBlock::Item(prevTx, 1, height, 81 + tx * 300));
+        items.push_back(FastUndoBlock::Item(prevTx, 3, height, 81 + tx * 300));
+        items.push_back(FastUndoBlock::Item(GetRandHash(), 0, height - 100, 5000 + tx));
+        // the created outputs
+        const uint256 txid = GetRandHash();
+        for (int out = 0; out < 2 + tx % 5; ++out) {
+            items.push_back(FastUndoBlock::Item(txid, out));
+        }
+    }
+    return items;
+}
+}
+
+BOOST_FIXTURE_TEST_SUITE(undoblock_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(undoblock_roundtrip)
+{
+    auto chunk1 = createItems(50, 1);
+    auto chunk2 = createItems(30, 2);
+    // gaps and a group that doesn't start at zero
+    const uint256 txid = GetRandHash();
+    chunk2.push_back(FastUndoBlock::Item(txid, 2));
+    chunk2.push_back(FastUndoBlock::Item(txid, 5));
+    chunk2.push_back(FastUndoBlock::Item(txid, 6));
+    chunk2.push_back(FastUndoBlock::Item(GetRandHash(), 1, 10, 100000000));
+
+    UndoBlockBuilder builder(GetRandHash());
+    builder.append(chunk1);
+    builder.append(std::deque<FastUndoBlock::Item>());
+    builder.append(chunk2);
+
+    std::vector<ItemKey> expected;
+    for (const auto &item : chunk1) expected.push_back(key(item));
+    for (const auto &item : chunk2) expected.push_back(key(item));
+    std::sort(expected.begin(), expected.end());
+
+    FastUndoBlock block(join(builder.finish()));
+    BOOST_CHECK_EQUAL(block.version(), 2);
+    BOOST_CHECK(readAll(block) == expected);
+    BOOST_CHECK(!block.nextItem().isValid());
+
+    block.restartStream();
+    BOOST_CHECK_EQUAL(block.version(), 2);
+    BOOST_CHECK(readAll(block) == expected);
+}
+
+BOOST_AUTO_TEST_CASE(undoblock_read_v1)
+{
+    // the tags of the version 1 format
+    enum { StartBlock = 0x10, RMTxId, RMTxOutIndex, InsTxId, InsTxOutIndex, InsBlockHeight, InsOffsetInBlock };
+
+    const auto items = createItems(20, 3);
+    Streaming::BufferPool pool;
+    pool.reserve(static_cast<int>(items.size()) * 60 + 40);
+    Streaming::MessageBuilder builder(pool);
+    builder.add(StartBlock, GetRandHash());
+    std::vector<ItemKey> expected;
+    for (const auto &item : items) {
+        expected.push_back(key(item));
+        if (item.isInsert()) {
+            builder.add(RMTxId, item.prevTxId);
+            builder.add(RMTxOutIndex, item.outputIndex);
+        } else {
+            builder.add(InsTxId, item.prevTxId);
+            builder.add(InsTxOutIndex, item.outputIndex);
+            builder.add(InsBlockHeight, item.blockHeight);
+            builder.add(InsOffsetInBlock, item.offsetInBlock);
+        }
+    }
+    std::sort(expected.begin(), expected.end());
+
+    FastUndoBlock block(builder.buffer());
+    BOOST_CHECK_EQUAL(block.version(), 1);
+    BOOST_CHECK(readAll(block) == expected);
+    block.restartStream();
+    BOOST_CHECK(readAll(block) == expected);
+    const int v1Size = block.size();
+
+    // and the same data in the new format should be a lot smaller.
+    UndoBlockBuilder v2Builder(GetRandHash());
+    v2Builder.append(items);
+    FastUndoBlock v2(join(v2Builder.finish()));
+    BOOST_CHECK(readAll(v2) == expected);
+    BOOST_CHECK_LT(v2.size() * 10, v1Size * 7);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,89 @@
+/*
+ * This file is part of the Flowee project
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "LatencyHistogram.h"
+
+#include <algorithm>
+#include <cassert>
+
+LatencyHistogram::LatencyHistogram()
+    : m_buckets(64, 0)
+{
+}
+
+void LatencyHistogram::add(int64_t microseconds)
+{
+    microseconds = std::max<int64_t>(0, microseconds);
+    if (!m_samples.empty() && microseconds < m_samples.back())
+        m_sorted = false;
+    m_samples.push_back(microseconds);
+    m_total += microseconds;
+
+    int bucket = 0;
+    while (bucket < 63 && (int64_t(1) << bucket) <= microseconds)
+        ++bucket;
+    ++m_buckets[bucket];
+}
+
+int LatencyHistogram::count() const
+{
+    return static_cast<int>(m_samples.size());
+}
+
+int64_t LatencyHistogram::min() const
+{
+    if (m_samples.empty())
+        return 0;
+    return percentile(0);
+}
+
+int64_t LatencyHistogram::max() const
+{
+    if (m_samples.empty())
+        return 0;
+    return percentile(1);
+}
+
+int64_t LatencyHistogram::mean() const
+{
+    if (m_samples.empty())
+        return 0;
+    return m_total / static_cast<int64_t>(m_samples.size());
+}
+
+int64_t LatencyHistogram::percentile(double fraction) const
+{
+    if (m_samples.empty())
+        return 0;
+    assert(fraction >= 0 && fraction <= 1);
+    if (!m_sorted) {
+        std::sort(m_samples.begin(), m_samples.end());
+        m_sorted = true;
+    }
+    const size_t index = static_cast<size_t>(fraction * (m_samples.size() - 1) + 0.5);
+    return m_samples.at(std::min(index, m_samples.size() - 1));
+}
+
+std::vector<LatencyHistogram::Bucket> LatencyHistogram::buckets() const
+{
+    std::vector<Bucket> answer;
+    for (size_t i = 0; i < m_buckets.size(); ++i) {
+        if (m_buckets.at(i) > 0)
+            answer.push_back({int64_t(1) << i, m_buckets.at(i)});
+    }
+    return answer;
+}
@@ -0,0 +1,58 @@
+/*
+ * This file is part of the Flowee project
+ * Copyright (C) 2021 Tom Zander <tom@flowee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Collects latencies (in microseconds) and reports their distribution.
+ *
+ * Samples are bucketed in powers of two, the percentiles are calculated
+ * from the exact samples which are all kept.
+ */
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void add(int64_t microseconds);
+
+    int count() const;
+    int64_t min() const;
+    int64_t max() const;
+    int64_t mean() const;
+    /// returns the latency below which \a fraction (0 to 1) of the samples fall.
+    int64_t percentile(double fraction) const;
+
+    struct Bucket {
+        int64_t upTo; // exclusive upper bound, in microseconds
+        int count;
+    };
+    /// returns the non-empty buckets, sorted.
+    std::vector<Bucket> buckets() const;
+
+private:
+    mutable std::vector<int64_t> m_samples;
+    mutable bool m_sorted = true;
+    std::vector<int> m_buckets;
+    int64_t m_total = 0;
+};
+
+#endif
@@ -28,12 +28,22 @@
 #include <boost/algorithm/hex.hpp>
 #include <algorithm>
 #include <base58.h>
+#include <memory>
 #include <random>
 
 #define MIN_FEE 1000
 
+// used in the deterministic mode
+static constexpr int DefaultChainLength = 5;
+static constexpr int ConsolidationInputs = 20;
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QStandardPaths>
 #include <cashaddr.h>
+#include <hash.h>
 #include <qtimer.h>
 
 enum PrivateTags {
@@ -60,6 +70,7 @@ TxVulcano::TxVulcano(boost::asio::io_service &ioService, const QString &walletna
 
 TxVulcano::~TxVulcano()
 {
+    writeReport();
     m_workerThread.exit(0);
     m_workerThread.wait();
 }
@@ -99,6 +110,19 @@ void TxVulcano::connectionEstablished(const EndPoint &)
     m_connection.send(Message(Api::APIService, Api::Meta::Version));
 
     QMutexLocker lock(&m_walletMutex);
+    if (m_deterministic) {
+        // derive the keys from the seed instead of asking the Hub for random ones.
+        for (int i = m_wallet.keyCount(); i < 100; ++i) {
+            CHashWriter ss(SER_GETHASH, 0);
+            ss << std::string("txVulcano") << m_seed << i;
+            const uint256 secret = ss.finalizeHash();
+            CKey key;
+            key.Set(secret.begin(), secret.end(), true);
+            if (key.IsValid())
+                m_wallet.addKey(key);
+        }
+        m_wallet.saveKeys();
+    }
     // fill the wallet with private keys
     int count = 100 - m_wallet.keyCount();
     Message createAddressRequest(Api::UtilService, Api::Util::CreateAddress);
@@ -145,10 +169,13 @@ void TxVulcano::incomingMessage(const Message& message)
         }
         if (serviceId == Api::LiveTransactionService && messageId == Api::LiveTransactions::SendTransaction) {
             int requestId = message.headerInt(Api::RequestId);
+            QMutexLocker lock(&m_walletMutex);
             QMutexLocker lock2(&m_miscMutex);
             auto iter = m_transactionsInProgress.find(requestId);
-            if (iter != m_transactionsInProgress.end())
+            if (iter != m_transactionsInProgress.end()) {
+                m_transactionsFailed += iter->second.count;
                 m_transactionsInProgress.erase(iter);
+            }
         }
         // logDebug().nospace()
         //     << "incoming message recived a '" << errorMessage  << "` notification. S/C: " << serviceId << "/" << messageId;
@@ -213,6 +240,10 @@ void TxVulcano::incomingMessage(const Message& message)
         emit newBlockFound(message);
     }
     else if (message.serviceId() == Api::RegTestService && message.messageId() == Api::RegTest::GenerateBlockReply) {
+        QMutexLocker lock(&m_walletMutex);
+        if (m_waitingForBlock)
+            m_generateLatency.add(std::chrono::duration_cast<std::chrono::microseconds>(
+                                      std::chrono::steady_clock::now() - m_generateSent).count());
         Streaming::MessageParser parser(message.body());
         while (parser.next() == Streaming::FoundTag) {
             if (parser.tag() == Api::RegTest::BlockHash)
@@ -233,6 +264,11 @@ void TxVulcano::incomingMessage(const Message& message)
             if (parser.tag() == Api::BlockNotification::BlockHash) {
                 logInfo() << "Hub mined or found a new block:" << parser.uint256Data();
                 QMutexLocker lock(&m_walletMutex);
+                if (m_waitingForBlock) {
+                    m_blockNotificationLatency.add(std::chrono::duration_cast<std::chrono::microseconds>(
+                                                       std::chrono::steady_clock::now() - m_generateSent).count());
+                    m_waitingForBlock = false;
+                }
                 m_pool.reserve(40 + m_wallet.publicKeys().size() * 35);
                 Streaming::MessageBuilder builder(m_pool);
                 builder.add(Api::BlockChain::BlockHash, parser.uint256Data());
@@ -251,6 +287,8 @@ void TxVulcano::incomingMessage(const Message& message)
         auto item = m_transactionsInProgress.find(message.headerInt(Api::RequestId));
         if (item != m_transactionsInProgress.end()) {
             UnvalidatedTransaction txData = item->second;
+            m_submitLatency.add(std::chrono::duration_cast<std::chrono::microseconds>(
+                                    std::chrono::steady_clock::now() - txData.submitted).count());
             const uint256 hash = txData.transaction.createHash();
             int64_t amount = -1;
             int outIndex = 0;
@@ -259,6 +297,8 @@ void TxVulcano::incomingMessage(const Message& message)
                 if (iter.tag() == Tx::OutputValue)
                     amount = iter.longData();
                 else if (iter.tag() == Tx::OutputScript) {
+                    if (outIndex == int(txData.pubKeys.size())) // the OP_RETURN output
+                        break;
                     auto constBuf = iter.byteData();
                     CScript script = CScript(reinterpret_cast<const unsigned char*>(constBuf.begin()),
                             reinterpret_cast<const unsigned char*>(constBuf.end()));
@@ -268,6 +308,7 @@ void TxVulcano::incomingMessage(const Message& message)
                     ++outIndex;
                 }
             }
+            m_transactionsAccepted += txData.count;
             m_transactionsInProgress.erase(item);
             if (++m_transactionsCreated > m_transactionsToCreate && m_transactionsToCreate > 0) {
                 m_timer.cancel();
@@ -276,7 +317,7 @@ void TxVulcano::incomingMessage(const Message& message)
                 m_connection.disconnect();
                 QCoreApplication::exit(0);
             }
-            m_blockSizeLeft -= txData.transaction.size();
+            m_blockSizeLeft -= txData.size;
             if (m_lastPrintedBlockSizeLeft - m_blockSizeLeft > 10000000) {
                 m_lastPrintedBlockSizeLeft = m_blockSizeLeft;
                 logCritical() << "Block still"
@@ -409,10 +450,15 @@ void TxVulcano::createTransactions_priv()
      * What about I add a list of those in this class?
      */
 
+    QMutexLocker lock(&m_walletMutex);
+    const TxShape shape = nextShape();
     TransactionBuilder builder;
+    int chainLength = 1;
+    if (shape == Chain)
+        chainLength = m_orphanChainLength > 1 ? m_orphanChainLength : DefaultChainLength;
+    const int maxInputs = shape == Consolidation ? ConsolidationInputs : 1000;
     short unconfirmedDepth = 0;
     int64_t amount = 0;
-    QMutexLocker lock(&m_walletMutex);
     for (auto utxo = m_wallet.unspentOutputs().begin(); utxo != m_wallet.unspentOutputs().end();) {
         if (utxo->coinbaseHeight > 0 && utxo->coinbaseHeight + 99 > m_highestBlock) {// coinbase maturity
             ++utxo;
@@ -429,10 +475,12 @@ void TxVulcano::createTransactions_priv()
         builder.pushInputSignature(*key, utxo->prevOutScript, utxo->amount, TransactionBuilder::Schnorr);
         utxo = m_wallet.spendOutput(utxo);
         unconfirmedDepth = std::max(unconfirmedDepth, utxo->unconfirmedDepth);
-        if (amount > 12500)
+        if (builder.inputCount() >= maxInputs)
+            break;
+        if (shape != Consolidation && amount > 12500 + MIN_FEE * (chainLength - 1))
             break;
     }
-    if (amount < 10000) {
+    if (amount < 10000 + MIN_FEE * (chainLength - 1)) {
         logCritical() << "No matured coins available.";
         m_timer.cancel();
         m_timer.expires_from_now(boost::posix_time::seconds(1));
@@ -455,51 +503,140 @@ void TxVulcano::createTransactions_priv()
         m_outOfCoin = false;
     }
 
-    const int OutputCount = m_wallet.unspentOutputs().size() < 5000 ? 20 :
-                            m_wallet.unspentOutputs().size() < 20000 ? 10 : 2;
-    const int64_t outAmount = (amount - MIN_FEE - 100 * OutputCount) / OutputCount;
+    int OutputCount = m_wallet.unspentOutputs().size() < 5000 ? 20 :
+                      m_wallet.unspentOutputs().size() < 20000 ? 10 : 2;
+    if (shape == Consolidation)
+        OutputCount = 1;
+    // the fee for the inputs, all of them are in the first transaction of a chain.
+    const int64_t inputsFee = 150 * builder.inputCount();
+    const int64_t outAmount = (amount - inputsFee - MIN_FEE * chainLength - 100 * OutputCount) / OutputCount;
 
     UnvalidatedTransaction unvalidatedTransaction;
-    unvalidatedTransaction.unconfirmedDepth = unconfirmedDepth;
+    unvalidatedTransaction.unconfirmedDepth = unconfirmedDepth + chainLength - 1;
 
     auto pubKeys = m_wallet.publicKeys();
-    static auto engine = std::default_random_engine{};
-    std::shuffle(std::begin(pubKeys), std::end(pubKeys), engine);
+    // Fisher-Yates, std::shuffle differs between implementations which would make runs unreproducible.
+    for (size_t i = pubKeys.size(); i > 1; --i) {
+        std::swap(pubKeys[i - 1], pubKeys[m_random() % i]);
+    }
+
+    /*
+     * When creating chains we first create a chain of transactions with one output
+     * each, only the last in the chain gets the normal outputs.
+     */
+    std::vector<Tx> chain;
+    TransactionBuilder *current = &builder;
+    std::unique_ptr<TransactionBuilder> chainBuilder;
+    if (chainLength > 1) {
+        const int keyId = pubKeys.front();
+        const CKey *key = m_wallet.privateKey(keyId);
+        assert(key);
+        const CKeyID address = m_wallet.publicKey(keyId).getKeyId();
+        const CScript prevOutScript = CScript() << OP_DUP << OP_HASH160 << ToByteVector(address)
+                                                << OP_EQUALVERIFY << OP_CHECKSIG;
+        int64_t chainAmount = amount - inputsFee;
+        for (int i = 1; i < chainLength; ++i) {
+            chainAmount -= MIN_FEE;
+            current->appendOutput(chainAmount);
+            current->pushOutputPay2Address(address);
+            m_Txpool.reserve(1000);
+            chain.push_back(current->createTransaction(&m_Txpool));
+            unvalidatedTransaction.size += chain.back().size();
+
+            chainBuilder.reset(new TransactionBuilder());
+            current = chainBuilder.get();
+            current->appendInput(chain.back().createHash(), 0);
+            current->pushInputSignature(*key, prevOutScript, chainAmount, TransactionBuilder::Schnorr);
+        }
+    }
+
     int count = 0;
     for (auto out : pubKeys) {
         if (count++ == OutputCount)
             break;
-        builder.appendOutput(outAmount);
-        builder.pushOutputPay2Address(m_wallet.publicKey(out).getKeyId());
+        current->appendOutput(outAmount);
+        current->pushOutputPay2Address(m_wallet.publicKey(out).getKeyId());
         unvalidatedTransaction.pubKeys.push_back(out);
     }
     assert(count > 0);
+    if (shape == OpReturn) { // goes last, after the outputs we track in pubKeys
+        std::vector<uint8_t> data(40);
+        for (size_t i = 0; i < data.size(); ++i) {
+            data[i] = static_cast<uint8_t>(m_random());
+        }
+        current->appendOutput(0);
+        current->pushOutputNullData(data);
+    }
 
-    m_Txpool.reserve(1000); // Should be plenty
-    Tx signedTx = builder.createTransaction(&m_Txpool);
-
-    m_Txpool.reserve(signedTx.size() + 30);
-    Streaming::MessageBuilder mb(m_Txpool);
-    mb.add(Api::LiveTransactions::Transaction, signedTx.data());
-    Message m(mb.message(Api::LiveTransactionService, Api::LiveTransactions::SendTransaction));
-    if (m_serverSupportsAsync)
-        m.setHeaderInt(Api::ASyncRequest, true);
-
+    m_Txpool.reserve(current->inputCount() * 150 + 1000); // Should be plenty
+    Tx signedTx = current->createTransaction(&m_Txpool);
+    chain.push_back(signedTx);
+    unvalidatedTransaction.size += signedTx.size();
+    unvalidatedTransaction.count = static_cast<int>(chain.size());
     unvalidatedTransaction.transaction = signedTx;
-    {
-        QMutexLocker lock(&m_miscMutex);
-        const int id = ++m_lastId;
-        m_transactionsInProgress.insert(std::make_pair(id, unvalidatedTransaction));
-        m.setHeaderInt(Api::RequestId, id);
-    }
-    m_connection.send(m);
 
+    /*
+     * In orphan-chain mode the chain is sent children-first, the Hub keeps them in its
+     * orphan-cache until the first one arrives.
+     * The reply to the last transaction we send is what tells us the chain got accepted.
+     */
+    const bool childrenFirst = m_orphanChainLength > 1;
+    if (childrenFirst)
+        std::reverse(chain.begin(), chain.end());
+    if (m_transactionsSent == 0)
+        m_runStarted = std::chrono::steady_clock::now();
+    unvalidatedTransaction.submitted = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < chain.size(); ++i) {
+        const Tx &tx = chain.at(i);
+        m_Txpool.reserve(tx.size() + 30);
+        Streaming::MessageBuilder mb(m_Txpool);
+        mb.add(Api::LiveTransactions::Transaction, tx.data());
+        if (childrenFirst)
+            mb.add(Api::LiveTransactions::KeepOrphan, true);
+        Message m(mb.message(Api::LiveTransactionService, Api::LiveTransactions::SendTransaction));
+        if (m_serverSupportsAsync)
+            m.setHeaderInt(Api::ASyncRequest, true);
+
+        if (i == chain.size() - 1) {
+            QMutexLocker lock(&m_miscMutex);
+            const int id = ++m_lastId;
+            m_transactionsInProgress.insert(std::make_pair(id, unvalidatedTransaction));
+            m.setHeaderInt(Api::RequestId, id);
+        }
+        m_connection.send(m);
+    }
+    m_transactionsSent += static_cast<int>(chain.size());
+    m_bytesSent += unvalidatedTransaction.size;
+    ++m_shapeCounts[shape];
+
+    int64_t delay = 0;
+    if (m_transactionRate > 0) {
+        // plan relative to the start of the run, to not drift from the requested rate.
+        const auto due = m_runStarted + std::chrono::microseconds(int64_t(m_transactionsSent) * 1000000 / m_transactionRate);
+        delay = std::chrono::duration_cast<std::chrono::milliseconds>(due - std::chrono::steady_clock::now()).count();
+    }
     // wait until next eventloop so we still do network in the meantime
     m_timer.cancel();
-    m_timer.expires_from_now(boost::posix_time::milliseconds(0));
+    m_timer.expires_from_now(boost::posix_time::milliseconds(std::max<int64_t>(0, delay)));
     m_timer.async_wait(std::bind(&TxVulcano::createTransactions, this, std::placeholders::_1));
 }
 
+TxVulcano::TxShape TxVulcano::nextShape()
+{
+    if (!m_deterministic)
+        return m_orphanChainLength > 1 ? Chain : PayToAddress;
+
+    // the fixed mix; 60% pay-to-address, 15% consolidations, 15% chains and 10% OP_RETURN.
+    const uint32_t pick = m_random() % 100;
+    if (pick < 60)
+        return PayToAddress;
+    if (pick < 75)
+        return Consolidation;
+    if (pick < 90)
+        return Chain;
+    return OpReturn;
+}
+
 std::vector<char> TxVulcano::createOutScript(const std::vector<char> &address)
 {
     const uint8_t OP_DUP = 0x76;
@@ -559,6 +696,8 @@ void TxVulcano::generate(int blockCount)
     const CKeyID id = m_wallet.publicKey(pkId).getKeyId();
     builder.addByteArray(Api::RegTest::BitcoinP2PKHAddress, id.begin(), id.size());
     builder.add(Api::RegTest::Amount, blockCount);
+    m_generateSent = std::chrono::steady_clock::now();
+    m_waitingForBlock = true;
     auto log = logCritical() << "  Sending generate";
     if (m_blockSizeLeft >= 1000)
         log << "The block size we aimed for is still" << (m_blockSizeLeft / 1000) << "KB away";
@@ -570,6 +709,102 @@ bool TxVulcano::canRunGenerate() const
     return m_canRunGenerate;
 }
 
+void TxVulcano::setOrphanChainLength(int length)
+{
+    assert(length >= 0);
+    m_orphanChainLength = length;
+}
+
+void TxVulcano::setSeed(uint32_t seed)
+{
+    QMutexLocker lock(&m_walletMutex);
+    // a reproducible run can't depend on what an earlier run left in the wallet.
+    // The keys are derived from the seed, so they don't need to be saved either.
+    m_wallet.clear();
+    m_deterministic = true;
+    m_seed = seed;
+    m_random.seed(seed);
+}
+
+void TxVulcano::setTransactionRate(int perSecond)
+{
+    assert(perSecond >= 0);
+    m_transactionRate = perSecond;
+}
+
+void TxVulcano::setReportFile(const QString &filename)
+{
+    m_reportFile = filename;
+}
+
+namespace {
+QJsonObject toJson(const LatencyHistogram &histogram)
+{
+    QJsonObject answer;
+    answer.insert("count", histogram.count());
+    answer.insert("minUs", static_cast<double>(histogram.min()));
+    answer.insert("maxUs", static_cast<double>(histogram.max()));
+    answer.insert("meanUs", static_cast<double>(histogram.mean()));
+    answer.insert("p50Us", static_cast<double>(histogram.percentile(0.5)));
+    answer.insert("p90Us", static_cast<double>(histogram.percentile(0.9)));
+    answer.insert("p99Us", static_cast<double>(histogram.percentile(0.99)));
+    answer.insert("p999Us", static_cast<double>(histogram.percentile(0.999)));
+    QJsonArray buckets;
+    for (const auto &bucket : histogram.buckets()) {
+        QJsonObject b;
+        b.insert("belowUs", static_cast<double>(bucket.upTo));
+        b.insert("count", bucket.count);
+        buckets.append(b);
+    }
+    answer.insert("buckets", buckets);
+    return answer;
+}
+}
+
+void TxVulcano::writeReport()
+{
+    QMutexLocker lock(&m_walletMutex);
+    if (m_reportFile.isEmpty())
+        return;
+    QJsonObject root;
+    if (m_deterministic)
+        root.insert("seed", static_cast<double>(m_seed));
+    root.insert("targetRate", m_transactionRate);
+    double duration = 0;
+    if (m_transactionsSent > 0)
+        duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_runStarted).count();
+    root.insert("durationMs", duration);
+
+    QJsonObject transactions;
+    transactions.insert("sent", m_transactionsSent);
+    transactions.insert("accepted", m_transactionsAccepted);
+    transactions.insert("failed", m_transactionsFailed);
+    transactions.insert("bytes", static_cast<double>(m_bytesSent));
+    if (duration > 0)
+        transactions.insert("perSecond", m_transactionsSent * 1000. / duration);
+    root.insert("transactions", transactions);
+
+    QJsonObject shapes;
+    shapes.insert("payToAddress", m_shapeCounts[PayToAddress]);
+    shapes.insert("consolidation", m_shapeCounts[Consolidation]);
+    shapes.insert("chain", m_shapeCounts[Chain]);
+    shapes.insert("opReturn", m_shapeCounts[OpReturn]);
+    root.insert("shapes", shapes);
+
+    root.insert("submitLatency", toJson(m_submitLatency));
+    root.insert("generateLatency", toJson(m_generateLatency));
+    root.insert("blockNotificationLatency", toJson(m_blockNotificationLatency));
+
+    QFile file(m_reportFile);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        logFatal() << "Failed to write the report to" << m_reportFile;
+        return;
+    }
+    file.write(QJsonDocument(root).toJson());
+    logCritical() << "Wrote the report to" << m_reportFile;
+    m_reportFile.clear(); // only once
+}
+
 void TxVulcano::setCanRunGenerate(bool canRunGenerate)
 {
     m_canRunGenerate = canRunGenerate;
@@ -20,6 +20,7 @@
 
 #include <QString>
 
+#include "LatencyHistogram.h"
 #include "Wallet.h"
 
 #include <streaming/BufferPool.h>
@@ -33,6 +34,8 @@
 #include <qlist.h>
 #include <qmutex.h>
 #include <qthread.h>
+#include <chrono>
+#include <random>
 #include <vector>
 
 namespace Streaming {
@@ -61,6 +64,31 @@ public:
      */
     void setAddressesAreOwned(bool yes);
 
+    /**
+     * Create chains of \a length transactions, sent to the Hub children-first
+     * which makes it put all but the first in its orphan-cache.
+     */
+    void setOrphanChainLength(int length);
+
+    /**
+     * Make the run reproducible.
+     * The keys are derived from the \a seed instead of fetched from the Hub and
+     * all random choices, including the shape of each transaction, are seeded.
+     * The transaction shapes are picked from a fixed mix of pay-to-address,
+     * consolidation, chained and OP_RETURN carrying transactions.
+     */
+    void setSeed(uint32_t seed);
+
+    /// Limit the creation of transactions to \a perSecond, zero means as fast as possible.
+    void setTransactionRate(int perSecond);
+
+    /**
+     * Write the statistics of the run as JSON to \a filename when the run ends.
+     * This includes the latency between sending a transaction and the Hub's reply, and
+     * the time between asking for a block to be generated and the notification of it.
+     */
+    void setReportFile(const QString &filename);
+
     bool canRunGenerate() const;
     void setCanRunGenerate(bool canRunGenerate);
 
@@ -87,6 +115,15 @@ private:
 
     void nowCurrent(); // called when the client has seen all blocks the upstread knows about
 
+    enum TxShape {
+        PayToAddress,   // one or a few inputs, many outputs
+        Consolidation,  // many inputs, one output
+        Chain,          // a chain of transactions, each spending the previous
+        OpReturn        // pay to address with an extra OP_RETURN output
+    };
+    TxShape nextShape();
+    void writeReport();
+
     void generate(int blockCount = 1); // generate a block;
 
     NetworkManager m_networkManager;
@@ -108,13 +145,35 @@ private:
     struct UnvalidatedTransaction {
         Tx transaction;
         int unconfirmedDepth = 0;
+        int size = 0; // the size of all transactions in the chain
+        int count = 1; // the number of transactions in the chain
         std::vector<int> pubKeys;
+        std::chrono::steady_clock::time_point submitted;
     };
 
     QMutex m_miscMutex;
     std::map<int, UnvalidatedTransaction> m_transactionsInProgress;
     int m_lastId = 0;
     bool m_canRunGenerate = false; // i.e. we run on regtest where mining is an API command.
+    int m_orphanChainLength = 0;
+
+    // reproducible runs and statistics. Protected by m_walletMutex
+    bool m_deterministic = false;
+    uint32_t m_seed = 0;
+    std::mt19937 m_random;
+    int m_transactionRate = 0;
+    int m_transactionsSent = 0;
+    int m_transactionsAccepted = 0; // counts each transaction of a chain
+    int m_transactionsFailed = 0;
+    int64_t m_bytesSent = 0;
+    int m_shapeCounts[4] = { 0, 0, 0, 0 };
+    std::chrono::steady_clock::time_point m_runStarted;
+    std::chrono::steady_clock::time_point m_generateSent;
+    bool m_waitingForBlock = false;
+    LatencyHistogram m_submitLatency;
+    LatencyHistogram m_generateLatency;
+    LatencyHistogram m_blockNotificationLatency;
+    QString m_reportFile;
 
     QMutex m_walletMutex;
     Wallet m_wallet;
@@ -105,6 +105,17 @@ void Wallet::clearUnconfirmedUTXOs()
     }
 }
 
+void Wallet::clear()
+{
+    m_keys.clear();
+    m_pubkeys.clear();
+    m_walletItems.clear();
+    m_unspentOutputs.clear();
+    m_lastCachedBlock.SetNull();
+    m_privKeysNeedsSave = false;
+    m_saveToDisk = false;
+}
+
 const CKey *Wallet::privateKey(int keyId) const
 {
     for (auto iter = m_keys.begin(); iter != m_keys.end(); ++iter) {
@@ -142,7 +153,7 @@ std::vector<int> Wallet::publicKeys() const
 
 void Wallet::saveKeys()
 {
-    if (!m_privKeysNeedsSave)
+    if (!m_privKeysNeedsSave || !m_saveToDisk)
         return;
     QFileInfo info(m_dbFile);
     if (!info.dir().exists()) {
@@ -57,6 +57,11 @@ public:
     void addOutput(int blockHeight, const uint256 &txid, int offsetInBlock, int outIndex, int64_t amount, const CKeyID &destAddress, const CScript &script);
     void addOutput(const uint256 &txid, int outIndex, int64_t amount, int keyId, short unconfirmedDepth, const CScript &script);
     void clearUnconfirmedUTXOs();
+    /**
+     * Forget all keys and outputs.
+     * The keys saved on disk are left alone, this wallet will no longer write to that file.
+     */
+    void clear();
 
     int keyCount() const {
         return static_cast<int>(m_keys.size());
@@ -123,6 +128,7 @@ private:
     uint256 m_lastCachedBlock;
 
     bool m_privKeysNeedsSave = false;
+    bool m_saveToDisk = true;
 };
 
 #endif
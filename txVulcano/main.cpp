@@ -40,6 +40,14 @@ int main(int argc, char **argv)
     parser.addOption(txLimit);
     QCommandLineOption scalenet(QStringList() << "scalenet", "Run on Scalenet");
     parser.addOption(scalenet);
+    QCommandLineOption orphanChains(QStringList() << "orphan-chains", "Create chains of transactions which are sent in reverse order, to stress the Hub's orphan handling", "length");
+    parser.addOption(orphanChains);
+    QCommandLineOption seed(QStringList() << "seed", "Make the run reproducible, derives keys and all random choices from <seed>", "seed");
+    parser.addOption(seed);
+    QCommandLineOption rate(QStringList() << "rate", "Limit to <tps> transactions per second", "tps");
+    parser.addOption(rate);
+    QCommandLineOption report(QStringList() << "report", "Write statistics, including latencies, as JSON to <file> at the end of the run", "file");
+    parser.addOption(report);
     QCommandLineOption privkey(QStringList() << "key", "Pass in a private key which is used on scalenet", "key");
     parser.addOption(privkey);
 
@@ -55,8 +63,32 @@ int main(int argc, char **argv)
     else
         SelectParams("regtest");
 
+    uint32_t seedValue = 0;
+    if (parser.isSet(seed)) {
+        bool ok;
+        seedValue = parser.value(seed).toUInt(&ok);
+        if (!ok) {
+            logFatal() << "seed has to be a number between 0 and 4294967295";
+            return 1;
+        }
+    }
+    QString walletName = useScalenet ? "scalenet_wallet" : "mywallet";
+
     WorkerThreads workers;
-    TxVulcano vulcano(workers.ioService(), useScalenet ? "scalenet_wallet" : "mywallet");
+    TxVulcano vulcano(workers.ioService(), walletName);
+    if (parser.isSet(seed))
+        vulcano.setSeed(seedValue);
+    if (parser.isSet(rate)) {
+        bool ok;
+        int tps = parser.value(rate).toInt(&ok);
+        if (!ok || tps < 1) {
+            logFatal() << "rate has to be a positive number";
+            return 1;
+        }
+        vulcano.setTransactionRate(tps);
+    }
+    if (parser.isSet(report))
+        vulcano.setReportFile(parser.value(report));
     if (parser.isSet(sizeLimit)) {
         bool ok;
         int sl = parser.value(sizeLimit).toInt(&ok);
@@ -83,6 +115,15 @@ int main(int argc, char **argv)
         }
         vulcano.setMaxNumTransactions(lim);
     }
+    if (parser.isSet(orphanChains)) {
+        bool ok;
+        int length = parser.value(orphanChains).toInt(&ok);
+        if (!ok || length < 2 || length > 20) {
+            logFatal() << "orphan-chains has to be a number between 2 and 20";
+            return 1;
+        }
+        vulcano.setOrphanChainLength(length);
+    }
     vulcano.setCanRunGenerate(!useScalenet);
     for (auto privKey : parser.values(privkey)) {
         if (!vulcano.addPrivKey(privKey)) // method prints error for us.